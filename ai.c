@@ -0,0 +1,292 @@
+/*
+ * RACHEL AI POLICIES
+ *
+ * Every bot that ever shipped in a front end, rebuilt on the rules
+ * engine so they can play each other without a screen.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <string.h>
+#include <time.h>
+#include "ai.h"
+#include "mcts.h"
+
+/* Suit we hold most of, ignoring jokers (hearts on a tie or empty hand) */
+uint8_t rachel_ai_best_suit(uint64_t hand_mask) {
+    uint8_t best = SUIT_HEARTS;
+    uint8_t best_count = RACHEL_MASK_COUNT(hand_mask & rachel_suit_masks[SUIT_HEARTS]);
+    uint8_t suit, count;
+
+    for (suit = SUIT_DIAMONDS; suit <= SUIT_SPADES; suit++) {
+        count = RACHEL_MASK_COUNT(hand_mask & rachel_suit_masks[suit]);
+        if (count > best_count) {
+            best = suit;
+            best_count = count;
+        }
+    }
+    return best;
+}
+
+/* Add every other held card of the first card's rank to the play */
+void rachel_ai_add_stack(const Game* game, uint8_t player_id, AiPlay* play) {
+    uint64_t same;
+    uint8_t rank = GET_RANK(play->cards[0].encoded);
+
+    same = game->players[player_id].hand_mask & rachel_rank_masks[rank & 0x0F];
+    same = rachel_mask_remove(same, play->cards[0]);
+
+    while (same && play->count < AI_MAX_STACK) {
+        play->cards[play->count++] = rachel_card_from_index(RACHEL_MASK_LOWEST(same));
+        same &= same - 1;
+    }
+}
+
+/* rachel.c ai_turn: first valid card, always nominate hearts */
+static void ai_choose_first(const Game* game, uint8_t player_id,
+                            RachelRng* rng, AiPlay* play) {
+    uint64_t valid = rachel_valid_plays_mask(game, player_id);
+
+    (void)rng;
+    play->cards[0] = rachel_card_from_index(RACHEL_MASK_LOWEST(valid));
+    play->count = 1;
+    play->nominated_suit = SUIT_HEARTS;
+}
+
+/* rachel_correct.c cpu_turn: first valid card plus every card of the
+ * same rank, random nomination. Counters an attack with a single card. */
+static void ai_choose_stack(const Game* game, uint8_t player_id,
+                            RachelRng* rng, AiPlay* play) {
+    uint64_t valid = rachel_valid_plays_mask(game, player_id);
+
+    play->cards[0] = rachel_card_from_index(RACHEL_MASK_LOWEST(valid));
+    play->count = 1;
+    if (game->pending_effect.count == 0) {
+        rachel_ai_add_stack(game, player_id, play);
+    }
+    play->nominated_suit = (uint8_t)rachel_rng_below(rng, 4);
+}
+
+/* Keep options open: play into our longest suit, hold aces and jokers
+ * back while anything else fits, stack, then nominate our longest suit. */
+static void ai_choose_suit(const Game* game, uint8_t player_id,
+                           RachelRng* rng, AiPlay* play) {
+    uint64_t hand = game->players[player_id].hand_mask;
+    uint64_t valid = rachel_valid_plays_mask(game, player_id);
+    uint64_t plain = valid & ~rachel_rank_masks[RANK_ACE] & ~RACHEL_MASK_JOKERS;
+    uint64_t in_suit;
+    uint8_t i;
+
+    (void)rng;
+    if (plain) {
+        valid = plain;
+    }
+
+    /* Prefer the valid card whose suit we hold most of */
+    in_suit = valid & rachel_suit_masks[rachel_ai_best_suit(hand)];
+    if (!in_suit) {
+        in_suit = valid;
+    }
+
+    play->cards[0] = rachel_card_from_index(RACHEL_MASK_LOWEST(in_suit));
+    play->count = 1;
+    if (game->pending_effect.count == 0) {
+        rachel_ai_add_stack(game, player_id, play);
+    }
+
+    for (i = 0; i < play->count; i++) {
+        hand = rachel_mask_remove(hand, play->cards[i]);
+    }
+    play->nominated_suit = rachel_ai_best_suit(hand);
+}
+
+const AiPolicy rachel_ai_policies[] = {
+    { "first", "First valid card, nominates hearts (rachel.c)",   ai_choose_first, 0 },
+    { "stack", "Stacks same rank, random suit (rachel_correct.c)", ai_choose_stack, 0 },
+    { "suit",  "Plays into its longest suit, saves wild cards",    ai_choose_suit, 0 },
+    { "ismcts", "Information-set MCTS, 200 samples per move",      rachel_mcts_policy_choose,
+      rachel_mcts_policy_choose_known },
+    { 0, 0, 0, 0 }
+};
+
+const AiPolicy* rachel_ai_find(const char* name) {
+    const AiPolicy* policy;
+
+    for (policy = rachel_ai_policies; policy->name; policy++) {
+        if (strcmp(policy->name, name) == 0) {
+            return policy;
+        }
+    }
+    return 0;
+}
+
+static uint64_t ai_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* Values below two steps get a bucket each; above, AI_LATENCY_STEPS
+ * buckets split each power of two */
+static unsigned ai_latency_bucket(uint64_t ns) {
+    unsigned octave;
+
+    if (ns < 2 * AI_LATENCY_STEPS) {
+        return (unsigned)ns;
+    }
+#if defined(__GNUC__)
+    octave = 63 - (unsigned)__builtin_clzll(ns);
+#else
+    for (octave = 4; octave < 63 && (ns >> (octave + 1)) != 0; octave++) {
+    }
+#endif
+    return (octave - 2) * AI_LATENCY_STEPS +
+           (unsigned)((ns >> (octave - 3)) & (AI_LATENCY_STEPS - 1));
+}
+
+/* Largest value that lands in a bucket */
+static uint64_t ai_latency_upper(unsigned bucket) {
+    unsigned octave;
+
+    if (bucket < 2 * AI_LATENCY_STEPS) {
+        return bucket;
+    }
+    octave = bucket / AI_LATENCY_STEPS + 2;
+    return (((uint64_t)(AI_LATENCY_STEPS + bucket % AI_LATENCY_STEPS) + 1)
+            << (octave - 3)) - 1;
+}
+
+void rachel_ai_latency_init(AiLatency* latency, uint64_t budget_ns) {
+    memset(latency, 0, sizeof(*latency));
+    latency->budget_ns = budget_ns;
+}
+
+void rachel_ai_latency_record(AiLatency* latency, uint64_t ns) {
+    latency->decisions++;
+    latency->total_ns += (double)ns;
+    latency->buckets[ai_latency_bucket(ns)]++;
+    if (ns > latency->max_ns) {
+        latency->max_ns = ns;
+    }
+    if (latency->budget_ns != 0 && ns > latency->budget_ns) {
+        latency->over_budget++;
+    }
+}
+
+void rachel_ai_latency_merge(AiLatency* total, const AiLatency* part) {
+    unsigned i;
+
+    total->decisions += part->decisions;
+    total->over_budget += part->over_budget;
+    total->total_ns += part->total_ns;
+    if (part->max_ns > total->max_ns) {
+        total->max_ns = part->max_ns;
+    }
+    for (i = 0; i < AI_LATENCY_BUCKETS; i++) {
+        total->buckets[i] += part->buckets[i];
+    }
+}
+
+uint64_t rachel_ai_latency_quantile(const AiLatency* latency, double fraction) {
+    unsigned long target = (unsigned long)(fraction * latency->decisions);
+    unsigned long seen = 0;
+    uint64_t upper;
+    unsigned i;
+
+    for (i = 0; i < AI_LATENCY_BUCKETS; i++) {
+        seen += latency->buckets[i];
+        if (seen > target) {
+            upper = ai_latency_upper(i);
+            return upper < latency->max_ns ? upper : latency->max_ns;
+        }
+    }
+    return latency->max_ns;
+}
+
+void rachel_ai_pass_turn_log(Game* game, EventLog* log) {
+    uint8_t effect_type;
+
+    if (game->pending_effect.count > 0) {
+        effect_type = game->pending_effect.type;
+        rachel_log_process_effects(log, game);
+        if (effect_type == RANK_7) {
+            return;  /* Skips already advanced the turn */
+        }
+    } else {
+        rachel_log_draw_cards(log, game, game->current_player_index, 1);
+    }
+
+    rachel_log_next_turn(log, game);
+}
+
+/* The policy's choice, from what the mover has seen if it can use that */
+static void ai_choose(const Game* game, const AiPolicy* policy, const Knowledge* know,
+                      RachelRng* rng, AiPlay* play) {
+    if (know != 0 && policy->choose_known != 0) {
+        policy->choose_known(game, game->current_player_index, know, rng, play);
+    } else {
+        policy->choose(game, game->current_player_index, rng, play);
+    }
+}
+
+/*
+ * One complete turn for the current player.
+ *
+ * Under a pending attack the player counters if they can, otherwise the
+ * effect is resolved: penalty draws end the turn, skips hand the turn on.
+ * Without an attack the player must play if they can and draws one card
+ * if they cannot. A policy that offers an illegal play is overruled with
+ * its first valid card - the rules say you must play.
+ */
+uint64_t rachel_ai_take_turn_known(Game* game, const AiPolicy* policy,
+                                   const Knowledge* know, RachelRng* rng,
+                                   EventLog* log, AiLatency* latency) {
+    uint8_t player_id = game->current_player_index;
+    uint64_t valid = rachel_valid_plays_mask(game, player_id);
+    uint64_t start, spent = 0;
+    AiPlay play;
+
+    if (valid) {
+        play.count = 0;
+        play.nominated_suit = SUIT_HEARTS;
+        if (latency != NULL) {
+            start = ai_now_ns();
+            ai_choose(game, policy, know, rng, &play);
+            spent = ai_now_ns() - start;
+            rachel_ai_latency_record(latency, spent);
+        } else {
+            ai_choose(game, policy, know, rng, &play);
+        }
+
+        if (play.count == 0 ||
+            !rachel_log_play_cards(log, game, player_id, play.cards, play.count,
+                                   play.nominated_suit)) {
+            play.cards[0] = rachel_card_from_index(RACHEL_MASK_LOWEST(valid));
+            rachel_log_play_cards(log, game, player_id, play.cards, 1, SUIT_HEARTS);
+        }
+        rachel_log_next_turn(log, game);
+        return spent;
+    }
+
+    rachel_ai_pass_turn_log(game, log);
+    return 0;
+}
+
+uint64_t rachel_ai_take_turn_timed(Game* game, const AiPolicy* policy,
+                                   RachelRng* rng, EventLog* log,
+                                   AiLatency* latency) {
+    return rachel_ai_take_turn_known(game, policy, 0, rng, log, latency);
+}
+
+void rachel_ai_take_turn_log(Game* game, const AiPolicy* policy, RachelRng* rng,
+                             EventLog* log) {
+    rachel_ai_take_turn_timed(game, policy, rng, log, 0);
+}
+
+void rachel_ai_take_turn(Game* game, const AiPolicy* policy, RachelRng* rng) {
+    rachel_ai_take_turn_log(game, policy, rng, 0);
+}
+
+void rachel_ai_pass_turn(Game* game) {
+    rachel_ai_pass_turn_log(game, 0);
+}
@@ -0,0 +1,112 @@
+/*
+ * RACHEL AI POLICIES
+ *
+ * Computer players built only on the public rules.h API.
+ * Pure C, no I/O, no globals - safe to run one game per thread.
+ *
+ * A policy is a vtable entry: anything that can fill in an AiPlay for
+ * a position can sit at a table. Callers that need to hold bots to a
+ * latency budget time each decision into an AiLatency.
+ *
+ * "The machine must play if it can, too."
+ */
+
+#ifndef RACHEL_AI_H
+#define RACHEL_AI_H
+
+#include "rules.h"
+#include "eventlog.h"
+#include "knowledge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AI_MAX_STACK 4    /* Four of a rank, or four jokers */
+
+/* One decision: the cards to put down, first card must be playable */
+typedef struct {
+    Card    cards[AI_MAX_STACK];
+    uint8_t count;
+    uint8_t nominated_suit;   /* Used when the play is an ace or joker */
+} AiPlay;
+
+/* Pick a play for player_id - only called when they have a valid play.
+ * rng belongs to the caller so decisions never disturb the deal. */
+typedef void (*AiChooseFn)(const Game* game, uint8_t player_id,
+                           RachelRng* rng, AiPlay* play);
+
+/* The same, also reading know: player_id's tracker for this game */
+typedef void (*AiChooseKnownFn)(const Game* game, uint8_t player_id,
+                                const Knowledge* know, RachelRng* rng,
+                                AiPlay* play);
+
+typedef struct {
+    const char*     name;
+    const char*     description;
+    AiChooseFn      choose;
+    AiChooseKnownFn choose_known;   /* NULL if the position is all it uses */
+} AiPolicy;
+
+/* Time per decision - log-linear buckets, AI_LATENCY_STEPS per power
+ * of two of nanoseconds, so any quantile is within about 12% */
+#define AI_LATENCY_STEPS    8
+#define AI_LATENCY_BUCKETS  ((64 - 2) * AI_LATENCY_STEPS)
+
+typedef struct {
+    unsigned long decisions;
+    unsigned long over_budget;    /* Decisions slower than budget_ns */
+    uint64_t      budget_ns;      /* Latency SLA, 0 for none */
+    uint64_t      max_ns;
+    double        total_ns;
+    unsigned long buckets[AI_LATENCY_BUCKETS];
+} AiLatency;
+
+void rachel_ai_latency_init(AiLatency* latency, uint64_t budget_ns);
+void rachel_ai_latency_record(AiLatency* latency, uint64_t ns);
+void rachel_ai_latency_merge(AiLatency* total, const AiLatency* part);
+
+/* Upper edge of the bucket holding the given fraction of decisions,
+ * never above the slowest one seen */
+uint64_t rachel_ai_latency_quantile(const AiLatency* latency, double fraction);
+
+/* Built-in policies, terminated by a NULL name */
+extern const AiPolicy rachel_ai_policies[];
+
+/* Look up a built-in policy by name, NULL if unknown */
+const AiPolicy* rachel_ai_find(const char* name);
+
+/* Play one complete turn for the current player:
+ * counter or take a pending attack, otherwise play if possible or draw. */
+void rachel_ai_take_turn(Game* game, const AiPolicy* policy, RachelRng* rng);
+
+/* Same, recording every rule call in log (which may be NULL) */
+void rachel_ai_take_turn_log(Game* game, const AiPolicy* policy, RachelRng* rng,
+                             EventLog* log);
+
+/* Same, timing the policy's decision into latency (which may be NULL).
+ * Returns the decision time in ns, 0 if the player had nothing to decide. */
+uint64_t rachel_ai_take_turn_timed(Game* game, const AiPolicy* policy,
+                                   RachelRng* rng, EventLog* log,
+                                   AiLatency* latency);
+
+/* Same, handing know - the mover's tracker, or NULL - to a policy
+ * that has choose_known */
+uint64_t rachel_ai_take_turn_known(Game* game, const AiPolicy* policy,
+                                   const Knowledge* know, RachelRng* rng,
+                                   EventLog* log, AiLatency* latency);
+
+/* The turn of a player with no valid play: take the pending effect,
+ * or draw one card, then hand the turn on */
+void rachel_ai_pass_turn(Game* game);
+void rachel_ai_pass_turn_log(Game* game, EventLog* log);
+
+/* Helpers shared by policies */
+uint8_t rachel_ai_best_suit(uint64_t hand_mask);
+void rachel_ai_add_stack(const Game* game, uint8_t player_id, AiPlay* play);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RACHEL_AI_H */
@@ -0,0 +1,417 @@
+/*
+ * RACHEL EVENT LOG
+ *
+ * Logging wraps the rule functions: apply, then describe what happened
+ * in one record. Replay is the same thing backwards - read the record,
+ * apply the rule, compare.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "eventlog.h"
+#include "ai.h"
+
+static void log_put64(uint8_t* p, uint64_t v) {
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint64_t log_get64(const uint8_t* p) {
+    uint64_t v = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+void rachel_log_encode(const EventRecord* record, uint8_t* out) {
+    out[0] = record->type;
+    out[1] = record->player;
+    out[2] = record->count;
+    out[3] = record->arg;
+    memcpy(out + 4, record->cards, RACHEL_MAX_PLAY);
+    log_put64(out + 8, record->check);
+}
+
+void rachel_log_decode(const uint8_t* in, EventRecord* record) {
+    record->type = in[0];
+    record->player = in[1];
+    record->count = in[2];
+    record->arg = in[3];
+    memcpy(record->cards, in + 4, RACHEL_MAX_PLAY);
+    record->check = log_get64(in + 8);
+}
+
+static void log_header(uint8_t* out) {
+    memset(out, 0, EVENT_RECORD_SIZE);
+    memcpy(out, EVENT_MAGIC, 7);
+    out[7] = EVENT_VERSION;
+    out[8] = EVENT_RECORD_SIZE;
+}
+
+FILE* rachel_log_create(const char* path) {
+    uint8_t header[EVENT_RECORD_SIZE];
+    FILE* file = fopen(path, "ab");
+
+    if (file == NULL) {
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) == 0 && ftell(file) == 0) {
+        log_header(header);
+        if (fwrite(header, EVENT_RECORD_SIZE, 1, file) != 1) {
+            fclose(file);
+            return NULL;
+        }
+    }
+    return file;
+}
+
+void rachel_log_init(EventLog* log, FILE* file) {
+    log->file = file;
+    log->pending = NULL;
+    log->count = 0;
+    log->capacity = 0;
+    log->failed = FALSE;
+    log->tap = NULL;
+    log->tap_context = NULL;
+}
+
+void rachel_log_set_tap(EventLog* log, EventTap tap, void* context) {
+    log->tap = tap;
+    log->tap_context = context;
+}
+
+void rachel_log_free(EventLog* log) {
+    free(log->pending);
+    log->pending = NULL;
+    log->count = log->capacity = 0;
+}
+
+/* Append one record to the game in progress */
+static void log_append(EventLog* log, const EventRecord* record) {
+    uint8_t* grown;
+    uint32_t capacity;
+
+    if (log->count == log->capacity) {
+        capacity = log->capacity ? log->capacity * 2 : 1024;
+        grown = (uint8_t*)realloc(log->pending, (size_t)capacity * EVENT_RECORD_SIZE);
+        if (grown == NULL) {
+            log->failed = TRUE;
+            return;
+        }
+        log->pending = grown;
+        log->capacity = capacity;
+    }
+    rachel_log_encode(record, log->pending + (size_t)log->count * EVENT_RECORD_SIZE);
+    log->count++;
+}
+
+static void log_record(EventLog* log, uint8_t type, uint8_t player, uint8_t count,
+                       uint8_t arg, uint64_t check) {
+    EventRecord record;
+
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.player = player;
+    record.count = count;
+    record.arg = arg;
+    record.check = check;
+    log_append(log, &record);
+}
+
+void rachel_log_start_game(EventLog* log, Game* game, uint64_t seed,
+                           uint32_t stream) {
+    EventRecord record;
+
+    rachel_seed_game(game, seed, stream);
+    rachel_start_game(game);
+    if (log == NULL) {
+        return;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.type = EVENT_GAME;
+    record.player = game->player_count;
+    record.arg = (uint8_t)game->ultimate_mode;
+    record.cards[0] = (uint8_t)stream;
+    record.cards[1] = (uint8_t)(stream >> 8);
+    record.cards[2] = (uint8_t)(stream >> 16);
+    record.cards[3] = (uint8_t)(stream >> 24);
+    record.check = seed;
+    log_append(log, &record);
+}
+
+bool_t rachel_log_play_cards(EventLog* log, Game* game, uint8_t player_id,
+                             const Card* cards, uint8_t count,
+                             uint8_t nominated_suit) {
+    EventRecord record;
+    uint8_t i;
+
+    if (!rachel_play_cards(game, player_id, cards, count, nominated_suit)) {
+        return FALSE;
+    }
+    if (log == NULL) {
+        return TRUE;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.type = EVENT_PLAY;
+    record.player = player_id;
+    record.count = count;
+    record.arg = nominated_suit;
+    for (i = 0; i < count && i < RACHEL_MAX_PLAY; i++) {
+        record.cards[i] = rachel_encode_card(cards[i]);
+    }
+    record.check = game->hash;
+    log_append(log, &record);
+    return TRUE;
+}
+
+bool_t rachel_log_draw_cards(EventLog* log, Game* game, uint8_t player_id,
+                             uint8_t count) {
+    if (!rachel_draw_cards(game, player_id, count)) {
+        return FALSE;
+    }
+    if (log != NULL) {
+        log_record(log, EVENT_DRAW, player_id, count, 0, game->hash);
+    }
+    return TRUE;
+}
+
+void rachel_log_process_effects(EventLog* log, Game* game) {
+    uint8_t type = game->pending_effect.type;
+    uint8_t count = game->pending_effect.count;
+    uint8_t player = game->current_player_index;
+
+    rachel_process_effects(game);
+    if (log != NULL && count > 0) {
+        log_record(log, EVENT_EFFECT, player, count, type, game->hash);
+    }
+}
+
+void rachel_log_next_turn(EventLog* log, Game* game) {
+    rachel_next_turn(game);
+    if (log != NULL) {
+        log_record(log, EVENT_TURN, game->current_player_index, 0, 0, game->hash);
+    }
+}
+
+bool_t rachel_log_end_game(EventLog* log, const Game* game) {
+    EventRecord record;
+    bool_t ok;
+
+    if (log == NULL) {
+        return TRUE;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.type = EVENT_END;
+    record.player = game->current_player_index;
+    record.count = game->winner_count;
+    record.cards[0] = game->deck_count;
+    record.cards[1] = game->discard_count;
+    record.check = game->hash;
+    log_append(log, &record);
+
+    if (log->tap != NULL && !log->failed) {
+        log->tap(log->tap_context, log->pending, log->count);
+    }
+
+    /* No file: keep accumulating in memory, unless the tap had it */
+    if (log->file == NULL) {
+        ok = !log->failed;
+        if (log->tap != NULL) {
+            log->count = 0;
+            log->failed = FALSE;
+        }
+        return ok;
+    }
+    ok = !log->failed &&
+         fwrite(log->pending, EVENT_RECORD_SIZE, log->count, log->file) == log->count;
+    log->count = 0;
+    log->failed = FALSE;
+    return ok;
+}
+
+/* Stop replaying at this record */
+static void log_mismatch(EventReplay* result, unsigned long index, const char* reason) {
+    result->ok = FALSE;
+    result->bad_record = index;
+    result->reason = reason;
+}
+
+void rachel_log_replay(const uint8_t* data, size_t size, EventReplay* result) {
+    uint8_t header[EVENT_RECORD_SIZE];
+    EventRecord record;
+    Game game;
+    Card cards[RACHEL_MAX_PLAY];
+    bool_t in_game = FALSE;
+    unsigned long index, total;
+    uint32_t stream;
+    uint8_t i;
+
+    memset(result, 0, sizeof(*result));
+    result->ok = TRUE;
+    log_header(header);
+    if (size < EVENT_RECORD_SIZE || memcmp(data, header, EVENT_RECORD_SIZE) != 0) {
+        log_mismatch(result, 0, "not a Rachel event log");
+        return;
+    }
+    if (size % EVENT_RECORD_SIZE != 0) {
+        log_mismatch(result, (unsigned long)(size / EVENT_RECORD_SIZE),
+                     "truncated record at end of file");
+        return;
+    }
+
+    total = (unsigned long)(size / EVENT_RECORD_SIZE);
+    for (index = 1; index < total; index++) {
+        rachel_log_decode(data + (size_t)index * EVENT_RECORD_SIZE, &record);
+        result->records++;
+
+        if (record.type != EVENT_GAME && !in_game) {
+            log_mismatch(result, index, "event outside a game");
+            return;
+        }
+
+        switch (record.type) {
+        case EVENT_GAME:
+            if (in_game) {
+                log_mismatch(result, index, "game started before the last one ended");
+                return;
+            }
+            if (record.player < 2 || record.player > MAX_PLAYERS) {
+                log_mismatch(result, index, "bad player count");
+                return;
+            }
+            rachel_init_game(&game, record.player);
+            while (game.player_count < record.player) {
+                rachel_add_player(&game, "REPLAY", TRUE);
+            }
+            game.ultimate_mode = record.arg != 0;
+            stream = record.cards[0] | ((uint32_t)record.cards[1] << 8) |
+                     ((uint32_t)record.cards[2] << 16) |
+                     ((uint32_t)record.cards[3] << 24);
+            rachel_seed_game(&game, record.check, stream);
+            rachel_start_game(&game);
+            in_game = TRUE;
+            continue;
+
+        case EVENT_PLAY:
+            if (record.count == 0 || record.count > RACHEL_MAX_PLAY) {
+                log_mismatch(result, index, "bad card count");
+                return;
+            }
+            for (i = 0; i < record.count; i++) {
+                cards[i] = rachel_decode_card(record.cards[i]);
+            }
+            if (!rachel_play_cards(&game, record.player, cards, record.count,
+                                   record.arg)) {
+                log_mismatch(result, index, "play refused by the rules");
+                return;
+            }
+            break;
+
+        case EVENT_DRAW:
+            if (!rachel_draw_cards(&game, record.player, record.count)) {
+                log_mismatch(result, index, "draw refused by the rules");
+                return;
+            }
+            break;
+
+        case EVENT_EFFECT:
+            if (game.pending_effect.type != record.arg ||
+                game.pending_effect.count != record.count ||
+                game.current_player_index != record.player) {
+                log_mismatch(result, index, "pending effect differs");
+                return;
+            }
+            rachel_process_effects(&game);
+            break;
+
+        case EVENT_TURN:
+            rachel_next_turn(&game);
+            if (game.current_player_index != record.player) {
+                log_mismatch(result, index, "turn passed to a different player");
+                return;
+            }
+            break;
+
+        case EVENT_END:
+            if (game.winner_count != record.count ||
+                game.deck_count != record.cards[0] ||
+                game.discard_count != record.cards[1] ||
+                game.current_player_index != record.player) {
+                log_mismatch(result, index, "final position differs");
+                return;
+            }
+            in_game = FALSE;
+            result->games++;
+            break;
+
+        default:
+            log_mismatch(result, index, "unknown record type");
+            return;
+        }
+
+        if (game.hash != record.check) {
+            log_mismatch(result, index, "position hash differs");
+            return;
+        }
+    }
+
+    if (in_game) {
+        result->incomplete++;
+    }
+}
+
+bool_t rachel_log_self_test(void) {
+    EventLog log;
+    EventReplay result;
+    Game game;
+    RachelRng rng;
+    uint8_t* data;
+    size_t size;
+    int seed;
+    bool_t ok;
+
+    rachel_log_init(&log, NULL);
+    rachel_rng_seed(&rng, 0x106, 0);
+    for (seed = 0; seed < 8; seed++) {
+        rachel_test_seat(&game, (uint8_t)(2 + seed % 7), seed & 1);
+        rachel_log_start_game(&log, &game, 0x10C, (uint32_t)seed);
+        while (!rachel_is_game_over(&game) && game.turn_count < 2000) {
+            rachel_ai_take_turn_log(&game, &rachel_ai_policies[seed % 3], &rng, &log);
+        }
+        rachel_log_end_game(&log, &game);
+    }
+    if (log.failed) {
+        rachel_log_free(&log);
+        return FALSE;
+    }
+
+    size = ((size_t)log.count + 1) * EVENT_RECORD_SIZE;
+    data = (uint8_t*)malloc(size);
+    if (data == NULL) {
+        rachel_log_free(&log);
+        return FALSE;
+    }
+    log_header(data);
+    memcpy(data + EVENT_RECORD_SIZE, log.pending, size - EVENT_RECORD_SIZE);
+
+    rachel_log_replay(data, size, &result);
+    ok = result.ok && result.games == 8 && result.incomplete == 0;
+
+    /* Flip one bit of a hash mid-log: the replay must notice */
+    data[(log.count / 2 + 1) * EVENT_RECORD_SIZE + 8] ^= 0x40;
+    rachel_log_replay(data, size, &result);
+    ok = ok && !result.ok;
+
+    free(data);
+    rachel_log_free(&log);
+    return ok;
+}
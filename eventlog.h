@@ -0,0 +1,126 @@
+/*
+ * RACHEL EVENT LOG
+ *
+ * Every transition a game makes, as fixed 16-byte records in an
+ * append-only file:
+ *
+ *   GAME    seed, stream, players, jokers      - the deal
+ *   PLAY    player, cards, nomination          - rachel_play_cards
+ *   DRAW    player, count                      - rachel_draw_cards
+ *   EFFECT  pending type and count             - rachel_process_effects
+ *   TURN    player now to move                 - rachel_next_turn
+ *   END     counts and winners
+ *
+ * Each record after GAME carries the Zobrist hash of the position it
+ * leads to, so a replay checks the whole game, step by step, against
+ * what actually happened.
+ *
+ * A game's records are buffered and written in one piece when it ends,
+ * so any number of games - or threads, or tables - can share one file
+ * without interleaving. Log functions take a NULL log and then just
+ * apply the rule. A tap, if set, sees each whole game just before it
+ * is written - that is how the stats module follows play.
+ */
+
+#ifndef RACHEL_EVENTLOG_H
+#define RACHEL_EVENTLOG_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "rules.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EVENT_RECORD_SIZE   16
+#define EVENT_MAGIC         "RACHLOG"       /* Header: magic, version, size */
+#define EVENT_VERSION       2
+
+/* Record types */
+#define EVENT_GAME     1
+#define EVENT_PLAY     2
+#define EVENT_DRAW     3
+#define EVENT_EFFECT   4
+#define EVENT_TURN     5
+#define EVENT_END      6
+
+/* One record, decoded. On disk: type, player, count, arg, cards[4],
+ * then check, all little-endian. */
+typedef struct {
+    uint8_t  type;
+    uint8_t  player;      /* GAME: player count */
+    uint8_t  count;       /* Cards played or drawn, effect count,
+                           * END: winners */
+    uint8_t  arg;         /* Nomination, effect type, GAME: jokers */
+    uint8_t  cards[RACHEL_MAX_PLAY];  /* Encoded cards, GAME: stream,
+                                       * END: deck, discard counts */
+    uint64_t check;       /* Hash afterwards, GAME: seed */
+} EventRecord;
+
+/* Called with each whole game's records, GAME to END, as it ends */
+typedef void (*EventTap)(void* context, const uint8_t* records, uint32_t count);
+
+/* One game's pending records and where they go */
+typedef struct {
+    FILE*    file;
+    uint8_t* pending;
+    uint32_t count;       /* Records pending */
+    uint32_t capacity;
+    bool_t   failed;      /* Out of memory or a write error */
+    EventTap tap;         /* Or NULL */
+    void*    tap_context;
+} EventLog;
+
+/* Open a log file for appending; a new file gets the header */
+FILE* rachel_log_create(const char* path);
+
+/* Attach a buffer to a file. file may be shared by many EventLogs as
+ * long as commits are serialised (one thread, or a lock). */
+void rachel_log_init(EventLog* log, FILE* file);
+void rachel_log_free(EventLog* log);
+
+/* Show every finished game to tap. A log with a tap and no file keeps
+ * only the game in progress instead of accumulating. */
+void rachel_log_set_tap(EventLog* log, EventTap tap, void* context);
+
+/* Logged rule functions */
+void rachel_log_start_game(EventLog* log, Game* game, uint64_t seed,
+                           uint32_t stream);
+bool_t rachel_log_play_cards(EventLog* log, Game* game, uint8_t player_id,
+                             const Card* cards, uint8_t count,
+                             uint8_t nominated_suit);
+bool_t rachel_log_draw_cards(EventLog* log, Game* game, uint8_t player_id,
+                             uint8_t count);
+void rachel_log_process_effects(EventLog* log, Game* game);
+void rachel_log_next_turn(EventLog* log, Game* game);
+
+/* Record the end and write the game out. Games cut short end here too. */
+bool_t rachel_log_end_game(EventLog* log, const Game* game);
+
+/* Record <-> bytes */
+void rachel_log_encode(const EventRecord* record, uint8_t* out);
+void rachel_log_decode(const uint8_t* in, EventRecord* record);
+
+/* Result of replaying a log */
+typedef struct {
+    unsigned long games;
+    unsigned long records;
+    unsigned long incomplete;    /* GAME without END at end of file */
+    bool_t        ok;
+    unsigned long bad_record;    /* Index of the first mismatch */
+    const char*   reason;
+} EventReplay;
+
+/* Re-run every game in a log (header included) through the rules and
+ * stop at the first record that does not match */
+void rachel_log_replay(const uint8_t* data, size_t size, EventReplay* result);
+
+/* Logs games into memory, replays them, then checks a corrupted log fails */
+bool_t rachel_log_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RACHEL_EVENTLOG_H */
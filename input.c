@@ -0,0 +1,326 @@
+/*
+ * RACHEL KEYBOARD INPUT
+ *
+ * The ring queue and the escape sequence decoder are the same
+ * everywhere; only how bytes arrive differs. Unix reads the raw
+ * terminal in bulk, Windows asks _getch one key at a time.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include "input.h"
+
+static int input_queue[INPUT_QUEUE];
+static unsigned input_head, input_tail;   /* Pop at head, push at tail */
+static uint8_t input_bytes[INPUT_BUFFER];
+static int input_have;
+
+/* Queue one event; a full queue drops the newest, like a full
+ * keyboard buffer */
+static void input_push(int key) {
+    if (input_tail - input_head < INPUT_QUEUE) {
+        input_queue[input_tail++ % INPUT_QUEUE] = key;
+    }
+}
+
+int input_next(void) {
+    if (input_head == input_tail) {
+        return KEY_NONE;
+    }
+    return input_queue[input_head++ % INPUT_QUEUE];
+}
+
+int input_decode(const uint8_t* b, int n, int* key) {
+    int i, code = 0;
+
+    if (n < 1) {
+        return 0;
+    }
+    if (b[0] == '\r') {
+        *key = '\n';
+        return 1;
+    }
+    if (b[0] != 0x1B) {
+        *key = b[0];
+        return 1;
+    }
+    if (n < 2) {
+        return 0;
+    }
+    if (b[1] != '[' && b[1] != 'O') {
+        *key = KEY_ESCAPE;          /* ESC then an ordinary key */
+        return 1;
+    }
+
+    /* CSI: parameter bytes, then one final byte */
+    for (i = 2; i < n && b[i] >= 0x30 && b[i] <= 0x3F; i++) {
+    }
+    if (i == n) {
+        return 0;
+    }
+    switch (b[i]) {
+        case 'A': *key = KEY_UP; break;
+        case 'B': *key = KEY_DOWN; break;
+        case 'C': *key = KEY_RIGHT; break;
+        case 'D': *key = KEY_LEFT; break;
+        case 'H': *key = KEY_HOME; break;
+        case 'F': *key = KEY_END; break;
+        case '~':
+            /* First parameter numbers the key: ESC [ 15 ~ is F5, not Home */
+            for (i = 2; b[i] >= '0' && b[i] <= '9'; i++) {
+                code = code < 1000 ? code * 10 + (b[i] - '0') : code;
+            }
+            while (b[i] != '~') {
+                i++;
+            }
+            switch (code) {
+                case 1: case 7: *key = KEY_HOME; break;
+                case 4: case 8: *key = KEY_END; break;
+                case 3: *key = KEY_DELETE; break;
+                default: *key = KEY_NONE; break;
+            }
+            break;
+        default:
+            *key = KEY_NONE;        /* A key we have no use for */
+            break;
+    }
+    return i + 1;
+}
+
+/* Queue every complete event in input_bytes */
+static int input_drain(void) {
+    int count = 0, used, key;
+
+    while (input_have > 0 &&
+           (used = input_decode(input_bytes, input_have, &key)) > 0) {
+        if (key != KEY_NONE) {
+            input_push(key);
+            count++;
+        }
+        input_have -= used;
+        memmove(input_bytes, input_bytes + used, (size_t)input_have);
+    }
+    return count;
+}
+
+/* Nothing more came: an unfinished sequence was the Escape key on
+ * its own */
+static int input_timeout(void) {
+    if (input_have == 0) {
+        return 0;
+    }
+    input_push(KEY_ESCAPE);
+    input_have = 0;
+    return 1;
+}
+
+#ifdef _WIN32
+    #include <conio.h>
+    #include <windows.h>
+
+    void input_start(void) {
+    }
+
+    void input_restore(void) {
+    }
+
+    int input_poll(int timeout_ms) {
+        DWORD start = GetTickCount();
+        int count = 0, ch;
+
+        fflush(stdout);
+        while (!_kbhit()) {
+            if (timeout_ms >= 0 && GetTickCount() - start >= (DWORD)timeout_ms) {
+                return 0;
+            }
+            Sleep(1);
+        }
+        while (_kbhit()) {
+            ch = _getch();
+            if (ch == '\r') {
+                ch = '\n';
+            } else if (ch == 0 || ch == 224) {     /* Extended key */
+                switch (_getch()) {
+                    case 72: ch = KEY_UP; break;
+                    case 80: ch = KEY_DOWN; break;
+                    case 77: ch = KEY_RIGHT; break;
+                    case 75: ch = KEY_LEFT; break;
+                    case 71: ch = KEY_HOME; break;
+                    case 79: ch = KEY_END; break;
+                    case 83: ch = KEY_DELETE; break;
+                    default: continue;
+                }
+            }
+            input_push(ch);
+            count++;
+        }
+        return count;
+    }
+#else
+    #include <termios.h>
+    #include <unistd.h>
+    #include <poll.h>
+    #include <signal.h>
+    #include <stdlib.h>
+
+    static struct termios input_saved;
+    static struct termios input_raw;
+    static volatile sig_atomic_t input_active = 0;
+
+    void input_restore(void) {
+        if (input_active) {
+            tcsetattr(STDIN_FILENO, TCSAFLUSH, &input_saved);
+            input_active = 0;
+        }
+    }
+
+    static void input_signal(int sig) {
+        input_restore();
+        if (sig == SIGTSTP) {
+            raise(SIGSTOP);         /* Suspend with the terminal usable */
+            return;
+        }
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+
+    static void input_resume(int sig) {
+        (void)sig;
+        if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &input_raw) == 0) {
+            input_active = 1;
+        }
+    }
+
+    void input_start(void) {
+        static const int fatal[] = { SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGTSTP };
+        struct sigaction action;
+        size_t i;
+
+        if (input_active || !isatty(STDIN_FILENO) ||
+            tcgetattr(STDIN_FILENO, &input_saved) != 0) {
+            return;
+        }
+        input_raw = input_saved;
+        input_raw.c_lflag &= ~(ICANON | ECHO);
+        input_raw.c_iflag &= ~(IXON | ICRNL);
+        input_raw.c_cc[VMIN] = 0;
+        input_raw.c_cc[VTIME] = 0;
+
+        memset(&action, 0, sizeof(action));
+        sigemptyset(&action.sa_mask);
+        action.sa_handler = input_signal;
+        for (i = 0; i < sizeof(fatal) / sizeof(fatal[0]); i++) {
+            sigaction(fatal[i], &action, NULL);
+        }
+        action.sa_handler = input_resume;
+        sigaction(SIGCONT, &action, NULL);
+        atexit(input_restore);
+        input_resume(0);
+    }
+
+    static int input_wait(int timeout_ms) {
+        struct pollfd pfd;
+
+        pfd.fd = STDIN_FILENO;
+        pfd.events = POLLIN;
+        return poll(&pfd, 1, timeout_ms) > 0;
+    }
+
+    int input_poll(int timeout_ms) {
+        ssize_t got;
+        int count = 0;
+
+        fflush(stdout);
+        if (!input_wait(timeout_ms)) {
+            return 0;
+        }
+        /* An unfinished sequence gets a moment for the rest to arrive */
+        do {
+            got = read(STDIN_FILENO, input_bytes + input_have,
+                       (size_t)(INPUT_BUFFER - input_have));
+            if (got <= 0) {
+                break;
+            }
+            input_have += (int)got;
+            count += input_drain();
+        } while (input_wait(input_have > 0 ? INPUT_ESC_MS : 0));
+
+        return count + input_timeout();
+    }
+#endif
+
+/* Self test */
+
+/* Feed bytes as if read in one go, then as if the wait ran out */
+static bool_t input_test(const char* bytes, const int* expect, int expected) {
+    int count = (int)strlen(bytes), events, i;
+
+    memcpy(input_bytes + input_have, bytes, (size_t)count);
+    input_have += count;
+    events = input_drain();
+    events += input_timeout();
+    if (events != expected) {
+        return FALSE;
+    }
+    for (i = 0; i < expected; i++) {
+        if (input_next() != expect[i]) {
+            return FALSE;
+        }
+    }
+    return input_next() == KEY_NONE;
+}
+
+bool_t rachel_input_self_test(void) {
+    static const int arrows[] = { KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT };
+    static const int edit[] = { KEY_DELETE, KEY_HOME, KEY_END, KEY_HOME, KEY_END };
+    static const int plain[] = { '1', '\n', 'd', '\n' };
+    static const int lone[] = { KEY_ESCAPE };
+    static const int escaped[] = { KEY_ESCAPE, 'q', KEY_LEFT };
+    static const int mixed[] = { '3', KEY_UP, '\n' };
+    int key, i;
+    bool_t ok;
+
+    input_head = input_tail = 0;
+    input_have = 0;
+
+    ok = input_test("\033[A\033[B\033[C\033[D", arrows, 4) &&
+         input_test("\033OA\033OB\033OC\033OD", arrows, 4) &&
+         input_test("\033[3~\033[1~\033[4~\033[H\033[F", edit, 5) &&
+         input_test("1\rd\n", plain, 4) &&
+         input_test("\033", lone, 1) &&
+         input_test("\033q\033[D", escaped, 3) &&
+         input_test("3\033[1;5A\033[15~\r", mixed, 3);
+
+    /* Sequences split across reads wait for the rest */
+    ok = ok && input_decode((const uint8_t*)"\033", 1, &key) == 0 &&
+         input_decode((const uint8_t*)"\033[", 2, &key) == 0 &&
+         input_decode((const uint8_t*)"\033[3", 3, &key) == 0 &&
+         input_decode((const uint8_t*)"\033[3~", 4, &key) == 4 &&
+         key == KEY_DELETE;
+    memcpy(input_bytes, "x\033[", 3);
+    input_have = 3;
+    ok = ok && input_drain() == 1 && input_have == 2 && input_next() == 'x';
+    input_bytes[input_have++] = 'B';
+    ok = ok && input_drain() == 1 && input_have == 0 &&
+         input_next() == KEY_DOWN;
+
+    /* A full queue drops the newest */
+    for (i = 0; i < INPUT_QUEUE + 8; i++) {
+        input_push('a' + i % 26);
+    }
+    for (i = 0; i < INPUT_QUEUE && ok; i++) {
+        ok = input_next() == 'a' + i % 26;
+    }
+    ok = ok && input_next() == KEY_NONE;
+
+    input_head = input_tail = 0;
+    return ok;
+}
+
+/*
+ * End of input.
+ *
+ * Three bytes for an arrow, one for everything that matters.
+ */
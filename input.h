@@ -0,0 +1,70 @@
+/*
+ * RACHEL KEYBOARD INPUT
+ *
+ * A small key event layer for the terminal clients. The terminal goes
+ * raw once, bytes are read in bulk whenever poll says they are there,
+ * escape sequences become single key events on a ring queue, and the
+ * game loop drains the queue. The terminal is put back on exit, on a
+ * fatal signal and while the process is suspended.
+ *
+ * Plain keys are their byte, with CR read as '\n'. Arrows, Home, End
+ * and Delete arrive as CSI or SS3 sequences and become the KEY_ codes
+ * above 255. An ESC that nothing follows within INPUT_ESC_MS is the
+ * Escape key on its own.
+ *
+ * Windows gets the same API over _kbhit/_getch. The queue belongs to
+ * one thread.
+ */
+
+#ifndef RACHEL_INPUT_H
+#define RACHEL_INPUT_H
+
+#include "rules.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Key events: plain keys are their byte, the rest are above 255 */
+#define KEY_NONE        0
+#define KEY_UP          0x101
+#define KEY_DOWN        0x102
+#define KEY_RIGHT       0x103
+#define KEY_LEFT        0x104
+#define KEY_HOME        0x105
+#define KEY_END         0x106
+#define KEY_DELETE      0x107
+#define KEY_ESCAPE      0x1B
+
+#define INPUT_QUEUE     64      /* Events waiting for the game loop */
+#define INPUT_BUFFER    64      /* Bytes read but not yet decoded */
+#define INPUT_ESC_MS    25      /* A lone ESC this long is the Escape key */
+
+/* Raw mode for the rest of the run: no line buffering, no echo, and
+ * reads that return at once. Ctrl-C still interrupts. Does nothing
+ * when stdin is not a terminal. */
+void input_start(void);
+
+/* Put the terminal back as it was found; safe in a signal handler */
+void input_restore(void);
+
+/* Wait up to timeout_ms (-1: forever) for input, then read all that
+ * is there and queue the events. Returns the number queued. */
+int input_poll(int timeout_ms);
+
+/* Next queued event, or KEY_NONE */
+int input_next(void);
+
+/* Turn the front of count bytes into one event in *key, KEY_NONE for
+ * a sequence with no use here. Returns the bytes used, or 0 if a
+ * sequence has started but not finished. */
+int input_decode(const uint8_t* bytes, int count, int* key);
+
+/* Decoding of every sequence the clients read, through the queue */
+bool_t rachel_input_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RACHEL_INPUT_H */
@@ -0,0 +1,549 @@
+/*
+ * RACHEL CARD KNOWLEDGE
+ *
+ * The per-event updates, the deduction pass they share and the
+ * constrained sampler. Nothing here looks at a hidden hand: updates
+ * read the public parts of the game and the observer's own hand only.
+ */
+
+#include <string.h>
+#include "knowledge.h"
+#include "ai.h"
+
+#define KNOW_DECK          MAX_PLAYERS   /* Group owner for the deck */
+#define KNOW_GROUPS        (2 * MAX_PLAYERS + 1)
+
+/* A card's bit in a group's allowed set; every set has the joker bit */
+#define KNOW_FITS(index)   ((uint64_t)1 << (index))
+
+/* Slots to fill from one set of cards */
+typedef struct {
+    uint64_t allowed;
+    uint8_t  slots;
+    uint8_t  owner;     /* Seat, or KNOW_DECK */
+} KnowGroup;
+
+static uint64_t know_hidden(const Knowledge* know) {
+    return RACHEL_MASK_STANDARD & ~know->own & ~know->discard;
+}
+
+static uint64_t know_deck_may(const Knowledge* know, uint64_t hidden) {
+    return know->deck_count ? know->deck & hidden : 0;
+}
+
+static uint64_t know_may(const Knowledge* know, uint8_t player, uint64_t hidden) {
+    if (player == know->observer || know->hand_count[player] == 0) {
+        return 0;
+    }
+    return know->free[player] ? hidden : hidden & ~know->cannot[player];
+}
+
+/* A card can only be where nobody else might have it: derive known
+ * cards and voids from the may-sets, one OR pass each way */
+static void know_refresh(Knowledge* know) {
+    uint64_t may[MAX_PLAYERS], after[MAX_PLAYERS + 1];
+    uint64_t hidden = know_hidden(know), before;
+    uint8_t p, s;
+
+    before = know_deck_may(know, hidden);
+    after[know->player_count] = 0;
+    for (p = 0; p < know->player_count; p++) {
+        may[p] = know_may(know, p, hidden);
+    }
+    for (p = know->player_count; p > 0; p--) {
+        after[p - 1] = after[p] | may[p - 1];
+    }
+    for (p = 0; p < know->player_count; p++) {
+        know->known[p] = may[p] & ~(before | after[p + 1]);
+        know->void_suits[p] = 0;
+        for (s = 0; s < 4; s++) {
+            if ((may[p] & rachel_suit_masks[s]) == 0) {
+                know->void_suits[p] |= (uint8_t)(1 << s);
+            }
+        }
+        before |= may[p];
+    }
+}
+
+/* Counts and the observer's hand, straight from the game */
+static void know_sync(Knowledge* know, const Game* game) {
+    uint8_t p;
+
+    know->player_count = game->player_count;
+    know->deck_count = game->deck_count;
+    know->discard_count = game->discard_count;
+    know->own = game->players[know->observer].hand_mask;
+    know->seen |= know->own & RACHEL_MASK_STANDARD;
+    for (p = 0; p < game->player_count; p++) {
+        know->hand_count[p] = game->players[p].hand_count;
+        if (know->free[p] > know->hand_count[p]) {
+            know->free[p] = know->hand_count[p];
+        }
+    }
+}
+
+/* player showed they hold none of playable */
+static void know_constrain(Knowledge* know, uint8_t player, uint64_t playable) {
+    if (player == know->observer || player >= know->player_count) {
+        return;
+    }
+    playable &= RACHEL_MASK_STANDARD;
+    if (know->free[player] == 0) {
+        know->cannot[player] |= playable;
+    } else {
+        know->cannot[player] = playable;
+        know->free[player] = 0;
+    }
+}
+
+void rachel_know_init(Knowledge* know, const Game* game, uint8_t observer) {
+    uint8_t i;
+
+    memset(know, 0, sizeof(*know));
+    know->observer = observer;
+    for (i = 0; i < game->discard_count; i++) {
+        know->discard |= rachel_card_bit(RACHEL_DISCARD(game)[i]);
+    }
+    know->discard &= RACHEL_MASK_STANDARD;
+    know->seen = know->discard;
+    know->deck = RACHEL_MASK_STANDARD;
+    for (i = 0; i < game->player_count; i++) {
+        know->free[i] = i == observer ? 0 : game->players[i].hand_count;
+    }
+    know_sync(know, game);
+    know_refresh(know);
+}
+
+void rachel_know_play(Knowledge* know, const Game* after, uint8_t player,
+                      const Card* cards, uint8_t count) {
+    uint64_t bit;
+    uint8_t i;
+
+    for (i = 0; i < count; i++) {
+        bit = rachel_card_bit(cards[i]) & RACHEL_MASK_STANDARD;
+        if (player != know->observer && (bit & know->cannot[player])) {
+            if (know->free[player] > 0) {
+                know->free[player]--;
+            } else {
+                /* They could have played it after all - the pass was
+                 * not forced, so forget what it said */
+                know->cannot[player] = 0;
+                know->free[player] = know->hand_count[player];
+            }
+        }
+        know->discard |= bit;
+        know->seen |= bit;
+    }
+    know_sync(know, after);
+    know_refresh(know);
+}
+
+void rachel_know_pass(Knowledge* know, const Game* before, uint8_t player) {
+    know_constrain(know, player, rachel_playable_mask(before));
+    know_refresh(know);
+}
+
+void rachel_know_draw(Knowledge* know, const Game* after, uint8_t player) {
+    uint64_t top;
+    uint8_t drawn = 0;
+
+    if (player < after->player_count &&
+        after->players[player].hand_count > know->hand_count[player]) {
+        drawn = after->players[player].hand_count - know->hand_count[player];
+    }
+
+    /* The pile under the top card became the deck */
+    if (after->discard_count < know->discard_count) {
+        top = rachel_card_bit(RACHEL_TOP_CARD(after)) & RACHEL_MASK_STANDARD;
+        know->deck = know->discard & ~top;
+        know->discard = top;
+    }
+    if (player != know->observer) {
+        know->free[player] += drawn;
+    }
+    know_sync(know, after);
+    know_refresh(know);
+}
+
+void rachel_know_observe(Knowledge* know, const Game* after,
+                         const EventRecord* record) {
+    PendingEffect effect;
+    Card cards[RACHEL_MAX_PLAY];
+    uint8_t i, count;
+
+    effect.type = 0;
+    effect.count = 0;
+    effect.source_player = 0xFF;
+
+    switch (record->type) {
+    case EVENT_GAME:
+        rachel_know_init(know, after, know->observer);
+        break;
+    case EVENT_PLAY:
+        count = record->count < RACHEL_MAX_PLAY ? record->count : RACHEL_MAX_PLAY;
+        for (i = 0; i < count; i++) {
+            cards[i] = rachel_decode_card(record->cards[i]);
+        }
+        rachel_know_play(know, after, record->player, cards, count);
+        break;
+    case EVENT_DRAW:
+        /* A draw is a pass: nothing could go on the unchanged top card */
+        know_constrain(know, record->player,
+                       rachel_playable_mask_for(RACHEL_TOP_CARD(after),
+                                                after->nominated_suit, &effect));
+        rachel_know_draw(know, after, record->player);
+        break;
+    case EVENT_EFFECT:
+        /* ...and so is taking an attack rather than passing it on */
+        effect.type = record->arg;
+        effect.count = record->count;
+        know_constrain(know, record->player,
+                       rachel_playable_mask_for(RACHEL_TOP_CARD(after),
+                                                after->nominated_suit, &effect));
+        if (record->arg == RANK_7) {
+            know_sync(know, after);
+            know_refresh(know);
+        } else {
+            rachel_know_draw(know, after, record->player);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+uint64_t rachel_know_possible(const Knowledge* know, uint8_t player) {
+    return know_may(know, player, know_hidden(know));
+}
+
+static void know_place(Game* out, uint8_t owner, Card card) {
+    Player* player;
+
+    if (owner == KNOW_DECK) {
+        RACHEL_DECK(out)[out->deck_count++] = card;
+        return;
+    }
+    player = &out->players[owner];
+    player->hand[player->hand_count++] = card;
+    player->hand_mask = rachel_mask_add(player->hand_mask, card);
+}
+
+/* Add a group, unless it has no slots to fill */
+static uint8_t know_group(KnowGroup* groups, uint8_t count, uint64_t allowed,
+                          uint8_t slots, uint8_t owner) {
+    if (slots > 0) {
+        groups[count].allowed = allowed | RACHEL_JOKER_BIT;
+        groups[count].slots = slots;
+        groups[count++].owner = owner;
+    }
+    return count;
+}
+
+/* c has nowhere to go: find a chain of moves - a card out of one of
+ * c's groups into another group it fits, and so on - that ends in a
+ * group with room. Breadth first over the groups, like a matching. */
+static bool_t know_augment(KnowGroup* groups, uint8_t group_count,
+                           const uint8_t* cards, uint8_t* group_of,
+                           uint8_t c) {
+    uint8_t parent[KNOW_GROUPS], via[KNOW_GROUPS], queue[KNOW_GROUPS];
+    uint8_t head = 0, tail = 0, g, h, x;
+    uint64_t bit = KNOW_FITS(cards[c]);
+
+    memset(parent, 0xFF, sizeof(parent));
+    for (g = 0; g < group_count; g++) {
+        if (groups[g].allowed & bit) {
+            parent[g] = KNOW_GROUPS;
+            queue[tail++] = g;
+        }
+    }
+    while (head < tail) {
+        g = queue[head++];
+        for (x = 0; x < c; x++) {
+            if (group_of[x] != g) {
+                continue;
+            }
+            bit = KNOW_FITS(cards[x]);
+            for (h = 0; h < group_count; h++) {
+                if (parent[h] != 0xFF || !(groups[h].allowed & bit)) {
+                    continue;
+                }
+                parent[h] = g;
+                via[h] = x;
+                if (groups[h].slots == 0) {
+                    queue[tail++] = h;
+                    continue;
+                }
+                /* Shift every card on the chain one group along */
+                while (parent[h] != KNOW_GROUPS) {
+                    group_of[via[h]] = h;
+                    groups[h].slots--;
+                    h = parent[h];
+                    groups[h].slots++;
+                }
+                group_of[c] = h;
+                groups[h].slots--;
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+/* Deal the hidden cards. Known cards go first; the rest go in random
+ * order, each to one of its groups with odds by the slots left there,
+ * and a card that finds every group full makes room by moving others
+ * along. Jokers are cards that fit anywhere. constrained FALSE
+ * keeps only the counts. Fails only if no deal agrees. */
+static bool_t know_deal(const Knowledge* know, Game* out, uint8_t jokers,
+                        bool_t constrained, RachelRng* rng) {
+    KnowGroup groups[KNOW_GROUPS];
+    uint8_t cards[ULTIMATE_DECK], group_of[ULTIMATE_DECK];
+    uint64_t hidden = know_hidden(know), pool = hidden, bits, bit, common;
+    uint32_t room, pick, total = 0;
+    uint8_t group_count = 0, count = 0, tight, loose, p, g, i, j, swap;
+
+    for (p = 0; p < know->player_count; p++) {
+        if (p == know->observer) {
+            continue;
+        }
+        out->players[p].hand_count = 0;
+        out->players[p].hand_mask = 0;
+        if (!constrained) {
+            group_count = know_group(groups, group_count, hidden,
+                                     know->hand_count[p], p);
+            continue;
+        }
+
+        loose = know->free[p];
+        tight = know->hand_count[p] - loose;
+        for (bits = know->known[p] & pool; bits; bits &= bits - 1) {
+            if ((bits & (0 - bits) & know->cannot[p]) == 0 && tight > 0) {
+                tight--;
+            } else if (loose > 0) {
+                loose--;
+            } else {
+                return FALSE;
+            }
+            know_place(out, p, rachel_card_from_index(RACHEL_MASK_LOWEST(bits)));
+        }
+        pool &= ~know->known[p];
+        group_count = know_group(groups, group_count, hidden & ~know->cannot[p],
+                                 tight, p);
+        group_count = know_group(groups, group_count, hidden, loose, p);
+    }
+    out->deck_count = 0;
+    group_count = know_group(groups, group_count,
+                             constrained ? know_deck_may(know, hidden) : hidden,
+                             know->deck_count, KNOW_DECK);
+
+    for (bits = pool; bits; bits &= bits - 1) {
+        cards[count++] = RACHEL_MASK_LOWEST(bits);
+    }
+    while (jokers-- > 0 && count < ULTIMATE_DECK) {
+        cards[count++] = STANDARD_DECK;
+    }
+
+    /* Order only matters if some card cannot go everywhere */
+    common = ~(uint64_t)0;
+    for (g = 0; g < group_count; g++) {
+        common &= groups[g].allowed;
+        total += groups[g].slots;
+    }
+    for (i = count; i > 1 && (pool & ~common) != 0; i--) {
+        j = (uint8_t)rachel_rng_below(rng, i);
+        swap = cards[i - 1];
+        cards[i - 1] = cards[j];
+        cards[j] = swap;
+    }
+
+    for (i = 0; i < count; i++) {
+        bit = KNOW_FITS(cards[i]);
+        room = total;
+        if ((bit & common) == 0) {
+            room = 0;
+            for (g = 0; g < group_count; g++) {
+                room += (groups[g].allowed & bit) ? groups[g].slots : 0;
+            }
+        }
+        total--;
+        if (room == 0) {
+            if (!know_augment(groups, group_count, cards, group_of, i)) {
+                return FALSE;
+            }
+            continue;
+        }
+        pick = rachel_rng_below(rng, room);
+        for (g = 0; !(groups[g].allowed & bit) || pick >= groups[g].slots; g++) {
+            pick -= (groups[g].allowed & bit) ? groups[g].slots : 0;
+        }
+        group_of[i] = g;
+        groups[g].slots--;
+    }
+
+    for (i = 0; i < count; i++) {
+        know_place(out, groups[group_of[i]].owner, rachel_card_from_index(cards[i]));
+    }
+    for (g = 0; g < group_count; g++) {
+        if (groups[g].slots > 0) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+bool_t rachel_know_sample(const Knowledge* know, const Game* game, Game* out,
+                          RachelRng* rng) {
+    uint64_t seed;
+    uint8_t jokers;
+    bool_t found;
+
+    /* Jokers not in our hand or on the pile, by count */
+    jokers = game->ultimate_mode ? 4 : 0;
+    jokers -= RACHEL_MASK_COUNT(know->own & RACHEL_MASK_JOKERS);
+    jokers -= know->discard_count - RACHEL_MASK_COUNT(know->discard);
+
+    *out = *game;
+    found = know_deal(know, out, jokers, TRUE, rng);
+    if (!found) {
+        *out = *game;
+        know_deal(know, out, jokers, FALSE, rng);
+    }
+
+    seed = (uint64_t)rachel_rng_next(rng) << 32;
+    seed |= rachel_rng_next(rng);
+    rachel_rng_seed(&out->rng, seed, rachel_rng_next(rng));
+    out->hash = rachel_hash_game(out);
+    return found;
+}
+
+/* Is everything the observer believes true of the real game? */
+static bool_t know_sound(const Knowledge* know, const Game* game) {
+    uint64_t hand, deck = 0, discard = 0;
+    uint8_t p, s, i;
+
+    for (i = 0; i < game->deck_count; i++) {
+        deck |= rachel_card_bit(RACHEL_DECK(game)[i]);
+    }
+    for (i = 0; i < game->discard_count; i++) {
+        discard |= rachel_card_bit(RACHEL_DISCARD(game)[i]);
+    }
+    if (know->own != game->players[know->observer].hand_mask ||
+        know->discard != (discard & RACHEL_MASK_STANDARD) ||
+        (deck & RACHEL_MASK_STANDARD & ~know->deck) != 0) {
+        return FALSE;
+    }
+    for (p = 0; p < game->player_count; p++) {
+        if (p == know->observer) {
+            continue;
+        }
+        hand = game->players[p].hand_mask & RACHEL_MASK_STANDARD;
+        if ((know->known[p] & ~hand) != 0 ||
+            RACHEL_MASK_COUNT(hand & know->cannot[p]) > know->free[p]) {
+            return FALSE;
+        }
+        for (s = 0; s < 4; s++) {
+            if ((know->void_suits[p] >> s & 1) && (hand & rachel_suit_masks[s])) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/* Does a sampled world keep the counts, the pile and every constraint? */
+static bool_t know_agrees(const Knowledge* know, const Game* game, const Game* world) {
+    uint64_t hidden = know_hidden(know), all = 0, hand;
+    uint8_t p, i, total = world->deck_count + world->discard_count;
+
+    for (p = 0; p < world->player_count; p++) {
+        hand = 0;
+        for (i = 0; i < world->players[p].hand_count; i++) {
+            hand = rachel_mask_add(hand, world->players[p].hand[i]);
+        }
+        if (hand != world->players[p].hand_mask ||
+            world->players[p].hand_count != game->players[p].hand_count ||
+            (hand & all & RACHEL_MASK_STANDARD) != 0) {
+            return FALSE;
+        }
+        all |= hand;
+        total += world->players[p].hand_count;
+        hand &= RACHEL_MASK_STANDARD;
+        if (p != know->observer &&
+            ((know->known[p] & ~hand) != 0 ||
+             RACHEL_MASK_COUNT(hand & know->cannot[p]) > know->free[p])) {
+            return FALSE;
+        }
+    }
+    for (i = 0; i < world->deck_count; i++) {
+        hand = rachel_card_bit(RACHEL_DECK(world)[i]) & RACHEL_MASK_STANDARD;
+        if ((hand & (all | ~know->deck | ~hidden)) != 0) {
+            return FALSE;
+        }
+        all |= hand;
+    }
+    return total == (game->ultimate_mode ? ULTIMATE_DECK : STANDARD_DECK) &&
+           world->players[know->observer].hand_mask ==
+               game->players[know->observer].hand_mask &&
+           world->hash == rachel_hash_game(world);
+}
+
+bool_t rachel_know_self_test(void) {
+    Knowledge know[MAX_PLAYERS];
+    EventLog log;
+    EventRecord record;
+    RachelRng rng;
+    Game game, world;
+    uint32_t next = 0, turn, known = 0, voids = 0;
+    uint8_t p, q;
+    int seed;
+    bool_t ok = TRUE;
+
+    rachel_log_init(&log, NULL);
+    rachel_rng_seed(&rng, 0x16, 0);
+
+    for (seed = 0; seed < 12 && ok; seed++) {
+        rachel_test_seat(&game, (uint8_t)(2 + seed % 6), seed & 1);
+        log.count = 0;
+        next = 0;
+        rachel_log_start_game(&log, &game, 16, (uint32_t)seed);
+        for (p = 0; p < game.player_count; p++) {
+            know[p].observer = p;
+        }
+
+        for (turn = 0; turn < 400 && ok && !rachel_is_game_over(&game); turn++) {
+            if (turn > 0) {
+                rachel_ai_take_turn_log(&game, &rachel_ai_policies[1 + seed % 2],
+                                        &rng, &log);
+            }
+            for (; next < log.count; next++) {
+                rachel_log_decode(log.pending + (size_t)next * EVENT_RECORD_SIZE,
+                                  &record);
+                for (p = 0; p < game.player_count; p++) {
+                    rachel_know_observe(&know[p], &game, &record);
+                }
+            }
+
+            for (p = 0; p < game.player_count && ok; p++) {
+                ok = know_sound(&know[p], &game);
+                for (q = 0; q < game.player_count; q++) {
+                    known += RACHEL_MASK_COUNT(know[p].known[q]);
+                    voids += game.players[q].hand_count > 0 &&
+                             know[p].void_suits[q] != 0;
+                }
+                if (ok && turn % 5 == 0) {
+                    ok = rachel_know_sample(&know[p], &game, &world, &rng) &&
+                         know_agrees(&know[p], &game, &world);
+                }
+            }
+        }
+    }
+
+    rachel_log_free(&log);
+    return ok && known > 0 && voids > 0;
+}
+
+/*
+ * End of knowledge.
+ *
+ * Every card is somewhere. Most of them, we can say where.
+ */
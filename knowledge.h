@@ -0,0 +1,91 @@
+/*
+ * RACHEL CARD KNOWLEDGE
+ *
+ * What one seat can work out about the hidden cards, kept up to date
+ * one event at a time instead of being rebuilt from the discard pile
+ * every turn. Everything is a bitboard (see rules.h):
+ *
+ *   own, discard, seen   - the observer's hand, the pile, all cards seen
+ *   deck                 - hidden cards that may still be in the deck;
+ *                          after a reshuffle only the old pile can be
+ *   cannot[p]            - cards p could not play when p last passed.
+ *                          Every card p held then is none of them; the
+ *                          free[p] cards drawn since could be anything.
+ *   known[p], void_suits - what follows: cards that cannot be anywhere
+ *                          but p's hand, suits p cannot be holding
+ *
+ * A pass means "no valid play", since the rules make a player play if
+ * they can. Each update costs a few mask operations per seat, however
+ * many cards have gone by.
+ *
+ * Jokers are identical, so they carry no information; they are left
+ * out of the masks and the sampler deals them as unconstrained cards.
+ *
+ * "Counting cards is not cheating when the cards are on the table."
+ */
+
+#ifndef RACHEL_KNOWLEDGE_H
+#define RACHEL_KNOWLEDGE_H
+
+#include "rules.h"
+#include "eventlog.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t  observer;
+    uint8_t  player_count;
+    uint8_t  deck_count;
+    uint8_t  discard_count;             /* A drop means a reshuffle */
+    uint8_t  hand_count[MAX_PLAYERS];
+    uint8_t  free[MAX_PLAYERS];         /* Drawn since p last passed */
+    uint8_t  void_suits[MAX_PLAYERS];   /* Bit per suit p holds none of */
+    uint64_t own;
+    uint64_t discard;
+    uint64_t seen;
+    uint64_t deck;
+    uint64_t cannot[MAX_PLAYERS];
+    uint64_t known[MAX_PLAYERS];
+} Knowledge;
+
+/* Start tracking for observer from a position, as if nothing had been
+ * seen before it (a fresh deal, or joining a table late) */
+void rachel_know_init(Knowledge* know, const Game* game, uint8_t observer);
+
+/* After rachel_play_cards: player put cards[0..count) down */
+void rachel_know_play(Knowledge* know, const Game* after, uint8_t player,
+                      const Card* cards, uint8_t count);
+
+/* Before a pass: player has no valid play in this position */
+void rachel_know_pass(Knowledge* know, const Game* before, uint8_t player);
+
+/* After player drew, or took a penalty - the count comes from after */
+void rachel_know_draw(Knowledge* know, const Game* after, uint8_t player);
+
+/* The same, from event log records. after is the game once the record
+ * (or the whole turn it belongs to) has been applied; only the public
+ * parts and the observer's own hand are read. */
+void rachel_know_observe(Knowledge* know, const Game* after,
+                         const EventRecord* record);
+
+/* Hidden cards that could be in p's hand */
+uint64_t rachel_know_possible(const Knowledge* know, uint8_t player);
+
+/* Deal every hidden card - opponents' hands and the deck - at random,
+ * agreeing with everything the observer knows, into a copy of game.
+ * The RNG is reseeded as in rachel_mcts_determinize. Returns FALSE if
+ * no agreeing deal was found in a few tries; out is then dealt with
+ * only the card counts kept. */
+bool_t rachel_know_sample(const Knowledge* know, const Game* game, Game* out,
+                          RachelRng* rng);
+
+/* Every observer of seeded games, checked against the real hands */
+bool_t rachel_know_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RACHEL_KNOWLEDGE_H */
@@ -0,0 +1,655 @@
+/*
+ * RACHEL LOCKSTEP SIMULATOR
+ *
+ * The lanes, the two step kernels and the scalar turns. Both kernels
+ * play the same moves; the scalar one is the plain reading of the
+ * rules, the AVX2 one does four lanes per instruction and hands the
+ * lanes with no play back to the scalar turn code.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include "lockstep.h"
+#include "ai.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define LOCKSTEP_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+/* What playing a card does, by encoded card - mirrors the chain of
+ * cases in rachel_play_cards */
+#define LOCKSTEP_CLASS_MASK   0x0003u   /* Starts or adds to this attack */
+#define LOCKSTEP_ADD_SHIFT    8         /* ...by this many cards or skips */
+#define LOCKSTEP_RED_JACK     0x10000u  /* Cuts a jack attack by five */
+#define LOCKSTEP_QUEEN        0x20000u
+#define LOCKSTEP_NOMINATES    0x40000u  /* Ace or joker: hearts, always */
+#define LOCKSTEP_PLAIN        0x80000u  /* Clears the nomination */
+
+#define LOCKSTEP_CARD_SLOTS   64        /* card_at[] - bit index to card */
+#define LOCKSTEP_SEAT_SLOTS   (256 * 16)
+
+/* Self test size: fewer lanes than games, so lanes are refilled and packed */
+#define LOCKSTEP_TEST_LANES   8
+#define LOCKSTEP_TEST_GAMES   24
+
+static void lockstep_build_tables(LockstepBatch* batch) {
+    unsigned encoded, index;
+    uint32_t effect;
+
+    for (encoded = 0; encoded < 256; encoded++) {
+        if (IS_TWO(encoded)) {
+            effect = 1 | (2u << LOCKSTEP_ADD_SHIFT);
+        } else if (IS_SEVEN(encoded)) {
+            effect = 2 | (1u << LOCKSTEP_ADD_SHIFT);
+        } else if (IS_BLACK_JACK(encoded)) {
+            effect = 3 | (5u << LOCKSTEP_ADD_SHIFT);
+        } else if (IS_RED_JACK(encoded)) {
+            /* Without a jack attack it falls through to the plain case */
+            effect = LOCKSTEP_RED_JACK | LOCKSTEP_PLAIN;
+        } else if (IS_QUEEN(encoded)) {
+            effect = LOCKSTEP_QUEEN;
+        } else if (IS_ACE(encoded) || IS_JOKER(encoded)) {
+            effect = LOCKSTEP_NOMINATES;
+        } else {
+            effect = LOCKSTEP_PLAIN;
+        }
+        batch->effects[encoded] = effect;
+    }
+    for (index = 0; index < LOCKSTEP_CARD_SLOTS; index++) {
+        batch->card_at[index] = rachel_card_from_index((uint8_t)index).encoded;
+    }
+}
+
+bool_t rachel_lockstep_has_avx2(void) {
+#ifdef LOCKSTEP_HAVE_AVX2
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return FALSE;
+#endif
+}
+
+bool_t rachel_lockstep_init(LockstepBatch* batch, unsigned lanes,
+                            LockstepKernel kernel) {
+    uint8_t* memory;
+    size_t hands, fields;
+
+    memset(batch, 0, sizeof(*batch));
+    if (lanes == 0 || lanes > LOCKSTEP_MAX_LANES) {
+        return FALSE;
+    }
+    if (kernel == LOCKSTEP_AUTO) {
+        kernel = rachel_lockstep_has_avx2() ? LOCKSTEP_AVX2 : LOCKSTEP_SCALAR;
+    }
+    if (kernel == LOCKSTEP_AVX2 && !rachel_lockstep_has_avx2()) {
+        return FALSE;
+    }
+
+    lanes = (lanes + LOCKSTEP_WIDTH - 1) / LOCKSTEP_WIDTH * LOCKSTEP_WIDTH;
+    hands = (size_t)MAX_PLAYERS * lanes * sizeof(uint64_t);
+    fields = (size_t)10 * lanes * sizeof(uint32_t);
+    memory = (uint8_t*)calloc(1, hands + fields +
+                              (LOCKSTEP_SEAT_SLOTS + 256 + LOCKSTEP_CARD_SLOTS) *
+                              sizeof(uint32_t) +
+                              lanes * sizeof(LockstepCold));
+    if (memory == NULL) {
+        return FALSE;
+    }
+
+    batch->memory = memory;
+    batch->lanes = lanes;
+    batch->kernel = kernel;
+    batch->hands = (uint64_t*)memory;
+    batch->top = (uint32_t*)(memory + hands);
+    batch->nominated = batch->top + lanes;
+    batch->pending_class = batch->nominated + lanes;
+    batch->pending_count = batch->pending_class + lanes;
+    batch->direction = batch->pending_count + lanes;
+    batch->current = batch->direction + lanes;
+    batch->out = batch->current + lanes;
+    batch->alive = batch->out + lanes;
+    batch->turns = batch->alive + lanes;
+    batch->passes = batch->turns + lanes;
+    batch->next_seat = batch->passes + lanes;
+    batch->effects = batch->next_seat + LOCKSTEP_SEAT_SLOTS;
+    batch->card_at = batch->effects + 256;
+    batch->cold = (LockstepCold*)(batch->card_at + LOCKSTEP_CARD_SLOTS);
+    lockstep_build_tables(batch);
+    return TRUE;
+}
+
+void rachel_lockstep_free(LockstepBatch* batch) {
+    free(batch->memory);
+    memset(batch, 0, sizeof(*batch));
+}
+
+/* rachel_next_turn for every out mask, direction and seat */
+static void lockstep_build_seats(LockstepBatch* batch, uint8_t players) {
+    unsigned out, direction, seat, next, attempts;
+
+    batch->players = players;
+    for (out = 0; out < 256; out++) {
+        for (direction = 0; direction < 2; direction++) {
+            for (seat = 0; seat < 8; seat++) {
+                next = seat;
+                attempts = 0;
+                if (seat < players) {
+                    do {
+                        if (direction == DIR_CLOCKWISE) {
+                            next = (next + 1) % players;
+                        } else {
+                            next = next == 0 ? players - 1u : next - 1;
+                        }
+                        attempts++;
+                    } while (((out >> next) & 1) && attempts < players);
+                }
+                batch->next_seat[out << 4 | direction << 3 | seat] = next;
+            }
+        }
+    }
+}
+
+static void lockstep_next_turn(LockstepBatch* batch, unsigned lane) {
+    batch->current[lane] = batch->next_seat[batch->out[lane] << 4 |
+                                            batch->direction[lane] << 3 |
+                                            batch->current[lane]];
+    batch->turns[lane]++;
+}
+
+/* rachel_deck_take on a lane's piles */
+static Card lockstep_deck_take(LockstepCold* cold) {
+    Card* deck = cold->piles[cold->deck_pile];
+    uint8_t n = cold->deck_count;
+    uint8_t j = 0;
+    Card card;
+
+    if (n > 1) {
+        j = (uint8_t)rachel_rng_below(&cold->rng, n);
+    }
+    card = deck[j];
+    deck[j] = deck[n - 1];
+    cold->deck_count = n - 1;
+    return card;
+}
+
+/* rachel_draw_cards, reshuffle included */
+static void lockstep_draw(LockstepBatch* batch, unsigned lane, unsigned seat,
+                          unsigned count) {
+    LockstepCold* cold = &batch->cold[lane];
+    uint64_t* hand = &batch->hands[(size_t)seat * batch->lanes + lane];
+    Card top;
+
+    while (count > 0) {
+        if (cold->deck_count == 0) {
+            if (cold->discard_count <= 1) {
+                break;
+            }
+            top = cold->piles[cold->deck_pile ^ 1][cold->discard_count - 1];
+            cold->deck_count = cold->discard_count - 1;
+            cold->deck_pile ^= 1;
+            cold->piles[cold->deck_pile ^ 1][0] = top;
+            cold->discard_count = 1;
+        }
+        *hand = rachel_mask_add(*hand, lockstep_deck_take(cold));
+        count--;
+    }
+}
+
+/* Deal game number game into a lane, as rachel_start_game would */
+static void lockstep_deal(LockstepBatch* batch, unsigned lane, uint64_t seed,
+                          unsigned long game) {
+    LockstepCold* cold = &batch->cold[lane];
+    uint8_t hand_size = rachel_calculate_hand_size(batch->players);
+    uint8_t seat, i;
+    Card card;
+
+    for (seat = 0; seat < MAX_PLAYERS; seat++) {
+        batch->hands[(size_t)seat * batch->lanes + lane] = 0;
+        cold->finish[seat] = 0;
+    }
+    rachel_rng_seed(&cold->rng, seed, game);
+    cold->game = game;
+    cold->deck_pile = 0;
+    cold->winners = 0;
+    rachel_create_deck(cold->piles[0], FALSE);
+    cold->deck_count = STANDARD_DECK;
+
+    for (i = 0; i < hand_size; i++) {
+        for (seat = 0; seat < batch->players; seat++) {
+            card = lockstep_deck_take(cold);
+            batch->hands[(size_t)seat * batch->lanes + lane] =
+                rachel_mask_add(batch->hands[(size_t)seat * batch->lanes + lane],
+                                card);
+        }
+    }
+    card = lockstep_deck_take(cold);
+    cold->piles[1][0] = card;
+    cold->discard_count = 1;
+
+    batch->top[lane] = card.encoded;
+    batch->nominated[lane] = 0xFF;
+    batch->pending_class[lane] = 0;
+    batch->pending_count[lane] = 0;
+    batch->direction[lane] = DIR_CLOCKWISE;
+    batch->current[lane] = 0;
+    batch->out[lane] = 0;
+    batch->alive[lane] = batch->players;
+    batch->turns[lane] = 0;
+}
+
+/* The seat's hand emptied with the play just made */
+static void lockstep_go_out(LockstepBatch* batch, unsigned lane, unsigned seat) {
+    LockstepCold* cold = &batch->cold[lane];
+
+    batch->out[lane] |= 1u << seat;
+    batch->alive[lane]--;
+    cold->finish[seat] = ++cold->winners;
+}
+
+/* Play the lowest valid card and hand the turn on */
+static void lockstep_play(LockstepBatch* batch, unsigned lane, unsigned seat,
+                          uint64_t valid) {
+    LockstepCold* cold = &batch->cold[lane];
+    uint64_t* hand = &batch->hands[(size_t)seat * batch->lanes + lane];
+    uint8_t index = RACHEL_MASK_LOWEST(valid);
+    uint32_t card = batch->card_at[index];
+    uint32_t effect = batch->effects[card];
+    uint32_t count;
+
+    if (index >= STANDARD_DECK) {
+        *hand = (*hand & ~RACHEL_MASK_JOKERS) |
+                (((*hand & RACHEL_MASK_JOKERS) >> 1) & RACHEL_MASK_JOKERS);
+    } else {
+        *hand &= ~((uint64_t)1 << index);
+    }
+    cold->piles[cold->deck_pile ^ 1][cold->discard_count++].encoded = (uint8_t)card;
+    batch->top[lane] = card;
+
+    if (effect & LOCKSTEP_CLASS_MASK) {
+        batch->pending_class[lane] = effect & LOCKSTEP_CLASS_MASK;
+        batch->pending_count[lane] =
+            (batch->pending_count[lane] + (effect >> LOCKSTEP_ADD_SHIFT)) & 0xFF;
+    } else if ((effect & LOCKSTEP_RED_JACK) && batch->pending_class[lane] == 3) {
+        count = batch->pending_count[lane];
+        count = count >= 5 ? count - 5 : 0;
+        batch->pending_count[lane] = count;
+        if (count == 0) {
+            batch->pending_class[lane] = 0;
+        }
+    } else if (effect & LOCKSTEP_QUEEN) {
+        batch->direction[lane] ^= 1;
+    } else if (effect & LOCKSTEP_NOMINATES) {
+        batch->nominated[lane] = SUIT_HEARTS;
+    } else {
+        batch->nominated[lane] = 0xFF;
+    }
+
+    if (*hand == 0) {
+        lockstep_go_out(batch, lane, seat);
+    }
+    lockstep_next_turn(batch, lane);
+}
+
+/* rachel_ai_pass_turn: take the pending effect, or draw one */
+static void lockstep_pass(LockstepBatch* batch, unsigned lane) {
+    unsigned count = batch->pending_count[lane];
+    unsigned effect_class = batch->pending_class[lane];
+
+    if (count > 0) {
+        batch->pending_class[lane] = 0;
+        batch->pending_count[lane] = 0;
+        if (effect_class == 2) {
+            while (count-- > 0) {
+                lockstep_next_turn(batch, lane);   /* Skips hand the turn on */
+            }
+            return;
+        }
+        lockstep_draw(batch, lane, batch->current[lane], count);
+    } else {
+        lockstep_draw(batch, lane, batch->current[lane], 1);
+    }
+    lockstep_next_turn(batch, lane);
+}
+
+/* One turn of every live game: plays here, lanes with no play are
+ * listed in batch->passes. Returns how many were listed. */
+static unsigned lockstep_step_scalar(LockstepBatch* batch) {
+    unsigned lane, seat, passes = 0;
+    uint64_t valid;
+
+    for (lane = 0; lane < batch->active; lane++) {
+        seat = batch->current[lane];
+        valid = batch->hands[(size_t)seat * batch->lanes + lane] &
+                rachel_playable_table[RACHEL_PLAYABLE_INDEX(
+                    batch->pending_class[lane], batch->top[lane],
+                    batch->nominated[lane])];
+        if (valid) {
+            lockstep_play(batch, lane, seat, valid);
+        } else {
+            batch->passes[passes++] = lane;
+        }
+    }
+    return passes;
+}
+
+#ifdef LOCKSTEP_HAVE_AVX2
+/*
+ * The same step, four lanes at a time. Legality is two gathers - the
+ * playable-table row and the current player's hand - and an AND. The
+ * lowest valid card's bit index is the popcount of the bits below it.
+ * Effects are blends on a gathered descriptor, as in lockstep_play.
+ * Writing hands back, the discard pile and going out are per lane;
+ * AVX2 has no scatter and they touch memory only one lane owns.
+ */
+__attribute__((target("avx2")))
+static unsigned lockstep_step_avx2(LockstepBatch* batch) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i popcount = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                              1, 2, 2, 3, 2, 3, 3, 4,
+                                              0, 1, 1, 2, 1, 2, 2, 3,
+                                              1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i jokers = _mm256_set1_epi64x((long long)RACHEL_MASK_JOKERS);
+    const __m256i joker_index = _mm256_set1_epi64x(STANDARD_DECK);
+    const __m256i low_dwords = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const __m128i zero4 = _mm_setzero_si128();
+    const __m128i one4 = _mm_set1_epi32(1);
+    const __m128i five4 = _mm_set1_epi32(5);
+    const __m128i three4 = _mm_set1_epi32(3);
+    const __m128i none4 = _mm_set1_epi32(0xFF);
+    const __m128i lanes4 = _mm_set1_epi32((int)batch->lanes);
+    const __m128i red4 = _mm_set1_epi32(LOCKSTEP_RED_JACK);
+    const __m128i queen4 = _mm_set1_epi32(LOCKSTEP_QUEEN);
+    const __m128i nominates4 = _mm_set1_epi32(LOCKSTEP_NOMINATES);
+    const __m128i plain4 = _mm_set1_epi32(LOCKSTEP_PLAIN);
+    uint64_t valid[LOCKSTEP_WIDTH], hand[LOCKSTEP_WIDTH];
+    uint32_t seat[LOCKSTEP_WIDTH], card[LOCKSTEP_WIDTH];
+    unsigned base, i, lane, passes = 0;
+
+    for (base = 0; base < batch->active; base += LOCKSTEP_WIDTH) {
+        __m128i top = _mm_loadu_si128((const __m128i*)(batch->top + base));
+        __m128i nominated = _mm_loadu_si128((const __m128i*)(batch->nominated + base));
+        __m128i effect_class = _mm_loadu_si128((const __m128i*)(batch->pending_class + base));
+        __m128i count = _mm_loadu_si128((const __m128i*)(batch->pending_count + base));
+        __m128i direction = _mm_loadu_si128((const __m128i*)(batch->direction + base));
+        __m128i current = _mm_loadu_si128((const __m128i*)(batch->current + base));
+        __m128i turns = _mm_loadu_si128((const __m128i*)(batch->turns + base));
+        __m128i index, slot, playing, played, effect, attack, red, queen;
+        __m128i nominates, plain, reduced, out, next;
+        __m256i playable, held, mask, bit, below, bits, plays, is_joker, less;
+
+        /* Legality: RACHEL_PLAYABLE_INDEX, then the hand at seat * lanes + lane */
+        index = _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(effect_class, 9),
+                         _mm_slli_epi32(_mm_or_si128(
+                             _mm_and_si128(_mm_srli_epi32(top, 2), _mm_set1_epi32(0x30)),
+                             _mm_and_si128(top, _mm_set1_epi32(0x0F))), 3)),
+            _mm_and_si128(_mm_add_epi32(nominated, one4), _mm_set1_epi32(7)));
+        playable = _mm256_i32gather_epi64((const long long*)rachel_playable_table,
+                                          index, 8);
+        slot = _mm_add_epi32(_mm_mullo_epi32(current, lanes4),
+                             _mm_add_epi32(_mm_set1_epi32((int)base),
+                                           _mm_setr_epi32(0, 1, 2, 3)));
+        held = _mm256_i32gather_epi64((const long long*)batch->hands, slot, 8);
+        mask = _mm256_and_si256(held, playable);
+
+        /* Move: lowest valid bit, index = popcount(bit - 1) */
+        bit = _mm256_and_si256(mask, _mm256_sub_epi64(zero, mask));
+        below = _mm256_sub_epi64(bit, one);
+        bits = _mm256_sad_epu8(
+            _mm256_add_epi8(
+                _mm256_shuffle_epi8(popcount, _mm256_and_si256(below, nibble)),
+                _mm256_shuffle_epi8(popcount, _mm256_and_si256(
+                    _mm256_srli_epi16(below, 4), nibble))),
+            _mm256_setzero_si256());
+        plays = _mm256_xor_si256(_mm256_cmpeq_epi64(mask, zero),
+                                 _mm256_set1_epi64x(-1));
+        playing = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(plays, low_dwords));
+        index = _mm_min_epu32(_mm256_castsi256_si128(
+                                  _mm256_permutevar8x32_epi32(bits, low_dwords)),
+                              _mm_set1_epi32(LOCKSTEP_CARD_SLOTS - 1));
+        played = _mm_i32gather_epi32((const int*)batch->card_at, index, 4);
+
+        /* The hand without it - a joker takes the top joker bit */
+        is_joker = _mm256_cmpeq_epi64(bits, joker_index);
+        less = _mm256_or_si256(_mm256_andnot_si256(jokers, held),
+                               _mm256_and_si256(_mm256_srli_epi64(
+                                   _mm256_and_si256(held, jokers), 1), jokers));
+        held = _mm256_blendv_epi8(_mm256_xor_si256(held, bit), less, is_joker);
+
+        /* Effects, in rachel_play_cards order */
+        effect = _mm_i32gather_epi32((const int*)batch->effects, played, 4);
+        attack = _mm_and_si128(effect, three4);
+        red = _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(effect, red4), red4),
+                            _mm_cmpeq_epi32(effect_class, three4));
+        queen = _mm_cmpeq_epi32(_mm_and_si128(effect, queen4), queen4);
+        nominates = _mm_cmpeq_epi32(_mm_and_si128(effect, nominates4), nominates4);
+        plain = _mm_andnot_si128(red, _mm_cmpeq_epi32(_mm_and_si128(effect, plain4),
+                                                      plain4));
+        reduced = _mm_max_epi32(_mm_sub_epi32(count, five4), zero4);
+
+        red = _mm_and_si128(red, playing);
+        count = _mm_blendv_epi8(count, reduced, red);
+        effect_class = _mm_blendv_epi8(effect_class,
+                                       _mm_andnot_si128(_mm_cmpeq_epi32(reduced, zero4),
+                                                        effect_class), red);
+        attack = _mm_and_si128(_mm_cmpgt_epi32(attack, zero4), playing);
+        count = _mm_blendv_epi8(count, _mm_and_si128(
+                                    _mm_add_epi32(count, _mm_srli_epi32(effect, 8)),
+                                    none4), attack);
+        effect_class = _mm_blendv_epi8(effect_class, _mm_and_si128(effect, three4),
+                                       attack);
+        direction = _mm_xor_si128(direction,
+                                  _mm_and_si128(_mm_and_si128(queen, playing), one4));
+        nominated = _mm_blendv_epi8(nominated, none4, _mm_and_si128(plain, playing));
+        nominated = _mm_andnot_si128(_mm_and_si128(nominates, playing), nominated);
+        top = _mm_blendv_epi8(top, played, playing);
+
+        _mm_storeu_si128((__m128i*)(batch->top + base), top);
+        _mm_storeu_si128((__m128i*)(batch->nominated + base), nominated);
+        _mm_storeu_si128((__m128i*)(batch->pending_class + base), effect_class);
+        _mm_storeu_si128((__m128i*)(batch->pending_count + base), count);
+        _mm_storeu_si128((__m128i*)(batch->direction + base), direction);
+
+        /* Per lane: the hand back in place, the discard pile, going out */
+        _mm256_storeu_si256((__m256i*)valid, mask);
+        _mm256_storeu_si256((__m256i*)hand, held);
+        _mm_storeu_si128((__m128i*)seat, current);
+        _mm_storeu_si128((__m128i*)card, played);
+        for (i = 0; i < LOCKSTEP_WIDTH && base + i < batch->active; i++) {
+            lane = base + i;
+            if (valid[i] == 0) {
+                batch->passes[passes++] = lane;
+                continue;
+            }
+            batch->hands[(size_t)seat[i] * batch->lanes + lane] = hand[i];
+            batch->cold[lane].piles[batch->cold[lane].deck_pile ^ 1]
+                [batch->cold[lane].discard_count++].encoded = (uint8_t)card[i];
+            if (hand[i] == 0) {
+                lockstep_go_out(batch, lane, seat[i]);
+            }
+        }
+
+        /* Next turn for the lanes that played, with out as it now is */
+        out = _mm_loadu_si128((const __m128i*)(batch->out + base));
+        next = _mm_i32gather_epi32((const int*)batch->next_seat,
+                                   _mm_or_si128(_mm_or_si128(_mm_slli_epi32(out, 4),
+                                                             _mm_slli_epi32(direction, 3)),
+                                                current), 4);
+        _mm_storeu_si128((__m128i*)(batch->current + base),
+                         _mm_blendv_epi8(current, next, playing));
+        _mm_storeu_si128((__m128i*)(batch->turns + base),
+                         _mm_sub_epi32(turns, playing));
+    }
+    return passes;
+}
+#endif
+
+/* Move the game in lane from into lane to */
+static void lockstep_move(LockstepBatch* batch, unsigned from, unsigned to) {
+    unsigned seat;
+
+    for (seat = 0; seat < batch->players; seat++) {
+        batch->hands[(size_t)seat * batch->lanes + to] =
+            batch->hands[(size_t)seat * batch->lanes + from];
+    }
+    batch->top[to] = batch->top[from];
+    batch->nominated[to] = batch->nominated[from];
+    batch->pending_class[to] = batch->pending_class[from];
+    batch->pending_count[to] = batch->pending_count[from];
+    batch->direction[to] = batch->direction[from];
+    batch->current[to] = batch->current[from];
+    batch->out[to] = batch->out[from];
+    batch->alive[to] = batch->alive[from];
+    batch->turns[to] = batch->turns[from];
+    batch->cold[to] = batch->cold[from];
+}
+
+static void lockstep_retire(const LockstepBatch* batch, unsigned lane,
+                            bool_t finished, LockstepResult* result) {
+    const LockstepCold* cold = &batch->cold[lane];
+    unsigned seat;
+
+    memset(result, 0, sizeof(*result));
+    result->turns = batch->turns[lane];
+    result->finished = finished;
+    for (seat = 0; seat < batch->players; seat++) {
+        result->finish[seat] = cold->finish[seat];
+        result->hands[seat] = batch->hands[(size_t)seat * batch->lanes + lane];
+    }
+    result->rng_state = cold->rng.state;
+    result->top_card = (uint8_t)batch->top[lane];
+    result->deck_count = cold->deck_count;
+    result->discard_count = cold->discard_count;
+    result->current_player = (uint8_t)batch->current[lane];
+}
+
+void rachel_lockstep_play(LockstepBatch* batch, uint8_t players,
+                          uint64_t seed, unsigned long first,
+                          unsigned long count, uint32_t max_turns,
+                          LockstepResult* results) {
+    unsigned long next = first, end = first + count;
+    unsigned lane, passes, i;
+    bool_t finished;
+
+    if (batch->players != players) {
+        lockstep_build_seats(batch, players);
+    }
+    batch->active = 0;
+    while (batch->active < batch->lanes && next < end) {
+        lockstep_deal(batch, batch->active++, seed, next++);
+    }
+
+    while (batch->active > 0) {
+        /* Finished games leave; the next game takes the lane, or the
+         * last live lane moves down into it */
+        lane = 0;
+        while (lane < batch->active) {
+            finished = batch->alive[lane] <= 1;
+            if (!finished && batch->turns[lane] < max_turns) {
+                lane++;
+                continue;
+            }
+            lockstep_retire(batch, lane, finished,
+                            &results[batch->cold[lane].game - first]);
+            if (next < end) {
+                lockstep_deal(batch, lane, seed, next++);
+            } else if (lane < --batch->active) {
+                lockstep_move(batch, batch->active, lane);
+            }
+        }
+        if (batch->active == 0) {
+            break;
+        }
+
+#ifdef LOCKSTEP_HAVE_AVX2
+        if (batch->kernel == LOCKSTEP_AVX2) {
+            passes = lockstep_step_avx2(batch);
+        } else
+#endif
+        {
+            passes = lockstep_step_scalar(batch);
+        }
+        for (i = 0; i < passes; i++) {
+            lockstep_pass(batch, batch->passes[i]);
+        }
+    }
+}
+
+/* One result against the same game played by rules.c */
+static bool_t lockstep_same(const LockstepResult* result, const Game* game,
+                            bool_t finished) {
+    uint8_t seat;
+
+    if (result->finished != finished || result->turns != game->turn_count ||
+        result->rng_state != game->rng.state ||
+        result->top_card != RACHEL_TOP_CARD(game).encoded ||
+        result->deck_count != game->deck_count ||
+        result->discard_count != game->discard_count ||
+        result->current_player != game->current_player_index) {
+        return FALSE;
+    }
+    for (seat = 0; seat < game->player_count; seat++) {
+        if (result->hands[seat] != game->players[seat].hand_mask ||
+            result->finish[seat] != game->players[seat].finish_position) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+bool_t rachel_lockstep_self_test(void) {
+    static const LockstepKernel kernels[2] = { LOCKSTEP_SCALAR, LOCKSTEP_AVX2 };
+    const AiPolicy* policy = rachel_ai_find("first");
+    LockstepResult results[LOCKSTEP_TEST_GAMES];
+    LockstepBatch batch;
+    RachelRng rng;
+    Game game;
+    uint32_t max_turns;
+    uint8_t players;
+    bool_t finished;
+    int k, i;
+
+    for (k = 0; k < 2; k++) {
+        if (kernels[k] == LOCKSTEP_AVX2 && !rachel_lockstep_has_avx2()) {
+            continue;
+        }
+        if (!rachel_lockstep_init(&batch, LOCKSTEP_TEST_LANES, kernels[k])) {
+            return FALSE;
+        }
+        for (players = 2; players <= MAX_PLAYERS; players++) {
+            /* Short caps on odd counts, so some games are cut off */
+            max_turns = (players & 1) ? 60 : 2000;
+            rachel_lockstep_play(&batch, players, 0x10C, 100 * players,
+                                 LOCKSTEP_TEST_GAMES, max_turns, results);
+
+            for (i = 0; i < LOCKSTEP_TEST_GAMES; i++) {
+                rachel_test_deal(&game, players, FALSE, 0x10C, 100 * players + i);
+                rachel_rng_seed(&rng, ~(uint64_t)0x10C, 100 * players + i);
+                finished = TRUE;
+                while (!rachel_is_game_over(&game)) {
+                    if (game.turn_count >= max_turns) {
+                        finished = FALSE;
+                        break;
+                    }
+                    rachel_ai_take_turn(&game, policy, &rng);
+                }
+                if (!lockstep_same(&results[i], &game, finished)) {
+                    rachel_lockstep_free(&batch);
+                    return FALSE;
+                }
+            }
+        }
+        rachel_lockstep_free(&batch);
+    }
+    return TRUE;
+}
+
+/*
+ * End of lockstep.
+ *
+ * Four games, one instruction, no surprises.
+ */
@@ -0,0 +1,116 @@
+/*
+ * RACHEL LOCKSTEP SIMULATOR
+ *
+ * Plays thousands of "first" policy games side by side, one turn of
+ * every game per step. Each field of the game state is its own array
+ * with one slot (lane) per game: hand bitboards, top card, nomination,
+ * pending effect, direction, current player. The common turn - find the
+ * valid cards, play the lowest, apply its effect, hand the turn on -
+ * then runs down those arrays for all games at once, four games per
+ * instruction with AVX2 where the CPU has it.
+ *
+ * A game whose turn is not a play (a draw, a penalty, a skip) drops to
+ * scalar code for that turn, since only it needs the RNG and the piles.
+ * A game that finishes is replaced by the next one in its lane, and
+ * lanes are packed when the games run out, so the vector loops only
+ * ever see live games.
+ *
+ * Every game ends exactly as rachel_ai_take_turn with the "first" policy
+ * would have played it through rules.c - same seed, same stream, same
+ * cards. The self test holds it to that.
+ *
+ * "Everybody play your lowest card. Now."
+ */
+
+#ifndef RACHEL_LOCKSTEP_H
+#define RACHEL_LOCKSTEP_H
+
+#include "rules.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOCKSTEP_WIDTH       4      /* Games per AVX2 step */
+#define LOCKSTEP_MAX_LANES   65536
+
+typedef enum {
+    LOCKSTEP_AUTO,       /* AVX2 if this CPU has it, else scalar */
+    LOCKSTEP_SCALAR,
+    LOCKSTEP_AVX2
+} LockstepKernel;
+
+/* How one game ended */
+typedef struct {
+    uint32_t turns;
+    bool_t   finished;                /* FALSE if it hit the turn cap */
+    uint8_t  finish[MAX_PLAYERS];     /* finish_position by seat, 0 if in */
+    uint64_t hands[MAX_PLAYERS];      /* Final hand bitboards */
+    uint64_t rng_state;
+    uint8_t  top_card;
+    uint8_t  deck_count;
+    uint8_t  discard_count;
+    uint8_t  current_player;
+} LockstepResult;
+
+/* What only the scalar turns touch - one per lane */
+typedef struct {
+    Card          piles[2][ULTIMATE_DECK];
+    RachelRng     rng;
+    unsigned long game;               /* Game number within the run */
+    uint8_t       deck_pile;
+    uint8_t       deck_count;
+    uint8_t       discard_count;
+    uint8_t       winners;
+    uint8_t       finish[MAX_PLAYERS];
+} LockstepCold;
+
+/* The lanes. Small fields are 32 bits wide so four of them load next
+ * to four hand bitboards. pending_class is the playable-table effect
+ * class (0 none, 1 twos, 2 sevens, 3 jacks). */
+typedef struct {
+    unsigned       lanes;             /* Capacity, a multiple of the width */
+    unsigned       active;            /* Live games, packed at the front */
+    LockstepKernel kernel;
+    uint8_t        players;
+    uint64_t*      hands;             /* [seat * lanes + lane] */
+    uint32_t*      top;
+    uint32_t*      nominated;
+    uint32_t*      pending_class;
+    uint32_t*      pending_count;
+    uint32_t*      direction;
+    uint32_t*      current;
+    uint32_t*      out;               /* Bit per seat that has gone out */
+    uint32_t*      alive;             /* Seats still in */
+    uint32_t*      turns;
+    uint32_t*      passes;            /* Scratch: lanes with no play */
+    uint32_t*      next_seat;         /* [out << 4 | direction << 3 | seat] */
+    uint32_t*      effects;           /* [encoded card] what playing it does */
+    uint32_t*      card_at;           /* [bit index] encoded card */
+    LockstepCold*  cold;
+    void*          memory;
+} LockstepBatch;
+
+/* Room for up to lanes games at once (rounded up to the width) */
+bool_t rachel_lockstep_init(LockstepBatch* batch, unsigned lanes,
+                            LockstepKernel kernel);
+void rachel_lockstep_free(LockstepBatch* batch);
+
+/* TRUE if LOCKSTEP_AVX2 can run here */
+bool_t rachel_lockstep_has_avx2(void);
+
+/* Play games first .. first + count - 1 of a run: game i is dealt from
+ * stream i of seed, like rachel_sim. results[i - first] gets game i. */
+void rachel_lockstep_play(LockstepBatch* batch, uint8_t players,
+                          uint64_t seed, unsigned long first,
+                          unsigned long count, uint32_t max_turns,
+                          LockstepResult* results);
+
+/* Both kernels against rachel_ai_take_turn, game for game */
+bool_t rachel_lockstep_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RACHEL_LOCKSTEP_H */
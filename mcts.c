@@ -0,0 +1,691 @@
+/*
+ * RACHEL INFORMATION-SET MONTE CARLO TREE SEARCH
+ *
+ * Single-observer ISMCTS. Every iteration deals the unseen cards out
+ * again at random, as far as the observer's knowledge allows, then
+ * descends one tree shared by all those worlds, only considering the
+ * moves that are legal in this one. A child's
+ * "available" count tracks how often it could have been picked, which
+ * keeps rarely-legal moves from looking better than they are.
+ *
+ * "Play the odds, not the cards."
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "mcts.h"
+
+#define MCTS_MAX_ACTIONS   128
+#define MCTS_MAX_DEPTH     256
+#define MCTS_NONE          (-1)
+
+/* Action: card index bits 0-5, stack bit 6, nominated suit bits 7-8 */
+#define MCTS_ACTION(index, stack, suit) \
+    ((uint16_t)((index) | ((stack) ? 0x40 : 0) | ((suit) << 7)))
+#define MCTS_ACTION_INDEX(a)   ((uint8_t)((a) & 0x3F))
+#define MCTS_ACTION_STACK(a)   (((a) & 0x40) != 0)
+#define MCTS_ACTION_SUIT(a)    ((uint8_t)(((a) >> 7) & 3))
+
+typedef struct {
+    uint32_t visits;
+    uint32_t available;
+    uint32_t wins;
+    int32_t  first_child;
+    int32_t  next_sibling;
+    uint16_t action;
+    uint8_t  player;        /* Who made the move leading here */
+} MctsNode;
+
+/* One root-parallel search - a private tree, world and RNG stream */
+typedef struct {
+    const Game*        root;
+    const MctsConfig*  config;
+    const Knowledge*   know;              /* The observer's, shared */
+    uint8_t            observer;
+    MctsNode*          nodes;
+    uint32_t           node_count;
+    uint32_t           node_limit;
+    uint32_t           iterations;
+    uint32_t           iteration_limit;   /* 0 = until the deadline */
+    double             deadline;          /* 0 = none */
+    bool_t             hit_deadline;
+    RachelRng          rng;
+    Game               world;
+    pthread_t          thread;
+} MctsSearch;
+
+static double mcts_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void rachel_mcts_default_config(MctsConfig* config) {
+    config->iterations = 1000;
+    config->budget_ms = 0;
+    config->max_latency_ms = 1000;
+    config->threads = 1;
+    config->max_nodes = 65536;
+    config->rollout_turns = 400;
+    config->exploration = 0.7;
+    config->seed = 0;
+}
+
+void rachel_mcts_determinize(const Game* game, uint8_t player_id,
+                             const Knowledge* know, Game* out, RachelRng* rng) {
+    Card unseen[ULTIMATE_DECK];
+    uint64_t seen, bits, hand, seed;
+    uint8_t count = 0, jokers, next = 0, i, j, k;
+    Player* player;
+    Card swap;
+
+    if (know != 0) {
+        rachel_know_sample(know, game, out, rng);
+        return;
+    }
+
+    /* With no history every deal of the unseen cards is as likely, and
+     * a plain shuffle is twice as fast as the constrained sampler */
+    *out = *game;
+
+    /* Everything not in our hand or on the discard pile */
+    seen = game->players[player_id].hand_mask;
+    jokers = game->ultimate_mode ? 4 : 0;
+    jokers -= RACHEL_MASK_COUNT(seen & RACHEL_MASK_JOKERS);
+    for (i = 0; i < game->discard_count; i++) {
+        if (IS_JOKER(RACHEL_DISCARD(game)[i].encoded)) {
+            jokers--;
+        } else {
+            seen |= rachel_card_bit(RACHEL_DISCARD(game)[i]);
+        }
+    }
+    bits = ~seen & RACHEL_MASK_STANDARD;
+    while (bits) {
+        unseen[count++] = rachel_card_from_index(RACHEL_MASK_LOWEST(bits));
+        bits &= bits - 1;
+    }
+    while (jokers-- > 0 && count < ULTIMATE_DECK) {
+        unseen[count++] = rachel_card_from_index(STANDARD_DECK);
+    }
+
+    for (i = count; i > 1; i--) {
+        j = (uint8_t)rachel_rng_below(rng, i);
+        swap = unseen[i - 1];
+        unseen[i - 1] = unseen[j];
+        unseen[j] = swap;
+    }
+
+    /* Opponents keep their card counts, the rest is the deck */
+    for (i = 0; i < game->player_count; i++) {
+        if (i == player_id) {
+            continue;
+        }
+        player = &out->players[i];
+        hand = 0;
+        for (k = 0; k < player->hand_count && next < count; k++) {
+            player->hand[k] = unseen[next++];
+            hand = rachel_mask_add(hand, player->hand[k]);
+        }
+        player->hand_mask = hand;
+    }
+    out->deck_count = 0;
+    while (next < count) {
+        RACHEL_DECK(out)[out->deck_count++] = unseen[next++];
+    }
+
+    seed = (uint64_t)rachel_rng_next(rng) << 32;
+    seed |= rachel_rng_next(rng);
+    rachel_rng_seed(&out->rng, seed, rachel_rng_next(rng));
+    out->hash = rachel_hash_game(out);
+}
+
+/* Every distinct move: each valid card, a stacked version when more of
+ * the rank is held, and one per suit for aces and jokers. Jokers are
+ * identical, so only the first joker bit makes moves. */
+static uint8_t mcts_actions(const Game* game, uint16_t* actions) {
+    uint8_t player_id = game->current_player_index;
+    uint64_t hand = game->players[player_id].hand_mask;
+    uint64_t valid = rachel_valid_plays_mask(game, player_id) &
+                     (RACHEL_MASK_STANDARD | RACHEL_JOKER_BIT);
+    uint64_t rank_mask;
+    uint8_t count = 0, index, stack, suit, suits;
+    Card card;
+
+    while (valid) {
+        index = RACHEL_MASK_LOWEST(valid);
+        valid &= valid - 1;
+        card = rachel_card_from_index(index);
+        rank_mask = IS_JOKER(card.encoded) ? RACHEL_MASK_JOKERS :
+                    rachel_rank_masks[GET_RANK(card.encoded)];
+        suits = (IS_ACE(card.encoded) || IS_JOKER(card.encoded)) ? 4 : 1;
+
+        for (stack = 0; stack < 2; stack++) {
+            if (stack && RACHEL_MASK_COUNT(hand & rank_mask) < 2) {
+                break;
+            }
+            for (suit = 0; suit < suits && count < MCTS_MAX_ACTIONS; suit++) {
+                actions[count++] = MCTS_ACTION(index, stack, suit);
+            }
+        }
+    }
+    return count;
+}
+
+static void mcts_action_play(const Game* game, uint16_t action, AiPlay* play) {
+    play->cards[0] = rachel_card_from_index(MCTS_ACTION_INDEX(action));
+    play->count = 1;
+    play->nominated_suit = MCTS_ACTION_SUIT(action);
+    if (MCTS_ACTION_STACK(action)) {
+        rachel_ai_add_stack(game, game->current_player_index, play);
+    }
+}
+
+static void mcts_apply(Game* game, uint16_t action) {
+    AiPlay play;
+
+    mcts_action_play(game, action, &play);
+    rachel_play_cards(game, game->current_player_index, play.cards, play.count,
+                      play.nominated_suit);
+    rachel_next_turn(game);
+}
+
+/* Pass forced turns until someone can play. FALSE once the game is
+ * decided - first out wins - or the turn limit is reached. */
+static bool_t mcts_settle(Game* game, uint32_t turn_limit) {
+    while (game->winner_count == 0 && game->turn_count < turn_limit) {
+        if (rachel_valid_plays_mask(game, game->current_player_index)) {
+            return TRUE;
+        }
+        rachel_ai_pass_turn(game);
+    }
+    return FALSE;
+}
+
+/* First out, or fewest cards if the playout was cut short */
+static uint8_t mcts_winner(const Game* game) {
+    uint8_t i, best = 0;
+
+    for (i = 0; i < game->player_count; i++) {
+        if (game->players[i].finish_position == 1) {
+            return i;
+        }
+        if (game->players[i].hand_count < game->players[best].hand_count) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/* Uniformly random single cards, nominating our longest suit */
+static uint8_t mcts_rollout(Game* game, uint32_t turn_limit, RachelRng* rng) {
+    uint64_t valid;
+    uint32_t pick;
+    Card card;
+
+    while (mcts_settle(game, turn_limit)) {
+        valid = rachel_valid_plays_mask(game, game->current_player_index);
+        for (pick = rachel_rng_below(rng, RACHEL_MASK_COUNT(valid)); pick; pick--) {
+            valid &= valid - 1;
+        }
+        card = rachel_card_from_index(RACHEL_MASK_LOWEST(valid));
+        rachel_play_cards(game, game->current_player_index, &card, 1,
+                          rachel_ai_best_suit(
+                              game->players[game->current_player_index].hand_mask));
+        rachel_next_turn(game);
+    }
+    return mcts_winner(game);
+}
+
+static int32_t mcts_new_node(MctsSearch* search, int32_t parent,
+                             uint16_t action, uint8_t player) {
+    MctsNode* node = &search->nodes[search->node_count];
+
+    node->visits = 0;
+    node->available = 1;
+    node->wins = 0;
+    node->first_child = MCTS_NONE;
+    node->next_sibling = search->nodes[parent].first_child;
+    node->action = action;
+    node->player = player;
+    search->nodes[parent].first_child = (int32_t)search->node_count;
+    return (int32_t)search->node_count++;
+}
+
+/* One determinize - select - expand - playout - update pass */
+static void mcts_iterate(MctsSearch* search) {
+    Game* world = &search->world;
+    uint16_t actions[MCTS_MAX_ACTIONS];
+    bool_t tried[MCTS_MAX_ACTIONS];
+    int32_t path[MCTS_MAX_DEPTH];
+    uint8_t action_count, untried, player, winner, i;
+    uint32_t turn_limit, depth = 0, pick;
+    int32_t node = 0, child, best;
+    double score, best_score, log_available;
+    MctsNode* n;
+
+    rachel_mcts_determinize(search->root, search->observer, search->know, world,
+                            &search->rng);
+    turn_limit = world->turn_count + search->config->rollout_turns;
+    path[depth++] = 0;
+
+    while (depth < MCTS_MAX_DEPTH && mcts_settle(world, turn_limit)) {
+        action_count = mcts_actions(world, actions);
+        player = world->current_player_index;
+        memset(tried, 0, sizeof(tried));
+
+        /* Score the children that are legal in this world */
+        best = MCTS_NONE;
+        best_score = -1.0;
+        for (child = search->nodes[node].first_child; child != MCTS_NONE;
+             child = search->nodes[child].next_sibling) {
+            n = &search->nodes[child];
+            if (n->player != player) {
+                continue;
+            }
+            for (i = 0; i < action_count && actions[i] != n->action; i++) {
+            }
+            if (i == action_count) {
+                continue;
+            }
+            tried[i] = TRUE;
+            n->available++;
+            log_available = log((double)n->available);
+            score = n->visits == 0 ? 1e9 :
+                    (double)n->wins / n->visits +
+                    search->config->exploration * sqrt(log_available / n->visits);
+            if (score > best_score) {
+                best_score = score;
+                best = child;
+            }
+        }
+
+        /* Expand one untried move, then play out */
+        untried = 0;
+        for (i = 0; i < action_count; i++) {
+            untried += !tried[i];
+        }
+        if (untried > 0 && search->node_count < search->node_limit) {
+            pick = rachel_rng_below(&search->rng, untried);
+            for (i = 0; tried[i] || pick-- > 0; i++) {
+            }
+            child = mcts_new_node(search, node, actions[i], player);
+            mcts_apply(world, actions[i]);
+            path[depth++] = child;
+            break;
+        }
+        if (best == MCTS_NONE) {
+            break;
+        }
+
+        mcts_apply(world, search->nodes[best].action);
+        path[depth++] = best;
+        node = best;
+    }
+
+    winner = mcts_rollout(world, turn_limit, &search->rng);
+    while (depth > 0) {
+        n = &search->nodes[path[--depth]];
+        n->visits++;
+        n->wins += n->player == winner;
+    }
+    search->iterations++;
+}
+
+static void* mcts_search_run(void* arg) {
+    MctsSearch* search = (MctsSearch*)arg;
+
+    search->nodes[0].visits = 0;
+    search->nodes[0].available = 0;
+    search->nodes[0].wins = 0;
+    search->nodes[0].first_child = MCTS_NONE;
+    search->nodes[0].next_sibling = MCTS_NONE;
+    search->nodes[0].action = 0;
+    search->nodes[0].player = search->observer;
+    search->node_count = 1;
+
+    /* Check the clock every iteration - one playout is microseconds */
+    while (search->iteration_limit == 0 ||
+           search->iterations < search->iteration_limit) {
+        if (search->deadline > 0 && mcts_now_ms() >= search->deadline) {
+            search->hit_deadline = TRUE;
+            break;
+        }
+        mcts_iterate(search);
+    }
+    return 0;
+}
+
+bool_t rachel_mcts_choose(const Game* game, uint8_t player_id,
+                          const MctsConfig* config, AiPlay* play,
+                          MctsStats* stats) {
+    return rachel_mcts_choose_known(game, player_id, 0, config, play, stats);
+}
+
+bool_t rachel_mcts_choose_known(const Game* game, uint8_t player_id,
+                                const Knowledge* know, const MctsConfig* config,
+                                AiPlay* play, MctsStats* stats) {
+    MctsSearch* searches;
+    uint16_t actions[MCTS_MAX_ACTIONS];
+    uint32_t visits[MCTS_MAX_ACTIONS], wins[MCTS_MAX_ACTIONS];
+    uint8_t action_count, threads, allocated, i, best;
+    uint32_t t, cap, node_limit;
+    int32_t child;
+    double start = mcts_now_ms();
+    MctsStats local;
+    Game view;
+
+    if (stats == 0) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    /* Search from player_id's seat even if it is not their turn yet */
+    view = *game;
+    view.current_player_index = player_id;
+    action_count = mcts_actions(&view, actions);
+    if (action_count == 0) {
+        return FALSE;
+    }
+    stats->actions = action_count;
+    mcts_action_play(&view, actions[0], play);
+    if (action_count == 1) {
+        stats->elapsed_ms = mcts_now_ms() - start;
+        return TRUE;
+    }
+
+    threads = config->threads == 0 ? 1 :
+              config->threads > MCTS_MAX_THREADS ? MCTS_MAX_THREADS : config->threads;
+    allocated = threads;
+    searches = (MctsSearch*)calloc(threads, sizeof(MctsSearch));
+    if (searches == 0) {
+        return TRUE;
+    }
+
+    /* Each iteration adds at most one node */
+    node_limit = config->max_nodes < 2 ? 2 : config->max_nodes;
+    if (config->iterations > 0 && config->iterations / threads + 2 < node_limit) {
+        node_limit = config->iterations / threads + 2;
+    }
+
+    cap = config->max_latency_ms;
+    if (config->budget_ms > 0 && (cap == 0 || config->budget_ms < cap)) {
+        cap = config->budget_ms;
+    }
+    if (cap == 0 && config->iterations == 0) {
+        cap = 1000;    /* Never search forever */
+    }
+
+    for (t = 0; t < threads; t++) {
+        searches[t].root = &view;
+        searches[t].config = config;
+        searches[t].know = know;
+        searches[t].observer = player_id;
+        searches[t].node_limit = node_limit;
+        searches[t].iteration_limit = config->iterations == 0 ? 0 :
+            config->iterations / threads + (t < config->iterations % threads);
+        searches[t].deadline = cap > 0 ? start + cap : 0;
+        rachel_rng_seed(&searches[t].rng, config->seed, t);
+        searches[t].nodes = (MctsNode*)malloc(node_limit * sizeof(MctsNode));
+        if (searches[t].nodes == 0) {
+            threads = (uint8_t)t;
+            break;
+        }
+    }
+
+    /* Thread 0 searches on the caller's thread */
+    for (t = 1; t < threads; t++) {
+        if (pthread_create(&searches[t].thread, 0, mcts_search_run, &searches[t]) != 0) {
+            searches[t].iteration_limit = 0;
+            searches[t].deadline = -1;    /* Never started, contributes nothing */
+        }
+    }
+    if (threads > 0) {
+        mcts_search_run(&searches[0]);
+    }
+    for (t = 1; t < threads; t++) {
+        if (searches[t].deadline >= 0) {
+            pthread_join(searches[t].thread, 0);
+        }
+    }
+
+    /* Sum the root children of every tree by move */
+    memset(visits, 0, sizeof(visits));
+    memset(wins, 0, sizeof(wins));
+    for (t = 0; t < threads; t++) {
+        if (searches[t].deadline < 0) {
+            continue;
+        }
+        for (child = searches[t].nodes[0].first_child; child != MCTS_NONE;
+             child = searches[t].nodes[child].next_sibling) {
+            for (i = 0; i < action_count; i++) {
+                if (actions[i] == searches[t].nodes[child].action) {
+                    visits[i] += searches[t].nodes[child].visits;
+                    wins[i] += searches[t].nodes[child].wins;
+                    break;
+                }
+            }
+        }
+        stats->iterations += searches[t].iterations;
+        stats->nodes += searches[t].node_count;
+        stats->hit_deadline |= searches[t].hit_deadline;
+    }
+
+    /* Most visited move is the most robust */
+    best = 0;
+    for (i = 1; i < action_count; i++) {
+        if (visits[i] > visits[best]) {
+            best = i;
+        }
+    }
+    mcts_action_play(&view, actions[best], play);
+    stats->win_rate = visits[best] ? (double)wins[best] / visits[best] : 0.0;
+
+    for (t = 0; t < allocated; t++) {
+        free(searches[t].nodes);
+    }
+    free(searches);
+    stats->elapsed_ms = mcts_now_ms() - start;
+    return TRUE;
+}
+
+void rachel_mcts_policy_choose(const Game* game, uint8_t player_id,
+                               RachelRng* rng, AiPlay* play) {
+    rachel_mcts_policy_choose_known(game, player_id, 0, rng, play);
+}
+
+void rachel_mcts_policy_choose_known(const Game* game, uint8_t player_id,
+                                     const Knowledge* know, RachelRng* rng,
+                                     AiPlay* play) {
+    MctsConfig config;
+
+    rachel_mcts_default_config(&config);
+    config.iterations = 200;
+    config.max_latency_ms = 100;
+    config.seed = (uint64_t)rachel_rng_next(rng) << 32;
+    config.seed |= rachel_rng_next(rng);
+    rachel_mcts_choose_known(game, player_id, know, &config, play, 0);
+}
+
+/* Does world put a card where know says it cannot be: in a suit an
+ * opponent is void in, or a known card anywhere else? */
+static bool_t mcts_breaks(const Knowledge* know, const Game* world) {
+    uint64_t hand;
+    uint8_t p, s;
+
+    for (p = 0; p < world->player_count; p++) {
+        if (p == know->observer) {
+            continue;
+        }
+        hand = world->players[p].hand_mask & RACHEL_MASK_STANDARD;
+        if ((know->known[p] & ~hand) != 0) {
+            return TRUE;
+        }
+        for (s = 0; s < 4; s++) {
+            if ((know->void_suits[p] >> s & 1) && (hand & rachel_suit_masks[s])) {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+/* No two actions may make the same play, or they split its visits */
+static bool_t mcts_distinct(const Game* game) {
+    uint16_t actions[MCTS_MAX_ACTIONS];
+    AiPlay plays[MCTS_MAX_ACTIONS];
+    uint8_t count, i, j, k;
+
+    count = mcts_actions(game, actions);
+    for (i = 0; i < count; i++) {
+        mcts_action_play(game, actions[i], &plays[i]);
+        for (j = 0; j < i; j++) {
+            if (plays[j].count != plays[i].count ||
+                plays[j].nominated_suit != plays[i].nominated_suit) {
+                continue;
+            }
+            for (k = 0; k < plays[i].count &&
+                        plays[j].cards[k].encoded == plays[i].cards[k].encoded; k++) {
+            }
+            if (k == plays[i].count) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/* Determinized worlds must be real deals that agree with what the
+ * observer can see, and the search must answer with a legal play */
+bool_t rachel_mcts_self_test(void) {
+    MctsConfig config;
+    AiPlay play, again;
+    RachelRng rng;
+    Game game, world;
+    Knowledge know;
+    EventLog log;
+    EventRecord record;
+    uint64_t all, mask;
+    uint32_t next, turn, kept = 0, broken = 0, searched = 0, jokers = 0;
+    uint8_t observer, i, j, total;
+    int seed;
+
+    rachel_mcts_default_config(&config);
+    config.iterations = 64;
+    config.max_latency_ms = 0;
+    rachel_rng_seed(&rng, 0x15, 0);
+
+    for (seed = 0; seed < 6; seed++) {
+        rachel_test_deal(&game, (uint8_t)(2 + seed), seed & 1, 77, seed);
+
+        /* A few turns in, so the discard pile has some history */
+        for (i = 0; i < 12 && !rachel_is_game_over(&game); i++) {
+            rachel_ai_take_turn(&game, &rachel_ai_policies[0], &rng);
+        }
+        observer = game.current_player_index;
+
+        rachel_mcts_determinize(&game, observer, 0, &world, &rng);
+        all = 0;
+        total = world.deck_count + world.discard_count;
+        for (i = 0; i < world.player_count; i++) {
+            if (world.players[i].hand_count != game.players[i].hand_count) {
+                return FALSE;
+            }
+            mask = 0;
+            for (j = 0; j < world.players[i].hand_count; j++) {
+                mask = rachel_mask_add(mask, world.players[i].hand[j]);
+            }
+            if (mask != world.players[i].hand_mask || (mask & all & RACHEL_MASK_STANDARD)) {
+                return FALSE;
+            }
+            all |= mask;
+            total += world.players[i].hand_count;
+        }
+        for (i = 0; i < world.deck_count; i++) {
+            if (!IS_JOKER(RACHEL_DECK(&world)[i].encoded) &&
+                (all & rachel_card_bit(RACHEL_DECK(&world)[i]))) {
+                return FALSE;
+            }
+            all |= rachel_card_bit(RACHEL_DECK(&world)[i]);
+        }
+        if (total != (game.ultimate_mode ? ULTIMATE_DECK : STANDARD_DECK) ||
+            world.players[observer].hand_mask != game.players[observer].hand_mask ||
+            world.hash != rachel_hash_game(&world)) {
+            return FALSE;
+        }
+
+        /* Legal, and the same answer for the same seed */
+        if (rachel_valid_plays_mask(&game, observer) == 0) {
+            continue;
+        }
+        config.seed = seed;
+        rachel_mcts_choose(&game, observer, &config, &play, 0);
+        rachel_mcts_choose(&game, observer, &config, &again, 0);
+        if (play.count != again.count || play.nominated_suit != again.nominated_suit ||
+            play.cards[0].encoded != again.cards[0].encoded) {
+            return FALSE;
+        }
+        world = game;
+        if (!rachel_play_cards(&world, observer, play.cards, play.count,
+                               play.nominated_suit)) {
+            return FALSE;
+        }
+    }
+
+    /* Seat 0 follows seeded games from the log. Its worlds must keep to
+     * what it has seen, which worlds from the position alone do not, and
+     * the policy entry must search them to a legal play. */
+    rachel_log_init(&log, NULL);
+    for (seed = 0; seed < 6; seed++) {
+        rachel_test_seat(&game, (uint8_t)(3 + seed % 3), seed & 1);
+        log.count = 0;
+        next = 0;
+        rachel_log_start_game(&log, &game, 77, (uint32_t)seed);
+        know.observer = 0;
+
+        for (turn = 0; turn < 200 && !rachel_is_game_over(&game); turn++) {
+            if (turn > 0) {
+                rachel_ai_take_turn_log(&game, &rachel_ai_policies[2], &rng, &log);
+            }
+            for (; next < log.count; next++) {
+                rachel_log_decode(log.pending + (size_t)next * EVENT_RECORD_SIZE,
+                                  &record);
+                rachel_know_observe(&know, &game, &record);
+            }
+            if (!mcts_distinct(&game)) {
+                rachel_log_free(&log);
+                return FALSE;
+            }
+            mask = game.players[game.current_player_index].hand_mask;
+            jokers += RACHEL_MASK_COUNT(mask & RACHEL_MASK_JOKERS) > 1 &&
+                      (rachel_valid_plays_mask(&game, game.current_player_index) &
+                       RACHEL_MASK_JOKERS);
+            if (turn % 4 != 0) {
+                continue;
+            }
+            for (i = 0; i < 4; i++) {
+                rachel_mcts_determinize(&game, 0, &know, &world, &rng);
+                kept += mcts_breaks(&know, &world);
+                rachel_mcts_determinize(&game, 0, 0, &world, &rng);
+                broken += mcts_breaks(&know, &world);
+            }
+            if (game.current_player_index == 0 && rachel_valid_plays_mask(&game, 0)) {
+                rachel_ai_find("ismcts")->choose_known(&game, 0, &know, &rng, &play);
+                world = game;
+                if (!rachel_play_cards(&world, 0, play.cards, play.count,
+                                       play.nominated_suit)) {
+                    rachel_log_free(&log);
+                    return FALSE;
+                }
+                searched++;
+            }
+        }
+    }
+    rachel_log_free(&log);
+    return kept == 0 && broken > 0 && searched > 0 && jokers > 0;
+}
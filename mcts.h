@@ -0,0 +1,86 @@
+/*
+ * RACHEL INFORMATION-SET MONTE CARLO TREE SEARCH
+ *
+ * A computer player that only knows what a human in its seat would:
+ * its own hand, the discard pile, everyone's card counts and, given a
+ * tracker (knowledge.h), what the play so far has shown. Each iteration
+ * samples the hidden cards to agree with all of it, walks a shared tree
+ * of moves (SO-ISMCTS) and plays the game out at random.
+ *
+ * Search stops at an iteration count, a time budget or the hard latency
+ * cap, whichever comes first. Several threads can each grow their own
+ * tree from the root; their root statistics are summed at the end.
+ */
+
+#ifndef RACHEL_MCTS_H
+#define RACHEL_MCTS_H
+
+#include "rules.h"
+#include "ai.h"
+#include "knowledge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MCTS_MAX_THREADS  64
+
+typedef struct {
+    uint32_t iterations;       /* Total rollouts per move, 0 = time only */
+    uint32_t budget_ms;        /* Time budget per move, 0 = none */
+    uint32_t max_latency_ms;   /* Hard cap per move, 0 = none */
+    uint8_t  threads;          /* Root-parallel trees, 1 = no threads */
+    uint32_t max_nodes;        /* Tree size per thread */
+    uint16_t rollout_turns;    /* Playouts longer than this are scored */
+    double   exploration;      /* UCB constant */
+    uint64_t seed;
+} MctsConfig;
+
+typedef struct {
+    uint32_t iterations;
+    uint32_t nodes;
+    uint8_t  actions;          /* Distinct moves at the root */
+    double   elapsed_ms;
+    bool_t   hit_deadline;
+    double   win_rate;         /* Estimated for the chosen move */
+} MctsStats;
+
+/* Sensible defaults: 1000 iterations, one thread, 1 second cap */
+void rachel_mcts_default_config(MctsConfig* config);
+
+/* Choose a play for player_id, who must have a valid play.
+ * Never looks at hidden hands, the deck order or the game's RNG.
+ * stats may be NULL. Returns FALSE only if there was nothing to play. */
+bool_t rachel_mcts_choose(const Game* game, uint8_t player_id,
+                          const MctsConfig* config, AiPlay* play,
+                          MctsStats* stats);
+
+/* The same, sampling worlds that agree with know, player_id's tracker
+ * for this game: draws seen, suits shown void. NULL = the position only. */
+bool_t rachel_mcts_choose_known(const Game* game, uint8_t player_id,
+                                const Knowledge* know, const MctsConfig* config,
+                                AiPlay* play, MctsStats* stats);
+
+/* Resample everything player_id cannot see: opponents' hands, the deck
+ * order and the RNG. Card counts and public cards are kept. With know,
+ * the deal is rachel_know_sample's; NULL shuffles the unseen cards. */
+void rachel_mcts_determinize(const Game* game, uint8_t player_id,
+                             const Knowledge* know, Game* out, RachelRng* rng);
+
+/* AiPolicy adapter: 200 iterations, single thread, seeded from rng */
+void rachel_mcts_policy_choose(const Game* game, uint8_t player_id,
+                               RachelRng* rng, AiPlay* play);
+
+/* Its choose_known: the same search, dealing worlds from know */
+void rachel_mcts_policy_choose_known(const Game* game, uint8_t player_id,
+                                     const Knowledge* know, RachelRng* rng,
+                                     AiPlay* play);
+
+/* Determinization and search sanity checks */
+bool_t rachel_mcts_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RACHEL_MCTS_H */
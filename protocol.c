@@ -0,0 +1,614 @@
+/*
+ * RACHEL WIRE PROTOCOL
+ *
+ * Frames are packed a byte at a time, so the layout is the same on
+ * every compiler, padding rule and byte order.
+ */
+
+#include <string.h>
+#include "protocol.h"
+
+static void net_put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t net_get32(const uint8_t* p) {
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+}
+
+static void net_put64(uint8_t* p, uint64_t v) {
+    net_put32(p, (uint32_t)v);
+    net_put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t net_get64(const uint8_t* p) {
+    return net_get32(p) | ((uint64_t)net_get32(p + 4) << 32);
+}
+
+/* Seats whose bit is set in mask, one byte each */
+static uint8_t* net_put_seats(uint8_t* p, uint8_t mask, const uint8_t* values) {
+    int i;
+
+    *p++ = mask;
+    for (i = 0; i < MAX_PLAYERS; i++) {
+        if (mask & (1u << i)) {
+            *p++ = values[i];
+        }
+    }
+    return p;
+}
+
+static const uint8_t* net_get_seats(const uint8_t* p, uint8_t* mask, uint8_t* values) {
+    int i;
+
+    *mask = *p++;
+    for (i = 0; i < MAX_PLAYERS; i++) {
+        if (*mask & (1u << i)) {
+            values[i] = *p++;
+        }
+    }
+    return p;
+}
+
+/* At most 2 + 4 + 5 + 2 + 2 + 9 + 9 + 18 = 51 bytes; returns how many */
+static size_t net_put_delta(const NetDelta* delta, uint8_t* p) {
+    uint8_t* start = p;
+    uint16_t changed = delta->changed;
+    int i;
+
+    p[0] = (uint8_t)changed;
+    p[1] = (uint8_t)(changed >> 8);
+    net_put32(p + 2, delta->turn_count);
+    p += 6;
+    if (changed & NET_DELTA_STATE)     *p++ = delta->state;
+    if (changed & NET_DELTA_CURRENT)   *p++ = delta->current_player;
+    if (changed & NET_DELTA_DIRECTION) *p++ = delta->direction;
+    if (changed & NET_DELTA_NOMINATED) *p++ = delta->nominated_suit;
+    if (changed & NET_DELTA_TOP)       *p++ = rachel_encode_card(delta->top_card);
+    if (changed & NET_DELTA_PENDING) {
+        *p++ = delta->pending_type;
+        *p++ = delta->pending_count;
+    }
+    if (changed & NET_DELTA_PILES) {
+        *p++ = delta->deck_count;
+        *p++ = delta->discard_count;
+    }
+    if (changed & NET_DELTA_COUNTS) {
+        p = net_put_seats(p, delta->counts_changed, delta->hand_counts);
+    }
+    if (changed & NET_DELTA_FINISH) {
+        p = net_put_seats(p, delta->finish_changed, delta->finish);
+    }
+    if (changed & NET_DELTA_HAND_CARDS) {
+        *p++ = delta->gained;
+        *p++ = delta->lost;
+        for (i = 0; i < delta->gained + delta->lost; i++) {
+            *p++ = rachel_encode_card(delta->cards[i]);
+        }
+    }
+    if (changed & NET_DELTA_HAND_MASK) {
+        net_put64(p, delta->hand_mask);
+        p += 8;
+    }
+    return (size_t)(p - start);
+}
+
+/* Parsed from a zero-padded copy, so a length that lies about the
+ * fields reads nothing past the frame and is caught at the end */
+static bool_t net_get_delta(const uint8_t* in, size_t length, NetDelta* delta) {
+    uint8_t copy[NET_PAYLOAD_SIZE - 1];
+    const uint8_t* p = copy;
+    uint16_t changed;
+    int i;
+
+    memset(delta, 0, sizeof(*delta));
+    if (length < 6 || length > sizeof(copy)) {
+        return FALSE;
+    }
+    memset(copy, 0, sizeof(copy));
+    memcpy(copy, in, length);
+    changed = (uint16_t)(p[0] | (p[1] << 8));
+    delta->changed = changed;
+    delta->turn_count = net_get32(p + 2);
+    p += 6;
+    if ((changed & ~(NET_DELTA_HAND_MASK * 2 - 1)) ||
+        ((changed & NET_DELTA_HAND_CARDS) && (changed & NET_DELTA_HAND_MASK))) {
+        return FALSE;       /* Unknown fields, or more than a frame holds */
+    }
+    if (changed & NET_DELTA_STATE)     delta->state = *p++;
+    if (changed & NET_DELTA_CURRENT)   delta->current_player = *p++;
+    if (changed & NET_DELTA_DIRECTION) delta->direction = *p++;
+    if (changed & NET_DELTA_NOMINATED) delta->nominated_suit = *p++;
+    if (changed & NET_DELTA_TOP)       delta->top_card = rachel_decode_card(*p++);
+    if (changed & NET_DELTA_PENDING) {
+        delta->pending_type = *p++;
+        delta->pending_count = *p++;
+    }
+    if (changed & NET_DELTA_PILES) {
+        delta->deck_count = *p++;
+        delta->discard_count = *p++;
+    }
+    if (changed & NET_DELTA_COUNTS) {
+        p = net_get_seats(p, &delta->counts_changed, delta->hand_counts);
+    }
+    if (changed & NET_DELTA_FINISH) {
+        p = net_get_seats(p, &delta->finish_changed, delta->finish);
+    }
+    if (changed & NET_DELTA_HAND_CARDS) {
+        delta->gained = *p++;
+        delta->lost = *p++;
+        if (delta->gained + delta->lost > NET_DELTA_MAX_CARDS) {
+            return FALSE;
+        }
+        for (i = 0; i < delta->gained + delta->lost; i++) {
+            delta->cards[i] = rachel_decode_card(*p++);
+        }
+    }
+    if (changed & NET_DELTA_HAND_MASK) {
+        delta->hand_mask = net_get64(p);
+        p += 8;
+    }
+    return (size_t)(p - copy) == length;
+}
+
+size_t rachel_net_encode(const NetMessage* msg, uint8_t* frame) {
+    uint8_t* payload = frame + NET_HEADER_SIZE;
+    const NetState* state = &msg->u.state;
+    int i;
+
+    memset(frame, 0, NET_FRAME_SIZE);
+    frame[0] = NET_MAGIC;
+    frame[1] = NET_VERSION;
+    frame[2] = msg->type;
+    frame[3] = msg->seat;
+    net_put32(frame + 4, msg->table);
+    net_put32(frame + 8, msg->seq);
+
+    switch (msg->type) {
+    case NET_MSG_JOIN:
+        payload[0] = msg->u.join.players;
+        payload[1] = msg->u.join.bots;
+        memcpy(payload + 2, msg->u.join.name, NET_NAME_SIZE);
+        payload[2 + NET_NAME_SIZE - 1] = 0;
+        break;
+    case NET_MSG_PLAY:
+        payload[0] = msg->u.play.count;
+        for (i = 0; i < RACHEL_MAX_PLAY; i++) {
+            payload[1 + i] = rachel_encode_card(msg->u.play.cards[i]);
+        }
+        payload[5] = msg->u.play.nominated_suit;
+        break;
+    case NET_MSG_WELCOME:
+        payload[0] = msg->u.players;
+        break;
+    case NET_MSG_REJECT:
+        payload[0] = msg->u.reason;
+        break;
+    case NET_MSG_STATE:
+        payload[0] = state->state;
+        payload[1] = state->player_count;
+        payload[2] = state->current_player;
+        payload[3] = state->direction;
+        payload[4] = state->nominated_suit;
+        payload[5] = rachel_encode_card(state->top_card);
+        payload[6] = state->pending_type;
+        payload[7] = state->pending_count;
+        payload[8] = state->deck_count;
+        payload[9] = state->discard_count;
+        net_put32(payload + 10, state->turn_count);
+        net_put64(payload + 14, state->hand_mask);
+        memcpy(payload + 22, state->hand_counts, MAX_PLAYERS);
+        memcpy(payload + 30, state->finish, MAX_PLAYERS);
+        break;
+    case NET_MSG_DELTA:
+        payload[0] = (uint8_t)net_put_delta(&msg->u.delta, payload + 1);
+        return NET_HEADER_SIZE + 1 + payload[0];
+    }
+    return NET_FRAME_SIZE;
+}
+
+bool_t rachel_net_decode(const uint8_t* frame, NetMessage* msg) {
+    const uint8_t* payload = frame + NET_HEADER_SIZE;
+    NetState* state = &msg->u.state;
+    int i;
+
+    if (frame[0] != NET_MAGIC || frame[1] != NET_VERSION) {
+        return FALSE;
+    }
+    msg->type = frame[2];
+    msg->seat = frame[3];
+    msg->table = net_get32(frame + 4);
+    msg->seq = net_get32(frame + 8);
+
+    switch (msg->type) {
+    case NET_MSG_JOIN:
+        msg->u.join.players = payload[0];
+        msg->u.join.bots = payload[1];
+        memcpy(msg->u.join.name, payload + 2, NET_NAME_SIZE);
+        msg->u.join.name[NET_NAME_SIZE - 1] = 0;
+        return TRUE;
+    case NET_MSG_PLAY:
+        msg->u.play.count = payload[0];
+        for (i = 0; i < RACHEL_MAX_PLAY; i++) {
+            msg->u.play.cards[i] = rachel_decode_card(payload[1 + i]);
+        }
+        msg->u.play.nominated_suit = payload[5];
+        return TRUE;
+    case NET_MSG_LEAVE:
+    case NET_MSG_RESYNC:
+    case NET_MSG_WATCH:
+        return TRUE;
+    case NET_MSG_WELCOME:
+        msg->u.players = payload[0];
+        return TRUE;
+    case NET_MSG_REJECT:
+        msg->u.reason = payload[0];
+        return TRUE;
+    case NET_MSG_STATE:
+        state->state = payload[0];
+        state->player_count = payload[1];
+        state->current_player = payload[2];
+        state->direction = payload[3];
+        state->nominated_suit = payload[4];
+        state->top_card = rachel_decode_card(payload[5]);
+        state->pending_type = payload[6];
+        state->pending_count = payload[7];
+        state->deck_count = payload[8];
+        state->discard_count = payload[9];
+        state->turn_count = net_get32(payload + 10);
+        state->hand_mask = net_get64(payload + 14);
+        memcpy(state->hand_counts, payload + 22, MAX_PLAYERS);
+        memcpy(state->finish, payload + 30, MAX_PLAYERS);
+        return state->player_count <= MAX_PLAYERS;
+    case NET_MSG_DELTA:
+        return net_get_delta(payload + 1, payload[0], &msg->u.delta);
+    }
+    return FALSE;
+}
+
+size_t rachel_net_frame_size(const uint8_t* frame, size_t have) {
+    if (have < NET_MIN_FRAME_SIZE) {
+        return NET_MIN_FRAME_SIZE;
+    }
+    if (frame[0] == NET_MAGIC && frame[1] == NET_VERSION &&
+        frame[2] == NET_MSG_DELTA && frame[NET_HEADER_SIZE] >= 6 &&
+        frame[NET_HEADER_SIZE] < NET_PAYLOAD_SIZE) {
+        return NET_HEADER_SIZE + 1 + frame[NET_HEADER_SIZE];
+    }
+    return NET_FRAME_SIZE;
+}
+
+void rachel_net_state(const Game* game, uint8_t seat, NetState* state) {
+    int i;
+
+    memset(state, 0, sizeof(*state));
+    state->state = (uint8_t)game->state;
+    state->player_count = game->player_count;
+    state->current_player = game->current_player_index;
+    state->direction = (uint8_t)game->direction;
+    state->nominated_suit = game->nominated_suit;
+    state->top_card.encoded = NO_CARD;
+    if (game->discard_count > 0) {
+        state->top_card = RACHEL_TOP_CARD(game);
+    }
+    state->pending_type = game->pending_effect.type;
+    state->pending_count = game->pending_effect.count;
+    state->deck_count = game->deck_count;
+    state->discard_count = game->discard_count;
+    state->turn_count = game->turn_count;
+    if (seat < game->player_count) {
+        state->hand_mask = game->players[seat].hand_mask;
+    }
+    for (i = 0; i < game->player_count; i++) {
+        state->hand_counts[i] = game->players[i].hand_count;
+        state->finish[i] = game->players[i].finish_position;
+    }
+}
+
+bool_t rachel_net_diff(const NetState* from, const NetState* to, NetDelta* delta) {
+    uint64_t gained, lost, hand;
+    uint16_t changed = 0;
+    int i, n = 0;
+
+    if (from->player_count != to->player_count) {
+        return FALSE;
+    }
+    delta->turn_count = to->turn_count;
+    delta->state = to->state;
+    delta->current_player = to->current_player;
+    delta->direction = to->direction;
+    delta->nominated_suit = to->nominated_suit;
+    delta->top_card = to->top_card;
+    delta->pending_type = to->pending_type;
+    delta->pending_count = to->pending_count;
+    delta->deck_count = to->deck_count;
+    delta->discard_count = to->discard_count;
+    delta->hand_mask = to->hand_mask;
+    memcpy(delta->hand_counts, to->hand_counts, MAX_PLAYERS);
+    memcpy(delta->finish, to->finish, MAX_PLAYERS);
+
+    if (from->state != to->state) changed |= NET_DELTA_STATE;
+    if (from->current_player != to->current_player) changed |= NET_DELTA_CURRENT;
+    if (from->direction != to->direction) changed |= NET_DELTA_DIRECTION;
+    if (from->nominated_suit != to->nominated_suit) changed |= NET_DELTA_NOMINATED;
+    if (from->top_card.encoded != to->top_card.encoded) changed |= NET_DELTA_TOP;
+    if (from->pending_type != to->pending_type ||
+        from->pending_count != to->pending_count) changed |= NET_DELTA_PENDING;
+    if (from->deck_count != to->deck_count ||
+        from->discard_count != to->discard_count) changed |= NET_DELTA_PILES;
+
+    delta->counts_changed = 0;
+    delta->finish_changed = 0;
+    for (i = 0; i < to->player_count; i++) {
+        if (from->hand_counts[i] != to->hand_counts[i]) {
+            delta->counts_changed |= (uint8_t)(1u << i);
+        }
+        if (from->finish[i] != to->finish[i]) {
+            delta->finish_changed |= (uint8_t)(1u << i);
+        }
+    }
+    if (delta->counts_changed) changed |= NET_DELTA_COUNTS;
+    if (delta->finish_changed) changed |= NET_DELTA_FINISH;
+
+    /* Our own hand: the cards in and out, or the whole mask if that is
+     * shorter than a long list. Jokers are a count in unary bits, not
+     * cards with bits of their own, so any change to them sends the mask. */
+    gained = to->hand_mask & ~from->hand_mask;
+    lost = from->hand_mask & ~to->hand_mask;
+    delta->gained = RACHEL_MASK_COUNT(gained);
+    delta->lost = RACHEL_MASK_COUNT(lost);
+    if (delta->gained + delta->lost > NET_DELTA_MAX_CARDS ||
+        ((gained | lost) & RACHEL_MASK_JOKERS)) {
+        changed |= NET_DELTA_HAND_MASK;
+        delta->gained = delta->lost = 0;
+    } else if (gained | lost) {
+        changed |= NET_DELTA_HAND_CARDS;
+        for (hand = gained; hand; hand &= hand - 1) {
+            delta->cards[n++] = rachel_card_from_index(RACHEL_MASK_LOWEST(hand));
+        }
+        for (hand = lost; hand; hand &= hand - 1) {
+            delta->cards[n++] = rachel_card_from_index(RACHEL_MASK_LOWEST(hand));
+        }
+    }
+    delta->changed = changed;
+    return TRUE;
+}
+
+bool_t rachel_net_apply(NetState* state, const NetDelta* delta) {
+    uint16_t changed = delta->changed;
+    uint64_t hand = state->hand_mask, bit;
+    uint8_t seats = (uint8_t)((1u << state->player_count) - 1);
+    int i;
+
+    if (delta->turn_count < state->turn_count ||
+        ((changed & NET_DELTA_COUNTS) && (delta->counts_changed & ~seats)) ||
+        ((changed & NET_DELTA_FINISH) && (delta->finish_changed & ~seats))) {
+        return FALSE;
+    }
+    if (changed & NET_DELTA_HAND_CARDS) {
+        for (i = 0; i < delta->gained + delta->lost; i++) {
+            bit = rachel_card_bits[delta->cards[i].encoded];
+            if (bit == 0 || (bit & RACHEL_MASK_JOKERS) ||
+                ((hand & bit) != 0) != (i >= delta->gained)) {
+                return FALSE;       /* A joker, gained one we hold, or lost one we don't */
+            }
+            hand ^= bit;
+        }
+    }
+    if (changed & NET_DELTA_HAND_MASK) {
+        hand = delta->hand_mask;
+    }
+
+    state->turn_count = delta->turn_count;
+    state->hand_mask = hand;
+    if (changed & NET_DELTA_STATE)     state->state = delta->state;
+    if (changed & NET_DELTA_CURRENT)   state->current_player = delta->current_player;
+    if (changed & NET_DELTA_DIRECTION) state->direction = delta->direction;
+    if (changed & NET_DELTA_NOMINATED) state->nominated_suit = delta->nominated_suit;
+    if (changed & NET_DELTA_TOP)       state->top_card = delta->top_card;
+    if (changed & NET_DELTA_PENDING) {
+        state->pending_type = delta->pending_type;
+        state->pending_count = delta->pending_count;
+    }
+    if (changed & NET_DELTA_PILES) {
+        state->deck_count = delta->deck_count;
+        state->discard_count = delta->discard_count;
+    }
+    for (i = 0; i < state->player_count; i++) {
+        if ((changed & NET_DELTA_COUNTS) && (delta->counts_changed & (1u << i))) {
+            state->hand_counts[i] = delta->hand_counts[i];
+        }
+        if ((changed & NET_DELTA_FINISH) && (delta->finish_changed & (1u << i))) {
+            state->finish[i] = delta->finish[i];
+        }
+    }
+    return TRUE;
+}
+
+void rachel_net_view(const NetState* state, uint8_t seat, Game* view) {
+    uint64_t hand;
+    Player* player;
+    int i;
+
+    memset(view, 0, sizeof(*view));
+    view->player_count = state->player_count;
+    view->current_player_index = state->current_player;
+    view->state = (GameState)state->state;
+    view->direction = state->direction ? DIR_COUNTER_CLOCKWISE : DIR_CLOCKWISE;
+    view->nominated_suit = state->nominated_suit;
+    view->pending_effect.type = state->pending_type;
+    view->pending_effect.count = state->pending_count;
+    view->pending_effect.source_player = 0xFF;
+    view->deck_count = 0;
+    view->turn_count = state->turn_count;
+    if (state->top_card.encoded != NO_CARD) {
+        RACHEL_DISCARD(view)[0] = state->top_card;
+        view->discard_count = 1;
+    }
+
+    for (i = 0; i < state->player_count && i < MAX_PLAYERS; i++) {
+        player = &view->players[i];
+        player->id = (uint8_t)i;
+        player->hand_count = state->hand_counts[i];
+        player->finish_position = state->finish[i];
+        player->is_out = state->finish[i] != 0;
+        if (player->is_out) {
+            view->winner_count++;
+        }
+    }
+
+    if (seat < MAX_PLAYERS) {
+        player = &view->players[seat];
+        hand = state->hand_mask;
+        player->hand_mask = hand;
+        player->hand_count = 0;
+        while (hand && player->hand_count < MAX_HAND_SIZE) {
+            player->hand[player->hand_count++] =
+                rachel_card_from_index(RACHEL_MASK_LOWEST(hand));
+            hand &= hand - 1;
+        }
+    }
+    view->hash = rachel_hash_game(view);
+}
+
+/* Follow a seeded game from its first STATE on deltas alone, through
+ * the wire, at every seat; each view must stay the one STATE would send.
+ * The bytes after each frame are junk, as in a reader's buffer. */
+static bool_t net_test_deltas(uint8_t players, bool_t ultimate, uint64_t stream) {
+    NetState views[MAX_PLAYERS], now;
+    NetMessage msg, back;
+    uint8_t frame[NET_FRAME_SIZE];
+    MoveUndo undo;
+    Move move;
+    Game game;
+    size_t size;
+    int seat;
+
+    rachel_test_deal(&game, players, ultimate, 64, stream);
+    for (seat = 0; seat < players; seat++) {
+        rachel_net_state(&game, (uint8_t)seat, &views[seat]);
+    }
+
+    while (!rachel_is_game_over(&game) && game.turn_count < 1000) {
+        rachel_test_move(&game, &move);
+        if (!rachel_make_move(&game, &move, &undo)) {
+            return FALSE;
+        }
+        for (seat = 0; seat < players; seat++) {
+            rachel_net_state(&game, (uint8_t)seat, &now);
+            memset(&msg, 0, sizeof(msg));
+            msg.type = NET_MSG_DELTA;
+            if (!rachel_net_diff(&views[seat], &now, &msg.u.delta)) {
+                return FALSE;
+            }
+            size = rachel_net_encode(&msg, frame);
+            memset(frame + size, 0xA5, NET_FRAME_SIZE - size);
+            if (rachel_net_frame_size(frame, NET_MIN_FRAME_SIZE - 1) != NET_MIN_FRAME_SIZE ||
+                rachel_net_frame_size(frame, NET_MIN_FRAME_SIZE) != size ||
+                !rachel_net_decode(frame, &back) || back.type != NET_MSG_DELTA ||
+                !rachel_net_apply(&views[seat], &back.u.delta) ||
+                memcmp(&views[seat], &now, sizeof(NetState)) != 0) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+bool_t rachel_net_self_test(void) {
+    NetMessage msg, back;
+    NetState view_state;
+    NetDelta delta;
+    uint8_t frame[NET_FRAME_SIZE];
+    Game game, view;
+    int seed, i;
+
+    /* Every seat's state survives the wire and rebuilds a usable view */
+    for (seed = 0; seed < 4; seed++) {
+        rachel_test_deal(&game, (uint8_t)(2 + seed * 2), seed & 1, 64, seed);
+
+        for (i = 0; i < game.player_count; i++) {
+            memset(&msg, 0, sizeof(msg));
+            msg.type = NET_MSG_STATE;
+            msg.seat = (uint8_t)i;
+            msg.table = 0x01020304UL + seed;
+            msg.seq = 0xFFFFFFF0UL;
+            rachel_net_state(&game, (uint8_t)i, &msg.u.state);
+            if (rachel_net_encode(&msg, frame) != NET_FRAME_SIZE ||
+                rachel_net_frame_size(frame, NET_MIN_FRAME_SIZE) != NET_FRAME_SIZE) {
+                return FALSE;
+            }
+            memset(&back, 0, sizeof(back));
+            if (!rachel_net_decode(frame, &back) || back.table != msg.table ||
+                back.seq != msg.seq || back.seat != i ||
+                memcmp(&back.u.state, &msg.u.state, sizeof(NetState)) != 0) {
+                return FALSE;
+            }
+            rachel_net_view(&back.u.state, (uint8_t)i, &view);
+            if (rachel_valid_plays_mask(&view, (uint8_t)i) !=
+                rachel_valid_plays_mask(&game, (uint8_t)i)) {
+                return FALSE;
+            }
+        }
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_PLAY;
+    msg.u.play.count = 2;
+    msg.u.play.cards[0].encoded = MAKE_CARD(SUIT_SPADES, RANK_ACE);
+    msg.u.play.cards[1].encoded = MAKE_CARD(SUIT_CLUBS, RANK_ACE);
+    msg.u.play.nominated_suit = SUIT_DIAMONDS;
+    rachel_net_encode(&msg, frame);
+    if (!rachel_net_decode(frame, &back) || back.u.play.count != 2 ||
+        back.u.play.cards[1].encoded != msg.u.play.cards[1].encoded ||
+        back.u.play.cards[2].encoded != NO_CARD ||
+        back.u.play.nominated_suit != SUIT_DIAMONDS) {
+        return FALSE;
+    }
+
+    /* Deltas along whole games, two to eight seats, with and without
+     * jokers */
+    for (seed = 0; seed < 8; seed++) {
+        if (!net_test_deltas((uint8_t)(2 + (seed & 3) * 2), seed >= 4,
+                             (uint64_t)seed)) {
+            return FALSE;
+        }
+    }
+
+    /* A big penalty sends the whole hand; a stale view is refused */
+    rachel_net_state(&game, 0, &msg.u.state);
+    view_state = msg.u.state;
+    view_state.hand_mask = RACHEL_MASK_STANDARD >> 20;
+    view_state.turn_count++;
+    if (!rachel_net_diff(&msg.u.state, &view_state, &delta) ||
+        !(delta.changed & NET_DELTA_HAND_MASK) || (delta.changed & NET_DELTA_HAND_CARDS) ||
+        !rachel_net_apply(&msg.u.state, &delta) ||
+        memcmp(&msg.u.state, &view_state, sizeof(NetState)) != 0) {
+        return FALSE;
+    }
+    view_state.turn_count = 0;
+    if (rachel_net_diff(&msg.u.state, &view_state, &delta) &&
+        rachel_net_apply(&msg.u.state, &delta)) {
+        return FALSE;
+    }
+
+    /* A DELTA whose length disagrees with its fields is refused */
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_DELTA;
+    msg.u.delta.changed = NET_DELTA_CURRENT | NET_DELTA_PILES;
+    if (rachel_net_encode(&msg, frame) != NET_MIN_FRAME_SIZE + 3 ||
+        !rachel_net_decode(frame, &back)) {
+        return FALSE;
+    }
+    frame[NET_HEADER_SIZE]--;
+    if (rachel_net_decode(frame, &back)) {
+        return FALSE;
+    }
+
+    frame[0] = 'X';
+    return !rachel_net_decode(frame, &back);
+}
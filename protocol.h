@@ -0,0 +1,212 @@
+/*
+ * RACHEL WIRE PROTOCOL
+ *
+ * Every message is one frame of at most 64 bytes, both ways:
+ *
+ *   0      'R'             magic
+ *   1      version
+ *   2      type            NET_MSG_*
+ *   3      seat
+ *   4-7    table           little-endian
+ *   8-11   sequence        little-endian, per connection
+ *   12-63  payload         depends on type, zero padded
+ *
+ * Frames are the whole 64 bytes but for DELTA, which stops after its
+ * last field. A reader takes NET_MIN_FRAME_SIZE bytes, asks
+ * rachel_net_frame_size how long the frame is, and reads the rest.
+ *
+ * Cards travel as rachel_encode_card bytes. A player's own hand is sent
+ * as its 64-bit bitboard, so any hand fits in one frame; opponents' hands
+ * are only ever counts.
+ *
+ * STATE is a seat's whole view and works as a snapshot: a client that
+ * has one knows everything it may know. After the first STATE of a
+ * game the server sends DELTA frames instead. A DELTA carries the turn
+ * count and then only the fields that changed, in this order, each
+ * present when its NET_DELTA_* bit is set:
+ *
+ *   0      length          of the delta after this byte, 6 to 51
+ *   1-2    changed         little-endian NET_DELTA_* bits
+ *   3-6    turn count      always
+ *          state, current player, direction, nominated suit, top card
+ *                          one byte each
+ *          pending         type, count
+ *          piles           deck count, discard count
+ *          counts, finish  a seat bit mask, then one byte per set bit
+ *          hand cards      cards gained, cards lost, then the cards
+ *          hand mask       the whole hand, for when the lists are long
+ *                          or the joker count changed
+ *
+ * The worst case is 51 bytes, so every delta fits one frame; a turn's
+ * delta is typically half of that. A client
+ * whose view falls out of step sends RESYNC and gets a fresh STATE.
+ *
+ * A spectator sends WATCH with a table id in the header and from then on
+ * gets that table's public view as whole STATE frames, game after game,
+ * with seat NET_SEAT_SPECTATOR and no hand. The server encodes each of
+ * these frames once, for all its spectators. Their sequence number is
+ * the table's view count rather than the connection's, and a gap means
+ * the spectator fell behind and older views were skipped.
+ */
+
+#ifndef RACHEL_PROTOCOL_H
+#define RACHEL_PROTOCOL_H
+
+#include "rules.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NET_FRAME_SIZE     64
+#define NET_HEADER_SIZE    12
+#define NET_PAYLOAD_SIZE   (NET_FRAME_SIZE - NET_HEADER_SIZE)
+#define NET_MIN_FRAME_SIZE (NET_HEADER_SIZE + 7)    /* The shortest DELTA */
+#define NET_MAGIC          'R'
+#define NET_VERSION        3
+#define NET_DEFAULT_PORT   5252
+#define NET_NAME_SIZE      16
+
+/* Client -> server */
+#define NET_MSG_JOIN       0x01   /* Sit at the next table of this shape */
+#define NET_MSG_PLAY       0x02   /* Play cards on our turn */
+#define NET_MSG_LEAVE      0x03   /* Give our seat to a bot */
+#define NET_MSG_RESYNC     0x04   /* Send our whole view again */
+#define NET_MSG_WATCH      0x05   /* Spectate the table in the header */
+
+/* Server -> client */
+#define NET_MSG_WELCOME    0x81   /* Seated, waiting for the table to fill */
+#define NET_MSG_STATE      0x82   /* Position after every change */
+#define NET_MSG_REJECT     0x83   /* Request refused, nothing changed */
+#define NET_MSG_DELTA      0x84   /* What changed since the last view */
+
+/* Delta fields */
+#define NET_DELTA_STATE      0x0001
+#define NET_DELTA_CURRENT    0x0002
+#define NET_DELTA_DIRECTION  0x0004
+#define NET_DELTA_NOMINATED  0x0008
+#define NET_DELTA_TOP        0x0010
+#define NET_DELTA_PENDING    0x0020
+#define NET_DELTA_PILES      0x0040
+#define NET_DELTA_COUNTS     0x0080
+#define NET_DELTA_FINISH     0x0100
+#define NET_DELTA_HAND_CARDS 0x0200
+#define NET_DELTA_HAND_MASK  0x0400
+#define NET_DELTA_MAX_CARDS  16     /* Gained plus lost; more sends the mask */
+
+/* Reject reasons */
+#define NET_REJECT_BAD_FRAME     1
+#define NET_REJECT_NOT_SEATED    2
+#define NET_REJECT_NOT_YOUR_TURN 3
+#define NET_REJECT_ILLEGAL_CARD  4   /* rachel_can_play_card said no */
+#define NET_REJECT_ILLEGAL_PLAY  5   /* rachel_play_cards said no */
+#define NET_REJECT_SEATED        6   /* Already at a table */
+#define NET_REJECT_FULL          7   /* No free tables */
+#define NET_REJECT_NO_TABLE      8   /* WATCH of a table id out of range */
+
+#define NET_SEAT_SPECTATOR  0xFF
+
+typedef struct {
+    uint8_t  players;            /* Table size, 2-8 */
+    uint8_t  bots;               /* Seats the server plays */
+    char     name[NET_NAME_SIZE];
+} NetJoin;
+
+typedef struct {
+    uint8_t  count;
+    Card     cards[RACHEL_MAX_PLAY];
+    uint8_t  nominated_suit;
+} NetPlay;
+
+/* One seat's view of a game */
+typedef struct {
+    uint8_t  state;              /* GameState */
+    uint8_t  player_count;
+    uint8_t  current_player;
+    uint8_t  direction;
+    uint8_t  nominated_suit;
+    Card     top_card;
+    uint8_t  pending_type;
+    uint8_t  pending_count;
+    uint8_t  deck_count;
+    uint8_t  discard_count;
+    uint32_t turn_count;
+    uint64_t hand_mask;          /* Receiving seat only */
+    uint8_t  hand_counts[MAX_PLAYERS];
+    uint8_t  finish[MAX_PLAYERS];
+} NetState;
+
+/* The change from one NetState to the next. Only fields whose bit is
+ * set are meaningful; counts and finish hold every seat, but only the
+ * seats in their masks travel. */
+typedef struct {
+    uint16_t changed;            /* NET_DELTA_* */
+    uint32_t turn_count;
+    uint8_t  state;
+    uint8_t  current_player;
+    uint8_t  direction;
+    uint8_t  nominated_suit;
+    Card     top_card;
+    uint8_t  pending_type;
+    uint8_t  pending_count;
+    uint8_t  deck_count;
+    uint8_t  discard_count;
+    uint8_t  counts_changed;     /* Seat bits */
+    uint8_t  finish_changed;
+    uint8_t  hand_counts[MAX_PLAYERS];
+    uint8_t  finish[MAX_PLAYERS];
+    uint8_t  gained, lost;
+    Card     cards[NET_DELTA_MAX_CARDS];   /* Gained, then lost */
+    uint64_t hand_mask;
+} NetDelta;
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  seat;
+    uint32_t table;
+    uint32_t seq;
+    union {
+        NetJoin  join;
+        NetPlay  play;
+        NetState state;
+        NetDelta delta;
+        uint8_t  reason;
+        uint8_t  players;        /* WELCOME: table size */
+    } u;
+} NetMessage;
+
+/* Message <-> frame. frame has room for NET_FRAME_SIZE bytes; encoding
+ * returns how many of them to send. Decoding fails on a bad magic,
+ * version, type or length. */
+size_t rachel_net_encode(const NetMessage* msg, uint8_t* frame);
+bool_t rachel_net_decode(const uint8_t* frame, NetMessage* msg);
+
+/* The length of the frame starting at frame, of which have bytes are
+ * in: NET_MIN_FRAME_SIZE while that is too few to tell. A frame that is
+ * not a well-formed DELTA counts as NET_FRAME_SIZE and fails to decode. */
+size_t rachel_net_frame_size(const uint8_t* frame, size_t have);
+
+/* What seat may see of game */
+void rachel_net_state(const Game* game, uint8_t seat, NetState* state);
+
+/* Rebuild a Game the AI policies can read from a seat's view: our hand,
+ * the top card and the flow are real, other hands are empty counts. */
+void rachel_net_view(const NetState* state, uint8_t seat, Game* view);
+
+/* The delta that takes from to to. FALSE when the two are not views of
+ * one game (the player counts differ): send a STATE instead. */
+bool_t rachel_net_diff(const NetState* from, const NetState* to, NetDelta* delta);
+
+/* Bring state up to date. FALSE, with state unchanged, when the delta
+ * does not fit it: a card lost that was not held, a seat out of range
+ * or a turn count going backwards. */
+bool_t rachel_net_apply(NetState* state, const NetDelta* delta);
+
+/* Encoding round trips, and deltas along seeded games */
+bool_t rachel_net_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RACHEL_PROTOCOL_H */
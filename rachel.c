@@ -9,15 +9,32 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <conio.h>
 #include <dos.h>
 #include <string.h>
+#include <time.h>
 #include "rules.h"
+#include "ai.h"
 
 /* CGA video memory */
 #define CGA_MEMORY 0xB8000000L
 #define SCREEN_WIDTH 80
 #define SCREEN_HEIGHT 25
+#define SCREEN_CELLS (SCREEN_WIDTH * SCREEN_HEIGHT)
+
+/* One 16-bit cell per character: attribute high, character low.
+ * DJGPP runs in protected mode and reaches the first megabyte through
+ * the DOS selector; real-mode compilers take a far pointer. */
+#ifdef __DJGPP__
+#include <go32.h>
+#include <sys/farptr.h>
+#define VIDEO_SELECT()             _farsetsel(_dos_ds)
+#define VIDEO_POKE(offset, cell)   _farnspokew(0xB8000L + (offset) * 2, (cell))
+#else
+#define VIDEO_SELECT()
+#define VIDEO_POKE(offset, cell)   (((unsigned short far*)CGA_MEMORY)[offset] = (cell))
+#endif
 
 /* CGA colors */
 #define COLOR_BLACK     0x00
@@ -28,6 +45,7 @@
 #define COLOR_MAGENTA   0x05
 #define COLOR_BROWN     0x06
 #define COLOR_WHITE     0x07
+#define COLOR_YELLOW    0x0E    /* Bright brown */
 #define COLOR_BRIGHT    0x08
 #define COLOR_BLINK     0x80
 
@@ -41,6 +59,10 @@ void set_video_mode(int mode);
 void clear_screen(void);
 void gotoxy(int x, int y);
 void textcolor(int color);
+void screen_putch(int ch);
+void screen_printf(const char* format, ...);
+void screen_flush(void);
+void screen_forget(void);
 void draw_box(int x, int y, int width, int height);
 void draw_card(int x, int y, Card card);
 void draw_card_back(int x, int y);
@@ -52,33 +74,106 @@ int get_key(void);
 static Game game;
 static int current_selection = 0;
 
-/* Clear screen using BIOS */
+/* Computer players go through the AiPolicy vtable, so this bot can be
+ * swapped for any other choose function. The host policies in ai.c
+ * need threads and a monotonic clock, so the DOS build keeps its own. */
+static void dos_choose_first(const Game* g, uint8_t player_id,
+                             RachelRng* rng, AiPlay* play);
+static const AiPolicy dos_bot = {
+    "first", "First valid card, nominates hearts", dos_choose_first, 0
+};
+static const AiPolicy* ai_policy = &dos_bot;
+static RachelRng ai_rng;
+
+/* Screens are drawn into a shadow of the 80x25 text page, never into
+ * video memory. screen_flush compares it with what the last flush left
+ * on screen and writes only the cells that differ, so moving the hand
+ * cursor costs two cell writes rather than a BIOS call per character. */
+static unsigned short screen_cells[SCREEN_CELLS];   /* Frame being drawn */
+static unsigned short screen_shown[SCREEN_CELLS];   /* Frame in video memory */
+static bool_t screen_stale = TRUE;     /* DOS wrote to the screen since */
+static int screen_x, screen_y;         /* Drawing position, from 0 */
+static unsigned char screen_attr = COLOR_WHITE;
+
+/* Clear the shadow screen */
 void clear_screen(void) {
-    union REGS regs;
-    regs.h.ah = 0x06;  /* Scroll up */
-    regs.h.al = 0x00;  /* Clear entire screen */
-    regs.h.bh = 0x07;  /* White on black */
-    regs.h.ch = 0x00;  /* Top row */
-    regs.h.cl = 0x00;  /* Left column */
-    regs.h.dh = 24;    /* Bottom row */
-    regs.h.dl = 79;    /* Right column */
-    int86(0x10, &regs, &regs);
+    int i;
+    
+    for (i = 0; i < SCREEN_CELLS; i++) {
+        screen_cells[i] = (COLOR_WHITE << 8) | ' ';
+    }
     gotoxy(1, 1);
 }
 
-/* Set cursor position */
+/* Set drawing position, 1-based like conio */
 void gotoxy(int x, int y) {
+    screen_x = x - 1;
+    screen_y = y - 1;
+}
+
+/* Set text color */
+void textcolor(int color) {
+    screen_attr = (unsigned char)color;
+}
+
+/* One character at the drawing position; wraps like the console */
+void screen_putch(int ch) {
+    if (ch == '\n') {
+        screen_x = 0;
+        screen_y++;
+        return;
+    }
+    if (screen_x >= SCREEN_WIDTH) {
+        screen_x = 0;
+        screen_y++;
+    }
+    if (screen_y < 0 || screen_y >= SCREEN_HEIGHT || screen_x < 0) {
+        return;
+    }
+    screen_cells[screen_y * SCREEN_WIDTH + screen_x] =
+        (unsigned short)((screen_attr << 8) | (unsigned char)ch);
+    screen_x++;
+}
+
+void screen_printf(const char* format, ...) {
+    char text[256];
+    va_list args;
+    int i;
+    
+    va_start(args, format);
+    vsprintf(text, format, args);
+    va_end(args);
+    for (i = 0; text[i] != '\0'; i++) {
+        screen_putch(text[i]);
+    }
+}
+
+/* Write the changed cells to CGA memory, then park the hardware cursor
+ * at the drawing position - one BIOS call per frame */
+void screen_flush(void) {
     union REGS regs;
+    int i;
+    
+    VIDEO_SELECT();
+    for (i = 0; i < SCREEN_CELLS; i++) {
+        if (screen_stale || screen_cells[i] != screen_shown[i]) {
+            VIDEO_POKE(i, screen_cells[i]);
+            screen_shown[i] = screen_cells[i];
+        }
+    }
+    screen_stale = FALSE;
+    
     regs.h.ah = 0x02;
     regs.h.bh = 0x00;
-    regs.h.dh = y - 1;
-    regs.h.dl = x - 1;
+    regs.h.dh = (unsigned char)(screen_y < SCREEN_HEIGHT ? screen_y : SCREEN_HEIGHT - 1);
+    regs.h.dl = (unsigned char)(screen_x < SCREEN_WIDTH ? screen_x : SCREEN_WIDTH - 1);
     int86(0x10, &regs, &regs);
 }
 
-/* Set text color */
-void textcolor(int color) {
-    textattr(color);
+/* DOS console output or input echo changed the screen: the next flush
+ * rewrites every cell */
+void screen_forget(void) {
+    screen_stale = TRUE;
 }
 
 /* Draw a box using DOS box drawing characters */
@@ -86,21 +181,21 @@ void draw_box(int x, int y, int width, int height) {
     int i;
     
     gotoxy(x, y);
-    putch(218);  /* Top-left corner */
-    for (i = 0; i < width - 2; i++) putch(196);  /* Horizontal line */
-    putch(191);  /* Top-right corner */
+    screen_putch(218);  /* Top-left corner */
+    for (i = 0; i < width - 2; i++) screen_putch(196);  /* Horizontal line */
+    screen_putch(191);  /* Top-right corner */
     
     for (i = 1; i < height - 1; i++) {
         gotoxy(x, y + i);
-        putch(179);  /* Vertical line */
+        screen_putch(179);  /* Vertical line */
         gotoxy(x + width - 1, y + i);
-        putch(179);  /* Vertical line */
+        screen_putch(179);  /* Vertical line */
     }
     
     gotoxy(x, y + height - 1);
-    putch(192);  /* Bottom-left corner */
-    for (i = 0; i < width - 2; i++) putch(196);  /* Horizontal line */
-    putch(217);  /* Bottom-right corner */
+    screen_putch(192);  /* Bottom-left corner */
+    for (i = 0; i < width - 2; i++) screen_putch(196);  /* Horizontal line */
+    screen_putch(217);  /* Bottom-right corner */
 }
 
 /* Draw ASCII art card */
@@ -155,21 +250,21 @@ void draw_card(int x, int y, Card card) {
     textcolor(color);
     gotoxy(x + 2, y + 1);
     if (rank == 10) {
-        printf("10");
+        screen_printf("10");
     } else {
-        putch(rank_char);
-        putch(' ');
+        screen_putch(rank_char);
+        screen_putch(' ');
     }
     
     gotoxy(x + 3, y + 2);
-    putch(suit_char);
+    screen_putch(suit_char);
     
     gotoxy(x + 2, y + 3);
     if (rank == 10) {
-        printf("10");
+        screen_printf("10");
     } else {
-        putch(' ');
-        putch(rank_char);
+        screen_putch(' ');
+        screen_putch(rank_char);
     }
 }
 
@@ -178,7 +273,7 @@ void draw_card_back(int x, int y) {
     textcolor(CARD_BACK);
     draw_box(x, y, 7, 5);
     gotoxy(x + 2, y + 2);
-    printf("###");
+    screen_printf("###");
 }
 
 /* Draw title screen */
@@ -187,33 +282,34 @@ void draw_title(void) {
     textcolor(COLOR_WHITE | COLOR_BRIGHT);
     
     gotoxy(20, 5);
-    printf("╔═══════════════════════════════════════╗");
+    screen_printf("╔═══════════════════════════════════════╗");
     gotoxy(20, 6);
-    printf("║            R A C H E L                ║");
+    screen_printf("║            R A C H E L                ║");
     gotoxy(20, 7);
-    printf("║         DOS Edition v1.0              ║");
+    screen_printf("║         DOS Edition v1.0              ║");
     gotoxy(20, 8);
-    printf("║         Platform #002 of ∞            ║");
+    screen_printf("║         Platform #002 of ∞            ║");
     gotoxy(20, 9);
-    printf("╚═══════════════════════════════════════╝");
+    screen_printf("╚═══════════════════════════════════════╝");
     
     textcolor(COLOR_CYAN);
     gotoxy(25, 12);
-    printf("CGA Graphics in 4-color glory!");
+    screen_printf("CGA Graphics in 4-color glory!");
     
     textcolor(COLOR_WHITE);
     gotoxy(22, 15);
-    printf("1. Play against AI");
+    screen_printf("1. Play against AI");
     gotoxy(22, 16);
-    printf("2. Two player game");
+    screen_printf("2. Two player game");
     gotoxy(22, 17);
-    printf("3. View rules");
+    screen_printf("3. View rules");
     gotoxy(22, 18);
-    printf("ESC. Exit to DOS");
+    screen_printf("ESC. Exit to DOS");
     
     textcolor(COLOR_YELLOW);
     gotoxy(20, 22);
-    printf("Press a key to select...");
+    screen_printf("Press a key to select...");
+    screen_flush();
 }
 
 /* Main game display */
@@ -228,7 +324,7 @@ void draw_game_state(void) {
     textcolor(COLOR_WHITE | COLOR_BRIGHT);
     draw_box(1, 1, 79, 3);
     gotoxy(30, 2);
-    printf("RACHEL - Turn %d", game.turn_count);
+    screen_printf("RACHEL - Turn %d", game.turn_count);
     
     /* Draw opponents */
     y = 5;
@@ -237,10 +333,10 @@ void draw_game_state(void) {
             gotoxy(3, y);
             if (game.players[i].is_out) {
                 textcolor(COLOR_RED);
-                printf("%s: OUT", game.players[i].name);
+                screen_printf("%s: OUT", game.players[i].name);
             } else {
                 textcolor(COLOR_WHITE);
-                printf("%s: %d cards", game.players[i].name, 
+                screen_printf("%s: %d cards", game.players[i].name, 
                        game.players[i].hand_count);
                 
                 /* Draw card backs */
@@ -257,30 +353,30 @@ void draw_game_state(void) {
     /* Draw discard pile */
     textcolor(COLOR_WHITE);
     gotoxy(35, 12);
-    printf("DISCARD");
+    screen_printf("DISCARD");
     if (game.discard_count > 0) {
-        top_card = game.discard_pile[game.discard_count - 1];
+        top_card = RACHEL_TOP_CARD(&game);
         draw_card(36, 13, top_card);
     }
     
     /* Draw deck */
     textcolor(COLOR_WHITE);
     gotoxy(50, 12);
-    printf("DECK: %d", game.deck_count);
+    screen_printf("DECK: %d", game.deck_count);
     draw_card_back(50, 13);
     
     /* Draw current player's hand */
     current = &game.players[game.current_player_index];
     textcolor(COLOR_YELLOW);
     gotoxy(3, 19);
-    printf("Your hand (%s):", current->name);
+    screen_printf("Your hand (%s):", current->name);
     
     x = 3;
     for (i = 0; i < current->hand_count && i < 9; i++) {
         if (i == current_selection) {
             textcolor(COLOR_YELLOW | COLOR_BRIGHT);
             gotoxy(x, 24);
-            putch('^');
+            screen_putch('^');
         }
         draw_card(x, 20, current->hand[i]);
         x += 8;
@@ -289,7 +385,8 @@ void draw_game_state(void) {
     /* Status line */
     textcolor(COLOR_WHITE);
     gotoxy(1, 25);
-    printf("←→:Select  ENTER:Play  D:Draw  ESC:Menu");
+    screen_printf("←→:Select  ENTER:Play  D:Draw  ESC:Menu");
+    screen_flush();
 }
 
 /* Get keyboard input */
@@ -308,16 +405,30 @@ void wait_key(void) {
     getch();
 }
 
-/* Simple AI turn */
+/* Simple AI: first valid card, always nominate hearts */
+static void dos_choose_first(const Game* g, uint8_t player_id,
+                             RachelRng* rng, AiPlay* play) {
+    Card valid_cards[MAX_HAND_SIZE];
+    
+    (void)player_id;
+    (void)rng;
+    rachel_get_valid_plays(g, valid_cards);
+    play->cards[0] = valid_cards[0];
+    play->count = 1;
+    play->nominated_suit = SUIT_HEARTS;
+}
+
+/* AI turn - the policy picks, the rules have the last word */
 void ai_turn(void) {
     Player* player = &game.players[game.current_player_index];
     Card valid_cards[MAX_HAND_SIZE];
     uint8_t valid_count;
-    Card play_card;
+    AiPlay play;
     
     gotoxy(20, 12);
     textcolor(COLOR_CYAN);
-    printf("%s is thinking...", player->name);
+    screen_printf("%s is thinking...", player->name);
+    screen_flush();
     delay(1000);  /* DOS delay function */
     
     valid_count = rachel_get_valid_plays(&game, valid_cards);
@@ -325,8 +436,14 @@ void ai_turn(void) {
     if (valid_count == 0) {
         rachel_draw_cards(&game, player->id, 1);
     } else {
-        play_card = valid_cards[0];
-        rachel_play_cards(&game, player->id, &play_card, 1, SUIT_HEARTS);
+        play.count = 0;
+        play.nominated_suit = SUIT_HEARTS;
+        ai_policy->choose(&game, player->id, &ai_rng, &play);
+        if (play.count == 0 ||
+            !rachel_play_cards(&game, player->id, play.cards, play.count,
+                               play.nominated_suit)) {
+            rachel_play_cards(&game, player->id, &valid_cards[0], 1, SUIT_HEARTS);
+        }
     }
     
     rachel_next_turn(&game);
@@ -341,12 +458,16 @@ void play_game(int num_ai) {
     
     /* Initialize game */
     rachel_init_game(&game, 1 + num_ai);
+    rachel_seed_game(&game, (uint32_t)time(NULL), 0);
+    rachel_rng_seed(&ai_rng, ~(uint64_t)time(NULL), 0);
     
     /* Get player name */
     clear_screen();
     gotoxy(20, 10);
-    printf("Enter your name: ");
+    screen_printf("Enter your name: ");
+    screen_flush();
     scanf("%31s", name);
+    screen_forget();    /* DOS echoed the name */
     rachel_add_player(&game, name, FALSE);
     
     /* Add AI players */
@@ -406,9 +527,10 @@ void play_game(int num_ai) {
     clear_screen();
     textcolor(COLOR_YELLOW | COLOR_BRIGHT);
     gotoxy(30, 10);
-    printf("GAME OVER!");
+    screen_printf("GAME OVER!");
     gotoxy(25, 15);
-    printf("Press any key to continue...");
+    screen_printf("Press any key to continue...");
+    screen_flush();
     wait_key();
 }
 
@@ -435,21 +557,24 @@ int main(void) {
                 break;
             case '3':
                 clear_screen();
-                printf("RACHEL RULES:\n\n");
-                printf("1. You must play if you can\n");
-                printf("2. Match suit or rank\n");
-                printf("3. 2s make next player draw 2\n");
-                printf("4. 7s skip next player\n");
-                printf("5. Queens reverse direction\n");
-                printf("6. Aces let you pick suit\n");
-                printf("7. Black Jacks = draw 5\n");
-                printf("8. Red Jacks counter Black Jacks\n");
-                printf("\nPress any key...");
+                textcolor(COLOR_WHITE);
+                screen_printf("RACHEL RULES:\n\n");
+                screen_printf("1. You must play if you can\n");
+                screen_printf("2. Match suit or rank\n");
+                screen_printf("3. 2s make next player draw 2\n");
+                screen_printf("4. 7s skip next player\n");
+                screen_printf("5. Queens reverse direction\n");
+                screen_printf("6. Aces let you pick suit\n");
+                screen_printf("7. Black Jacks = draw 5\n");
+                screen_printf("8. Red Jacks counter Black Jacks\n");
+                screen_printf("\nPress any key...");
+                screen_flush();
                 wait_key();
                 break;
             case 27:  /* ESC */
                 clear_screen();
                 textcolor(COLOR_WHITE);
+                screen_flush();    /* Blank page, cursor home, for DOS */
                 printf("Thanks for playing Rachel!\n");
                 printf("Platform #002 complete.\n");
                 printf("198 platforms to go...\n");
@@ -0,0 +1,819 @@
+/*
+ * RACHEL MICROBENCHMARKS
+ *
+ * Times the rules.h entry points one at a time, on real positions:
+ * a few thousand seeded games are played first and positions are taken
+ * from them into pools - any mid-game position, positions with a single
+ * or stacked play, pending effects, and empty decks about to reshuffle.
+ * Every benchmark then runs over its pool, so branch predictors see a
+ * game's worth of variety rather than one position on repeat.
+ *
+ * Calls that change the Game work on copies made outside the timed
+ * region. Each benchmark is run several times and the median is kept.
+ *
+ * Results go out as JSON with ns/op and cycles/op (the timestamp
+ * counter, where there is one). With -c a stored result is read back
+ * and anything slower by more than the threshold is a regression:
+ * reported, and the exit status is 1.
+ *
+ * "Faster is a claim. This is the evidence."
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rules.h"
+#include "ai.h"
+#include "mcts.h"
+#include "knowledge.h"
+#include "protocol.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_HAVE_TSC 0
+#define BENCH_CYCLES() 0
+#endif
+
+/* Defaults */
+#define BENCH_POSITIONS        256       /* Per pool */
+#define BENCH_MAX_GAMES        100000UL  /* To fill the pools */
+#define BENCH_DEFAULT_RUNS     5
+#define BENCH_DEFAULT_MS       40        /* Per run */
+#define BENCH_DEFAULT_PERCENT  10.0
+#define BENCH_INNER_PASSES     16        /* Read-only passes per timing */
+#define BENCH_GAMES_PER_PASS   16
+#define BENCH_SIBLINGS         8         /* Children per position */
+#define BENCH_MAX_CASES        32
+#define BENCH_SEED             0xBE4C
+
+/* Position pools */
+enum {
+    POOL_MID,          /* Any position with cards left to draw */
+    POOL_PLAY,         /* Current player has a play: plays[] */
+    POOL_STACK,        /* ...of two or more cards: plays[] */
+    POOL_EFFECT,       /* A pending effect waits on the current player */
+    POOL_RESHUFFLE,    /* Empty deck, so the next draw reshuffles */
+    POOL_COUNT
+};
+
+typedef struct {
+    Game  pools[POOL_COUNT][BENCH_POSITIONS];
+    Move  plays[POOL_COUNT][BENCH_POSITIONS];
+    int   counts[POOL_COUNT];
+    Game  work[BENCH_POSITIONS];         /* Copies for mutating calls */
+    Knowledge know[BENCH_POSITIONS];     /* Current player's, of pools[MID] */
+    NetState  views[BENCH_POSITIONS][2]; /* Mover's, before and after plays[PLAY] */
+    uint8_t   deltas[BENCH_POSITIONS][NET_FRAME_SIZE];   /* Between the two */
+    Card  deck[STANDARD_DECK];
+    RachelRng sample_rng;
+    uint32_t shuffle_seed;
+    uint32_t game_stream;
+} BenchData;
+
+typedef struct {
+    const char* name;
+    int         pool;                    /* Copied to work before each
+                                          * pass if mutates */
+    bool_t      mutates;
+    unsigned long (*pass)(BenchData* data);   /* One pass, returns ops */
+} BenchCase;
+
+typedef struct {
+    const char*   name;
+    double        ns_per_op;             /* Median over runs */
+    double        min_ns_per_op;
+    double        cycles_per_op;
+    unsigned long ops;                   /* Over all runs */
+} BenchResult;
+
+typedef struct {
+    int         runs;
+    double      run_ms;
+    double      threshold;               /* Percent slower = regression */
+    const char* output;
+    const char* baseline;
+    const char* filter;
+    bool_t      quiet;
+} BenchConfig;
+
+/* Results are summed here so no call can be optimised away */
+static volatile unsigned long bench_sink;
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* ----- Pools ----- */
+
+static void bench_add(BenchData* data, int pool, const Game* game,
+                      const Move* play) {
+    int n = data->counts[pool];
+
+    if (n >= BENCH_POSITIONS) {
+        return;
+    }
+    data->pools[pool][n] = *game;
+    if (play != NULL) {
+        data->plays[pool][n] = *play;
+    }
+    data->counts[pool]++;
+}
+
+/* The rules must accept a play before it is worth timing */
+static bool_t bench_legal(const Game* game, const Move* play) {
+    Game copy = *game;
+
+    return rachel_play_cards(&copy, game->current_player_index, play->cards,
+                             play->count, play->nominated_suit);
+}
+
+static void bench_consider(BenchData* data, const Game* game) {
+    uint8_t player = game->current_player_index;
+    uint64_t valid = rachel_valid_plays_mask(game, player);
+    AiPlay stack;
+    Move play;
+    uint8_t i;
+
+    if (game->deck_count >= 2 && game->turn_count % 5 == 0) {
+        bench_add(data, POOL_MID, game, NULL);
+    }
+    if (game->pending_effect.count > 0) {
+        bench_add(data, POOL_EFFECT, game, NULL);
+    }
+    if (game->deck_count == 0 && game->discard_count >= 2) {
+        bench_add(data, POOL_RESHUFFLE, game, NULL);
+    }
+    if (!valid) {
+        return;
+    }
+
+    memset(&play, 0, sizeof(play));
+    play.type = MOVE_PLAY;
+    play.count = 1;
+    play.cards[0] = rachel_card_from_index(RACHEL_MASK_LOWEST(valid));
+    play.nominated_suit = SUIT_HEARTS;
+    if (game->turn_count % 3 == 0 && bench_legal(game, &play)) {
+        bench_add(data, POOL_PLAY, game, &play);
+    }
+
+    /* First valid card we hold more of */
+    for (; valid; valid &= valid - 1) {
+        stack.cards[0] = rachel_card_from_index(RACHEL_MASK_LOWEST(valid));
+        stack.count = 1;
+        rachel_ai_add_stack(game, player, &stack);
+        if (stack.count < 2) {
+            continue;
+        }
+        play.count = stack.count;
+        for (i = 0; i < stack.count; i++) {
+            play.cards[i] = stack.cards[i];
+        }
+        if (bench_legal(game, &play)) {
+            bench_add(data, POOL_STACK, game, &play);
+        }
+        break;
+    }
+}
+
+static bool_t bench_full(const BenchData* data) {
+    int pool;
+
+    for (pool = 0; pool < POOL_COUNT; pool++) {
+        if (data->counts[pool] < BENCH_POSITIONS) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* One turn as a client sees it: its view before and after, and the
+ * DELTA frame between */
+static void bench_net_views(BenchData* data, int i) {
+    Game game = data->pools[POOL_PLAY][i];
+    uint8_t seat = game.current_player_index;
+    NetMessage msg;
+    MoveUndo undo;
+
+    rachel_net_state(&game, seat, &data->views[i][0]);
+    rachel_make_move(&game, &data->plays[POOL_PLAY][i], &undo);
+    rachel_net_state(&game, seat, &data->views[i][1]);
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_DELTA;
+    rachel_net_diff(&data->views[i][0], &data->views[i][1], &msg.u.delta);
+    rachel_net_encode(&msg, data->deltas[i]);
+}
+
+/* Play seeded games over every table size until each pool is full */
+static bool_t bench_collect(BenchData* data) {
+    const AiPolicy* policy = rachel_ai_find("stack");
+    RachelRng rng;
+    Game game;
+    unsigned long index;
+    uint8_t players;
+    int i;
+
+    rachel_rng_seed(&rng, BENCH_SEED, 1);
+    for (index = 0; index < BENCH_MAX_GAMES && !bench_full(data); index++) {
+        players = (uint8_t)(2 + index % (MAX_PLAYERS - 1));
+        rachel_test_deal(&game, players, FALSE, BENCH_SEED, index);
+        while (!rachel_is_game_over(&game) && game.turn_count < 2000) {
+            bench_consider(data, &game);
+            rachel_ai_take_turn(&game, policy, &rng);
+        }
+    }
+    for (i = 0; i < data->counts[POOL_MID]; i++) {
+        rachel_know_init(&data->know[i], &data->pools[POOL_MID][i],
+                         data->pools[POOL_MID][i].current_player_index);
+    }
+    for (i = 0; i < data->counts[POOL_PLAY]; i++) {
+        bench_net_views(data, i);
+    }
+    rachel_rng_seed(&data->sample_rng, BENCH_SEED, 2);
+    rachel_create_deck(data->deck, FALSE);
+    return bench_full(data);
+}
+
+/* ----- Benchmarks ----- */
+
+static unsigned long bench_can_play_card(BenchData* data) {
+    const Game* game;
+    const Player* player;
+    unsigned long ops = 0, sum = 0;
+    int i, c;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        game = &data->pools[POOL_MID][i];
+        player = &game->players[game->current_player_index];
+        for (c = 0; c < player->hand_count; c++) {
+            sum += rachel_can_play_card(game, player->hand[c]);
+        }
+        ops += player->hand_count;
+    }
+    bench_sink += sum;
+    return ops;
+}
+
+static unsigned long bench_must_play(BenchData* data) {
+    const Game* game;
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        game = &data->pools[POOL_MID][i];
+        sum += rachel_must_play(game, game->current_player_index);
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+static unsigned long bench_get_valid_plays(BenchData* data) {
+    Card valid[MAX_HAND_SIZE];
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        sum += rachel_get_valid_plays(&data->pools[POOL_MID][i], valid);
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+static unsigned long bench_valid_plays_mask(BenchData* data) {
+    const Game* game;
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        game = &data->pools[POOL_MID][i];
+        sum += (unsigned long)rachel_valid_plays_mask(game, game->current_player_index);
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+static unsigned long bench_hash_game(BenchData* data) {
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        sum += (unsigned long)rachel_hash_game(&data->pools[POOL_MID][i]);
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+/* The prepared play of each position in work[] */
+static unsigned long bench_play(BenchData* data, int pool) {
+    const Move* play;
+    Game* game;
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        game = &data->work[i];
+        play = &data->plays[pool][i];
+        sum += rachel_play_cards(game, game->current_player_index, play->cards,
+                                 play->count, play->nominated_suit);
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+static unsigned long bench_play_single(BenchData* data) {
+    return bench_play(data, POOL_PLAY);
+}
+
+static unsigned long bench_play_stacked(BenchData* data) {
+    return bench_play(data, POOL_STACK);
+}
+
+static unsigned long bench_draw(BenchData* data) {
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        sum += rachel_draw_cards(&data->work[i], data->work[i].current_player_index, 1);
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+static unsigned long bench_process_effects(BenchData* data) {
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        rachel_process_effects(&data->work[i]);
+        sum += data->work[i].current_player_index;
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+static unsigned long bench_next_turn(BenchData* data) {
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        rachel_next_turn(&data->work[i]);
+        sum += data->work[i].current_player_index;
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+/* A search step: make the play and take it back, leaving the pool as it was */
+static unsigned long bench_make_unmake(BenchData* data) {
+    MoveUndo undo;
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        sum += rachel_make_move(&data->pools[POOL_PLAY][i],
+                                &data->plays[POOL_PLAY][i], &undo);
+        rachel_unmake_move(&data->pools[POOL_PLAY][i], &undo);
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+/* One 52-card shuffle per op, each from a new seed */
+static unsigned long bench_shuffle(BenchData* data) {
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        rachel_shuffle(data->deck, STANDARD_DECK, data->shuffle_seed++);
+    }
+    bench_sink += data->deck[0].encoded;
+    return BENCH_POSITIONS;
+}
+
+/* One deal of the unseen cards per op, as a search player makes them.
+ * The knowledge is what the position alone shows, so both deal much
+ * the same cards; the difference is the cost of the constraints. */
+static unsigned long bench_know_sample(BenchData* data) {
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        rachel_know_sample(&data->know[i], &data->pools[POOL_MID][i],
+                           &data->work[0], &data->sample_rng);
+        sum += (unsigned long)data->work[0].hash;
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+static unsigned long bench_mcts_determinize(BenchData* data) {
+    const Game* game;
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        game = &data->pools[POOL_MID][i];
+        rachel_mcts_determinize(game, game->current_player_index, 0,
+                                &data->work[0], &data->sample_rng);
+        sum += (unsigned long)data->work[0].hash;
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+/* A resync: a seat's whole view, into a STATE frame */
+static unsigned long bench_net_snapshot(BenchData* data) {
+    const Game* game;
+    NetMessage msg;
+    uint8_t frame[NET_FRAME_SIZE];
+    unsigned long sum = 0;
+    int i;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_STATE;
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        game = &data->pools[POOL_MID][i];
+        rachel_net_state(game, game->current_player_index, &msg.u.state);
+        rachel_net_encode(&msg, frame);
+        sum += frame[NET_HEADER_SIZE + 5];
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+/* The server's side of a turn: diff two views, into a DELTA frame */
+static unsigned long bench_net_delta(BenchData* data) {
+    NetMessage msg;
+    uint8_t frame[NET_FRAME_SIZE];
+    unsigned long sum = 0;
+    int i;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_DELTA;
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        rachel_net_diff(&data->views[i][0], &data->views[i][1], &msg.u.delta);
+        sum += rachel_net_encode(&msg, frame);
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+/* The client's side: decode a DELTA frame onto the view before it */
+static unsigned long bench_net_apply(BenchData* data) {
+    NetMessage msg;
+    NetState view;
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        view = data->views[i][0];
+        sum += rachel_net_decode(data->deltas[i], &msg) &&
+               rachel_net_apply(&view, &msg.u.delta);
+        sum += view.current_player;
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS;
+}
+
+/* Branching the way a search does today: a whole Game per child, then
+ * the child's move. One child per op. */
+static unsigned long bench_copy_make_move(BenchData* data) {
+    MoveUndo undo;
+    unsigned long sum = 0;
+    int i, j;
+
+    for (i = 0; i < BENCH_POSITIONS; i++) {
+        for (j = 0; j < BENCH_SIBLINGS; j++) {
+            data->work[j] = data->pools[POOL_PLAY][i];
+            sum += rachel_make_move(&data->work[j], &data->plays[POOL_PLAY][i], &undo);
+        }
+    }
+    bench_sink += sum;
+    return BENCH_POSITIONS * BENCH_SIBLINGS;
+}
+
+/* Macro benchmark: whole four-player games, deal to last card, per op */
+static unsigned long bench_full_game(BenchData* data) {
+    const AiPolicy* policy = &rachel_ai_policies[0];
+    RachelRng rng;
+    Game* game = &data->work[0];
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < BENCH_GAMES_PER_PASS; i++) {
+        rachel_rng_seed(&rng, ~(uint64_t)BENCH_SEED, data->game_stream);
+        rachel_test_deal(game, 4, FALSE, BENCH_SEED, data->game_stream++);
+        while (!rachel_is_game_over(game) && game->turn_count < 2000) {
+            rachel_ai_take_turn(game, policy, &rng);
+        }
+        sum += game->turn_count;
+    }
+    bench_sink += sum;
+    return BENCH_GAMES_PER_PASS;
+}
+
+static const BenchCase bench_cases[] = {
+    { "can_play_card",        POOL_MID,       FALSE, bench_can_play_card },
+    { "must_play",            POOL_MID,       FALSE, bench_must_play },
+    { "get_valid_plays",      POOL_MID,       FALSE, bench_get_valid_plays },
+    { "valid_plays_mask",     POOL_MID,       FALSE, bench_valid_plays_mask },
+    { "hash_game",            POOL_MID,       FALSE, bench_hash_game },
+    { "play_cards_single",    POOL_PLAY,      TRUE,  bench_play_single },
+    { "play_cards_stacked",   POOL_STACK,     TRUE,  bench_play_stacked },
+    { "draw_cards",           POOL_MID,       TRUE,  bench_draw },
+    { "draw_cards_reshuffle", POOL_RESHUFFLE, TRUE,  bench_draw },
+    { "process_effects",      POOL_EFFECT,    TRUE,  bench_process_effects },
+    { "next_turn",            POOL_MID,       TRUE,  bench_next_turn },
+    { "make_unmake_move",     POOL_PLAY,      FALSE, bench_make_unmake },
+    { "shuffle",              POOL_MID,       FALSE, bench_shuffle },
+    { "know_sample",          POOL_MID,       FALSE, bench_know_sample },
+    { "mcts_determinize",     POOL_MID,       FALSE, bench_mcts_determinize },
+    { "net_snapshot",         POOL_MID,       FALSE, bench_net_snapshot },
+    { "net_delta",            POOL_PLAY,      FALSE, bench_net_delta },
+    { "net_apply",            POOL_PLAY,      FALSE, bench_net_apply },
+    { "copy_make_move",       POOL_PLAY,      FALSE, bench_copy_make_move },
+    { "full_game",            POOL_MID,       FALSE, bench_full_game },
+    { NULL, 0, FALSE, NULL }
+};
+
+/* ----- Timing ----- */
+
+static int bench_compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_run(BenchData* data, const BenchCase* bench,
+                      const BenchConfig* config, BenchResult* result) {
+    double ns[64], cycles[64];
+    double start, spent, total_ns;
+    unsigned long long cycle_start, total_cycles;
+    unsigned long ops;
+    int run, pass;
+
+    result->name = bench->name;
+    result->ops = 0;
+
+    /* Warm up caches and predictors, untimed */
+    if (bench->mutates) {
+        memcpy(data->work, data->pools[bench->pool], sizeof(data->work));
+    }
+    bench->pass(data);
+
+    for (run = 0; run < config->runs; run++) {
+        ops = 0;
+        total_ns = 0;
+        total_cycles = 0;
+        while (total_ns < config->run_ms * 1e6) {
+            if (bench->mutates) {
+                memcpy(data->work, data->pools[bench->pool], sizeof(data->work));
+            }
+            cycle_start = BENCH_CYCLES();
+            start = bench_now();
+            if (bench->mutates) {
+                ops += bench->pass(data);
+            } else {
+                for (pass = 0; pass < BENCH_INNER_PASSES; pass++) {
+                    ops += bench->pass(data);
+                }
+            }
+            spent = bench_now() - start;
+            total_cycles += BENCH_CYCLES() - cycle_start;
+            total_ns += spent;
+        }
+        ns[run] = total_ns / ops;
+        cycles[run] = (double)total_cycles / ops;
+        result->ops += ops;
+    }
+
+    qsort(ns, config->runs, sizeof(double), bench_compare_doubles);
+    qsort(cycles, config->runs, sizeof(double), bench_compare_doubles);
+    result->ns_per_op = ns[config->runs / 2];
+    result->min_ns_per_op = ns[0];
+    result->cycles_per_op = cycles[config->runs / 2];
+}
+
+/* ----- Output ----- */
+
+static void bench_write_json(FILE* out, const BenchResult* results, int count,
+                             const BenchConfig* config) {
+    int i;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"tool\": \"rachel_bench\",\n");
+    fprintf(out, "  \"rules_version\": \"%s\",\n", rachel_version());
+    fprintf(out, "  \"runs\": %d,\n", config->runs);
+    fprintf(out, "  \"run_ms\": %.0f,\n", config->run_ms);
+    fprintf(out, "  \"benchmarks\": [\n");
+    for (i = 0; i < count; i++) {
+        fprintf(out, "    {\"name\": \"%s\", \"ns_per_op\": %.3f, "
+                "\"min_ns_per_op\": %.3f, ", results[i].name,
+                results[i].ns_per_op, results[i].min_ns_per_op);
+        if (BENCH_HAVE_TSC) {
+            fprintf(out, "\"cycles_per_op\": %.2f, ", results[i].cycles_per_op);
+        } else {
+            fprintf(out, "\"cycles_per_op\": null, ");
+        }
+        fprintf(out, "\"ops\": %lu}%s\n", results[i].ops,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+/* ns_per_op of name in a result file we wrote, or a negative number.
+ * Not a JSON parser: it only has to read bench_write_json back. */
+static double bench_baseline_lookup(const char* text, const char* name) {
+    char key[64];
+    const char* found;
+    const char* field;
+
+    sprintf(key, "\"name\": \"%.40s\"", name);
+    found = strstr(text, key);
+    if (found == NULL) {
+        return -1.0;
+    }
+    field = strstr(found, "\"ns_per_op\":");
+    if (field == NULL) {
+        return -1.0;
+    }
+    return strtod(field + strlen("\"ns_per_op\":"), NULL);
+}
+
+static char* bench_read_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    char* text;
+    long size;
+
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    text = (char*)malloc((size_t)size + 1);
+    if (text != NULL) {
+        size = (long)fread(text, 1, (size_t)size, file);
+        text[size] = '\0';
+    }
+    fclose(file);
+    return text;
+}
+
+/* Print old against new, returns the number of regressions */
+static int bench_compare(const char* text, const BenchResult* results, int count,
+                         const BenchConfig* config) {
+    double old, change;
+    int i, regressions = 0;
+
+    fprintf(stderr, "\n%-22s %12s %12s %9s\n", "Benchmark", "Baseline", "Now",
+            "Change");
+    for (i = 0; i < count; i++) {
+        old = bench_baseline_lookup(text, results[i].name);
+        if (old <= 0) {
+            fprintf(stderr, "%-22s %12s %9.2f ns %9s\n", results[i].name,
+                    "-", results[i].ns_per_op, "new");
+            continue;
+        }
+        change = (results[i].ns_per_op - old) / old * 100.0;
+        fprintf(stderr, "%-22s %9.2f ns %9.2f ns %+8.1f%%%s\n", results[i].name,
+                old, results[i].ns_per_op, change,
+                change > config->threshold ? "  REGRESSION" : "");
+        if (change > config->threshold) {
+            regressions++;
+        }
+    }
+    fprintf(stderr, "%d regression%s over %.1f%%\n", regressions,
+            regressions == 1 ? "" : "s", config->threshold);
+    return regressions;
+}
+
+static void bench_usage(const char* program) {
+    const BenchCase* bench;
+
+    printf("Usage: %s [-o out.json] [-c baseline.json] [-r percent]\n"
+           "       [-n runs] [-t ms] [-f name] [-q]\n", program);
+    printf("  -o file       Write the JSON results here (default stdout)\n");
+    printf("  -c file       Compare with an earlier result file\n");
+    printf("  -r percent    Slower than the baseline by more than this is a\n"
+           "                regression (default %.0f)\n", BENCH_DEFAULT_PERCENT);
+    printf("  -n runs       Timed runs per benchmark, median kept (default %d)\n",
+           BENCH_DEFAULT_RUNS);
+    printf("  -t ms         Length of each run (default %d)\n", BENCH_DEFAULT_MS);
+    printf("  -f name       Only benchmarks whose name contains this\n");
+    printf("  -q            No progress table on stderr\n");
+    printf("\nBenchmarks:\n");
+    for (bench = bench_cases; bench->name; bench++) {
+        printf("  %s\n", bench->name);
+    }
+}
+
+static bool_t bench_parse_args(int argc, char** argv, BenchConfig* config) {
+    int i;
+
+    config->runs = BENCH_DEFAULT_RUNS;
+    config->run_ms = BENCH_DEFAULT_MS;
+    config->threshold = BENCH_DEFAULT_PERCENT;
+    config->output = NULL;
+    config->baseline = NULL;
+    config->filter = NULL;
+    config->quiet = FALSE;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            config->quiet = TRUE;
+        } else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+            config->output = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            config->baseline = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+            config->threshold = strtod(argv[++i], NULL);
+        } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+            config->runs = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            config->run_ms = strtod(argv[++i], NULL);
+        } else if (i + 1 < argc && strcmp(argv[i], "-f") == 0) {
+            config->filter = argv[++i];
+        } else {
+            return FALSE;
+        }
+    }
+    return config->runs >= 1 && config->runs <= 64 && config->run_ms > 0 &&
+           config->threshold >= 0;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    BenchResult results[BENCH_MAX_CASES];
+    BenchData* data;
+    const BenchCase* bench;
+    FILE* out = stdout;
+    char* baseline = NULL;
+    int count = 0, regressions = 0;
+
+    if (!bench_parse_args(argc, argv, &config)) {
+        bench_usage(argv[0]);
+        return 2;
+    }
+    if (!rachel_self_test() || !rachel_engine_self_test() ||
+        !rachel_net_self_test()) {
+        printf("Self test failed! The cards refuse to be dealt.\n");
+        return 1;
+    }
+    if (config.baseline != NULL) {
+        baseline = bench_read_file(config.baseline);
+        if (baseline == NULL) {
+            perror(config.baseline);
+            return 1;
+        }
+    }
+
+    data = (BenchData*)calloc(1, sizeof(BenchData));
+    if (data == NULL || !bench_collect(data)) {
+        fprintf(stderr, "Could not fill the position pools.\n");
+        return 1;
+    }
+
+    for (bench = bench_cases; bench->name; bench++) {
+        if (config.filter != NULL && strstr(bench->name, config.filter) == NULL) {
+            continue;
+        }
+        bench_run(data, bench, &config, &results[count]);
+        if (!config.quiet) {
+            fprintf(stderr, "%-22s %10.2f ns/op %10.1f cycles/op\n",
+                    results[count].name, results[count].ns_per_op,
+                    results[count].cycles_per_op);
+        }
+        count++;
+    }
+
+    if (config.output != NULL) {
+        out = fopen(config.output, "w");
+        if (out == NULL) {
+            perror(config.output);
+            return 1;
+        }
+    }
+    bench_write_json(out, results, count, &config);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    if (baseline != NULL) {
+        regressions = bench_compare(baseline, results, count, &config);
+        free(baseline);
+    }
+    free(data);
+    return regressions > 0 ? 1 : 0;
+}
+
+/*
+ * End of benchmarks.
+ *
+ * Measure twice, optimise once.
+ */
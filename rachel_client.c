@@ -0,0 +1,652 @@
+/*
+ * RACHEL SCRIPTED CLIENT
+ *
+ * Opens many connections to rachel_server and plays every seat with an
+ * AI policy, so the server can be exercised over loopback without a
+ * single human. Each connection plays its games back to back.
+ *
+ * With -x the client also probes the server's rule checks: on its first
+ * turn of every game it sends a play the rules forbid and expects a
+ * REJECT before playing properly.
+ *
+ * Each seat's view is built from the first STATE of a game and the
+ * DELTA frames after it. With -r n every n-th delta is followed by a
+ * RESYNC, and the STATE that answers it must match the view exactly.
+ *
+ * With -w n as many more connections WATCH one table as spectators and
+ * check every public view they get. -l makes some of them never read,
+ * so the server has a slow spectator to skip views for and drop.
+ *
+ * Reports round-trip move latency - PLAY sent to the view that answers
+ * it - and exits non-zero on any unexpected reject, bad frame, view
+ * mismatch or stall.
+ *
+ * "Somebody has to sit at all those tables."
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "rules.h"
+#include "ai.h"
+#include "protocol.h"
+
+/* Defaults */
+#define CLIENT_DEFAULT_CONNS    16
+#define CLIENT_DEFAULT_GAMES    10
+#define CLIENT_MAX_EVENTS       256
+#define CLIENT_STALL_SECONDS    5.0
+#define CLIENT_LATENCY_BUCKETS  100000     /* 1 us each, last is overflow */
+#define CLIENT_LAZY_RCVBUF      1024       /* So a lazy spectator fills up */
+
+typedef struct {
+    const char*     host;
+    uint16_t        port;
+    int             conns;
+    unsigned long   games;         /* Per connection */
+    uint8_t         players, bots;
+    const AiPolicy* policy;
+    unsigned long   seed;
+    bool_t          probe;
+    unsigned long   check_every;   /* Deltas per checking RESYNC, 0 never */
+    int             watchers;      /* Spectator connections */
+    int             lazy;          /* ...of which never read */
+    uint32_t        watch_table;
+    bool_t          quiet;
+} ClientConfig;
+
+typedef struct {
+    int       fd;
+    uint8_t   in[NET_FRAME_SIZE];
+    uint8_t   in_len;
+    uint32_t  seq;                 /* Next frame we expect */
+    uint8_t   seat;
+    unsigned long games_done;
+    bool_t    probed;              /* Illegal play sent this game */
+    bool_t    done;
+    double    sent_at;             /* PLAY in flight since, 0 if none */
+    NetState  last;                /* For the real play after a probe */
+    NetState  view;                /* STATE plus every DELTA since */
+    bool_t    synced;              /* view is good; otherwise wait for STATE */
+    bool_t    checking;            /* A RESYNC to compare against is out */
+    unsigned long deltas;
+    bool_t    watcher;             /* A spectator, not a seat */
+    bool_t    have_view;
+    uint32_t  last_view;           /* Table's view number, the frame seq */
+    RachelRng rng;
+} ClientConn;
+
+typedef struct {
+    unsigned long  moves, games, probes;
+    unsigned long  deltas, checks, resyncs;
+    unsigned long  watched, watch_skipped;
+    unsigned long  errors;
+    unsigned long* latency;        /* Round trips by microsecond */
+    double         worst;
+} ClientStats;
+
+static double client_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static bool_t client_send(ClientConn* conn, NetMessage* msg) {
+    uint8_t frame[NET_FRAME_SIZE];
+    size_t size, sent = 0;
+    ssize_t got;
+
+    msg->seq = 0;
+    size = rachel_net_encode(msg, frame);
+
+    /* One frame always fits an empty socket buffer; spin if it does not */
+    while (sent < size) {
+        got = send(conn->fd, frame + sent, size - sent, MSG_NOSIGNAL);
+        if (got < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            continue;
+        }
+        if (got <= 0) {
+            return FALSE;
+        }
+        sent += (size_t)got;
+    }
+    return TRUE;
+}
+
+static bool_t client_join(ClientConn* conn, const ClientConfig* config) {
+    NetMessage msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_JOIN;
+    msg.u.join.players = config->players;
+    msg.u.join.bots = config->bots;
+    sprintf(msg.u.join.name, "CLIENT_%d", conn->fd);
+    conn->probed = !config->probe;
+    conn->synced = FALSE;
+    return client_send(conn, &msg);
+}
+
+static bool_t client_resync(ClientConn* conn) {
+    NetMessage msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_RESYNC;
+    return client_send(conn, &msg);
+}
+
+/* A play the server must refuse: a card we hold that does not fit, or
+ * failing that, a fitting card we do not hold */
+static bool_t client_bad_play(const Game* view, uint8_t seat, NetPlay* play) {
+    uint64_t hand = view->players[seat].hand_mask;
+    uint64_t fits = rachel_playable_mask(view);
+    uint64_t bad = hand & ~fits & RACHEL_MASK_STANDARD;
+
+    if (!bad) {
+        bad = fits & ~hand & RACHEL_MASK_STANDARD;
+    }
+    if (!bad) {
+        return FALSE;
+    }
+    play->count = 1;
+    play->cards[0] = rachel_card_from_index(RACHEL_MASK_LOWEST(bad));
+    play->nominated_suit = SUIT_HEARTS;
+    return TRUE;
+}
+
+static bool_t client_turn(ClientConn* conn, const NetState* state,
+                          const ClientConfig* config, ClientStats* stats) {
+    NetMessage msg;
+    AiPlay play;
+    Game view;
+    int i;
+
+    rachel_net_view(state, conn->seat, &view);
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_PLAY;
+
+    if (!conn->probed) {
+        conn->probed = TRUE;
+        if (client_bad_play(&view, conn->seat, &msg.u.play)) {
+            conn->last = *state;
+            stats->probes++;
+            return client_send(conn, &msg);
+        }
+    }
+
+    play.count = 0;
+    play.nominated_suit = SUIT_HEARTS;
+    config->policy->choose(&view, conn->seat, &conn->rng, &play);
+    msg.u.play.count = play.count;
+    for (i = 0; i < play.count && i < RACHEL_MAX_PLAY; i++) {
+        msg.u.play.cards[i] = play.cards[i];
+    }
+    msg.u.play.nominated_suit = play.nominated_suit;
+    conn->sent_at = client_now();
+    return client_send(conn, &msg);
+}
+
+static void client_latency(ClientConn* conn, ClientStats* stats) {
+    double spent;
+    unsigned long us;
+
+    if (conn->sent_at == 0) {
+        return;
+    }
+    spent = client_now() - conn->sent_at;
+    conn->sent_at = 0;
+    us = (unsigned long)(spent * 1e6);
+    stats->latency[us < CLIENT_LATENCY_BUCKETS ? us : CLIENT_LATENCY_BUCKETS - 1]++;
+    if (spent > stats->worst) {
+        stats->worst = spent;
+    }
+    stats->moves++;
+}
+
+/* Compared as frames: NetState has padding that decoding leaves alone */
+static bool_t client_same_view(const NetState* a, const NetState* b) {
+    NetMessage msg;
+    uint8_t x[NET_FRAME_SIZE], y[NET_FRAME_SIZE];
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_STATE;
+    msg.u.state = *a;
+    rachel_net_encode(&msg, x);
+    msg.u.state = *b;
+    rachel_net_encode(&msg, y);
+    return memcmp(x, y, NET_FRAME_SIZE) == 0;
+}
+
+/* Act on the view, new from a STATE or a DELTA */
+static bool_t client_view(ClientConn* conn, const ClientConfig* config,
+                          ClientStats* stats) {
+    client_latency(conn, stats);
+    if (conn->view.state == STATE_FINISHED) {
+        stats->games++;
+        if (++conn->games_done >= config->games) {
+            conn->done = TRUE;
+            return FALSE;
+        }
+        return client_join(conn, config);
+    }
+    if (conn->view.current_player == conn->seat) {
+        return client_turn(conn, &conn->view, config, stats);
+    }
+    if (config->check_every != 0 && !conn->checking &&
+        ++conn->deltas % config->check_every == 0) {
+        conn->checking = TRUE;
+        return client_resync(conn);
+    }
+    return TRUE;
+}
+
+/* A spectator's frame: the table's public view, numbered by the table */
+static bool_t client_watch_frame(ClientConn* conn, const NetMessage* msg,
+                                 const ClientConfig* config, ClientStats* stats) {
+    if (msg->type != NET_MSG_STATE || msg->seat != NET_SEAT_SPECTATOR ||
+        msg->table != config->watch_table || msg->u.state.hand_mask != 0 ||
+        (conn->have_view && msg->seq <= conn->last_view)) {
+        fprintf(stderr, "Connection %d: bad spectator frame\n", conn->fd);
+        stats->errors++;
+        return FALSE;
+    }
+    if (conn->have_view) {
+        stats->watch_skipped += msg->seq - conn->last_view - 1;
+    }
+    conn->have_view = TRUE;
+    conn->last_view = msg->seq;
+    stats->watched++;
+    return TRUE;
+}
+
+/* FALSE means the connection is finished, cleanly or not */
+static bool_t client_frame(ClientConn* conn, const uint8_t* frame,
+                           const ClientConfig* config, ClientStats* stats) {
+    NetMessage msg;
+
+    if (!rachel_net_decode(frame, &msg) || (!conn->watcher && msg.seq != conn->seq++)) {
+        fprintf(stderr, "Connection %d: bad frame\n", conn->fd);
+        stats->errors++;
+        return FALSE;
+    }
+    if (conn->watcher) {
+        return client_watch_frame(conn, &msg, config, stats);
+    }
+
+    switch (msg.type) {
+    case NET_MSG_WELCOME:
+        conn->seat = msg.seat;
+        return TRUE;
+
+    case NET_MSG_REJECT:
+        if (msg.u.reason == NET_REJECT_NOT_SEATED && conn->checking) {
+            conn->checking = FALSE;     /* The game ended before our RESYNC */
+            return TRUE;
+        }
+        if (msg.u.reason == NET_REJECT_ILLEGAL_CARD ||
+            msg.u.reason == NET_REJECT_ILLEGAL_PLAY) {
+            if (conn->sent_at == 0) {
+                /* Our probe, refused as it should be - now play for real */
+                return client_turn(conn, &conn->last, config, stats);
+            }
+        }
+        fprintf(stderr, "Connection %d: rejected, reason %d\n",
+                conn->fd, msg.u.reason);
+        stats->errors++;
+        return FALSE;
+
+    case NET_MSG_STATE:
+        if (conn->checking) {
+            /* The answer to a check: the deltas must have kept up */
+            conn->checking = FALSE;
+            stats->checks++;
+            if (!client_same_view(&conn->view, &msg.u.state)) {
+                fprintf(stderr, "Connection %d: view differs from STATE\n", conn->fd);
+                stats->errors++;
+                return FALSE;
+            }
+            return TRUE;
+        }
+        conn->view = msg.u.state;
+        conn->synced = TRUE;
+        return client_view(conn, config, stats);
+
+    case NET_MSG_DELTA:
+        if (!conn->synced) {
+            return TRUE;                /* Waiting on a RESYNC */
+        }
+        stats->deltas++;
+        if (!rachel_net_apply(&conn->view, &msg.u.delta)) {
+            stats->resyncs++;
+            conn->synced = FALSE;
+            return client_resync(conn);
+        }
+        return client_view(conn, config, stats);
+    }
+
+    stats->errors++;
+    return FALSE;
+}
+
+static bool_t client_read(ClientConn* conn, const ClientConfig* config,
+                          ClientStats* stats) {
+    uint8_t buffer[64 * NET_FRAME_SIZE];
+    ssize_t got;
+    size_t pos, take, size;
+
+    for (;;) {
+        got = read(conn->fd, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return TRUE;
+        }
+        if (got <= 0) {
+            fprintf(stderr, "Connection %d: closed by server\n", conn->fd);
+            stats->errors++;
+            return FALSE;
+        }
+
+        pos = 0;
+        while (pos < (size_t)got) {
+            if (conn->in_len == 0) {
+                size = rachel_net_frame_size(buffer + pos, got - pos);
+                if (size <= got - pos) {
+                    if (!client_frame(conn, buffer + pos, config, stats)) {
+                        return FALSE;
+                    }
+                    pos += size;
+                    continue;
+                }
+            }
+            /* A frame split across reads: gather it in conn->in */
+            take = rachel_net_frame_size(conn->in, conn->in_len) - conn->in_len;
+            if (take > got - pos) {
+                take = got - pos;
+            }
+            memcpy(conn->in + conn->in_len, buffer + pos, take);
+            conn->in_len += (uint8_t)take;
+            pos += take;
+            if (conn->in_len == rachel_net_frame_size(conn->in, conn->in_len)) {
+                conn->in_len = 0;
+                if (!client_frame(conn, conn->in, config, stats)) {
+                    return FALSE;
+                }
+            }
+        }
+    }
+}
+
+static bool_t client_watch(ClientConn* conn, const ClientConfig* config) {
+    NetMessage msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_WATCH;
+    msg.table = config->watch_table;
+    conn->watcher = TRUE;
+    return client_send(conn, &msg);
+}
+
+/* rcvbuf: a small receive buffer, or 0 for the default */
+static int client_connect(const ClientConfig* config, int rcvbuf) {
+    struct sockaddr_in addr;
+    int fd, one = 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config->port);
+    if (inet_pton(AF_INET, config->host, &addr.sin_addr) != 1) {
+        return -1;
+    }
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (rcvbuf > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+/* Microseconds below which this fraction of round trips fell */
+static unsigned long client_quantile(const ClientStats* stats, double q) {
+    unsigned long target = (unsigned long)(q * stats->moves), seen = 0, us;
+
+    for (us = 0; us < CLIENT_LATENCY_BUCKETS; us++) {
+        seen += stats->latency[us];
+        if (seen > target) {
+            return us;
+        }
+    }
+    return CLIENT_LATENCY_BUCKETS - 1;
+}
+
+static bool_t client_run(const ClientConfig* config, ClientStats* stats) {
+    struct epoll_event event, events[CLIENT_MAX_EVENTS];
+    ClientConn* conns;
+    ClientConn* conn;
+    double start, last_progress;
+    unsigned long last_moves = 0;
+    int epfd, active = 0, count, i;
+
+    conns = (ClientConn*)calloc(config->conns + config->watchers, sizeof(ClientConn));
+    epfd = epoll_create1(0);
+    if (conns == NULL || epfd < 0) {
+        return FALSE;
+    }
+
+    for (i = 0; i < config->conns; i++) {
+        conn = &conns[i];
+        conn->fd = client_connect(config, 0);
+        if (conn->fd < 0) {
+            perror("rachel_client: connect");
+            return FALSE;
+        }
+        rachel_rng_seed(&conn->rng, config->seed, i);
+        event.events = EPOLLIN;
+        event.data.ptr = conn;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &event);
+        if (!client_join(conn, config)) {
+            return FALSE;
+        }
+        active++;
+    }
+
+    /* Spectators are not counted in active: the run ends with the seats */
+    for (i = config->conns; i < config->conns + config->watchers; i++) {
+        conn = &conns[i];
+        conn->fd = client_connect(config, i - config->conns < config->lazy ?
+                                  CLIENT_LAZY_RCVBUF : 0);
+        if (conn->fd < 0 || !client_watch(conn, config)) {
+            perror("rachel_client: watch");
+            return FALSE;
+        }
+        if (i - config->conns < config->lazy) {
+            continue;               /* Never read: the server must cope */
+        }
+        event.events = EPOLLIN;
+        event.data.ptr = conn;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &event);
+    }
+
+    start = last_progress = client_now();
+    while (active > 0) {
+        count = epoll_wait(epfd, events, CLIENT_MAX_EVENTS, 500);
+        for (i = 0; i < count; i++) {
+            conn = (ClientConn*)events[i].data.ptr;
+            if (conn->fd < 0 || client_read(conn, config, stats)) {
+                continue;
+            }
+            epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+            close(conn->fd);
+            conn->fd = -1;
+            if (!conn->watcher) {
+                active--;
+            }
+        }
+
+        /* Tables waiting for players that will never come */
+        if (stats->moves != last_moves || count > 0) {
+            last_moves = stats->moves;
+            last_progress = client_now();
+        } else if (client_now() - last_progress > CLIENT_STALL_SECONDS) {
+            fprintf(stderr, "Stalled with %d connections still waiting\n", active);
+            stats->errors += active;
+            break;
+        }
+    }
+
+    if (!config->quiet) {
+        printf("Connections: %d, %lu games each\n", config->conns, config->games);
+    }
+    printf("Games:       %lu\n", stats->games);
+    printf("Moves:       %lu (%lu probes refused)\n", stats->moves, stats->probes);
+    printf("Elapsed:     %.3f s\n", client_now() - start);
+    if (stats->moves > 0) {
+        printf("Round trip:  p50 %lu us  p99 %lu us  max %.0f us\n",
+               client_quantile(stats, 0.50), client_quantile(stats, 0.99),
+               stats->worst * 1e6);
+    }
+    printf("Views:       %lu deltas, %lu checked against STATE, %lu resyncs\n",
+           stats->deltas, stats->checks, stats->resyncs);
+    if (config->watchers > 0) {
+        printf("Spectators:  %d on table %lu (%d never reading), %lu views,"
+               " %lu skipped\n", config->watchers, (unsigned long)config->watch_table,
+               config->lazy, stats->watched, stats->watch_skipped);
+    }
+    printf("Errors:      %lu\n", stats->errors);
+
+    for (i = 0; i < config->conns + config->watchers; i++) {
+        if (conns[i].fd >= 0) {
+            close(conns[i].fd);
+        }
+    }
+    close(epfd);
+    free(conns);
+    return TRUE;
+}
+
+static void client_usage(const char* program) {
+    printf("Usage: %s [-H host] [-P port] [-c connections] [-g games]\n"
+           "       [-p players] [-b bots] [-a policy] [-s seed] [-r n]\n"
+           "       [-w watchers] [-l lazy] [-W table] [-x] [-q]\n",
+           program);
+    printf("  -H host       Server IPv4 address (default 127.0.0.1)\n");
+    printf("  -P port       Server port (default %d)\n", NET_DEFAULT_PORT);
+    printf("  -c conns      Connections, one seat each (default %d)\n",
+           CLIENT_DEFAULT_CONNS);
+    printf("  -g games      Games per connection (default %d)\n",
+           CLIENT_DEFAULT_GAMES);
+    printf("  -p players    Table size (default 2)\n");
+    printf("  -b bots       Server-played seats per table (default 1)\n");
+    printf("  -a policy     AI policy for our seats (default suit)\n");
+    printf("  -s seed       AI seed, connection i uses stream i (default 1)\n");
+    printf("  -r n          Check the view against a RESYNC every n deltas\n");
+    printf("  -w watchers   Spectator connections (default 0)\n");
+    printf("  -l lazy       How many of them never read (default 0)\n");
+    printf("  -W table      Table they watch (default 0)\n");
+    printf("  -x            Probe: one illegal play per game, must be refused\n");
+    printf("  -q            Summary only\n");
+    printf("\nWith fewer bots than seats, use a multiple of (players - bots)\n"
+           "connections so every table can fill.\n");
+}
+
+static bool_t client_parse_args(int argc, char** argv, ClientConfig* config) {
+    int i;
+
+    config->host = "127.0.0.1";
+    config->port = NET_DEFAULT_PORT;
+    config->conns = CLIENT_DEFAULT_CONNS;
+    config->games = CLIENT_DEFAULT_GAMES;
+    config->players = 2;
+    config->bots = 1;
+    config->policy = rachel_ai_find("suit");
+    config->seed = 1;
+    config->probe = FALSE;
+    config->check_every = 0;
+    config->watchers = 0;
+    config->lazy = 0;
+    config->watch_table = 0;
+    config->quiet = FALSE;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-x") == 0) {
+            config->probe = TRUE;
+        } else if (strcmp(argv[i], "-q") == 0) {
+            config->quiet = TRUE;
+        } else if (i + 1 < argc && strcmp(argv[i], "-H") == 0) {
+            config->host = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-P") == 0) {
+            config->port = (uint16_t)atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            config->conns = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-g") == 0) {
+            config->games = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+            config->players = (uint8_t)atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+            config->bots = (uint8_t)atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-a") == 0) {
+            config->policy = rachel_ai_find(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            config->seed = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+            config->check_every = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) {
+            config->watchers = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+            config->lazy = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-W") == 0) {
+            config->watch_table = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else {
+            return FALSE;
+        }
+    }
+    return config->conns > 0 && config->games > 0 && config->policy != NULL &&
+           config->players >= 2 && config->players <= MAX_PLAYERS &&
+           config->bots < config->players && config->watchers >= 0 &&
+           config->lazy >= 0 && config->lazy <= config->watchers;
+}
+
+int main(int argc, char** argv) {
+    ClientConfig config;
+    ClientStats stats;
+
+    if (!client_parse_args(argc, argv, &config)) {
+        client_usage(argv[0]);
+        return 2;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    stats.latency = (unsigned long*)calloc(CLIENT_LATENCY_BUCKETS, sizeof(unsigned long));
+    if (stats.latency == NULL || !client_run(&config, &stats)) {
+        printf("Could not reach the server at %s:%u\n", config.host, config.port);
+        return 1;
+    }
+
+    free(stats.latency);
+    return stats.errors == 0 ? 0 : 1;
+}
+
+/*
+ * End of client.
+ *
+ * It never complains about the cards it was dealt.
+ */
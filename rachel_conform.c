@@ -0,0 +1,704 @@
+/*
+ * RACHEL CONFORMANCE RUNNER
+ *
+ * rachel_correct.c carries a rules engine of its own: int rank and
+ * suit cards, a draw_penalty and a skip_count, can_counter_attack. This
+ * plays seeded two-player move sequences through it and through
+ * rules.c side by side, and stops each sequence at the first point
+ * where the two disagree:
+ *
+ *   legal   a card in the mover's hand one engine allows and one not
+ *   play    the states after the same play differ
+ *   pass    the states after the same forced pass differ
+ *
+ * Moves come from rules.c (rachel_solver_moves), one picked at random
+ * per turn, and each is played through rachel_correct.c's own turn
+ * (turn_start, then turn_resume with the answer to every prompt), both
+ * seats answering as its human would. Options only rachel_correct.c
+ * offers, like playing the card just drawn, are declined. The two engines
+ * deal cards in different orders, so after every agreeing turn the
+ * cards are copied across from rules.c; only the counts of a draw are
+ * compared.
+ *
+ * Disagreements are tallied by kind with the first sequence that shows
+ * each, whatever the thread count. Sequence i deals from stream i.
+ *
+ * "A man with one watch knows what time it is. A man with two is never sure."
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* rachel_correct.c without its main, quietened: it prints nothing, its
+ * shuffle draws from a per-thread stream and its Game and Card keep out
+ * of the way of rules.h. */
+static int conform_printf(const char* format, ...);
+static int conform_rand(void);
+
+#define RACHEL_CORRECT_ENGINE
+#define Game        CorrectGame
+#define Card        CorrectCard
+#define printf      conform_printf
+#define rand        conform_rand
+#define srand(seed)
+#include "rachel_correct.c"
+#undef Game
+#undef Card
+#undef printf
+#undef rand
+#undef srand
+
+#include "rules.h"
+#include "solver.h"
+
+#define CONFORM_DEFAULT_SEQUENCES  1000000UL
+#define CONFORM_DEFAULT_TURNS      200
+#define CONFORM_MAX_THREADS        256
+#define CONFORM_MAX_KINDS          64
+#define CONFORM_BATCH              1024UL    /* Sequences per grab */
+
+typedef struct {
+    unsigned long sequences;
+    unsigned      max_turns;
+    uint64_t      seed;
+    int           threads;
+    bool_t        quiet;         /* Tally only, no examples */
+} ConformConfig;
+
+/* Either engine's position, in common terms */
+typedef struct {
+    int      current;
+    int      direction;          /* 1 clockwise, -1 counter */
+    int      top_rank, top_suit;
+    int      nominated;          /* Suit, or -1 */
+    int      penalty;            /* Cards the next pass must draw */
+    int      skips;
+    int      hand_count[2];
+    uint64_t hands[2];           /* Standard card bits */
+    int      deck_count, discard_count;
+} ConformState;
+
+/* One kind of disagreement and the first time it showed */
+typedef struct {
+    char          name[64];
+    unsigned long count;
+    unsigned long sequence;      /* Lowest sequence that showed it */
+    unsigned      turn;
+    Move          move;
+    ConformState  rules, correct;
+} ConformKind;
+
+typedef struct {
+    ConformKind   kinds[CONFORM_MAX_KINDS];
+    int           kind_count;
+    unsigned long agreed;        /* Played out, or hit the turn cap */
+    unsigned long diverged;
+    unsigned long turns;
+} ConformTally;
+
+typedef struct {
+    const ConformConfig* config;
+    _Atomic unsigned long next;  /* Next batch to hand out */
+} ConformRun;
+
+typedef struct {
+    ConformRun*  run;
+    ConformTally tally;
+    pthread_t    thread;
+} ConformWorker;
+
+static _Thread_local RachelRng conform_rng;    /* rand() for rachel_correct.c */
+
+static int conform_printf(const char* format, ...) {
+    (void)format;
+    return 0;
+}
+
+static int conform_rand(void) {
+    return (int)(rachel_rng_next(&conform_rng) >> 1);
+}
+
+static double conform_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t conform_bit(int rank, int suit) {
+    return (uint64_t)1 << (suit * 13 + rank - 2);
+}
+
+static CorrectCard conform_card(Card card) {
+    CorrectCard c;
+
+    c.rank = GET_RANK(card.encoded);
+    c.suit = GET_SUIT(card.encoded);
+    return c;
+}
+
+static void conform_rules_state(const Game* game, ConformState* state) {
+    Card top = RACHEL_TOP_CARD(game);
+    int p, i;
+
+    memset(state, 0, sizeof(*state));
+    state->current = game->current_player_index;
+    state->direction = game->direction == DIR_CLOCKWISE ? 1 : -1;
+    state->top_rank = GET_RANK(top.encoded);
+    state->top_suit = GET_SUIT(top.encoded);
+    state->nominated = game->nominated_suit == 0xFF ? -1 : game->nominated_suit;
+    if (game->pending_effect.type == RANK_7) {
+        state->skips = game->pending_effect.count;
+    } else if (game->pending_effect.count > 0) {
+        state->penalty = game->pending_effect.count;
+    }
+    for (p = 0; p < 2; p++) {
+        state->hand_count[p] = game->players[p].hand_count;
+        for (i = 0; i < game->players[p].hand_count; i++) {
+            state->hands[p] |= conform_bit(GET_RANK(game->players[p].hand[i].encoded),
+                                           GET_SUIT(game->players[p].hand[i].encoded));
+        }
+    }
+    state->deck_count = game->deck_count;
+    state->discard_count = game->discard_count;
+}
+
+/* Seat 0 is rachel_correct.c's player, seat 1 its CPU */
+static void conform_correct_state(const CorrectGame* correct, ConformState* state) {
+    int i;
+
+    memset(state, 0, sizeof(*state));
+    state->current = correct->current_player;
+    state->direction = correct->direction;
+    state->top_rank = correct->top_card.rank;
+    state->top_suit = correct->top_card.suit;
+    state->nominated = correct->nominated_suit;
+    state->penalty = correct->draw_penalty;
+    state->skips = correct->skip_count;
+    state->hand_count[0] = correct->player_count;
+    state->hand_count[1] = correct->cpu_count;
+    for (i = 0; i < correct->player_count; i++) {
+        state->hands[0] |= conform_bit(correct->player_hand[i].rank,
+                                       correct->player_hand[i].suit);
+    }
+    for (i = 0; i < correct->cpu_count; i++) {
+        state->hands[1] |= conform_bit(correct->cpu_hand[i].rank, correct->cpu_hand[i].suit);
+    }
+    state->deck_count = correct->deck_count;
+    state->discard_count = correct->discard_count;
+}
+
+/* The first thing that differs, or NULL. Drawn cards differ by design:
+ * with drew set only the counts are compared. */
+static const char* conform_compare(const ConformState* a, const ConformState* b,
+                                   bool_t drew) {
+    if (a->current != b->current) return "player to move";
+    if (a->penalty != b->penalty) return "penalty";
+    if (a->skips != b->skips) return "skips";
+    if (a->top_rank != b->top_rank || a->top_suit != b->top_suit) return "top card";
+    if (a->nominated != b->nominated) return "nominated suit";
+    if (a->hand_count[0] != b->hand_count[0] ||
+        a->hand_count[1] != b->hand_count[1]) return "hand sizes";
+    if (!drew && (a->hands[0] != b->hands[0] ||
+                  a->hands[1] != b->hands[1])) return "hands";
+    if (a->deck_count != b->deck_count) return "deck";
+    if (a->discard_count != b->discard_count) return "discard";
+    if (a->direction != b->direction) return "direction";
+    return NULL;
+}
+
+/* Put rachel_correct.c's game where rules.c's is, card for card */
+static void conform_sync(CorrectGame* correct, const Game* game) {
+    ConformState state;
+    const Player* player;
+    int i;
+
+    conform_rules_state(game, &state);
+    correct->current_player = state.current;
+    correct->direction = state.direction;
+    correct->nominated_suit = state.nominated;
+    correct->draw_penalty = state.penalty;
+    correct->skip_count = state.skips;
+    correct->game_over = 0;
+    player = &game->players[0];
+    correct->player_count = player->hand_count;
+    for (i = 0; i < player->hand_count; i++) {
+        correct->player_hand[i] = conform_card(player->hand[i]);
+    }
+    player = &game->players[1];
+    correct->cpu_count = player->hand_count;
+    for (i = 0; i < player->hand_count; i++) {
+        correct->cpu_hand[i] = conform_card(player->hand[i]);
+    }
+    correct->deck_count = game->deck_count;
+    for (i = 0; i < game->deck_count; i++) {
+        correct->deck[i] = conform_card(RACHEL_DECK(game)[i]);
+    }
+    correct->discard_count = game->discard_count;
+    for (i = 0; i < game->discard_count; i++) {
+        correct->discard[i] = conform_card(RACHEL_DISCARD(game)[i]);
+    }
+    correct->top_card = conform_card(RACHEL_TOP_CARD(game));
+}
+
+/* Slot of a card in rachel_correct.c's hand */
+static int conform_slot(const CorrectCard* hand, int count, Card card) {
+    CorrectCard c = conform_card(card);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (hand[i].rank == c.rank && hand[i].suit == c.suit) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* rachel_correct.c asks for one card, then offers the rest of its rank
+ * in hand order: put a stack's other cards in that order */
+static void conform_order_stack(const Game* game, Move* move) {
+    const Player* player = &game->players[game->current_player_index];
+    int slots[RACHEL_MAX_PLAY];
+    Card card;
+    int i, j, slot;
+
+    for (i = 1; i < move->count; i++) {
+        for (slot = 0; player->hand[slot].encoded != move->cards[i].encoded; slot++) {
+        }
+        card = move->cards[i];
+        for (j = i; j > 1 && slots[j - 1] > slot; j--) {
+            slots[j] = slots[j - 1];
+            move->cards[j] = move->cards[j - 1];
+        }
+        slots[j] = slot;
+        move->cards[j] = card;
+    }
+}
+
+/* One turn of rachel_correct.c's, with move as the answer to each of
+ * its prompts. Returns why it could not follow move, or NULL. */
+static const char* conform_correct_turn(CorrectGame* correct, const Move* move) {
+    const CorrectCard* hand;
+    const CorrectCard* offer;
+    CorrectCard card;
+    Await await;
+    int count, answer, asked, i;
+
+    for (await = turn_start(correct), asked = 0; await != AWAIT_NONE;
+         await = turn_resume(correct, answer), asked++) {
+        if (correct->turn.refused || asked > RACHEL_MAX_PLAY + 4) {
+            return "play: rachel_correct.c refuses the answer";
+        }
+        hand = correct->current_player == 0 ? correct->player_hand : correct->cpu_hand;
+        count = correct->current_player == 0 ? correct->player_count : correct->cpu_count;
+        switch (await) {
+        case AWAIT_COUNTER:
+            answer = move->type == MOVE_PLAY ?
+                     conform_slot(hand, count, move->cards[0]) + 1 : 0;
+            break;
+        case AWAIT_CARD:
+            if (move->type != MOVE_PLAY) {
+                return "pass: rachel_correct.c plays on after the penalty";
+            }
+            answer = conform_slot(hand, count, move->cards[0]) + 1;
+            break;
+        case AWAIT_STACK:
+            answer = move->count > 1;
+            break;
+        case AWAIT_STACK_CARD:
+            offer = &hand[correct->turn.offer];
+            answer = 0;
+            for (i = 1; i < move->count; i++) {
+                card = conform_card(move->cards[i]);
+                if (card.rank == offer->rank && card.suit == offer->suit) {
+                    answer = 1;
+                }
+            }
+            break;
+        case AWAIT_SUIT:
+            answer = move->nominated_suit;
+            break;
+        default:
+            answer = 0;     /* Keep the card just drawn */
+            break;
+        }
+    }
+    return NULL;
+}
+
+static const char* conform_rank_name(int rank) {
+    static const char* const names[] = {
+        "?", "?", "2", "3", "4", "5", "6", "7", "8", "9", "10",
+        "jack", "queen", "king", "ace"
+    };
+    return rank >= 2 && rank <= 14 ? names[rank] : "?";
+}
+
+/* What was pending when a card was judged */
+static const char* conform_situation(const ConformState* state) {
+    if (state->penalty > 0) return " under a penalty";
+    if (state->skips > 0) return " under a skip";
+    if (state->nominated >= 0) return " after a nomination";
+    return "";
+}
+
+static void conform_tally(ConformTally* tally, const char* name, unsigned long sequence,
+                          unsigned turn, const Move* move,
+                          const ConformState* rules, const ConformState* correct) {
+    ConformKind* kind;
+    int i;
+
+    tally->diverged++;
+    for (i = 0; i < tally->kind_count; i++) {
+        if (strcmp(tally->kinds[i].name, name) == 0) {
+            tally->kinds[i].count++;
+            return;     /* Sequences run in order per thread: this is later */
+        }
+    }
+    if (tally->kind_count == CONFORM_MAX_KINDS) {
+        name = "other";
+        i = CONFORM_MAX_KINDS - 1;
+        tally->kinds[i].count++;
+        return;
+    }
+    kind = &tally->kinds[tally->kind_count++];
+    snprintf(kind->name, sizeof(kind->name), "%s", name);
+    kind->count = 1;
+    kind->sequence = sequence;
+    kind->turn = turn;
+    kind->move = *move;
+    kind->rules = *rules;
+    kind->correct = *correct;
+}
+
+/* Play one sequence until the engines disagree, the game ends or the
+ * turn cap */
+static void conform_sequence(const ConformConfig* config, unsigned long sequence,
+                             Game* game, CorrectGame* correct, ConformTally* tally) {
+    Move moves[SOLVER_MAX_MOVES];
+    MoveUndo undo;
+    ConformState rules, after;
+    RachelRng pick;
+    Move move;
+    const Player* mover;
+    const char* field;
+    const char* refused;
+    char name[64];
+    unsigned turn;
+    uint16_t count;
+    bool_t rules_ok, correct_ok;
+    int i;
+
+    rachel_init_game(game, 2);
+    rachel_add_player(game, "RULES", TRUE);
+    rachel_add_player(game, "CORRECT", TRUE);
+    rachel_seed_game(game, config->seed, sequence);
+    rachel_start_game(game);
+    rachel_rng_seed(&pick, ~config->seed, sequence);
+    rachel_rng_seed(&conform_rng, config->seed ^ 0x5EED, sequence);
+    correct->human[0] = correct->human[1] = 1;
+
+    for (turn = 0; turn < config->max_turns && !rachel_is_game_over(game); turn++) {
+        conform_sync(correct, game);
+        conform_rules_state(game, &rules);
+        memset(&move, 0, sizeof(move));
+        move.type = MOVE_PASS;
+
+        /* Every card the mover holds, judged by both */
+        mover = &game->players[game->current_player_index];
+        for (i = 0; i < mover->hand_count; i++) {
+            rules_ok = rachel_can_play_card(game, mover->hand[i]);
+            correct_ok = can_play_card(correct, conform_card(mover->hand[i])) != 0;
+            if (rules_ok != correct_ok) {
+                snprintf(name, sizeof(name), "legal: %s allows %s on %s%s",
+                         rules_ok ? "rules.c" : "rachel_correct.c",
+                         conform_rank_name(GET_RANK(mover->hand[i].encoded)),
+                         conform_rank_name(rules.top_rank), conform_situation(&rules));
+                move.type = MOVE_PLAY;
+                move.cards[0] = mover->hand[i];
+                move.count = 1;
+                conform_tally(tally, name, sequence, turn, &move, &rules, &rules);
+                tally->turns += turn;
+                return;
+            }
+        }
+
+        count = rachel_solver_moves(game, moves);
+        move = moves[rachel_rng_below(&pick, count)];
+        if (move.type == MOVE_PLAY) {
+            conform_order_stack(game, &move);
+        }
+        rachel_make_move(game, &move, &undo);
+        refused = conform_correct_turn(correct, &move);
+        if (refused != NULL) {
+            conform_correct_state(correct, &after);
+            conform_rules_state(game, &rules);
+            conform_tally(tally, refused, sequence, turn, &move, &rules, &after);
+            tally->turns += turn;
+            return;
+        }
+
+        conform_rules_state(game, &rules);
+        conform_correct_state(correct, &after);
+        if (correct->game_over) {
+            after.current = rules.current;      /* Nobody is left to move */
+        }
+        field = conform_compare(&rules, &after, move.type == MOVE_PASS);
+        if (field != NULL) {
+            if (move.type == MOVE_PLAY) {
+                snprintf(name, sizeof(name), "play %s%s: %s",
+                         conform_rank_name(GET_RANK(move.cards[0].encoded)),
+                         move.count > 1 ? " stack" : "", field);
+            } else {
+                snprintf(name, sizeof(name), "pass%s: %s",
+                         undo.pending_effect.count == 0 ? " (draw)" :
+                         undo.pending_effect.type == RANK_7 ? " (skip)" : " (penalty)",
+                         field);
+            }
+            conform_tally(tally, name, sequence, turn, &move, &rules, &after);
+            tally->turns += turn;
+            return;
+        }
+    }
+    tally->agreed++;
+    tally->turns += turn;
+}
+
+static void* conform_worker_main(void* arg) {
+    ConformWorker* worker = (ConformWorker*)arg;
+    const ConformConfig* config = worker->run->config;
+    unsigned long first, last, sequence;
+    Game game;
+    CorrectGame correct;
+
+    for (;;) {
+        first = atomic_fetch_add(&worker->run->next, CONFORM_BATCH);
+        if (first >= config->sequences) {
+            break;
+        }
+        last = first + CONFORM_BATCH;
+        if (last > config->sequences) {
+            last = config->sequences;
+        }
+        for (sequence = first; sequence < last; sequence++) {
+            conform_sequence(config, sequence, &game, &correct, &worker->tally);
+        }
+    }
+    return NULL;
+}
+
+/* Fold a worker's tally in, keeping each kind's earliest example */
+static void conform_merge(ConformTally* total, const ConformTally* part) {
+    const ConformKind* kind;
+    int i, j;
+
+    total->agreed += part->agreed;
+    total->diverged += part->diverged;
+    total->turns += part->turns;
+    for (i = 0; i < part->kind_count; i++) {
+        kind = &part->kinds[i];
+        for (j = 0; j < total->kind_count; j++) {
+            if (strcmp(total->kinds[j].name, kind->name) == 0) {
+                break;
+            }
+        }
+        if (j == total->kind_count) {
+            if (j == CONFORM_MAX_KINDS) {
+                continue;
+            }
+            total->kinds[total->kind_count++] = *kind;
+            continue;
+        }
+        total->kinds[j].count += kind->count;
+        if (kind->sequence < total->kinds[j].sequence) {
+            total->kinds[j].sequence = kind->sequence;
+            total->kinds[j].turn = kind->turn;
+            total->kinds[j].move = kind->move;
+            total->kinds[j].rules = kind->rules;
+            total->kinds[j].correct = kind->correct;
+        }
+    }
+}
+
+static bool_t conform_run(const ConformConfig* config, ConformTally* total) {
+    ConformRun run;
+    ConformWorker* workers;
+    int i, started = 0;
+
+    workers = (ConformWorker*)calloc(config->threads, sizeof(ConformWorker));
+    if (workers == NULL) {
+        return FALSE;
+    }
+    run.config = config;
+    atomic_init(&run.next, 0);
+    for (i = 0; i < config->threads; i++) {
+        workers[i].run = &run;
+        if (pthread_create(&workers[i].thread, NULL, conform_worker_main,
+                           &workers[i]) != 0) {
+            break;
+        }
+        started++;
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        conform_merge(total, &workers[i].tally);
+    }
+    free(workers);
+    return started > 0;
+}
+
+static int conform_by_count(const void* a, const void* b) {
+    const ConformKind* x = (const ConformKind*)a;
+    const ConformKind* y = (const ConformKind*)b;
+
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+    return x->sequence < y->sequence ? -1 : x->sequence > y->sequence;
+}
+
+static void conform_print_state(const char* engine, const ConformState* state) {
+    static const char suits[] = "HDCS";
+
+    printf("    %-17s to move %d, top %s%c, nominated %c, penalty %d, skips %d,"
+           " deck %d, discard %d\n", engine, state->current,
+           conform_rank_name(state->top_rank), suits[state->top_suit & 3],
+           state->nominated >= 0 ? suits[state->nominated & 3] : '-',
+           state->penalty, state->skips, state->deck_count, state->discard_count);
+    printf("    %-17s hands %d %013llx, %d %013llx\n", "", state->hand_count[0],
+           (unsigned long long)state->hands[0], state->hand_count[1],
+           (unsigned long long)state->hands[1]);
+}
+
+static void conform_report(const ConformTally* tally, const ConformConfig* config,
+                           double elapsed) {
+    ConformKind kinds[CONFORM_MAX_KINDS];
+    const ConformKind* kind;
+    unsigned long sequences = tally->agreed + tally->diverged;
+    int i, k;
+
+    printf("Rachel conformance: rules.c %s against rachel_correct.c\n", rachel_version());
+    printf("Sequences:   %lu (seed %lu, up to %u turns, 2 players)\n", sequences,
+           (unsigned long)config->seed, config->max_turns);
+    printf("Threads:     %d\n", config->threads);
+    printf("Elapsed:     %.3f s (%.0f sequences/min, %.0f turns/sec)\n", elapsed,
+           sequences / elapsed * 60.0, tally->turns / elapsed);
+    printf("Agreed:      %lu (%.2f%%)\n", tally->agreed,
+           sequences ? 100.0 * tally->agreed / sequences : 0.0);
+    printf("Diverged:    %lu (%.2f%%)\n", tally->diverged,
+           sequences ? 100.0 * tally->diverged / sequences : 0.0);
+    if (tally->kind_count == 0) {
+        return;
+    }
+
+    memcpy(kinds, tally->kinds, tally->kind_count * sizeof(ConformKind));
+    qsort(kinds, tally->kind_count, sizeof(ConformKind), conform_by_count);
+    printf("\n%-58s %10s %8s\n", "First divergence", "Sequences", "Share");
+    for (i = 0; i < tally->kind_count; i++) {
+        printf("%-58s %10lu %7.2f%%\n", kinds[i].name, kinds[i].count,
+               100.0 * kinds[i].count / tally->diverged);
+    }
+    if (config->quiet) {
+        return;
+    }
+
+    printf("\nFirst example of each:\n");
+    for (i = 0; i < tally->kind_count; i++) {
+        kind = &kinds[i];
+        printf("  %s\n    sequence %lu, turn %u, ", kind->name, kind->sequence, kind->turn);
+        if (kind->move.type == MOVE_PASS) {
+            printf("pass\n");
+        } else {
+            printf("play");
+            for (k = 0; k < kind->move.count; k++) {
+                printf(" %s%c", conform_rank_name(GET_RANK(kind->move.cards[k].encoded)),
+                       "HDCS"[GET_SUIT(kind->move.cards[k].encoded) & 3]);
+            }
+            printf("\n");
+        }
+        conform_print_state("rules.c", &kind->rules);
+        if (strncmp(kind->name, "legal", 5) != 0) {
+            conform_print_state("rachel_correct.c", &kind->correct);
+        }
+    }
+}
+
+static void conform_usage(const char* program) {
+    printf("Usage: %s [-n sequences] [-t turns] [-s seed] [-j threads] [-q]\n", program);
+    printf("  -n sequences  Move sequences to play (default %lu)\n",
+           CONFORM_DEFAULT_SEQUENCES);
+    printf("  -t turns      Longest sequence (default %d)\n", CONFORM_DEFAULT_TURNS);
+    printf("  -s seed       Base seed, sequence i uses stream i (default 1)\n");
+    printf("  -j threads    Worker threads, 1-%d (default: all cores)\n",
+           CONFORM_MAX_THREADS);
+    printf("  -q            Counts only, no examples\n");
+}
+
+static bool_t conform_parse_args(int argc, char** argv, ConformConfig* config) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int i;
+
+    config->sequences = CONFORM_DEFAULT_SEQUENCES;
+    config->max_turns = CONFORM_DEFAULT_TURNS;
+    config->seed = 1;
+    config->threads = cores < 1 ? 1 : (cores > CONFORM_MAX_THREADS ?
+                                       CONFORM_MAX_THREADS : (int)cores);
+    config->quiet = FALSE;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            config->quiet = TRUE;
+        } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+            config->sequences = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            config->max_turns = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            config->seed = strtoull(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+            config->threads = atoi(argv[++i]);
+        } else {
+            return FALSE;
+        }
+    }
+    return config->sequences > 0 && config->max_turns > 0 &&
+           config->threads >= 1 && config->threads <= CONFORM_MAX_THREADS;
+}
+
+int main(int argc, char** argv) {
+    ConformConfig config;
+    ConformTally* total;
+    double elapsed;
+
+    if (!conform_parse_args(argc, argv, &config)) {
+        conform_usage(argv[0]);
+        return 2;
+    }
+    if (!rachel_self_test() || !rachel_solver_self_test()) {
+        printf("Self test failed! The cards refuse to be dealt.\n");
+        return 1;
+    }
+
+    total = (ConformTally*)calloc(1, sizeof(ConformTally));
+    elapsed = conform_now();
+    if (total == NULL || !conform_run(&config, total)) {
+        printf("Could not start the run (out of memory or threads).\n");
+        return 1;
+    }
+    elapsed = conform_now() - elapsed;
+
+    conform_report(total, &config, elapsed);
+    free(total);
+    return 0;
+}
+
+/*
+ * End of conformance runner.
+ *
+ * Two engines, one game. Until they agree, neither is the law.
+ */
@@ -3,6 +3,13 @@
  * 
  * This time following the ACTUAL rules from GAME_RULES.md
  * No made-up rules, no shortcuts, the REAL game.
+ *
+ * A turn never waits on the keyboard itself. turn_start runs the player
+ * to move as far as it can and returns what it is waiting for (a card,
+ * a yes or no, a suit); turn_resume takes the answer and runs on to the
+ * next question or the end of the turn. Everything a turn needs to pick
+ * up again lives in its Game, so one loop can keep any number of games
+ * waiting on their players. main is the only place that reads input.
  */
 
 #include <stdio.h>
@@ -16,6 +23,26 @@ typedef struct {
     int suit;  /* 0=Hearts, 1=Diamonds, 2=Clubs, 3=Spades */
 } Card;
 
+/* What a turn is waiting for */
+typedef enum {
+    AWAIT_NONE,             /* Turn over, the next player is up */
+    AWAIT_COUNTER,          /* Card # to counter with, or 0 to accept penalty */
+    AWAIT_CARD,             /* Card # to play (mandatory rule) */
+    AWAIT_STACK,            /* Stack same rank? 1=yes, 0=no */
+    AWAIT_STACK_CARD,       /* Also play card turn.offer? 1=yes, 0=no */
+    AWAIT_SUIT,             /* Suit 0-3 for the Ace just played */
+    AWAIT_PLAY_DRAWN        /* Play the card just drawn? 1=yes, 0=no */
+} Await;
+
+/* A turn in progress */
+typedef struct {
+    Await await;
+    int cards[13];          /* Hand indices chosen so far */
+    int num_cards;
+    int offer;              /* Hand index AWAIT_STACK_CARD asks about */
+    int refused;            /* Last answer was not accepted */
+} Turn;
+
 /* Game state */
 typedef struct {
     Card deck[52];
@@ -38,29 +65,31 @@ typedef struct {
     int draw_penalty;       /* Accumulated from 2s and Jacks */
     int skip_count;         /* Accumulated from 7s */
     
+    int human[2];           /* Seats that answer prompts, others use the AI */
+    Turn turn;
+    
     int game_over;
 } Game;
 
-Game g;
-
 /* Function prototypes */
-void init_game(void);
-void shuffle_deck(void);
-void deal_cards(void);
+void init_game(Game *game);
+void shuffle_deck(Game *game);
+void deal_cards(Game *game);
 void clear_screen(void);
-void show_game(void);
+void show_game(Game *game);
 void print_card(Card c);
 void print_suit(int suit);
-int can_play_card(Card c);
-int can_counter_attack(Card c);
-void play_cards(Card *hand, int *count, int *indices, int num_cards);
-void draw_cards(Card *hand, int *count, int num);
-void apply_special_effects(Card *cards, int num_cards);
-void player_turn(void);
-void cpu_turn(void);
-void check_mandatory_play(Card *hand, int count, int *must_play);
-int find_valid_plays(Card *hand, int count, int *valid_indices);
-void next_player(void);
+int can_play_card(Game *game, Card c);
+int can_counter_attack(Game *game, Card c);
+int play_cards(Game *game, Card *hand, int *count, int *indices, int num_cards);
+void draw_cards(Game *game, Card *hand, int *count, int num);
+int apply_special_effects(Game *game, Card *cards, int num_cards);
+Await turn_start(Game *game);
+Await turn_resume(Game *game, int answer);
+void print_prompt(Game *game);
+void check_mandatory_play(Game *game, Card *hand, int count, int *must_play);
+int find_valid_plays(Game *game, Card *hand, int count, int *valid_indices);
+void next_player(Game *game);
 
 /* Clear screen */
 void clear_screen(void) {
@@ -68,62 +97,65 @@ void clear_screen(void) {
 }
 
 /* Initialize game */
-void init_game(void) {
-    int i, s, r, idx = 0;
+void init_game(Game *game) {
+    int s, r, idx = 0;
     
     /* Create deck - ranks 2-14, suits 0-3 */
     for (s = 0; s < 4; s++) {
         for (r = 2; r <= 14; r++) {
-            g.deck[idx].suit = s;
-            g.deck[idx].rank = r;
+            game->deck[idx].suit = s;
+            game->deck[idx].rank = r;
             idx++;
         }
     }
-    g.deck_count = 52;
+    game->deck_count = 52;
     
     /* Initialize state */
-    g.current_player = 0;
-    g.direction = 1;  /* Clockwise */
-    g.draw_penalty = 0;
-    g.skip_count = 0;
-    g.nominated_suit = -1;
-    g.game_over = 0;
+    game->current_player = 0;
+    game->direction = 1;  /* Clockwise */
+    game->draw_penalty = 0;
+    game->skip_count = 0;
+    game->nominated_suit = -1;
+    game->human[0] = 1;
+    game->human[1] = 0;
+    game->turn.await = AWAIT_NONE;
+    game->game_over = 0;
     
     /* Shuffle and deal */
-    shuffle_deck();
-    deal_cards();
+    shuffle_deck(game);
+    deal_cards(game);
     
     /* First card to discard (no effect) */
-    g.top_card = g.deck[--g.deck_count];
-    g.discard[0] = g.top_card;
-    g.discard_count = 1;
+    game->top_card = game->deck[--game->deck_count];
+    game->discard[0] = game->top_card;
+    game->discard_count = 1;
 }
 
 /* Shuffle deck */
-void shuffle_deck(void) {
+void shuffle_deck(Game *game) {
     int i, j;
     Card temp;
     
     srand((unsigned)time(NULL));
     
-    for (i = g.deck_count - 1; i > 0; i--) {
+    for (i = game->deck_count - 1; i > 0; i--) {
         j = rand() % (i + 1);
-        temp = g.deck[i];
-        g.deck[i] = g.deck[j];
-        g.deck[j] = temp;
+        temp = game->deck[i];
+        game->deck[i] = game->deck[j];
+        game->deck[j] = temp;
     }
 }
 
 /* Deal 7 cards to each player (for 2 players) */
-void deal_cards(void) {
+void deal_cards(Game *game) {
     int i;
     
-    g.player_count = 0;
-    g.cpu_count = 0;
+    game->player_count = 0;
+    game->cpu_count = 0;
     
     for (i = 0; i < 7; i++) {
-        g.player_hand[g.player_count++] = g.deck[--g.deck_count];
-        g.cpu_hand[g.cpu_count++] = g.deck[--g.deck_count];
+        game->player_hand[game->player_count++] = game->deck[--game->deck_count];
+        game->cpu_hand[game->cpu_count++] = game->deck[--game->deck_count];
     }
 }
 
@@ -154,30 +186,30 @@ void print_suit(int suit) {
 }
 
 /* Check if card can be played */
-int can_play_card(Card c) {
+int can_play_card(Game *game, Card c) {
     /* If there's a pending attack, special rules apply */
-    if (g.draw_penalty > 0) {
-        return can_counter_attack(c);
+    if (game->draw_penalty > 0) {
+        return can_counter_attack(game, c);
     }
     
     /* If suit was nominated by Ace */
-    if (g.nominated_suit >= 0) {
-        return (c.suit == g.nominated_suit || c.rank == 14); /* Match suit or play another Ace */
+    if (game->nominated_suit >= 0) {
+        return (c.suit == game->nominated_suit || c.rank == 14); /* Match suit or play another Ace */
     }
     
     /* Normal play: match rank or suit */
-    return (c.rank == g.top_card.rank || c.suit == g.top_card.suit);
+    return (c.rank == game->top_card.rank || c.suit == game->top_card.suit);
 }
 
 /* Check if card can counter current attack */
-int can_counter_attack(Card c) {
+int can_counter_attack(Game *game, Card c) {
     /* Pending draw from 2s */
-    if (g.top_card.rank == 2) {
+    if (game->top_card.rank == 2) {
         return c.rank == 2;  /* Only 2 can counter 2 */
     }
     
     /* Pending draw from Black Jack */
-    if (g.top_card.rank == 11 && g.top_card.suit >= 2) {  /* Black Jack */
+    if (game->top_card.rank == 11 && game->top_card.suit >= 2) {  /* Black Jack */
         /* Can play another Black Jack or Red Jack to reduce */
         return c.rank == 11;
     }
@@ -185,8 +217,9 @@ int can_counter_attack(Card c) {
     return 0;
 }
 
-/* Play cards (handles stacking) */
-void play_cards(Card *hand, int *count, int *indices, int num_cards) {
+/* Play cards (handles stacking). Returns the number of Aces played,
+ * whose suit the caller still has to nominate. */
+int play_cards(Game *game, Card *hand, int *count, int *indices, int num_cards) {
     int i, j;
     Card played[13];
     
@@ -205,16 +238,16 @@ void play_cards(Card *hand, int *count, int *indices, int num_cards) {
     
     /* Place on discard pile */
     for (i = 0; i < num_cards; i++) {
-        g.discard[g.discard_count++] = played[i];
+        game->discard[game->discard_count++] = played[i];
     }
-    g.top_card = played[num_cards - 1];
+    game->top_card = played[num_cards - 1];
     
     /* Apply special effects */
-    apply_special_effects(played, num_cards);
+    return apply_special_effects(game, played, num_cards);
 }
 
-/* Apply special card effects */
-void apply_special_effects(Card *cards, int num_cards) {
+/* Apply special card effects. Returns the number of Aces. */
+int apply_special_effects(Game *game, Card *cards, int num_cards) {
     int i;
     int black_jacks = 0, red_jacks = 0;
     int twos = 0, sevens = 0, queens = 0, aces = 0;
@@ -234,83 +267,74 @@ void apply_special_effects(Card *cards, int num_cards) {
     }
     
     /* Clear previous nomination */
-    g.nominated_suit = -1;
+    game->nominated_suit = -1;
     
     /* Apply effects */
     
     /* 2s - Draw two (stackable) */
     if (twos > 0) {
-        g.draw_penalty += twos * 2;
+        game->draw_penalty += twos * 2;
     }
     
     /* 7s - Skip turn (stackable) */
     if (sevens > 0) {
-        g.skip_count += sevens;
+        game->skip_count += sevens;
     }
     
     /* Jacks - Draw 5 or reduce */
     if (black_jacks > 0) {
-        g.draw_penalty += black_jacks * 5;
+        game->draw_penalty += black_jacks * 5;
     }
-    if (red_jacks > 0 && g.draw_penalty > 0) {
-        g.draw_penalty -= red_jacks * 5;
-        if (g.draw_penalty < 0) g.draw_penalty = 0;
+    if (red_jacks > 0 && game->draw_penalty > 0) {
+        game->draw_penalty -= red_jacks * 5;
+        if (game->draw_penalty < 0) game->draw_penalty = 0;
     }
     
     /* Queens - Reverse direction */
     if (queens > 0) {
         /* Each Queen reverses */
         for (i = 0; i < queens; i++) {
-            g.direction = -g.direction;
+            game->direction = -game->direction;
         }
     }
     
-    /* Aces - Nominate suit (only one nomination even if multiple aces) */
-    if (aces > 0) {
-        printf("\nChoose suit (H=0, D=1, C=2, S=3): ");
-        scanf("%d", &g.nominated_suit);
-        while (g.nominated_suit < 0 || g.nominated_suit > 3) {
-            printf("Invalid! Choose 0-3: ");
-            scanf("%d", &g.nominated_suit);
-        }
-        printf("Next play must be ");
-        print_suit(g.nominated_suit);
-        printf(" or an Ace\n");
-    }
+    /* Aces - Nominate suit (only one nomination even if multiple aces).
+     * The turn asks for the suit once the cards are down. */
+    return aces;
 }
 
 /* Draw cards */
-void draw_cards(Card *hand, int *count, int num) {
+void draw_cards(Game *game, Card *hand, int *count, int num) {
     int i;
     
     for (i = 0; i < num; i++) {
         /* Reshuffle if needed */
-        if (g.deck_count == 0) {
+        if (game->deck_count == 0) {
             int j;
-            Card saved = g.top_card;
+            Card saved = game->top_card;
             
             /* Move discard to deck (except top card) */
-            for (j = 0; j < g.discard_count - 1; j++) {
-                g.deck[j] = g.discard[j];
+            for (j = 0; j < game->discard_count - 1; j++) {
+                game->deck[j] = game->discard[j];
             }
-            g.deck_count = g.discard_count - 1;
+            game->deck_count = game->discard_count - 1;
             
             /* Reset discard */
-            g.discard[0] = saved;
-            g.discard_count = 1;
+            game->discard[0] = saved;
+            game->discard_count = 1;
             
-            shuffle_deck();
+            shuffle_deck(game);
         }
         
         /* Draw if possible */
-        if (g.deck_count > 0) {
-            hand[(*count)++] = g.deck[--g.deck_count];
+        if (game->deck_count > 0) {
+            hand[(*count)++] = game->deck[--game->deck_count];
         }
     }
 }
 
 /* Show game state */
-void show_game(void) {
+void show_game(Game *game) {
     int i;
     
     clear_screen();
@@ -320,43 +344,43 @@ void show_game(void) {
     printf("==============================\n\n");
     
     /* Game info */
-    printf("Direction: %s\n", g.direction > 0 ? "Clockwise" : "Counter-clockwise");
-    if (g.draw_penalty > 0) {
-        printf("PENDING: Draw %d cards!\n", g.draw_penalty);
+    printf("Direction: %s\n", game->direction > 0 ? "Clockwise" : "Counter-clockwise");
+    if (game->draw_penalty > 0) {
+        printf("PENDING: Draw %d cards!\n", game->draw_penalty);
     }
-    if (g.skip_count > 0) {
-        printf("PENDING: Skip %d turn(s)!\n", g.skip_count);
+    if (game->skip_count > 0) {
+        printf("PENDING: Skip %d turn(s)!\n", game->skip_count);
     }
-    if (g.nominated_suit >= 0) {
+    if (game->nominated_suit >= 0) {
         printf("Must play: ");
-        print_suit(g.nominated_suit);
+        print_suit(game->nominated_suit);
         printf(" or Ace\n");
     }
     printf("\n");
     
     /* CPU status */
-    printf("CPU: %d cards\n", g.cpu_count);
+    printf("CPU: %d cards\n", game->cpu_count);
     
     /* Top card */
     printf("Top: ");
-    print_card(g.top_card);
+    print_card(game->top_card);
     printf("\n");
     
     /* Deck */
-    printf("Deck: %d cards\n\n", g.deck_count);
+    printf("Deck: %d cards\n\n", game->deck_count);
     
     /* Player's hand */
-    printf("Your hand (%d cards):\n", g.player_count);
-    for (i = 0; i < g.player_count; i++) {
+    printf("Your hand (%d cards):\n", game->player_count);
+    for (i = 0; i < game->player_count; i++) {
         printf("%d.", i + 1);
-        print_card(g.player_hand[i]);
+        print_card(game->player_hand[i]);
         
         /* Mark special cards */
-        switch(g.player_hand[i].rank) {
+        switch(game->player_hand[i].rank) {
             case 2:  printf("(+2)"); break;
             case 7:  printf("(Skip)"); break;
-            case 11: 
-                if (g.player_hand[i].suit >= 2) printf("(+5)");
+            case 11:
+                if (game->player_hand[i].suit >= 2) printf("(+5)");
                 else printf("(-5)");
                 break;
             case 12: printf("(Rev)"); break;
@@ -370,12 +394,12 @@ void show_game(void) {
 }
 
 /* Check mandatory play rule */
-void check_mandatory_play(Card *hand, int count, int *must_play) {
+void check_mandatory_play(Game *game, Card *hand, int count, int *must_play) {
     int i;
     *must_play = 0;
     
     for (i = 0; i < count; i++) {
-        if (can_play_card(hand[i])) {
+        if (can_play_card(game, hand[i])) {
             *must_play = 1;
             return;
         }
@@ -383,11 +407,11 @@ void check_mandatory_play(Card *hand, int count, int *must_play) {
 }
 
 /* Find all valid plays */
-int find_valid_plays(Card *hand, int count, int *valid_indices) {
+int find_valid_plays(Game *game, Card *hand, int count, int *valid_indices) {
     int i, num_valid = 0;
     
     for (i = 0; i < count; i++) {
-        if (can_play_card(hand[i])) {
+        if (can_play_card(game, hand[i])) {
             valid_indices[num_valid++] = i;
         }
     }
@@ -396,234 +420,358 @@ int find_valid_plays(Card *hand, int count, int *valid_indices) {
 }
 
 /* Move to next player */
-void next_player(void) {
+void next_player(Game *game) {
     /* Handle skips */
-    if (g.skip_count > 0) {
-        g.skip_count--;
+    if (game->skip_count > 0) {
+        game->skip_count--;
         /* In 2-player, skip just returns to same player */
         return;
     }
     
     /* Normal turn change */
-    g.current_player = 1 - g.current_player;
+    game->current_player = 1 - game->current_player;
 }
 
-/* Player's turn */
-void player_turn(void) {
-    int must_play, num_valid, valid_indices[52];
-    int choice, i, num_to_play;
-    int cards_to_play[13], same_rank;
-    char input[100];
+/* Hand of the player to move */
+static Card *turn_hand(Game *game, int **count) {
+    if (game->current_player == 0) {
+        *count = &game->player_count;
+        return game->player_hand;
+    }
+    *count = &game->cpu_count;
+    return game->cpu_hand;
+}
+
+/* Wait for an answer */
+static Await turn_await(Game *game, Await await) {
+    game->turn.await = await;
+    return await;
+}
+
+/* Check for win, then hand over */
+static Await turn_end(Game *game) {
+    int *count;
     
-    /* Handle pending draw penalty */
-    if (g.draw_penalty > 0) {
-        /* Check if can counter */
-        num_valid = 0;
-        for (i = 0; i < g.player_count; i++) {
-            if (can_counter_attack(g.player_hand[i])) {
-                valid_indices[num_valid++] = i;
-            }
+    turn_hand(game, &count);
+    if (*count == 0) {
+        printf(game->current_player == 0 ? "\nYOU WIN!\n" : "\nCPU WINS!\n");
+        game->game_over = 1;
+    }
+    
+    if (!game->game_over) {
+        next_player(game);
+    }
+    return turn_await(game, AWAIT_NONE);
+}
+
+/* Next card after index from that matches the stack's rank */
+static int turn_next_offer(Game *game, int from) {
+    Card *hand;
+    int *count, i;
+    
+    hand = turn_hand(game, &count);
+    for (i = from + 1; i < *count; i++) {
+        if (i != game->turn.cards[0] && hand[i].rank == hand[game->turn.cards[0]].rank) {
+            return i;
         }
-        
-        if (num_valid > 0) {
-            printf("Counter attack? (card # or 0 to accept penalty): ");
-            scanf("%d", &choice);
-            
-            if (choice > 0 && choice <= g.player_count) {
-                if (can_counter_attack(g.player_hand[choice - 1])) {
-                    cards_to_play[0] = choice - 1;
-                    play_cards(g.player_hand, &g.player_count, cards_to_play, 1);
-                    return;
-                }
+    }
+    return -1;
+}
+
+/* Put the chosen cards down, then ask for a suit if any was an Ace */
+static Await turn_play(Game *game) {
+    Card *hand;
+    int *count;
+    
+    hand = turn_hand(game, &count);
+    if (play_cards(game, hand, count, game->turn.cards, game->turn.num_cards) == 0) {
+        return turn_end(game);
+    }
+    
+    if (game->human[game->current_player]) {
+        return turn_await(game, AWAIT_SUIT);
+    }
+    
+    game->nominated_suit = rand() % 4;
+    printf("CPU nominates ");
+    print_suit(game->nominated_suit);
+    printf("\n");
+    return turn_end(game);
+}
+
+/* CPU turn (simple AI), start to finish */
+static Await cpu_turn(Game *game) {
+    Card *hand;
+    int *count, i, j, must_play;
+    
+    printf("CPU thinking...\n");
+    hand = turn_hand(game, &count);
+    game->turn.num_cards = 0;
+    
+    /* Handle pending draw penalty */
+    if (game->draw_penalty > 0) {
+        /* Try to counter */
+        for (i = 0; i < *count; i++) {
+            if (can_counter_attack(game, hand[i])) {
+                printf("CPU counters with ");
+                print_card(hand[i]);
+                printf("\n");
+                game->turn.cards[game->turn.num_cards++] = i;
+                return turn_play(game);
             }
         }
         
         /* Accept penalty */
-        printf("Drawing %d cards...\n", g.draw_penalty);
-        draw_cards(g.player_hand, &g.player_count, g.draw_penalty);
-        g.draw_penalty = 0;
-        getchar(); /* Wait */
-        /* Continue turn after drawing! */
+        printf("CPU draws %d cards\n", game->draw_penalty);
+        draw_cards(game, hand, count, game->draw_penalty);
+        game->draw_penalty = 0;
+        /* Continue turn! */
     }
     
-    /* Check for mandatory play */
-    check_mandatory_play(g.player_hand, g.player_count, &must_play);
+    /* Check mandatory play */
+    check_mandatory_play(game, hand, *count, &must_play);
     
     if (must_play) {
-        printf("You MUST play (mandatory rule). Choose card: ");
-        
-        /* Find valid plays */
-        num_valid = find_valid_plays(g.player_hand, g.player_count, valid_indices);
-        
-        /* Show valid options */
-        printf("\nValid plays: ");
-        for (i = 0; i < num_valid; i++) {
-            printf("%d ", valid_indices[i] + 1);
-        }
-        printf("\n");
-        
-        /* Get choice */
-        scanf("%d", &choice);
-        choice--;  /* Convert to 0-based */
-        
-        /* Check for stacking */
-        same_rank = g.player_hand[choice].rank;
-        num_to_play = 0;
-        cards_to_play[num_to_play++] = choice;
-        
-        printf("Stack same rank? (y/n): ");
-        scanf("%s", input);
-        
-        if (input[0] == 'y' || input[0] == 'Y') {
-            for (i = 0; i < g.player_count; i++) {
-                if (i != choice && g.player_hand[i].rank == same_rank) {
-                    printf("Also play card %d (", i + 1);
-                    print_card(g.player_hand[i]);
-                    printf(")? (y/n): ");
-                    scanf("%s", input);
-                    if (input[0] == 'y' || input[0] == 'Y') {
-                        cards_to_play[num_to_play++] = i;
-                    }
-                }
-            }
+        /* Find first valid play (simple AI) */
+        for (i = 0; !can_play_card(game, hand[i]); i++) {
         }
+        printf("CPU plays ");
+        print_card(hand[i]);
         
-        /* Play the cards */
-        play_cards(g.player_hand, &g.player_count, cards_to_play, num_to_play);
-        
-    } else {
-        /* Must draw */
-        printf("No valid plays. Drawing card...\n");
-        draw_cards(g.player_hand, &g.player_count, 1);
-        getchar(); /* Wait */
-        
-        /* Check if new card can be played */
-        if (can_play_card(g.player_hand[g.player_count - 1])) {
-            printf("New card can be played! Play it? (y/n): ");
-            scanf("%s", input);
-            if (input[0] == 'y' || input[0] == 'Y') {
-                cards_to_play[0] = g.player_count - 1;
-                play_cards(g.player_hand, &g.player_count, cards_to_play, 1);
+        /* Simple stacking - play all of same rank */
+        game->turn.cards[game->turn.num_cards++] = i;
+        for (j = i + 1; j < *count; j++) {
+            if (hand[j].rank == hand[i].rank) {
+                printf(" + ");
+                print_card(hand[j]);
+                game->turn.cards[game->turn.num_cards++] = j;
             }
         }
+        printf("\n");
+        return turn_play(game);
     }
     
-    /* Check for win */
-    if (g.player_count == 0) {
-        printf("\nYOU WIN!\n");
-        g.game_over = 1;
+    /* Must draw */
+    printf("CPU draws a card\n");
+    draw_cards(game, hand, count, 1);
+    
+    /* Try to play new card */
+    if (*count > 0 && can_play_card(game, hand[*count - 1])) {
+        printf("CPU plays drawn card: ");
+        print_card(hand[*count - 1]);
+        printf("\n");
+        game->turn.cards[game->turn.num_cards++] = *count - 1;
+        return turn_play(game);
     }
+    return turn_end(game);
 }
 
-/* CPU turn (simple AI) */
-void cpu_turn(void) {
-    int i, must_play, played = 0;
-    int cards_to_play[13], num_to_play;
+/* Past any counter: play if able, draw if not */
+static Await turn_mandatory(Game *game) {
+    Card *hand;
+    int *count, must_play;
     
-    printf("CPU thinking...\n");
+    hand = turn_hand(game, &count);
+    check_mandatory_play(game, hand, *count, &must_play);
+    if (must_play) {
+        return turn_await(game, AWAIT_CARD);
+    }
+    
+    /* Must draw */
+    printf("No valid plays. Drawing card...\n");
+    draw_cards(game, hand, count, 1);
+    
+    /* Check if new card can be played */
+    if (*count > 0 && can_play_card(game, hand[*count - 1])) {
+        return turn_await(game, AWAIT_PLAY_DRAWN);
+    }
+    return turn_end(game);
+}
+
+/* Start the turn of the player to move. Runs until it needs an answer
+ * (see Await) or the turn is over (AWAIT_NONE). */
+Await turn_start(Game *game) {
+    Card *hand;
+    int *count, i;
+    
+    game->turn.num_cards = 0;
+    game->turn.refused = 0;
+    if (!game->human[game->current_player]) {
+        return cpu_turn(game);
+    }
     
     /* Handle pending draw penalty */
-    if (g.draw_penalty > 0) {
-        /* Try to counter */
-        for (i = 0; i < g.cpu_count; i++) {
-            if (can_counter_attack(g.cpu_hand[i])) {
-                printf("CPU counters with ");
-                print_card(g.cpu_hand[i]);
-                printf("\n");
-                cards_to_play[0] = i;
-                play_cards(g.cpu_hand, &g.cpu_count, cards_to_play, 1);
-                played = 1;
-                break;
+    if (game->draw_penalty > 0) {
+        /* Check if can counter */
+        hand = turn_hand(game, &count);
+        for (i = 0; i < *count; i++) {
+            if (can_counter_attack(game, hand[i])) {
+                return turn_await(game, AWAIT_COUNTER);
             }
         }
         
-        if (!played) {
+        /* Accept penalty */
+        printf("Drawing %d cards...\n", game->draw_penalty);
+        draw_cards(game, hand, count, game->draw_penalty);
+        game->draw_penalty = 0;
+        /* Continue turn after drawing! */
+    }
+    return turn_mandatory(game);
+}
+
+/* Answer what the turn is waiting for and run on to the next question
+ * or the end of the turn. An answer that does not fit asks again, with
+ * turn.refused set. */
+Await turn_resume(Game *game, int answer) {
+    Card *hand;
+    int *count;
+    
+    hand = turn_hand(game, &count);
+    game->turn.refused = 0;
+    
+    switch (game->turn.await) {
+        case AWAIT_COUNTER:
+            if (answer > 0 && answer <= *count && can_counter_attack(game, hand[answer - 1])) {
+                game->turn.cards[game->turn.num_cards++] = answer - 1;
+                return turn_play(game);
+            }
+            
             /* Accept penalty */
-            printf("CPU draws %d cards\n", g.draw_penalty);
-            draw_cards(g.cpu_hand, &g.cpu_count, g.draw_penalty);
-            g.draw_penalty = 0;
-            /* Continue turn! */
-        } else {
-            return;
-        }
+            printf("Drawing %d cards...\n", game->draw_penalty);
+            draw_cards(game, hand, count, game->draw_penalty);
+            game->draw_penalty = 0;
+            return turn_mandatory(game);
+        
+        case AWAIT_CARD:
+            if (answer < 1 || answer > *count || !can_play_card(game, hand[answer - 1])) {
+                game->turn.refused = 1;
+                return AWAIT_CARD;
+            }
+            game->turn.cards[game->turn.num_cards++] = answer - 1;
+            
+            /* Check for stacking */
+            if (turn_next_offer(game, -1) >= 0) {
+                return turn_await(game, AWAIT_STACK);
+            }
+            return turn_play(game);
+        
+        case AWAIT_STACK:
+            game->turn.offer = answer ? turn_next_offer(game, -1) : -1;
+            if (game->turn.offer >= 0) {
+                return turn_await(game, AWAIT_STACK_CARD);
+            }
+            return turn_play(game);
+        
+        case AWAIT_STACK_CARD:
+            if (answer) {
+                game->turn.cards[game->turn.num_cards++] = game->turn.offer;
+            }
+            game->turn.offer = turn_next_offer(game, game->turn.offer);
+            if (game->turn.offer >= 0) {
+                return AWAIT_STACK_CARD;
+            }
+            return turn_play(game);
+        
+        case AWAIT_SUIT:
+            if (answer < 0 || answer > 3) {
+                game->turn.refused = 1;
+                return AWAIT_SUIT;
+            }
+            game->nominated_suit = answer;
+            printf("Next play must be ");
+            print_suit(game->nominated_suit);
+            printf(" or an Ace\n");
+            return turn_end(game);
+        
+        case AWAIT_PLAY_DRAWN:
+            if (answer) {
+                game->turn.cards[game->turn.num_cards++] = *count - 1;
+                return turn_play(game);
+            }
+            return turn_end(game);
+        
+        case AWAIT_NONE:
+            break;
     }
+    return AWAIT_NONE;
+}
+
+/* Ask what the turn is waiting for */
+void print_prompt(Game *game) {
+    Card *hand;
+    int *count, i, num_valid, valid_indices[52];
     
-    /* Check mandatory play */
-    check_mandatory_play(g.cpu_hand, g.cpu_count, &must_play);
+    hand = turn_hand(game, &count);
+    if (game->turn.refused) {
+        printf("Invalid! ");
+    }
     
-    if (must_play) {
-        /* Find first valid play (simple AI) */
-        for (i = 0; i < g.cpu_count; i++) {
-            if (can_play_card(g.cpu_hand[i])) {
-                printf("CPU plays ");
-                print_card(g.cpu_hand[i]);
-                
-                /* Simple stacking - play all of same rank */
-                num_to_play = 0;
-                cards_to_play[num_to_play++] = i;
-                
-                /* Look for same rank to stack */
-                int rank = g.cpu_hand[i].rank;
-                int j;
-                for (j = i + 1; j < g.cpu_count; j++) {
-                    if (g.cpu_hand[j].rank == rank) {
-                        printf(" + ");
-                        print_card(g.cpu_hand[j]);
-                        cards_to_play[num_to_play++] = j;
-                    }
-                }
-                
-                printf("\n");
-                play_cards(g.cpu_hand, &g.cpu_count, cards_to_play, num_to_play);
-                
-                /* Handle Ace nomination */
-                if (rank == 14) {
-                    g.nominated_suit = rand() % 4;
-                    printf("CPU nominates ");
-                    print_suit(g.nominated_suit);
-                    printf("\n");
-                }
-                
-                played = 1;
-                break;
-            }
-        }
-    } else {
-        /* Must draw */
-        printf("CPU draws a card\n");
-        draw_cards(g.cpu_hand, &g.cpu_count, 1);
+    switch (game->turn.await) {
+        case AWAIT_COUNTER:
+            printf("Counter attack? (card # or 0 to accept penalty): ");
+            break;
         
-        /* Try to play new card */
-        if (can_play_card(g.cpu_hand[g.cpu_count - 1])) {
-            printf("CPU plays drawn card: ");
-            print_card(g.cpu_hand[g.cpu_count - 1]);
-            printf("\n");
-            cards_to_play[0] = g.cpu_count - 1;
-            play_cards(g.cpu_hand, &g.cpu_count, cards_to_play, 1);
+        case AWAIT_CARD:
+            printf("You MUST play (mandatory rule). Choose card: ");
             
-            /* Handle Ace */
-            if (g.cpu_hand[g.cpu_count - 1].rank == 14) {
-                g.nominated_suit = rand() % 4;
-                printf("CPU nominates ");
-                print_suit(g.nominated_suit);
-                printf("\n");
+            /* Show valid options */
+            num_valid = find_valid_plays(game, hand, *count, valid_indices);
+            printf("\nValid plays: ");
+            for (i = 0; i < num_valid; i++) {
+                printf("%d ", valid_indices[i] + 1);
             }
-        }
+            printf("\n");
+            break;
+        
+        case AWAIT_STACK:
+            printf("Stack same rank? (y/n): ");
+            break;
+        
+        case AWAIT_STACK_CARD:
+            printf("Also play card %d (", game->turn.offer + 1);
+            print_card(hand[game->turn.offer]);
+            printf(")? (y/n): ");
+            break;
+        
+        case AWAIT_SUIT:
+            printf("\nChoose suit (H=0, D=1, C=2, S=3): ");
+            break;
+        
+        case AWAIT_PLAY_DRAWN:
+            printf("New card can be played! Play it? (y/n): ");
+            break;
+        
+        case AWAIT_NONE:
+            break;
     }
+}
+
+#ifndef RACHEL_CORRECT_ENGINE
+/* Read the answer to a prompt: y/n as 1/0, anything else as a number
+ * (-1 if it is not one). Returns 0 at end of input. */
+static int read_answer(Await await, int *answer) {
+    char input[100];
+    char *end;
     
-    /* Check for win */
-    if (g.cpu_count == 0) {
-        printf("\nCPU WINS!\n");
-        g.game_over = 1;
+    if (fgets(input, sizeof(input), stdin) == NULL) {
+        return 0;
     }
     
-    printf("Press Enter to continue...");
-    getchar();
-    getchar();
+    if (await == AWAIT_STACK || await == AWAIT_STACK_CARD || await == AWAIT_PLAY_DRAWN) {
+        *answer = (input[0] == 'y' || input[0] == 'Y');
+    } else {
+        *answer = (int)strtol(input, &end, 10);
+        if (end == input) *answer = -1;
+    }
+    return 1;
 }
 
 /* Main game */
 int main(void) {
+    static Game game;
+    Await await;
+    int answer, seat;
+    
     clear_screen();
     printf("RACHEL - The REAL Card Game\n");
     printf("DOS Edition with CORRECT RULES\n\n");
@@ -638,20 +786,25 @@ int main(void) {
     printf("Press Enter to start...");
     getchar();
     
-    init_game();
+    init_game(&game);
     
     /* Game loop */
-    while (!g.game_over) {
-        show_game();
+    while (!game.game_over) {
+        show_game(&game);
         
-        if (g.current_player == 0) {
-            player_turn();
-        } else {
-            cpu_turn();
+        seat = game.current_player;
+        await = turn_start(&game);
+        while (await != AWAIT_NONE) {
+            print_prompt(&game);
+            if (!read_answer(await, &answer)) {
+                return 0;
+            }
+            await = turn_resume(&game, answer);
         }
         
-        if (!g.game_over) {
-            next_player();
+        if (!game.human[seat]) {
+            printf("Press Enter to continue...");
+            getchar();
         }
     }
     
@@ -659,4 +812,5 @@ int main(void) {
     getchar();
     
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,263 @@
+/*
+ * RACHEL ENDGAME GRADER
+ *
+ * Plays seeded games with one AI policy until few cards are left in
+ * hand, then solves every decision from there with all cards face up
+ * (solver.h). Where the player to move had a forced win, it checks the
+ * policy's move still wins - the same ground truth a chess engine gives
+ * a tablebase. Reports how often the policy kept its wins and how fast
+ * the solver went.
+ *
+ * "Knowing you have lost is the first step to playing better."
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rules.h"
+#include "ai.h"
+#include "solver.h"
+
+#define GRADE_DEFAULT_GAMES   20UL
+#define GRADE_DEFAULT_CARDS   8
+
+typedef struct {
+    unsigned long   games;
+    uint8_t         players;
+    uint8_t         cards;        /* Solve once hands hold this many in all */
+    uint64_t        seed;
+    const AiPolicy* policy;
+    SolverConfig    solver;
+} GradeConfig;
+
+typedef struct {
+    unsigned long positions;
+    unsigned long values[3];      /* By SolveValue + 1 */
+    unsigned long out_of_nodes;
+    unsigned long kept;           /* Won, and the policy's move still wins */
+    unsigned long thrown;         /* Won, and the policy's move does not */
+    unsigned long unclear;
+    uint64_t      nodes;
+    uint64_t      table_hits;
+    double        elapsed_ms;
+} GradeStats;
+
+static void grade_usage(const char* program) {
+    const AiPolicy* policy;
+
+    printf("Usage: %s [-g games] [-p players] [-c cards] [-a policy] [-s seed]\n"
+           "       [-n nodes] [-t turns] [-j threads]\n", program);
+    printf("  -g games    Number of games (default %lu)\n", GRADE_DEFAULT_GAMES);
+    printf("  -p players  Players per game, 2-%d (default 2)\n", MAX_PLAYERS);
+    printf("  -c cards    Solve once this few cards are left in hand (default %d)\n",
+           GRADE_DEFAULT_CARDS);
+    printf("  -a policy   Policy to play and grade (default suit)\n");
+    printf("  -s seed     Base seed, game i uses stream i (default 1)\n");
+    printf("  -n nodes    Node budget per solve, 0 = none (default 1000000)\n");
+    printf("  -t turns    Deepest search in turns, 1-%d (default 64)\n",
+           SOLVER_MAX_TURNS);
+    printf("  -j threads  Threads sharing the table, 1-%d (default 1)\n",
+           SOLVER_MAX_THREADS);
+    printf("\nPolicies:\n");
+    for (policy = rachel_ai_policies; policy->name; policy++) {
+        printf("  %-8s %s\n", policy->name, policy->description);
+    }
+}
+
+static bool_t grade_parse_args(int argc, char** argv, GradeConfig* config) {
+    int i;
+
+    config->games = GRADE_DEFAULT_GAMES;
+    config->players = 2;
+    config->cards = GRADE_DEFAULT_CARDS;
+    config->seed = 1;
+    config->policy = rachel_ai_find("suit");
+    rachel_solver_default_config(&config->solver);
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "-g") == 0) {
+            config->games = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+            config->players = (uint8_t)atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            config->cards = (uint8_t)atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-a") == 0) {
+            config->policy = rachel_ai_find(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            config->seed = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+            config->solver.max_nodes = strtoull(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            config->solver.max_turns = (uint8_t)atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+            config->solver.threads = (uint8_t)atoi(argv[++i]);
+        } else {
+            return FALSE;
+        }
+    }
+
+    return config->games > 0 && config->policy != NULL && config->cards > 0 &&
+           config->players >= 2 && config->players <= MAX_PLAYERS &&
+           config->solver.max_turns >= 1 &&
+           config->solver.max_turns <= SOLVER_MAX_TURNS &&
+           config->solver.threads >= 1 &&
+           config->solver.threads <= SOLVER_MAX_THREADS;
+}
+
+static uint8_t grade_cards_in_hand(const Game* game) {
+    uint8_t i, total = 0;
+
+    for (i = 0; i < game->player_count; i++) {
+        total += game->players[i].hand_count;
+    }
+    return total;
+}
+
+/* The policy's move as a Move, overruled like rachel_ai_take_turn */
+static void grade_policy_move(const Game* game, const AiPolicy* policy,
+                              RachelRng* rng, Move* move) {
+    uint8_t player_id = game->current_player_index;
+    uint64_t valid = rachel_valid_plays_mask(game, player_id);
+    Game check;
+    AiPlay play;
+
+    memset(move, 0, sizeof(*move));
+    if (valid == 0) {
+        move->type = MOVE_PASS;
+        return;
+    }
+    play.count = 0;
+    play.nominated_suit = SUIT_HEARTS;
+    policy->choose(game, player_id, rng, &play);
+
+    check = *game;
+    move->type = MOVE_PLAY;
+    if (play.count > 0 && play.count <= RACHEL_MAX_PLAY &&
+        rachel_play_cards(&check, player_id, play.cards, play.count,
+                          play.nominated_suit)) {
+        memcpy(move->cards, play.cards, play.count * sizeof(Card));
+        move->count = play.count;
+        move->nominated_suit = play.nominated_suit;
+    } else {
+        move->cards[0] = rachel_card_from_index(RACHEL_MASK_LOWEST(valid));
+        move->count = 1;
+        move->nominated_suit = SUIT_HEARTS;
+    }
+}
+
+static void grade_add(GradeStats* stats, const SolverResult* result) {
+    stats->nodes += result->nodes;
+    stats->table_hits += result->table_hits;
+    stats->elapsed_ms += result->elapsed_ms;
+    stats->out_of_nodes += result->out_of_nodes;
+}
+
+static void grade_game(const GradeConfig* config, unsigned long index,
+                       SolverTable* table, GradeStats* stats) {
+    Move moves[SOLVER_MAX_MOVES], move;
+    SolverResult result, after;
+    MoveUndo undo;
+    RachelRng rng;
+    Game game, child;
+    uint8_t seat, i;
+
+    rachel_init_game(&game, config->players);
+    for (i = 0; i < config->players; i++) {
+        rachel_add_player(&game, "Grader", TRUE);
+    }
+    rachel_seed_game(&game, config->seed, index);
+    rachel_rng_seed(&rng, ~config->seed, index);
+    rachel_start_game(&game);
+    rachel_solver_table_clear(table);
+
+    while (game.winner_count == 0 && game.turn_count < 2000) {
+        rachel_ai_take_turn(&game, config->policy, &rng);
+        if (grade_cards_in_hand(&game) <= config->cards) {
+            break;
+        }
+    }
+
+    while (game.winner_count == 0 && game.turn_count < 2000) {
+        seat = game.current_player_index;
+        grade_policy_move(&game, config->policy, &rng, &move);
+
+        /* Only real decisions are graded */
+        if (rachel_solver_moves(&game, moves) > 1 &&
+            rachel_solve(&game, seat, &config->solver, table, &result)) {
+            stats->positions++;
+            stats->values[result.value + 1]++;
+            grade_add(stats, &result);
+
+            if (result.value == SOLVE_WIN) {
+                child = game;
+                rachel_make_move(&child, &move, &undo);
+                if (child.winner_count > 0) {
+                    stats->kept += child.players[seat].finish_position == 1;
+                    stats->thrown += child.players[seat].finish_position != 1;
+                } else if (rachel_solve(&child, seat, &config->solver, table, &after)) {
+                    grade_add(stats, &after);
+                    stats->kept += after.value == SOLVE_WIN;
+                    stats->thrown += after.value == SOLVE_LOSS;
+                    stats->unclear += after.value == SOLVE_UNKNOWN;
+                }
+            }
+        }
+        rachel_make_move(&game, &move, &undo);
+    }
+}
+
+static double grade_percent(unsigned long part, unsigned long whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+int main(int argc, char** argv) {
+    GradeConfig config;
+    GradeStats stats;
+    SolverTable table;
+    unsigned long i;
+    double seconds;
+
+    if (!grade_parse_args(argc, argv, &config)) {
+        grade_usage(argv[0]);
+        return 2;
+    }
+    if (!rachel_self_test() || !rachel_solver_self_test()) {
+        printf("Self test failed! The cards refuse to be dealt.\n");
+        return 1;
+    }
+    if (!rachel_solver_table_init(&table, config.solver.table_bits)) {
+        printf("Out of memory for the table\n");
+        return 1;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    for (i = 0; i < config.games; i++) {
+        grade_game(&config, i, &table, &stats);
+    }
+    rachel_solver_table_free(&table);
+
+    seconds = stats.elapsed_ms / 1000.0;
+    printf("Rachel endgame grader (rules %s)\n", rachel_version());
+    printf("Players:     %u\n", config.players);
+    printf("Policy:      %s\n", config.policy->name);
+    printf("Games:       %lu, solved from %u cards in hand\n", config.games, config.cards);
+    printf("Positions:   %lu (win %lu, loss %lu, unknown %lu, %lu out of nodes)\n",
+           stats.positions, stats.values[SOLVE_WIN + 1], stats.values[SOLVE_LOSS + 1],
+           stats.values[SOLVE_UNKNOWN + 1], stats.out_of_nodes);
+    printf("Won:         kept %lu (%.1f%%), thrown away %lu, unclear %lu\n",
+           stats.kept, grade_percent(stats.kept, stats.values[SOLVE_WIN + 1]),
+           stats.thrown, stats.unclear);
+    printf("Nodes:       %llu (%.0f nodes/sec, %.1f%% table hits)\n",
+           (unsigned long long)stats.nodes, seconds > 0 ? stats.nodes / seconds : 0.0,
+           stats.nodes ? 100.0 * stats.table_hits / stats.nodes : 0.0);
+    printf("Solve time:  %.3f s\n", seconds);
+    return 0;
+}
+
+/*
+ * End of grader.
+ *
+ * Every won game a bot throws away is a lesson with an answer key.
+ */
@@ -3,38 +3,38 @@
  * 
  * A version that compiles on modern systems for testing
  * Before we build the real DOS version
+ *
+ * Keyboard input comes through the event layer in input.c: the
+ * terminal goes raw once and the game loop drains a queue of keys.
  */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include "rules.h"
+#include "input.h"
 
 #ifdef _WIN32
     #include <conio.h>
 #else
-    /* Unix/Mac compatibility */
-    #include <termios.h>
-    #include <unistd.h>
-    
-    int getch(void) {
-        struct termios oldattr, newattr;
-        int ch;
-        tcgetattr(STDIN_FILENO, &oldattr);
-        newattr = oldattr;
-        newattr.c_lflag &= ~(ICANON | ECHO);
-        tcsetattr(STDIN_FILENO, TCSANOW, &newattr);
-        ch = getchar();
-        tcsetattr(STDIN_FILENO, TCSANOW, &oldattr);
-        return ch;
-    }
-    
     void clrscr(void) {
         printf("\033[2J\033[H");
     }
 #endif
 
+/* Block until a key arrives */
+int getch(void) {
+    int key;
+    
+    while ((key = input_next()) == KEY_NONE) {
+        input_poll(-1);
+    }
+    return key;
+}
+
 /* Game state */
 typedef struct {
     Card deck[52];
@@ -195,40 +195,42 @@ int can_play_card(Card card) {
             card.rank == EIGHT); /* 8s are wild */
 }
 
+/* Drain the key queue until a key ends the turn; keys typed ahead of
+ * that stay queued for the next one */
 void player_turn(void) {
-    char input;
+    int input;
     int choice;
-    int valid = 0;
     
-    while (!valid) {
-        input = getch();
-        
-        if (input == 'q' || input == 'Q') {
-            game.game_over = 1;
-            return;
-        }
-        
-        if (input == 'd' || input == 'D') {
-            draw_card(game.player_hand, &game.player_count);
-            game.current_player = 1;
-            return;
-        }
-        
-        if (input >= '1' && input <= '9') {
-            choice = input - '1';
-            if (choice < game.player_count) {
-                if (can_play_card(game.player_hand[choice])) {
-                    if (play_card(game.player_hand, &game.player_count, choice)) {
-                        if (game.player_count == 0) {
-                            printf("\nYOU WIN!\n");
-                            game.game_over = 1;
-                        } else {
-                            game.current_player = 1;
+    for (;;) {
+        input_poll(-1);
+        while ((input = input_next()) != KEY_NONE) {
+            if (input == 'q' || input == 'Q' || input == KEY_ESCAPE) {
+                game.game_over = 1;
+                return;
+            }
+            
+            if (input == 'd' || input == 'D') {
+                draw_card(game.player_hand, &game.player_count);
+                game.current_player = 1;
+                return;
+            }
+            
+            if (input >= '1' && input <= '9') {
+                choice = input - '1';
+                if (choice < game.player_count) {
+                    if (can_play_card(game.player_hand[choice])) {
+                        if (play_card(game.player_hand, &game.player_count, choice)) {
+                            if (game.player_count == 0) {
+                                printf("\nYOU WIN!\n");
+                                game.game_over = 1;
+                            } else {
+                                game.current_player = 1;
+                            }
+                            return;
                         }
-                        return;
+                    } else {
+                        printf("\nCan't play that card! Try again: ");
                     }
-                } else {
-                    printf("\nCan't play that card! Try again: ");
                 }
             }
         }
@@ -301,6 +303,8 @@ void draw_card(Card *hand, int *count) {
 }
 
 int main(void) {
+    input_start();
+    
     printf("RACHEL - DOS Edition (Portable Test Build)\n");
     printf("=========================================\n\n");
     printf("Press any key to start...\n");
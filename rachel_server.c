@@ -0,0 +1,1246 @@
+/*
+ * RACHEL TABLE SERVER
+ *
+ * One process, one thread, one epoll set, thousands of tables.
+ * Clients speak short frames (protocol.h): they JOIN a table shape,
+ * are seated as tables fill, and send PLAY frames on their turn. Every
+ * play is checked with rachel_can_play_card and rachel_play_cards
+ * before it touches the game; everything else is pushed back as STATE.
+ * After the first STATE of a game each client gets DELTA frames, only
+ * what changed since the view it last got; RESYNC sends the whole view.
+ *
+ * Turns with no decision in them - bots, forced draws and penalties -
+ * are played here straight away, so a client only hears from us when
+ * something changed and only waits on the network when it must choose.
+ *
+ * Replies are queued per connection and written once per epoll batch.
+ * A client that stops reading loses its seat to a bot instead of
+ * holding up the table.
+ *
+ * With -l every table's game goes to an event log for rachel_replay,
+ * written whole when the table closes. With -c the same records are
+ * followed into game statistics (stats.h), written as CSV on exit.
+ *
+ * Spectators WATCH a table by id and follow it game after game. Each
+ * public view is encoded once into a reference-counted WatchFrame that
+ * every spectator's writev points at; nothing is copied per spectator.
+ * A spectator holds at most two frames, the one being written and the
+ * newest: a newer view replaces one not yet started, and a spectator
+ * that takes nothing for SERVER_WATCH_STALLS views is dropped.
+ *
+ * -a takes a list of bot policies, dealt out one per table in turn.
+ * When one of them can read a Knowledge tracker, each table keeps one
+ * per seat, fed from its event log before every bot decision.
+ * Every bot decision is timed. With -S a decision slower than the SLA
+ * hands that table's bot seats to the "first" policy for the rest of
+ * the game.
+ *
+ * "Pull up a chair. There is always another table."
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "rules.h"
+#include "ai.h"
+#include "protocol.h"
+#include "eventlog.h"
+#include "knowledge.h"
+#include "stats.h"
+
+/* Defaults */
+#define SERVER_DEFAULT_TABLES   4096
+#define SERVER_MAX_TURNS        2000UL   /* Same cap as rachel_sim */
+#define SERVER_OUT_FRAMES       64       /* Queued per connection */
+#define SERVER_MAX_EVENTS       256
+#define SERVER_READ_FRAMES      64
+#define SERVER_WATCH_BLOCK      256      /* WatchFrames allocated at a time */
+#define SERVER_WATCH_STALLS     64       /* Views skipped before a drop */
+
+/* Run configuration */
+typedef struct {
+    uint16_t        port;
+    uint32_t        tables;
+    unsigned long   seed;          /* Table game n plays stream n */
+    const AiPolicy* bots[MAX_PLAYERS];
+    uint8_t         bot_count;     /* Game n's bots: bots[n % bot_count] */
+    const AiPolicy* fallback;      /* Takes over a bot that breaks the SLA */
+    bool_t          observe;       /* A bot reads what its seat has seen */
+    uint64_t        sla_ns;        /* Per-decision budget, 0 for none */
+    bool_t          quiet;
+    const char*     log_path;      /* Event log to append to, or NULL */
+    const char*     stats_path;    /* Game statistics CSV, or NULL */
+} ServerConfig;
+
+/* One public view, shared by every spectator of its table */
+typedef struct WatchFrame {
+    uint32_t           refs;            /* The table's latest, plus writers */
+    struct WatchFrame* next_free;
+    uint8_t            frame[NET_FRAME_SIZE];
+} WatchFrame;
+
+/* One client connection */
+typedef struct {
+    int      fd;
+    uint8_t  in[NET_FRAME_SIZE];       /* Partial frame */
+    uint8_t  in_len;
+    uint8_t  out[SERVER_OUT_FRAMES * NET_FRAME_SIZE];
+    uint32_t out_start, out_end;       /* Unsent bytes */
+    uint32_t seq;
+    int32_t  table;                    /* -1 when not seated */
+    uint8_t  seat;
+    NetState view;                     /* Last view sent, deltas start here */
+    bool_t   synced;                   /* view is this game's */
+    bool_t   dirty;                    /* On the flush list */
+    bool_t   dead;                     /* Close at the next flush */
+    bool_t   polling_out;              /* EPOLLOUT is armed */
+    int32_t  watching;                 /* Table spectated, -1 for none */
+    int      watch_prev, watch_next;   /* Its spectator list, by fd */
+    WatchFrame* sending;               /* Partly written view */
+    uint8_t  sent;                     /* Bytes of it written */
+    WatchFrame* pending;               /* Newest view, not started */
+    uint32_t stalls;                   /* Views skipped since the last write */
+} ServerConn;
+
+/* One table. Seats are humans in join order, then bots. */
+typedef struct {
+    Game      game;
+    int       fds[MAX_PLAYERS];        /* -1 = played by the server */
+    uint8_t   players, bots;
+    uint8_t   seated;                  /* Humans who joined */
+    uint8_t   humans;                  /* Still connected */
+    bool_t    playing;
+    RachelRng bot_rng;
+    uint8_t   bot;                     /* Index into bots, or bot_count */
+    EventLog  log;
+    Knowledge know[MAX_PLAYERS];       /* Each seat's, fed from log */
+    uint32_t  known;                   /* Log records they have seen */
+    int       watchers;                /* First spectator's fd, or -1 */
+    uint32_t  watch_count;
+    uint32_t  views;                   /* Public views so far, their seq */
+    WatchFrame* latest;                /* Newest view while watched, or NULL */
+    bool_t    watch_dirty;             /* Game changed since latest */
+    bool_t    watch_listed;            /* On the server's watch_dirty list */
+    bool_t    in_use;
+} ServerTable;
+
+typedef struct {
+    unsigned long frames_in, frames_out;
+    unsigned long bytes_out;                /* Of frames_out */
+    unsigned long views, deltas, resyncs;   /* STATE and DELTA frames sent */
+    unsigned long moves, rejects;
+    unsigned long games_started, games_finished, games_capped;
+    unsigned long connections, dropped_slow;
+    unsigned long log_failures;
+    unsigned long peak_connections, peak_tables;
+    double        move_seconds, move_worst;   /* Server time per PLAY */
+    unsigned long bot_demotions;              /* Tables moved to the fallback */
+    unsigned long watch_views, watch_frames;  /* Encoded, and written out */
+    unsigned long watch_skipped, watch_dropped;
+    unsigned long peak_watchers;
+    double        watch_encode_seconds;       /* Once per view */
+    double        watch_seconds;              /* Handing it out */
+    unsigned long watch_offers;
+    AiLatency     latency[MAX_PLAYERS + 1];   /* By bot, then the fallback */
+} ServerStats;
+
+typedef struct {
+    const ServerConfig* config;
+    int           epfd, listen_fd;
+    ServerConn**  conns;               /* By fd */
+    int           max_fds;
+    int           open_conns;
+    ServerTable*  tables;
+    uint32_t*     free_tables;         /* Stack of unused table ids */
+    uint32_t      free_count;
+    int32_t       waiting[MAX_PLAYERS + 1][MAX_PLAYERS];  /* [players][bots] */
+    int*          flush;               /* Connections with queued output */
+    int           flush_count;
+    FILE*         log_file;
+    GameStats*    game_stats;          /* -c: every finished game */
+    WatchFrame*   watch_free;          /* Spare frames */
+    uint32_t*     watch_dirty;         /* Watched tables with a new view */
+    uint32_t      watch_dirty_count;
+    int           watcher_count;
+    ServerStats   stats;
+} Server;
+
+static volatile sig_atomic_t server_stop = 0;
+
+static void server_signal(int sig) {
+    (void)sig;
+    server_stop = 1;
+}
+
+static double server_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Queue one frame; the write happens in server_flush */
+static void server_send(Server* server, ServerConn* conn, NetMessage* msg) {
+    size_t size;
+
+    if (conn->dead) {
+        return;
+    }
+    if (conn->out_end + NET_FRAME_SIZE > sizeof(conn->out)) {
+        if (conn->out_start == 0) {
+            conn->dead = TRUE;          /* Not reading - give up on it */
+            server->stats.dropped_slow++;
+        } else {
+            memmove(conn->out, conn->out + conn->out_start,
+                    conn->out_end - conn->out_start);
+            conn->out_end -= conn->out_start;
+            conn->out_start = 0;
+        }
+    }
+    if (!conn->dead) {
+        msg->seq = conn->seq++;
+        size = rachel_net_encode(msg, conn->out + conn->out_end);
+        conn->out_end += (uint32_t)size;
+        server->stats.frames_out++;
+        server->stats.bytes_out += size;
+    }
+    if (!conn->dirty) {
+        conn->dirty = TRUE;
+        server->flush[server->flush_count++] = conn->fd;
+    }
+}
+
+static void server_reject(Server* server, ServerConn* conn, uint8_t reason) {
+    NetMessage msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_REJECT;
+    msg.seat = conn->seat;
+    msg.table = conn->table < 0 ? 0 : (uint32_t)conn->table;
+    msg.u.reason = reason;
+    server->stats.rejects++;
+    server_send(server, conn, &msg);
+}
+
+/* A seat's view as a delta from what it last got, or whole */
+static void server_send_view(Server* server, ServerConn* conn, uint32_t id) {
+    NetMessage msg;
+    NetState state;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.table = id;
+    msg.seat = conn->seat;
+    rachel_net_state(&server->tables[id].game, conn->seat, &state);
+    if (conn->synced && rachel_net_diff(&conn->view, &state, &msg.u.delta)) {
+        msg.type = NET_MSG_DELTA;
+        server->stats.deltas++;
+    } else {
+        msg.type = NET_MSG_STATE;
+        msg.u.state = state;
+        server->stats.views++;
+    }
+    conn->view = state;
+    conn->synced = TRUE;
+    server_send(server, conn, &msg);
+}
+
+/* A frame with one reference, from the spare list */
+static WatchFrame* server_frame_new(Server* server) {
+    WatchFrame* block;
+    int i;
+
+    if (server->watch_free == NULL) {
+        block = (WatchFrame*)malloc(SERVER_WATCH_BLOCK * sizeof(WatchFrame));
+        if (block == NULL) {
+            return NULL;
+        }
+        for (i = 0; i < SERVER_WATCH_BLOCK; i++) {
+            block[i].next_free = server->watch_free;
+            server->watch_free = &block[i];
+        }
+    }
+    block = server->watch_free;
+    server->watch_free = block->next_free;
+    block->refs = 1;
+    return block;
+}
+
+static void server_frame_release(Server* server, WatchFrame* frame) {
+    if (frame != NULL && --frame->refs == 0) {
+        frame->next_free = server->watch_free;
+        server->watch_free = frame;
+    }
+}
+
+static void server_mark_dirty(Server* server, ServerConn* conn) {
+    if (!conn->dirty) {
+        conn->dirty = TRUE;
+        server->flush[server->flush_count++] = conn->fd;
+    }
+}
+
+/* Make sure the spectator's next write is the newest view */
+static void server_watch_offer(Server* server, ServerConn* conn, WatchFrame* frame) {
+    if (conn->pending != NULL) {
+        server_frame_release(server, conn->pending);
+        server->stats.watch_skipped++;
+        if (++conn->stalls > SERVER_WATCH_STALLS && !conn->dead) {
+            conn->dead = TRUE;
+            server->stats.watch_dropped++;
+        }
+    }
+    conn->pending = frame;
+    frame->refs++;
+    server_mark_dirty(server, conn);
+}
+
+/* Encode the table's public view once and hand it to every spectator */
+static void server_watch_publish(Server* server, uint32_t id) {
+    ServerTable* table = &server->tables[id];
+    WatchFrame* frame;
+    NetMessage msg;
+    double start = server_now(), now;
+    int fd;
+
+    table->watch_dirty = FALSE;
+    frame = server_frame_new(server);
+    if (frame == NULL) {
+        return;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_STATE;
+    msg.seat = NET_SEAT_SPECTATOR;
+    msg.table = id;
+    msg.seq = table->views++;
+    rachel_net_state(&table->game, NET_SEAT_SPECTATOR, &msg.u.state);
+    rachel_net_encode(&msg, frame->frame);
+    server_frame_release(server, table->latest);
+    table->latest = frame;
+    server->stats.watch_views++;
+    now = server_now();
+    server->stats.watch_encode_seconds += now - start;
+
+    for (fd = table->watchers; fd >= 0; fd = server->conns[fd]->watch_next) {
+        server_watch_offer(server, server->conns[fd], frame);
+        server->stats.watch_offers++;
+    }
+    server->stats.watch_seconds += server_now() - now;
+}
+
+/* The table's public view changed: publish it at the next flush */
+static void server_watch_touch(Server* server, uint32_t id) {
+    ServerTable* table = &server->tables[id];
+
+    table->watch_dirty = TRUE;
+    if (!table->watch_listed) {
+        table->watch_listed = TRUE;
+        server->watch_dirty[server->watch_dirty_count++] = id;
+    }
+}
+
+/* Everyone at the table gets their own view */
+static void server_broadcast(Server* server, uint32_t id) {
+    ServerTable* table = &server->tables[id];
+    uint8_t seat;
+
+    if (table->watch_count > 0) {
+        server_watch_touch(server, id);
+    }
+    for (seat = 0; seat < table->players; seat++) {
+        if (table->fds[seat] >= 0) {
+            server_send_view(server, server->conns[table->fds[seat]], id);
+        }
+    }
+}
+
+/* Games are written out or counted */
+static bool_t server_keeps_log(Server* server) {
+    return server->log_file != NULL || server->game_stats != NULL;
+}
+
+/* The table's log if games are kept or bots follow them, else NULL */
+static EventLog* server_log(Server* server, ServerTable* table) {
+    return server_keeps_log(server) || server->config->observe ?
+           &table->log : NULL;
+}
+
+/* Bring every seat's tracker up to the end of the table's log */
+static void server_observe(ServerTable* table) {
+    EventRecord record;
+    uint8_t seat;
+
+    for (; table->known < table->log.count; table->known++) {
+        rachel_log_decode(table->log.pending + (size_t)table->known * EVENT_RECORD_SIZE,
+                          &record);
+        for (seat = 0; seat < table->game.player_count; seat++) {
+            rachel_know_observe(&table->know[seat], &table->game, &record);
+        }
+    }
+}
+
+static void server_release(Server* server, uint32_t id) {
+    ServerTable* table = &server->tables[id];
+    uint8_t seat;
+
+    if (table->playing && server_keeps_log(server) &&
+        !rachel_log_end_game(&table->log, &table->game)) {
+        server->stats.log_failures++;
+    }
+    table->log.count = 0;               /* Only kept for the trackers */
+    for (seat = 0; seat < table->players; seat++) {
+        if (table->fds[seat] >= 0) {
+            server->conns[table->fds[seat]]->table = -1;
+            table->fds[seat] = -1;
+        }
+    }
+    if (server->waiting[table->players][table->bots] == (int32_t)id) {
+        server->waiting[table->players][table->bots] = -1;
+    }
+    if (table->watch_dirty) {
+        server_watch_publish(server, id);   /* The last view, before reuse */
+    }
+    table->playing = FALSE;
+    table->in_use = FALSE;
+    server->free_tables[server->free_count++] = id;
+}
+
+/* Play every turn that needs no client, then tell the table */
+static void server_advance(Server* server, uint32_t id) {
+    ServerTable* table = &server->tables[id];
+    Game* game = &table->game;
+    EventLog* log = server_log(server, table);
+    const ServerConfig* config = server->config;
+    uint64_t spent;
+    uint8_t player;
+
+    while (!rachel_is_game_over(game) && game->turn_count < SERVER_MAX_TURNS) {
+        player = game->current_player_index;
+        if (table->fds[player] < 0) {
+            if (config->observe) {
+                server_observe(table);
+            }
+            spent = rachel_ai_take_turn_known(game, table->bot < config->bot_count ?
+                                              config->bots[table->bot] :
+                                              config->fallback,
+                                              config->observe ? &table->know[player] : 0,
+                                              &table->bot_rng, log,
+                                              &server->stats.latency[table->bot]);
+            if (config->sla_ns != 0 && spent > config->sla_ns &&
+                table->bot < config->bot_count) {
+                table->bot = config->bot_count;
+                server->stats.bot_demotions++;
+            }
+        } else if (!rachel_valid_plays_mask(game, player)) {
+            rachel_ai_pass_turn_log(game, log);
+        } else {
+            server_broadcast(server, id);
+            return;
+        }
+    }
+
+    if (rachel_is_game_over(game)) {
+        server->stats.games_finished++;
+    } else {
+        server->stats.games_capped++;
+    }
+    game->state = STATE_FINISHED;
+    server_broadcast(server, id);
+    server_release(server, id);
+}
+
+static void server_start_table(Server* server, uint32_t id) {
+    ServerTable* table = &server->tables[id];
+    uint8_t seat;
+
+    for (seat = table->seated; seat < table->players; seat++) {
+        rachel_add_player(&table->game, "BOT", TRUE);
+    }
+    rachel_rng_seed(&table->bot_rng, ~(uint64_t)server->config->seed,
+                    server->stats.games_started);
+    table->bot = (uint8_t)(server->stats.games_started %
+                           server->config->bot_count);
+    for (seat = 0; seat < table->players; seat++) {
+        table->know[seat].observer = seat;
+    }
+    table->known = table->log.count;
+    rachel_log_start_game(server_log(server, table), &table->game,
+                          server->config->seed,
+                          (uint32_t)server->stats.games_started);
+    server->stats.games_started++;
+    server->waiting[table->players][table->bots] = -1;
+    table->playing = TRUE;
+    server_advance(server, id);
+}
+
+static void server_join(Server* server, ServerConn* conn, const NetJoin* join) {
+    ServerTable* table;
+    NetMessage msg;
+    int32_t id;
+    uint32_t in_use;
+
+    if (conn->table >= 0 || conn->watching >= 0) {
+        server_reject(server, conn, NET_REJECT_SEATED);
+        return;
+    }
+    if (join->players < 2 || join->players > MAX_PLAYERS ||
+        join->bots >= join->players) {
+        server_reject(server, conn, NET_REJECT_BAD_FRAME);
+        return;
+    }
+
+    id = server->waiting[join->players][join->bots];
+    if (id < 0) {
+        if (server->free_count == 0) {
+            server_reject(server, conn, NET_REJECT_FULL);
+            return;
+        }
+        id = (int32_t)server->free_tables[--server->free_count];
+        table = &server->tables[id];
+        memset(table->fds, -1, sizeof(table->fds));
+        table->players = join->players;
+        table->bots = join->bots;
+        table->seated = 0;
+        table->humans = 0;
+        table->playing = FALSE;
+        table->in_use = TRUE;
+        rachel_init_game(&table->game, join->players);
+        server->waiting[join->players][join->bots] = id;
+
+        in_use = server->config->tables - server->free_count;
+        if (in_use > server->stats.peak_tables) {
+            server->stats.peak_tables = in_use;
+        }
+    }
+
+    table = &server->tables[id];
+    conn->table = id;
+    conn->seat = table->seated++;
+    conn->synced = FALSE;
+    table->fds[conn->seat] = conn->fd;
+    table->humans++;
+    rachel_add_player(&table->game, join->name[0] ? join->name : "PLAYER", FALSE);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.type = NET_MSG_WELCOME;
+    msg.seat = conn->seat;
+    msg.table = (uint32_t)id;
+    msg.u.players = table->players;
+    server_send(server, conn, &msg);
+
+    if (table->seated + table->bots == table->players) {
+        server_start_table(server, (uint32_t)id);
+    }
+}
+
+/* Validate with the rules in order: whose turn, first card, whole play */
+static void server_play(Server* server, ServerConn* conn, const NetPlay* play) {
+    ServerTable* table;
+    Game* game;
+    EventLog* log;
+    double start = server_now(), spent;
+
+    if (conn->table < 0 || !server->tables[conn->table].playing) {
+        server_reject(server, conn, NET_REJECT_NOT_SEATED);
+        return;
+    }
+    table = &server->tables[conn->table];
+    game = &table->game;
+
+    if (game->current_player_index != conn->seat) {
+        server_reject(server, conn, NET_REJECT_NOT_YOUR_TURN);
+        return;
+    }
+    if (play->count == 0 || play->count > RACHEL_MAX_PLAY) {
+        server_reject(server, conn, NET_REJECT_BAD_FRAME);
+        return;
+    }
+    if (!rachel_can_play_card(game, play->cards[0])) {
+        server_reject(server, conn, NET_REJECT_ILLEGAL_CARD);
+        return;
+    }
+    log = server_log(server, table);
+    if (!rachel_log_play_cards(log, game, conn->seat, play->cards, play->count,
+                               play->nominated_suit)) {
+        server_reject(server, conn, NET_REJECT_ILLEGAL_PLAY);
+        return;
+    }
+
+    rachel_log_next_turn(log, game);
+    server->stats.moves++;
+    server_advance(server, (uint32_t)conn->table);
+
+    spent = server_now() - start;
+    server->stats.move_seconds += spent;
+    if (spent > server->stats.move_worst) {
+        server->stats.move_worst = spent;
+    }
+}
+
+/* Follow a table's public view, from its newest on */
+static void server_watch(Server* server, ServerConn* conn, uint32_t id) {
+    ServerTable* table;
+
+    if (conn->table >= 0 || conn->watching >= 0) {
+        server_reject(server, conn, NET_REJECT_SEATED);
+        return;
+    }
+    if (id >= server->config->tables) {
+        server_reject(server, conn, NET_REJECT_NO_TABLE);
+        return;
+    }
+    table = &server->tables[id];
+    conn->watching = (int32_t)id;
+    conn->watch_prev = -1;
+    conn->watch_next = table->watchers;
+    if (table->watchers >= 0) {
+        server->conns[table->watchers]->watch_prev = conn->fd;
+    }
+    table->watchers = conn->fd;
+    table->watch_count++;
+    if (++server->watcher_count > (int)server->stats.peak_watchers) {
+        server->stats.peak_watchers = server->watcher_count;
+    }
+
+    if (table->in_use && table->latest == NULL) {
+        server_watch_touch(server, id);
+    } else if (table->latest != NULL && !table->watch_dirty) {
+        server_watch_offer(server, conn, table->latest);
+    }
+}
+
+static void server_unwatch(Server* server, ServerConn* conn) {
+    ServerTable* table = &server->tables[conn->watching];
+
+    if (conn->watch_prev >= 0) {
+        server->conns[conn->watch_prev]->watch_next = conn->watch_next;
+    } else {
+        table->watchers = conn->watch_next;
+    }
+    if (conn->watch_next >= 0) {
+        server->conns[conn->watch_next]->watch_prev = conn->watch_prev;
+    }
+    table->watch_count--;
+    server->watcher_count--;
+    conn->watching = -1;
+
+    /* Unwatched tables stop publishing, so the view would go stale */
+    if (table->watch_count == 0) {
+        server_frame_release(server, table->latest);
+        table->latest = NULL;
+        table->watch_dirty = FALSE;
+    }
+}
+
+/* The seat goes to a bot; a table with nobody left is closed. A
+ * spectator just stops watching. */
+static void server_leave(Server* server, ServerConn* conn) {
+    ServerTable* table;
+    uint32_t id;
+
+    if (conn->watching >= 0) {
+        server_unwatch(server, conn);
+    }
+    if (conn->table < 0) {
+        return;
+    }
+    id = (uint32_t)conn->table;
+    table = &server->tables[id];
+    table->fds[conn->seat] = -1;
+    table->humans--;
+    conn->table = -1;
+
+    if (table->humans == 0) {
+        server_release(server, id);
+    } else if (table->playing &&
+               table->game.current_player_index == conn->seat) {
+        server_advance(server, id);
+    }
+}
+
+/* The client lost track: send its whole view again */
+static void server_resync(Server* server, ServerConn* conn) {
+    if (conn->table < 0 || !server->tables[conn->table].playing) {
+        server_reject(server, conn, NET_REJECT_NOT_SEATED);
+        return;
+    }
+    server->stats.resyncs++;
+    conn->synced = FALSE;
+    server_send_view(server, conn, (uint32_t)conn->table);
+}
+
+static void server_frame(Server* server, ServerConn* conn, const uint8_t* frame) {
+    NetMessage msg;
+
+    server->stats.frames_in++;
+    if (!rachel_net_decode(frame, &msg)) {
+        server_reject(server, conn, NET_REJECT_BAD_FRAME);
+        return;
+    }
+    switch (msg.type) {
+    case NET_MSG_JOIN:
+        server_join(server, conn, &msg.u.join);
+        break;
+    case NET_MSG_PLAY:
+        server_play(server, conn, &msg.u.play);
+        break;
+    case NET_MSG_LEAVE:
+        server_leave(server, conn);
+        break;
+    case NET_MSG_RESYNC:
+        server_resync(server, conn);
+        break;
+    case NET_MSG_WATCH:
+        server_watch(server, conn, msg.table);
+        break;
+    default:
+        server_reject(server, conn, NET_REJECT_BAD_FRAME);
+        break;
+    }
+}
+
+/* Drain the socket, handling whole frames straight from the buffer */
+static void server_read(Server* server, ServerConn* conn) {
+    uint8_t buffer[SERVER_READ_FRAMES * NET_FRAME_SIZE];
+    ssize_t got;
+    size_t pos, take, size;
+
+    while (!conn->dead) {
+        got = read(conn->fd, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (got <= 0) {
+            conn->dead = TRUE;
+            if (!conn->dirty) {
+                conn->dirty = TRUE;
+                server->flush[server->flush_count++] = conn->fd;
+            }
+            return;
+        }
+
+        pos = 0;
+        while (pos < (size_t)got && !conn->dead) {
+            if (conn->in_len == 0) {
+                size = rachel_net_frame_size(buffer + pos, got - pos);
+                if (size <= got - pos) {
+                    server_frame(server, conn, buffer + pos);
+                    pos += size;
+                    continue;
+                }
+            }
+            /* A frame split across reads: gather it in conn->in */
+            take = rachel_net_frame_size(conn->in, conn->in_len) - conn->in_len;
+            if (take > got - pos) {
+                take = got - pos;
+            }
+            memcpy(conn->in + conn->in_len, buffer + pos, take);
+            conn->in_len += (uint8_t)take;
+            pos += take;
+            if (conn->in_len == rachel_net_frame_size(conn->in, conn->in_len)) {
+                conn->in_len = 0;
+                server_frame(server, conn, conn->in);
+            }
+        }
+    }
+}
+
+static void server_close(Server* server, ServerConn* conn) {
+    server_leave(server, conn);
+    server_frame_release(server, conn->sending);
+    server_frame_release(server, conn->pending);
+    epoll_ctl(server->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    server->conns[conn->fd] = NULL;
+    server->open_conns--;
+    free(conn);
+}
+
+/* A spectator's views straight from the shared frames: the rest of
+ * the one under way and the newest, in one writev */
+static void server_watch_write(Server* server, ServerConn* conn) {
+    struct iovec iov[2];
+    ssize_t sent;
+    size_t take;
+    int count;
+
+    while (!conn->dead && (conn->sending != NULL || conn->pending != NULL)) {
+        count = 0;
+        if (conn->sending != NULL) {
+            iov[count].iov_base = conn->sending->frame + conn->sent;
+            iov[count++].iov_len = NET_FRAME_SIZE - conn->sent;
+        }
+        if (conn->pending != NULL) {
+            iov[count].iov_base = conn->pending->frame;
+            iov[count++].iov_len = NET_FRAME_SIZE;
+        }
+        sent = writev(conn->fd, iov, count);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (sent <= 0) {
+            conn->dead = TRUE;
+            return;
+        }
+
+        conn->stalls = 0;
+        if (conn->sending != NULL) {
+            take = NET_FRAME_SIZE - conn->sent;
+            if ((size_t)sent < take) {
+                conn->sent += (uint8_t)sent;
+                continue;
+            }
+            sent -= (ssize_t)take;
+            server_frame_release(server, conn->sending);
+            conn->sending = NULL;
+            server->stats.watch_frames++;
+        }
+        if (sent > 0) {
+            conn->sending = conn->pending;
+            conn->pending = NULL;
+            conn->sent = (uint8_t)sent;
+            if (conn->sent == NET_FRAME_SIZE) {
+                server_frame_release(server, conn->sending);
+                conn->sending = NULL;
+                server->stats.watch_frames++;
+            }
+        }
+    }
+}
+
+/* Write queued frames; arm EPOLLOUT only while the kernel pushes back */
+static void server_flush(Server* server) {
+    struct epoll_event event;
+    ServerConn* conn;
+    ssize_t sent;
+    bool_t blocked;
+    uint32_t t;
+    int i;
+
+    /* New public views first: one encoding each, whoever watches */
+    for (t = 0; t < server->watch_dirty_count; t++) {
+        server->tables[server->watch_dirty[t]].watch_listed = FALSE;
+        if (server->tables[server->watch_dirty[t]].watch_dirty) {
+            server_watch_publish(server, server->watch_dirty[t]);
+        }
+    }
+    server->watch_dirty_count = 0;
+
+    /* Closing a seat can queue frames for others, so the list may grow */
+    for (i = 0; i < server->flush_count; i++) {
+        conn = server->conns[server->flush[i]];
+        if (conn == NULL) {
+            continue;
+        }
+        conn->dirty = FALSE;
+
+        while (!conn->dead && conn->out_start < conn->out_end) {
+            sent = send(conn->fd, conn->out + conn->out_start,
+                        conn->out_end - conn->out_start, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (sent <= 0) {
+                conn->dead = TRUE;
+                break;
+            }
+            conn->out_start += (uint32_t)sent;
+        }
+        if (conn->dead) {
+            server_close(server, conn);
+            continue;
+        }
+        if (conn->out_start == conn->out_end) {
+            conn->out_start = conn->out_end = 0;
+            server_watch_write(server, conn);
+            if (conn->dead) {
+                server_close(server, conn);
+                continue;
+            }
+        }
+        blocked = conn->out_start < conn->out_end ||
+                  conn->sending != NULL || conn->pending != NULL;
+        if (blocked != conn->polling_out) {
+            conn->polling_out = !conn->polling_out;
+            event.events = EPOLLIN | (conn->polling_out ? EPOLLOUT : 0);
+            event.data.fd = conn->fd;
+            epoll_ctl(server->epfd, EPOLL_CTL_MOD, conn->fd, &event);
+        }
+    }
+    server->flush_count = 0;
+}
+
+static void server_accept(Server* server) {
+    struct epoll_event event;
+    ServerConn* conn;
+    int fd, one = 1;
+
+    for (;;) {
+        fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        if (fd >= server->max_fds ||
+            (conn = (ServerConn*)calloc(1, sizeof(ServerConn))) == NULL) {
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        conn->fd = fd;
+        conn->table = -1;
+        conn->watching = -1;
+        server->conns[fd] = conn;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(server->epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            server->conns[fd] = NULL;
+            free(conn);
+            close(fd);
+            continue;
+        }
+
+        server->stats.connections++;
+        if (++server->open_conns > (int)server->stats.peak_connections) {
+            server->stats.peak_connections = server->open_conns;
+        }
+    }
+}
+
+static bool_t server_listen(Server* server) {
+    struct sockaddr_in addr;
+    struct epoll_event event;
+    int one = 1;
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listen_fd < 0) {
+        return FALSE;
+    }
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(server->config->port);
+    if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(server->listen_fd, 1024) < 0) {
+        return FALSE;
+    }
+    fcntl(server->listen_fd, F_SETFL, fcntl(server->listen_fd, F_GETFL) | O_NONBLOCK);
+
+    server->epfd = epoll_create1(0);
+    if (server->epfd < 0) {
+        return FALSE;
+    }
+    event.events = EPOLLIN;
+    event.data.fd = server->listen_fd;
+    return epoll_ctl(server->epfd, EPOLL_CTL_ADD, server->listen_fd, &event) == 0;
+}
+
+static bool_t server_init(Server* server, const ServerConfig* config) {
+    struct rlimit limit;
+    uint32_t i;
+    int p, b;
+
+    memset(server, 0, sizeof(*server));
+    server->config = config;
+    for (p = 0; p <= MAX_PLAYERS; p++) {
+        rachel_ai_latency_init(&server->stats.latency[p], config->sla_ns);
+    }
+
+    server->max_fds = 65536;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&
+        limit.rlim_cur < (rlim_t)server->max_fds) {
+        server->max_fds = (int)limit.rlim_cur;
+    }
+    server->conns = (ServerConn**)calloc(server->max_fds, sizeof(ServerConn*));
+    server->flush = (int*)malloc(server->max_fds * sizeof(int));
+    server->tables = (ServerTable*)calloc(config->tables, sizeof(ServerTable));
+    server->free_tables = (uint32_t*)malloc(config->tables * sizeof(uint32_t));
+    server->watch_dirty = (uint32_t*)malloc(config->tables * sizeof(uint32_t));
+    if (!server->conns || !server->flush || !server->tables || !server->free_tables ||
+        !server->watch_dirty) {
+        return FALSE;
+    }
+    if (config->log_path != NULL) {
+        server->log_file = rachel_log_create(config->log_path);
+        if (server->log_file == NULL) {
+            return FALSE;
+        }
+    }
+    if (config->stats_path != NULL) {
+        server->game_stats = (GameStats*)malloc(sizeof(GameStats));
+        if (server->game_stats == NULL) {
+            return FALSE;
+        }
+        rachel_stats_init(server->game_stats);
+    }
+
+    /* Lowest ids first */
+    for (i = 0; i < config->tables; i++) {
+        server->free_tables[i] = config->tables - 1 - i;
+        server->tables[i].watchers = -1;
+        rachel_log_init(&server->tables[i].log, server->log_file);
+        if (server->game_stats != NULL) {
+            rachel_log_set_tap(&server->tables[i].log, rachel_stats_tap,
+                               server->game_stats);
+        }
+    }
+    server->free_count = config->tables;
+    for (p = 0; p <= MAX_PLAYERS; p++) {
+        for (b = 0; b < MAX_PLAYERS; b++) {
+            server->waiting[p][b] = -1;
+        }
+    }
+    return server_listen(server);
+}
+
+static void server_run(Server* server) {
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    ServerConn* conn;
+    int count, i;
+
+    while (!server_stop) {
+        count = epoll_wait(server->epfd, events, SERVER_MAX_EVENTS, 1000);
+        for (i = 0; i < count; i++) {
+            if (events[i].data.fd == server->listen_fd) {
+                server_accept(server);
+                continue;
+            }
+            conn = server->conns[events[i].data.fd];
+            if (conn == NULL) {
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                server_read(server, conn);
+            }
+            if ((events[i].events & EPOLLOUT) && !conn->dirty) {
+                conn->dirty = TRUE;
+                server->flush[server->flush_count++] = conn->fd;
+            }
+        }
+        server_flush(server);
+    }
+}
+
+static void server_report(const Server* server) {
+    const ServerStats* stats = &server->stats;
+    const AiLatency* latency;
+    int i;
+
+    printf("Frames:      %lu in, %lu out (%.1f bytes mean)\n",
+           stats->frames_in, stats->frames_out,
+           stats->frames_out ? (double)stats->bytes_out / stats->frames_out : 0.0);
+    printf("Views:       %lu whole, %lu deltas, %lu resyncs asked for\n",
+           stats->views, stats->deltas, stats->resyncs);
+    printf("Moves:       %lu (%lu rejected)\n", stats->moves, stats->rejects);
+    if (stats->moves > 0) {
+        printf("Move time:   %.1f us mean, %.1f us worst (server side)\n",
+               stats->move_seconds / stats->moves * 1e6, stats->move_worst * 1e6);
+    }
+    printf("Games:       %lu started, %lu finished, %lu hit the %lu turn cap\n",
+           stats->games_started, stats->games_finished, stats->games_capped,
+           SERVER_MAX_TURNS);
+    printf("Connections: %lu total, %lu peak, %lu dropped as slow\n",
+           stats->connections, stats->peak_connections, stats->dropped_slow);
+    printf("Tables:      %lu peak of %lu\n", stats->peak_tables,
+           (unsigned long)server->config->tables);
+    if (stats->peak_watchers > 0) {
+        printf("Spectators:  %lu peak, %lu dropped as slow\n",
+               stats->peak_watchers, stats->watch_dropped);
+        printf("Watch views: %lu encoded at %.0f ns, handed out %lu times at %.0f ns,"
+               " %lu frames written, %lu skipped\n", stats->watch_views,
+               stats->watch_views ? stats->watch_encode_seconds / stats->watch_views * 1e9 : 0.0,
+               stats->watch_offers,
+               stats->watch_offers ? stats->watch_seconds / stats->watch_offers * 1e9 : 0.0,
+               stats->watch_frames, stats->watch_skipped);
+    }
+    if (server->log_file != NULL) {
+        printf("Event log:   %s (%lu games lost to write errors)\n",
+               server->config->log_path, stats->log_failures);
+    }
+    if (server->game_stats != NULL) {
+        printf("Statistics:  %s\n", server->config->stats_path);
+    }
+
+    printf("\nBot        Decisions    p50 us    p99 us    max us  Over SLA\n");
+    for (i = 0; i <= server->config->bot_count; i++) {
+        latency = &stats->latency[i];
+        if (i == server->config->bot_count && latency->decisions == 0) {
+            break;   /* The fallback never had to step in */
+        }
+        printf("%-10s %-12lu %8.2f  %8.2f  %8.2f  %lu\n",
+               i < server->config->bot_count ? server->config->bots[i]->name :
+               "fallback", latency->decisions,
+               rachel_ai_latency_quantile(latency, 0.50) / 1e3,
+               rachel_ai_latency_quantile(latency, 0.99) / 1e3,
+               latency->max_ns / 1e3, latency->over_budget);
+    }
+    if (server->config->sla_ns != 0) {
+        printf("SLA:         %.2f us per decision, %lu tables fell back to %s\n",
+               server->config->sla_ns / 1e3, stats->bot_demotions,
+               server->config->fallback->name);
+    }
+}
+
+static bool_t server_write_stats(const Server* server) {
+    FILE* file = fopen(server->config->stats_path, "w");
+    bool_t ok;
+
+    if (file == NULL) {
+        perror(server->config->stats_path);
+        return FALSE;
+    }
+    ok = rachel_stats_write_csv(server->game_stats, file);
+    return fclose(file) == 0 && ok;
+}
+
+static void server_usage(const char* program) {
+    printf("Usage: %s [-P port] [-T tables] [-s seed] [-a policy,policy,...]\n"
+           "       [-S usec] [-l log] [-c csv] [-q]\n",
+           program);
+    printf("  -P port       TCP port (default %d)\n", NET_DEFAULT_PORT);
+    printf("  -T tables     Most tables at once (default %d)\n",
+           SERVER_DEFAULT_TABLES);
+    printf("  -s seed       Base seed, game n uses stream n (default 1)\n");
+    printf("  -a policies   AI for bot seats and abandoned seats, one per table\n"
+           "                in turn (default suit)\n");
+    printf("  -S usec       Bot decision SLA: a slower bot plays \"first\" for the\n"
+           "                rest of that game\n");
+    printf("  -l log        Append every game to this event log\n");
+    printf("  -c csv        On exit, write game statistics to this file\n");
+    printf("  -q            No startup banner\n");
+}
+
+/* Comma separated policy names, returns FALSE on an unknown name */
+static bool_t server_parse_bots(char* list, ServerConfig* config) {
+    char* name;
+
+    config->bot_count = 0;
+    for (name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        if (config->bot_count >= MAX_PLAYERS) {
+            return FALSE;
+        }
+        config->bots[config->bot_count] = rachel_ai_find(name);
+        if (config->bots[config->bot_count] == NULL) {
+            return FALSE;
+        }
+        if (config->bots[config->bot_count]->choose_known != NULL) {
+            config->observe = TRUE;
+        }
+        config->bot_count++;
+    }
+    return config->bot_count > 0;
+}
+
+static bool_t server_parse_args(int argc, char** argv, ServerConfig* config) {
+    int i;
+
+    config->port = NET_DEFAULT_PORT;
+    config->tables = SERVER_DEFAULT_TABLES;
+    config->seed = 1;
+    config->bots[0] = rachel_ai_find("suit");
+    config->bot_count = 1;
+    config->fallback = rachel_ai_find("first");
+    config->observe = FALSE;
+    config->sla_ns = 0;
+    config->quiet = FALSE;
+    config->log_path = NULL;
+    config->stats_path = NULL;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            config->quiet = TRUE;
+        } else if (i + 1 < argc && strcmp(argv[i], "-P") == 0) {
+            config->port = (uint16_t)atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-T") == 0) {
+            config->tables = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            config->seed = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-a") == 0) {
+            if (!server_parse_bots(argv[++i], config)) {
+                return FALSE;
+            }
+        } else if (i + 1 < argc && strcmp(argv[i], "-S") == 0) {
+            config->sla_ns = (uint64_t)(strtod(argv[++i], NULL) * 1e3);
+        } else if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+            config->log_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            config->stats_path = argv[++i];
+        } else {
+            return FALSE;
+        }
+    }
+    return config->port > 0 && config->tables > 0;
+}
+
+int main(int argc, char** argv) {
+    ServerConfig config;
+    Server server;
+    struct sigaction action;
+
+    if (!server_parse_args(argc, argv, &config)) {
+        server_usage(argv[0]);
+        return 2;
+    }
+
+    if (!rachel_self_test() || !rachel_net_self_test() ||
+        !rachel_stats_self_test()) {
+        printf("Self test failed! The cards refuse to be dealt.\n");
+        return 1;
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = server_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, NULL);
+
+    if (!server_init(&server, &config)) {
+        perror("rachel_server");
+        return 1;
+    }
+    if (!config.quiet) {
+        printf("Rachel server (rules %s) on port %u, %lu tables\n",
+               rachel_version(), config.port, (unsigned long)config.tables);
+        fflush(stdout);
+    }
+
+    server_run(&server);
+    if (server.log_file != NULL && fclose(server.log_file) != 0) {
+        server.stats.log_failures++;
+    }
+    server_report(&server);
+    if (server.game_stats != NULL && !server_write_stats(&server)) {
+        printf("Statistics %s could not be written.\n", config.stats_path);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * End of server.
+ *
+ * The house always deals. The house never cheats.
+ */
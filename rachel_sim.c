@@ -0,0 +1,798 @@
+/*
+ * RACHEL HEADLESS SIMULATOR
+ *
+ * Plays AI-vs-AI games through the canonical rules engine as fast as
+ * the machine allows. No screen, no keyboard, no waiting.
+ * Used for capacity planning, AI tournaments and as a regression
+ * smoke test.
+ *
+ * Games are cut into batches and spread over per-thread work-stealing
+ * deques. Every worker owns one cache-aligned Game and a private result
+ * shard, so threads share nothing while playing; shards are merged at
+ * the end. Game i always uses RNG stream i, so results do not depend
+ * on the thread count.
+ *
+ * With -l every game is also written to an event log; workers buffer
+ * their own game and take a lock only to append it whole.
+ *
+ * With -c each worker also follows its games into its own GameStats
+ * (stats.h), folds it into the run's totals without a lock when it runs
+ * out of work, and the totals are written out as CSV.
+ *
+ * With -d every decision is timed into a per-policy latency histogram,
+ * and -S turns the p99 into a pass/fail SLA for each policy.
+ *
+ * With -L each batch is played by the lockstep engine instead: all of
+ * its games at once, one turn of each per step (lockstep.h). Only the
+ * "first" policy runs there, and the results are the same either way.
+ *
+ * "A million games before breakfast."
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "rules.h"
+#include "ai.h"
+#include "mcts.h"
+#include "eventlog.h"
+#include "lockstep.h"
+#include "knowledge.h"
+#include "solver.h"
+#include "stats.h"
+#include "input.h"
+
+/* Defaults */
+#define SIM_DEFAULT_GAMES      100000UL
+#define SIM_DEFAULT_PLAYERS    4
+#define SIM_DEFAULT_MAX_TURNS  2000UL
+#define SIM_DEFAULT_BATCH      256UL
+#define SIM_MAX_THREADS        256
+#define SIM_HISTOGRAM_ROWS     20
+#define SIM_CACHE_LINE         64
+
+/* Run configuration */
+typedef struct {
+    unsigned long   games;
+    uint8_t         players;
+    unsigned long   max_turns;     /* Games longer than this are abandoned */
+    unsigned long   seed;          /* Game i plays stream i of this seed */
+    unsigned long   batch;         /* Games per stealable task */
+    int             threads;
+    const AiPolicy* policies[MAX_PLAYERS];
+    uint8_t         policy_count;  /* Seat s of game i: (s + i) % count */
+    bool_t          quiet;         /* Summary only, no distribution */
+    const char*     log_path;      /* Event log to append to, or NULL */
+    const char*     stats_path;    /* Game statistics CSV, or NULL */
+    bool_t          lockstep;      /* Play each batch with lockstep.h */
+    bool_t          timed;         /* Time every policy decision */
+    uint64_t        sla_ns;        /* p99 decision budget, 0 for none */
+    bool_t          observe;       /* A policy reads what its seat has seen */
+} SimConfig;
+
+/* Accumulated results - one shard per worker, merged at the end */
+typedef struct {
+    unsigned long  games_played;
+    unsigned long  games_capped;     /* Hit max_turns without a result */
+    double         total_turns;
+    unsigned long* turn_histogram;   /* [max_turns + 1] games per length */
+    unsigned long  wins[MAX_PLAYERS];
+    unsigned long  policy_seats[MAX_PLAYERS];
+    unsigned long  policy_wins[MAX_PLAYERS];
+    AiLatency      latency[MAX_PLAYERS];   /* By policy, with -d */
+    double         elapsed;          /* Wall-clock seconds */
+} SimResults;
+
+/* Task range [top, bottom) packed as top << 32 | bottom.
+ * Tasks are all created up front, so one CAS on the pair is enough:
+ * the owner takes from the bottom, thieves take from the top. */
+typedef struct {
+    _Alignas(SIM_CACHE_LINE) _Atomic uint64_t range;
+} SimDeque;
+
+struct SimRun;
+
+/* Per-thread state; the alignment keeps neighbours off each other's lines */
+typedef struct {
+    _Alignas(SIM_CACHE_LINE) Game game;
+    SimResults     results;
+    SimDeque       deque;
+    EventLog       log;
+    Knowledge      know[MAX_PLAYERS];   /* Each seat's, fed from log */
+    GameStats      stats;           /* -c: this worker's games */
+    LockstepBatch  lockstep;        /* -L: lanes for one batch */
+    LockstepResult* lockstep_results;
+    struct SimRun* run;
+    int            index;
+    pthread_t      thread;
+} SimWorker;
+
+typedef struct SimRun {
+    const SimConfig* config;
+    SimWorker*       workers;
+    int              worker_count;
+    FILE*            log_file;      /* Shared by every worker's EventLog */
+    pthread_mutex_t  log_lock;
+    _Atomic bool_t   log_failed;
+    GameStats*       stats;         /* -c: every worker merges in here */
+} SimRun;
+
+/* Wall-clock time in seconds */
+static double sim_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Owner end of the deque */
+static bool_t sim_deque_pop(SimDeque* deque, unsigned long* task) {
+    uint64_t range = atomic_load_explicit(&deque->range, memory_order_relaxed);
+    uint32_t top, bottom;
+
+    do {
+        top = (uint32_t)(range >> 32);
+        bottom = (uint32_t)range;
+        if (top >= bottom) {
+            return FALSE;
+        }
+    } while (!atomic_compare_exchange_weak(&deque->range, &range,
+                                           ((uint64_t)top << 32) | (bottom - 1)));
+
+    *task = bottom - 1;
+    return TRUE;
+}
+
+/* Thief end of the deque */
+static bool_t sim_deque_steal(SimDeque* deque, unsigned long* task) {
+    uint64_t range = atomic_load_explicit(&deque->range, memory_order_relaxed);
+    uint32_t top, bottom;
+
+    do {
+        top = (uint32_t)(range >> 32);
+        bottom = (uint32_t)range;
+        if (top >= bottom) {
+            return FALSE;
+        }
+    } while (!atomic_compare_exchange_weak(&deque->range, &range,
+                                           ((uint64_t)(top + 1) << 32) | bottom));
+
+    *task = top;
+    return TRUE;
+}
+
+/* Seat s of game i is played by this policy */
+static const AiPolicy* sim_seat_policy(const SimConfig* config,
+                                       unsigned long game_index, int seat) {
+    return config->policies[(seat + game_index) % config->policy_count];
+}
+
+/* Bring every seat's tracker up to the newest record in log */
+static void sim_observe(Knowledge* know, const Game* game, const EventLog* log,
+                        uint32_t* next) {
+    EventRecord record;
+    uint8_t seat;
+
+    for (; *next < log->count; (*next)++) {
+        rachel_log_decode(log->pending + (size_t)*next * EVENT_RECORD_SIZE, &record);
+        for (seat = 0; seat < game->player_count; seat++) {
+            rachel_know_observe(&know[seat], game, &record);
+        }
+    }
+}
+
+/* Play one game to completion, returns FALSE if it hit the turn cap.
+ * know, if not NULL, has a tracker per seat and needs log. */
+static bool_t sim_play_game(Game* game, const SimConfig* config,
+                            unsigned long game_index, EventLog* log,
+                            Knowledge* know, SimResults* results) {
+    RachelRng ai_rng;
+    char name[16];
+    uint32_t next = log != NULL ? log->count : 0;
+    uint8_t seat;
+    int i;
+
+    rachel_init_game(game, config->players);
+    for (i = 0; i < config->players; i++) {
+        sprintf(name, "SIM_%d", i + 1);
+        rachel_add_player(game, name, TRUE);
+    }
+    rachel_rng_seed(&ai_rng, ~(uint64_t)config->seed, game_index);
+    rachel_log_start_game(log, game, config->seed, (uint32_t)game_index);
+    for (i = 0; know != NULL && i < config->players; i++) {
+        know[i].observer = (uint8_t)i;
+    }
+
+    while (!rachel_is_game_over(game)) {
+        if (game->turn_count >= config->max_turns) {
+            return FALSE;
+        }
+        if (know != NULL) {
+            sim_observe(know, game, log, &next);
+        }
+        seat = game->current_player_index;
+        rachel_ai_take_turn_known(game, sim_seat_policy(config, game_index, seat),
+                                  know != NULL ? &know[seat] : 0, &ai_rng, log,
+                                  config->timed ?
+                                  &results->latency[(seat + game_index) %
+                                                    config->policy_count] : 0);
+    }
+
+    game->state = STATE_FINISHED;
+    return TRUE;
+}
+
+/* Append a worker's game to the shared log, or just to its statistics */
+static void sim_log_game(SimWorker* worker) {
+    SimRun* run = worker->run;
+    bool_t ok;
+
+    if (run->log_file == NULL) {
+        if (!rachel_log_end_game(&worker->log, &worker->game)) {
+            atomic_store(&run->log_failed, TRUE);
+        }
+        return;
+    }
+    pthread_mutex_lock(&run->log_lock);
+    ok = rachel_log_end_game(&worker->log, &worker->game);
+    pthread_mutex_unlock(&run->log_lock);
+    if (!ok) {
+        atomic_store(&run->log_failed, TRUE);
+    }
+}
+
+/* Record one finished game; finish holds each seat's finish position */
+static void sim_record(SimResults* results, unsigned long turn_count,
+                       const uint8_t* finish, bool_t finished,
+                       const SimConfig* config, unsigned long game_index) {
+    unsigned long turns = turn_count;
+    int i, policy;
+
+    if (turns > config->max_turns) {
+        turns = config->max_turns;
+    }
+
+    results->games_played++;
+    results->total_turns += turn_count;
+    results->turn_histogram[turns]++;
+
+    if (!finished) {
+        results->games_capped++;
+        return;
+    }
+
+    for (i = 0; i < config->players; i++) {
+        policy = (int)((i + game_index) % config->policy_count);
+        results->policy_seats[policy]++;
+        if (finish[i] == 1) {
+            results->wins[i]++;
+            results->policy_wins[policy]++;
+        }
+    }
+}
+
+/* Next task: our own deque first, then steal round-robin */
+static bool_t sim_next_task(SimWorker* worker, unsigned long* task) {
+    SimRun* run = worker->run;
+    int k;
+
+    if (sim_deque_pop(&worker->deque, task)) {
+        return TRUE;
+    }
+    for (k = 1; k < run->worker_count; k++) {
+        if (sim_deque_steal(&run->workers[(worker->index + k) %
+                                          run->worker_count].deque, task)) {
+            return TRUE;
+        }
+    }
+    return FALSE;  /* No task is ever added, so empty everywhere is final */
+}
+
+static void* sim_worker_main(void* arg) {
+    SimWorker* worker = (SimWorker*)arg;
+    const SimConfig* config = worker->run->config;
+    bool_t keep = worker->run->log_file != NULL || worker->run->stats != NULL;
+    EventLog* log = keep || config->observe ? &worker->log : NULL;
+    const LockstepResult* result;
+    unsigned long task, i, first, last;
+    uint8_t finish[MAX_PLAYERS];
+    bool_t finished;
+    int seat;
+
+    while (sim_next_task(worker, &task)) {
+        first = task * config->batch;
+        last = first + config->batch;
+        if (last > config->games) {
+            last = config->games;
+        }
+        if (config->lockstep) {
+            rachel_lockstep_play(&worker->lockstep, config->players, config->seed,
+                                 first, last - first, (uint32_t)config->max_turns,
+                                 worker->lockstep_results);
+            for (i = first; i < last; i++) {
+                result = &worker->lockstep_results[i - first];
+                sim_record(&worker->results, result->turns, result->finish,
+                           result->finished, config, i);
+            }
+            continue;
+        }
+        for (i = first; i < last; i++) {
+            finished = sim_play_game(&worker->game, config, i, log,
+                                     config->observe ? worker->know : NULL,
+                                     &worker->results);
+            if (keep) {
+                sim_log_game(worker);
+            } else if (log != NULL) {
+                log->count = 0;         /* Only kept for the trackers */
+            }
+            for (seat = 0; seat < config->players; seat++) {
+                finish[seat] = worker->game.players[seat].finish_position;
+            }
+            sim_record(&worker->results, worker->game.turn_count, finish,
+                       finished, config, i);
+        }
+    }
+    if (worker->run->stats != NULL) {
+        rachel_stats_merge(worker->run->stats, &worker->stats);
+    }
+    return NULL;
+}
+
+/* Fold one worker's shard into the totals */
+static void sim_merge(SimResults* total, const SimResults* shard,
+                      const SimConfig* config) {
+    unsigned long turns;
+    int i;
+
+    total->games_played += shard->games_played;
+    total->games_capped += shard->games_capped;
+    total->total_turns += shard->total_turns;
+    for (turns = 0; turns <= config->max_turns; turns++) {
+        total->turn_histogram[turns] += shard->turn_histogram[turns];
+    }
+    for (i = 0; i < MAX_PLAYERS; i++) {
+        total->wins[i] += shard->wins[i];
+        total->policy_seats[i] += shard->policy_seats[i];
+        total->policy_wins[i] += shard->policy_wins[i];
+        rachel_ai_latency_merge(&total->latency[i], &shard->latency[i]);
+    }
+}
+
+/* Write the merged statistics as CSV */
+static bool_t sim_write_stats(const GameStats* stats, const SimConfig* config) {
+    FILE* file = fopen(config->stats_path, "w");
+    bool_t ok;
+
+    if (file == NULL) {
+        perror(config->stats_path);
+        return FALSE;
+    }
+    ok = rachel_stats_write_csv(stats, file);
+    return fclose(file) == 0 && ok;
+}
+
+/* Play every game across config->threads workers */
+static bool_t sim_run(const SimConfig* config, SimResults* results) {
+    SimRun run;
+    SimWorker* worker;
+    unsigned long tasks, first, last;
+    void* memory;
+    int i, k, started = 0;
+    bool_t ok = TRUE;
+
+    if (posix_memalign(&memory, SIM_CACHE_LINE,
+                       config->threads * sizeof(SimWorker)) != 0) {
+        return FALSE;
+    }
+    memset(memory, 0, config->threads * sizeof(SimWorker));
+
+    run.config = config;
+    run.workers = (SimWorker*)memory;
+    run.worker_count = config->threads;
+    run.log_file = NULL;
+    atomic_init(&run.log_failed, FALSE);
+    pthread_mutex_init(&run.log_lock, NULL);
+    run.stats = NULL;
+    if (config->stats_path != NULL) {
+        run.stats = (GameStats*)malloc(sizeof(GameStats));
+        if (run.stats == NULL) {
+            ok = FALSE;
+        } else {
+            rachel_stats_init(run.stats);
+        }
+    }
+    if (config->log_path != NULL) {
+        run.log_file = rachel_log_create(config->log_path);
+        if (run.log_file == NULL) {
+            perror(config->log_path);
+            ok = FALSE;
+        }
+    }
+
+    /* Contiguous runs of tasks per worker, stolen from when they run dry */
+    tasks = (config->games + config->batch - 1) / config->batch;
+    for (i = 0; i < run.worker_count; i++) {
+        worker = &run.workers[i];
+        worker->run = &run;
+        worker->index = i;
+        for (k = 0; k < MAX_PLAYERS; k++) {
+            rachel_ai_latency_init(&worker->results.latency[k], config->sla_ns);
+        }
+        rachel_log_init(&worker->log, run.log_file);
+        if (run.stats != NULL) {
+            rachel_stats_init(&worker->stats);
+            rachel_log_set_tap(&worker->log, rachel_stats_tap, &worker->stats);
+        }
+        worker->results.turn_histogram =
+            calloc(config->max_turns + 1, sizeof(unsigned long));
+        if (worker->results.turn_histogram == NULL) {
+            ok = FALSE;
+        }
+        if (config->lockstep) {
+            worker->lockstep_results = calloc(config->batch, sizeof(LockstepResult));
+            if (worker->lockstep_results == NULL ||
+                !rachel_lockstep_init(&worker->lockstep,
+                                      config->batch < LOCKSTEP_MAX_LANES ?
+                                      (unsigned)config->batch : LOCKSTEP_MAX_LANES,
+                                      LOCKSTEP_AUTO)) {
+                ok = FALSE;
+            }
+        }
+        first = tasks * i / run.worker_count;
+        last = tasks * (i + 1) / run.worker_count;
+        atomic_init(&worker->deque.range, ((uint64_t)first << 32) | last);
+    }
+
+    results->elapsed = sim_now();
+    for (i = 0; ok && i < run.worker_count; i++) {
+        if (pthread_create(&run.workers[i].thread, NULL, sim_worker_main,
+                           &run.workers[i]) != 0) {
+            ok = FALSE;
+            break;
+        }
+        started++;
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(run.workers[i].thread, NULL);
+    }
+    results->elapsed = sim_now() - results->elapsed;
+
+    for (i = 0; i < run.worker_count; i++) {
+        if (ok) {
+            sim_merge(results, &run.workers[i].results, config);
+        }
+        free(run.workers[i].results.turn_histogram);
+        free(run.workers[i].lockstep_results);
+        rachel_lockstep_free(&run.workers[i].lockstep);
+        rachel_log_free(&run.workers[i].log);
+    }
+    if (run.log_file != NULL) {
+        if (fclose(run.log_file) != 0 || atomic_load(&run.log_failed)) {
+            printf("Event log %s is incomplete (write failed).\n",
+                   config->log_path);
+            ok = FALSE;
+        }
+    }
+    if (ok && run.stats != NULL &&
+        (atomic_load(&run.log_failed) || !sim_write_stats(run.stats, config))) {
+        printf("Statistics %s could not be written.\n", config->stats_path);
+        ok = FALSE;
+    }
+    free(run.stats);
+    pthread_mutex_destroy(&run.log_lock);
+    free(memory);
+    return ok;
+}
+
+/* Turn count below which the given fraction of games finished */
+static unsigned long sim_percentile(const SimResults* results,
+                                    const SimConfig* config, double fraction) {
+    unsigned long target = (unsigned long)(fraction * results->games_played);
+    unsigned long seen = 0;
+    unsigned long turns;
+
+    for (turns = 0; turns <= config->max_turns; turns++) {
+        seen += results->turn_histogram[turns];
+        if (seen > target) {
+            return turns;
+        }
+    }
+    return config->max_turns;
+}
+
+/* Print the per-game turn-count distribution */
+static void sim_print_histogram(const SimResults* results,
+                                const SimConfig* config) {
+    unsigned long lowest = config->max_turns, highest = 0;
+    unsigned long width, start, turns, count, peak = 0;
+    unsigned long rows[SIM_HISTOGRAM_ROWS];
+    int row, bar;
+
+    for (turns = 0; turns <= config->max_turns; turns++) {
+        if (results->turn_histogram[turns] > 0) {
+            if (turns < lowest) lowest = turns;
+            highest = turns;
+        }
+    }
+    if (highest < lowest) {
+        return;
+    }
+
+    width = (highest - lowest) / SIM_HISTOGRAM_ROWS + 1;
+    memset(rows, 0, sizeof(rows));
+    for (turns = lowest; turns <= highest; turns++) {
+        rows[(turns - lowest) / width] += results->turn_histogram[turns];
+    }
+    for (row = 0; row < SIM_HISTOGRAM_ROWS; row++) {
+        if (rows[row] > peak) peak = rows[row];
+    }
+
+    printf("\nTurns per game:\n");
+    for (row = 0; row < SIM_HISTOGRAM_ROWS; row++) {
+        start = lowest + row * width;
+        if (start > highest) {
+            break;
+        }
+        count = rows[row];
+        printf("  %5lu-%-5lu %10lu %6.2f%% ", start, start + width - 1, count,
+               100.0 * count / results->games_played);
+        for (bar = 0; bar < (int)(40 * count / peak); bar++) {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+/* Every policy's p99 decision time within the SLA */
+static bool_t sim_sla_met(const SimResults* results, const SimConfig* config) {
+    int i;
+
+    for (i = 0; i < config->policy_count; i++) {
+        if (rachel_ai_latency_quantile(&results->latency[i], 0.99) > config->sla_ns) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Per-policy decision latency, and the SLA verdict if one was set */
+static void sim_print_latency(const SimResults* results, const SimConfig* config) {
+    const AiLatency* latency;
+    int i;
+
+    printf("\nPolicy     Decisions    p50 us    p99 us    max us  Over SLA\n");
+    for (i = 0; i < config->policy_count; i++) {
+        latency = &results->latency[i];
+        printf("%-10s %-12lu %8.2f  %8.2f  %8.2f  %lu\n", config->policies[i]->name,
+               latency->decisions,
+               rachel_ai_latency_quantile(latency, 0.50) / 1e3,
+               rachel_ai_latency_quantile(latency, 0.99) / 1e3,
+               latency->max_ns / 1e3, latency->over_budget);
+    }
+    if (config->sla_ns != 0) {
+        printf("SLA:         p99 <= %.2f us per policy: %s\n", config->sla_ns / 1e3,
+               sim_sla_met(results, config) ? "met" : "BROKEN");
+    }
+}
+
+/* Print the run summary */
+static void sim_report(const SimResults* results, const SimConfig* config) {
+    int i;
+
+    printf("Rachel simulator (rules %s)\n", rachel_version());
+    printf("Players:     %d\n", config->players);
+    printf("Seed:        %lu\n", config->seed);
+    printf("Threads:     %d (batches of %lu games)\n",
+           config->threads, config->batch);
+    if (config->lockstep) {
+        printf("Engine:      lockstep, %s kernel\n",
+               rachel_lockstep_has_avx2() ? "AVX2" : "scalar");
+    }
+    printf("Games:       %lu (%lu hit the %lu turn cap)\n",
+           results->games_played, results->games_capped, config->max_turns);
+    printf("Turns:       %.0f (%.1f per game)\n", results->total_turns,
+           results->total_turns / results->games_played);
+    printf("Elapsed:     %.3f s\n", results->elapsed);
+    printf("Games/sec:   %.0f\n", results->games_played / results->elapsed);
+    printf("Turns/sec:   %.0f\n", results->total_turns / results->elapsed);
+    printf("Turn count:  min %lu  p50 %lu  p90 %lu  p99 %lu  max %lu\n",
+           sim_percentile(results, config, 0.0),
+           sim_percentile(results, config, 0.50),
+           sim_percentile(results, config, 0.90),
+           sim_percentile(results, config, 0.99),
+           sim_percentile(results, config, 1.0 - 1e-12));
+
+    printf("Wins by seat:");
+    for (i = 0; i < config->players; i++) {
+        printf(" %lu", results->wins[i]);
+    }
+    printf("\n");
+
+    printf("\nPolicy     Seats        Wins     Win rate\n");
+    for (i = 0; i < config->policy_count; i++) {
+        printf("%-10s %-12lu %-12lu %6.2f%%\n", config->policies[i]->name,
+               results->policy_seats[i], results->policy_wins[i],
+               results->policy_seats[i] ?
+               100.0 * results->policy_wins[i] / results->policy_seats[i] : 0.0);
+    }
+
+    if (config->stats_path != NULL) {
+        printf("\nStatistics:  %s\n", config->stats_path);
+    }
+
+    if (config->timed) {
+        sim_print_latency(results, config);
+    }
+
+    if (!config->quiet) {
+        sim_print_histogram(results, config);
+    }
+}
+
+static void sim_usage(const char* program) {
+    const AiPolicy* policy;
+
+    printf("Usage: %s [-g games] [-p players] [-t max_turns] [-s seed]\n"
+           "       [-j threads] [-b batch] [-a policy,policy,...] [-l log] [-L]\n"
+           "       [-c csv] [-d] [-S usec] [-q]\n",
+           program);
+    printf("  -g games      Number of games to play (default %lu)\n",
+           SIM_DEFAULT_GAMES);
+    printf("  -p players    Players per game, 2-%d (default %d)\n",
+           MAX_PLAYERS, SIM_DEFAULT_PLAYERS);
+    printf("  -t max_turns  Abandon games longer than this (default %lu)\n",
+           SIM_DEFAULT_MAX_TURNS);
+    printf("  -s seed       Base seed, game i uses stream i (default 1)\n");
+    printf("  -j threads    Worker threads, 1-%d (default: all cores)\n",
+           SIM_MAX_THREADS);
+    printf("  -b batch      Games per stealable task (default %lu)\n",
+           SIM_DEFAULT_BATCH);
+    printf("  -a policies   AI policies, rotated through the seats each game\n");
+    printf("  -l log        Append every game to this event log\n");
+    printf("  -L            Lockstep engine, a batch per step (\"first\" only, no -l)\n");
+    printf("  -c csv        Write game statistics by player count to this file\n");
+    printf("  -d            Time every decision, p50/p99/max per policy\n");
+    printf("  -S usec       Decision SLA: exit 1 if a policy's p99 is slower (implies -d)\n");
+    printf("  -q            Summary only\n");
+    printf("\nPolicies:\n");
+    for (policy = rachel_ai_policies; policy->name; policy++) {
+        printf("  %-8s %s\n", policy->name, policy->description);
+    }
+}
+
+/* Comma separated policy names, returns FALSE on an unknown name */
+static bool_t sim_parse_policies(char* list, SimConfig* config) {
+    char* name;
+
+    config->policy_count = 0;
+    config->observe = FALSE;
+    for (name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        if (config->policy_count >= MAX_PLAYERS) {
+            return FALSE;
+        }
+        config->policies[config->policy_count] = rachel_ai_find(name);
+        if (config->policies[config->policy_count] == NULL) {
+            return FALSE;
+        }
+        if (config->policies[config->policy_count]->choose_known != NULL) {
+            config->observe = TRUE;
+        }
+        config->policy_count++;
+    }
+    return config->policy_count > 0;
+}
+
+/* Parse command line, returns FALSE on bad usage */
+static bool_t sim_parse_args(int argc, char** argv, SimConfig* config) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int i;
+
+    config->games = SIM_DEFAULT_GAMES;
+    config->players = SIM_DEFAULT_PLAYERS;
+    config->max_turns = SIM_DEFAULT_MAX_TURNS;
+    config->seed = 1;
+    config->batch = SIM_DEFAULT_BATCH;
+    config->threads = cores < 1 ? 1 : (cores > SIM_MAX_THREADS ?
+                                       SIM_MAX_THREADS : (int)cores);
+    config->policies[0] = rachel_ai_find("first");
+    config->policy_count = 1;
+    config->quiet = FALSE;
+    config->log_path = NULL;
+    config->stats_path = NULL;
+    config->lockstep = FALSE;
+    config->timed = FALSE;
+    config->sla_ns = 0;
+    config->observe = FALSE;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            config->quiet = TRUE;
+        } else if (strcmp(argv[i], "-L") == 0) {
+            config->lockstep = TRUE;
+        } else if (strcmp(argv[i], "-d") == 0) {
+            config->timed = TRUE;
+        } else if (i + 1 < argc && strcmp(argv[i], "-S") == 0) {
+            config->sla_ns = (uint64_t)(strtod(argv[++i], NULL) * 1e3);
+            config->timed = TRUE;
+        } else if (i + 1 < argc && strcmp(argv[i], "-g") == 0) {
+            config->games = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+            config->players = (uint8_t)atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            config->max_turns = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            config->seed = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+            config->threads = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-b") == 0) {
+            config->batch = strtoul(argv[++i], NULL, 10);
+        } else if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+            config->log_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            config->stats_path = argv[++i];
+        } else if (i + 1 < argc && strcmp(argv[i], "-a") == 0) {
+            if (!sim_parse_policies(argv[++i], config)) {
+                return FALSE;
+            }
+        } else {
+            return FALSE;
+        }
+    }
+
+    if (config->lockstep &&
+        (config->policy_count != 1 || strcmp(config->policies[0]->name, "first") != 0 ||
+         config->log_path != NULL || config->stats_path != NULL || config->timed)) {
+        return FALSE;
+    }
+
+    return config->games > 0 && config->max_turns > 0 && config->batch > 0 &&
+           config->games / config->batch < 0xFFFFFFFFUL &&
+           config->threads >= 1 && config->threads <= SIM_MAX_THREADS &&
+           config->players >= 2 && config->players <= MAX_PLAYERS;
+}
+
+int main(int argc, char** argv) {
+    SimConfig config;
+    SimResults results;
+    int i;
+
+    if (!sim_parse_args(argc, argv, &config)) {
+        sim_usage(argv[0]);
+        return 2;
+    }
+
+    if (!rachel_self_test() || !rachel_engine_self_test() ||
+        !rachel_mcts_self_test() || !rachel_log_self_test() ||
+        !rachel_lockstep_self_test() || !rachel_know_self_test() ||
+        !rachel_solver_self_test() || !rachel_stats_self_test() ||
+        !rachel_input_self_test()) {
+        printf("Self test failed! The cards refuse to be dealt.\n");
+        return 1;
+    }
+
+    memset(&results, 0, sizeof(results));
+    for (i = 0; i < MAX_PLAYERS; i++) {
+        rachel_ai_latency_init(&results.latency[i], config.sla_ns);
+    }
+    results.turn_histogram = calloc(config.max_turns + 1, sizeof(unsigned long));
+    if (results.turn_histogram == NULL || !sim_run(&config, &results)) {
+        printf("Could not start the simulation (out of memory or threads).\n");
+        return 1;
+    }
+
+    sim_report(&results, &config);
+
+    free(results.turn_histogram);
+    return config.sla_ns != 0 && !sim_sla_met(&results, &config) ? 1 : 0;
+}
+
+/*
+ * End of simulator.
+ *
+ * No humans were kept waiting in the making of these statistics.
+ */
@@ -2,13 +2,21 @@
  * RACHEL CANONICAL RULES IMPLEMENTATION
  * 
  * This is the sacred implementation. Every platform must behave identically.
- * Pure C89. No dependencies. Compiles everywhere from PDP-11 to modern systems.
+ * Pure C89 plus one 64-bit integer type. No dependencies. Compiles with
+ * DJGPP on DOS and anything newer.
  * 
  * "From 1 MHz to 1 THz, the rules remain the same."
  */
 
 #include "rules.h"
 
+#ifdef RACHEL_DEBUG
+#include <assert.h>
+#define RACHEL_CHECK_HASH(game) assert((game)->hash == rachel_hash_game(game))
+#else
+#define RACHEL_CHECK_HASH(game)
+#endif
+
 /* String functions we implement ourselves for portability */
 static void rachel_strcpy(char* dest, const char* src) {
     while (*src) {
@@ -17,16 +25,531 @@ static void rachel_strcpy(char* dest, const char* src) {
     *dest = '\0';
 }
 
-/* Random number generator - simple but portable */
-static uint32_t rachel_rand_seed = 12345;
+/* Random number generator - PCG32, state lives in the caller's RachelRng */
+#define RACHEL_RNG_MULT    (((uint64_t)0x5851F42DUL << 32) | 0x4C957F2DUL)
+#define RACHEL_RNG_DEFAULT 12345
+
+uint32_t rachel_rng_next(RachelRng* rng) {
+    uint64_t old = rng->state;
+    uint32_t xorshifted, rot;
+    
+    rng->state = old * RACHEL_RNG_MULT + rng->inc;
+    xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+void rachel_rng_seed(RachelRng* rng, uint64_t seed, uint64_t stream) {
+    rng->state = 0;
+    rng->inc = (stream << 1) | 1;
+    rachel_rng_next(rng);
+    rng->state += seed;
+    rachel_rng_next(rng);
+}
+
+/* Uniform in [0, bound) - multiply-shift, bias is negligible for decks */
+uint32_t rachel_rng_below(RachelRng* rng, uint32_t bound) {
+    return (uint32_t)(((uint64_t)rachel_rng_next(rng) * bound) >> 32);
+}
+
+/* Jump ahead delta steps in O(log delta) */
+void rachel_rng_advance(RachelRng* rng, uint64_t delta) {
+    uint64_t cur_mult = RACHEL_RNG_MULT;
+    uint64_t cur_plus = rng->inc;
+    uint64_t acc_mult = 1;
+    uint64_t acc_plus = 0;
+    
+    while (delta > 0) {
+        if (delta & 1) {
+            acc_mult *= cur_mult;
+            acc_plus = acc_plus * cur_mult + cur_plus;
+        }
+        cur_plus = (cur_mult + 1) * cur_plus;
+        cur_mult *= cur_mult;
+        delta >>= 1;
+    }
+    rng->state = acc_mult * rng->state + acc_plus;
+}
+
+/* Fisher-Yates shuffle drawing from the given stream */
+static void rachel_shuffle_rng(Card* cards, uint8_t count, RachelRng* rng) {
+    int i, j;
+    Card temp;
+    
+    for (i = count - 1; i > 0; i--) {
+        j = rachel_rng_below(rng, i + 1);
+        temp = cards[i];
+        cards[i] = cards[j];
+        cards[j] = temp;
+    }
+}
+
+/* Bitboard tables - one bit per card, see rules.h for the layout */
+const uint64_t rachel_suit_masks[4] = {
+    RACHEL_SUIT_MASK(SUIT_HEARTS),
+    RACHEL_SUIT_MASK(SUIT_DIAMONDS),
+    RACHEL_SUIT_MASK(SUIT_CLUBS),
+    RACHEL_SUIT_MASK(SUIT_SPADES)
+};
+
+const uint64_t rachel_rank_masks[16] = {
+    0, 0,
+    RACHEL_RANK_MASK(RANK_2),
+    RACHEL_RANK_MASK(RANK_3),
+    RACHEL_RANK_MASK(RANK_4),
+    RACHEL_RANK_MASK(RANK_5),
+    RACHEL_RANK_MASK(RANK_6),
+    RACHEL_RANK_MASK(RANK_7),
+    RACHEL_RANK_MASK(RANK_8),
+    RACHEL_RANK_MASK(RANK_9),
+    RACHEL_RANK_MASK(RANK_10),
+    RACHEL_RANK_MASK(RANK_JACK),
+    RACHEL_RANK_MASK(RANK_QUEEN),
+    RACHEL_RANK_MASK(RANK_KING),
+    RACHEL_RANK_MASK(RANK_ACE),
+    RACHEL_MASK_JOKERS
+};
+
+/*
+ * Lookup tables built by the preprocessor, so they are constant data
+ * on every compiler with nothing to initialise at startup.
+ *
+ * rachel_card_bits: the bitboard bit of every encoded byte.
+ *
+ * rachel_playable_table: every card that may go on the pile, indexed
+ * by RACHEL_PLAYABLE_INDEX - effect class (none, 2, 7, jack), top card
+ * as 2 suit + 4 rank bits, and nomination + 1 in 3 bits (0 = none).
+ * Entries follow rachel_can_play_card_reference below, which the self
+ * test checks them against over every reachable combination.
+ */
+#define RACHEL_T_CLAMP(r)    ((r) >= RANK_2 && (r) <= RANK_ACE ? (r) : RANK_2)
+#define RACHEL_T_RANK(r)     ((r) == RANK_JOKER ? RACHEL_MASK_JOKERS :          \
+                              (r) >= RANK_2 && (r) <= RANK_ACE ?                \
+                              RACHEL_RANK_MASK(RACHEL_T_CLAMP(r)) : (uint64_t)0)
+#define RACHEL_T_BIT(b)      (GET_RANK(b) == RANK_JOKER ? RACHEL_JOKER_BIT :    \
+                              GET_RANK(b) >= RANK_2 && GET_RANK(b) <= RANK_ACE ? \
+                              (uint64_t)1 << (GET_SUIT(b) * 13 +                \
+                                              RACHEL_T_CLAMP(GET_RANK(b)) -     \
+                                              RANK_2) : (uint64_t)0)
+#define RACHEL_T_BIT4(b)     RACHEL_T_BIT(b), RACHEL_T_BIT((b) + 1),            \
+                             RACHEL_T_BIT((b) + 2), RACHEL_T_BIT((b) + 3)
+#define RACHEL_T_BIT16(b)    RACHEL_T_BIT4(b), RACHEL_T_BIT4((b) + 4),          \
+                             RACHEL_T_BIT4((b) + 8), RACHEL_T_BIT4((b) + 12)
+#define RACHEL_T_BIT64(b)    RACHEL_T_BIT16(b), RACHEL_T_BIT16((b) + 16),       \
+                             RACHEL_T_BIT16((b) + 32), RACHEL_T_BIT16((b) + 48)
+
+const uint64_t rachel_card_bits[256] = {
+    RACHEL_T_BIT64(0), RACHEL_T_BIT64(64), RACHEL_T_BIT64(128), RACHEL_T_BIT64(192)
+};
+
+/* Top t = suit << 4 | rank, nomination n = suit + 1 or 0 */
+#define RACHEL_T_SUIT(t, n)  ((n) == 0 ? RACHEL_SUIT_MASK((t) >> 4) :          \
+                              (n) <= 4 ? RACHEL_SUIT_MASK((n) <= 4 ? (n) - 1 : 0) \
+                                       : (uint64_t)0)
+#define RACHEL_T_NORMAL(t, n) (RACHEL_T_RANK((t) & 0x0F) | RACHEL_MASK_JOKERS |  \
+                               RACHEL_T_SUIT(t, n))
+#define RACHEL_T_ENTRY(e, t, n)                                                  \
+    ((e) == 1 ? RACHEL_RANK_MASK(RANK_2) :                                       \
+     (e) == 2 ? RACHEL_RANK_MASK(RANK_7) :                                       \
+     (e) == 3 && ((t) & 0x0F) == RANK_JACK && ((t) >> 4) >= SUIT_CLUBS ?         \
+         RACHEL_RANK_MASK(RANK_JACK) : RACHEL_T_NORMAL(t, n))
+#define RACHEL_T_NOM(e, t)   RACHEL_T_ENTRY(e, t, 0), RACHEL_T_ENTRY(e, t, 1),  \
+                             RACHEL_T_ENTRY(e, t, 2), RACHEL_T_ENTRY(e, t, 3),  \
+                             RACHEL_T_ENTRY(e, t, 4), RACHEL_T_ENTRY(e, t, 5),  \
+                             RACHEL_T_ENTRY(e, t, 6), RACHEL_T_ENTRY(e, t, 7)
+#define RACHEL_T_TOP4(e, t)  RACHEL_T_NOM(e, t), RACHEL_T_NOM(e, (t) + 1),      \
+                             RACHEL_T_NOM(e, (t) + 2), RACHEL_T_NOM(e, (t) + 3)
+#define RACHEL_T_TOP16(e, t) RACHEL_T_TOP4(e, t), RACHEL_T_TOP4(e, (t) + 4),    \
+                             RACHEL_T_TOP4(e, (t) + 8), RACHEL_T_TOP4(e, (t) + 12)
+#define RACHEL_T_TOP64(e)    RACHEL_T_TOP16(e, 0), RACHEL_T_TOP16(e, 16),       \
+                             RACHEL_T_TOP16(e, 32), RACHEL_T_TOP16(e, 48)
+
+/* Index parts, pre-shifted: effect type to class << 9, top card to
+ * (suit << 4 | rank) << 3 */
+#define RACHEL_T_CLASS(t)    ((t) == RANK_2 ? 1 << 9 : (t) == RANK_7 ? 2 << 9 :  \
+                              (t) == RANK_JACK ? 3 << 9 : 0)
+#define RACHEL_T_CLASS4(t)   RACHEL_T_CLASS(t), RACHEL_T_CLASS((t) + 1),        \
+                             RACHEL_T_CLASS((t) + 2), RACHEL_T_CLASS((t) + 3)
+#define RACHEL_T_CLASS16(t)  RACHEL_T_CLASS4(t), RACHEL_T_CLASS4((t) + 4),      \
+                             RACHEL_T_CLASS4((t) + 8), RACHEL_T_CLASS4((t) + 12)
+#define RACHEL_T_CLASS64(t)  RACHEL_T_CLASS16(t), RACHEL_T_CLASS16((t) + 16),   \
+                             RACHEL_T_CLASS16((t) + 32), RACHEL_T_CLASS16((t) + 48)
+#define RACHEL_T_ROW(b)      (((((b) >> 2) & 0x30) | ((b) & 0x0F)) << 3)
+#define RACHEL_T_ROW4(b)     RACHEL_T_ROW(b), RACHEL_T_ROW((b) + 1),            \
+                             RACHEL_T_ROW((b) + 2), RACHEL_T_ROW((b) + 3)
+#define RACHEL_T_ROW16(b)    RACHEL_T_ROW4(b), RACHEL_T_ROW4((b) + 4),          \
+                             RACHEL_T_ROW4((b) + 8), RACHEL_T_ROW4((b) + 12)
+#define RACHEL_T_ROW64(b)    RACHEL_T_ROW16(b), RACHEL_T_ROW16((b) + 16),       \
+                             RACHEL_T_ROW16((b) + 32), RACHEL_T_ROW16((b) + 48)
+
+static const uint16_t rachel_effect_rows[256] = {
+    RACHEL_T_CLASS64(0), RACHEL_T_CLASS64(64),
+    RACHEL_T_CLASS64(128), RACHEL_T_CLASS64(192)
+};
+
+static const uint16_t rachel_top_rows[256] = {
+    RACHEL_T_ROW64(0), RACHEL_T_ROW64(64), RACHEL_T_ROW64(128), RACHEL_T_ROW64(192)
+};
+
+const uint64_t rachel_playable_table[RACHEL_PLAYABLE_ENTRIES] = {
+    RACHEL_T_TOP64(0), RACHEL_T_TOP64(1), RACHEL_T_TOP64(2), RACHEL_T_TOP64(3)
+};
+
+uint64_t rachel_card_bit(Card card) {
+    return rachel_card_bits[card.encoded];
+}
+
+Card rachel_card_from_index(uint8_t index) {
+    Card card;
+    
+    if (index >= STANDARD_DECK) {
+        card.encoded = RANK_JOKER;
+    } else {
+        card.encoded = MAKE_CARD(index / 13, index % 13 + RANK_2);
+    }
+    return card;
+}
+
+/* Jokers are a unary counter in bits 52-55 */
+uint64_t rachel_mask_add(uint64_t mask, Card card) {
+    if (IS_JOKER(card.encoded)) {
+        return mask | ((((mask & RACHEL_MASK_JOKERS) << 1) | RACHEL_JOKER_BIT) &
+                       RACHEL_MASK_JOKERS);
+    }
+    return mask | rachel_card_bit(card);
+}
+
+uint64_t rachel_mask_remove(uint64_t mask, Card card) {
+    if (IS_JOKER(card.encoded)) {
+        return (mask & ~RACHEL_MASK_JOKERS) |
+               (((mask & RACHEL_MASK_JOKERS) >> 1) & RACHEL_MASK_JOKERS);
+    }
+    return mask & ~rachel_card_bit(card);
+}
+
+uint8_t rachel_mask_count(uint64_t mask) {
+    mask = mask - ((mask >> 1) & (((uint64_t)0x55555555UL << 32) | 0x55555555UL));
+    mask = (mask & (((uint64_t)0x33333333UL << 32) | 0x33333333UL)) +
+           ((mask >> 2) & (((uint64_t)0x33333333UL << 32) | 0x33333333UL));
+    mask = (mask + (mask >> 4)) & (((uint64_t)0x0F0F0F0FUL << 32) | 0x0F0F0F0FUL);
+    return (uint8_t)((mask * (((uint64_t)0x01010101UL << 32) | 0x01010101UL)) >> 56);
+}
+
+uint8_t rachel_mask_lowest(uint64_t mask) {
+    uint8_t index = 0;
+    
+    while (!(mask & 1)) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+}
+
+/* Zobrist keys - generated once from PCG32 seed 0x5A0B stream 0, in
+ * declaration order. The self test regenerates them, never edit by hand. */
+#define Z(hi, lo) (((uint64_t)hi##UL << 32) | lo##UL)
+#define RACHEL_ZOBRIST_SEED 0x5A0B
+
+static const uint64_t rachel_zobrist_hand[MAX_PLAYERS][56] = {
+    {
+        Z(0xD7B1F3F9, 0xD8993181), Z(0xD3DFE94F, 0x253BD682), Z(0xC35FBFD0, 0x1FE631F1),
+        Z(0x621C9438, 0x4A6E92DC), Z(0xC3943BAC, 0x524AA90F), Z(0xB8E6BC23, 0x28056B08),
+        Z(0xF8A88E45, 0xAC119DAE), Z(0xE62F3484, 0x37878283), Z(0xCF34410F, 0x6BF4EAFA),
+        Z(0x658DD4CB, 0x95971AFA), Z(0xC05DC0A4, 0x1D65E7D2), Z(0x22797E20, 0xCC3792BF),
+        Z(0x92DCB2C7, 0x3AED0FA2), Z(0xED8E1F29, 0x8054ACA9), Z(0xC100EC23, 0x871D6B65),
+        Z(0x32509665, 0x07E8AEAE), Z(0x17A5637C, 0x1E69F771), Z(0x0A358B92, 0x3E635084),
+        Z(0xB1FCA58E, 0x7122B232), Z(0x30353ED0, 0xFE5E9BCF), Z(0x8A150332, 0x49343487),
+        Z(0x8710F832, 0x1A9FB908), Z(0xB0C85F49, 0xD857A9B4), Z(0x89C59680, 0xDC8103E7),
+        Z(0xD930D3B1, 0xED26A2B0), Z(0xDE6304AC, 0x2A9F23BA), Z(0x9D03C4A4, 0x77DD83CC),
+        Z(0x9B756F83, 0xCEFECCE8), Z(0xD727F5FD, 0x05B186F6), Z(0x9FFB15FC, 0x30429E13),
+        Z(0x28A3B1B4, 0xD6689440), Z(0xD1D59201, 0xD724F9CA), Z(0xD513D3C6, 0x4C2F7141),
+        Z(0x7484E1FB, 0x8C368320), Z(0x4DDA8FA2, 0x2A668D4D), Z(0x03AA8BB2, 0x0CD08FE2),
+        Z(0x8D9F4CAE, 0xF28AC65F), Z(0x0EBE277B, 0x3559D20E), Z(0xD940B24C, 0x1F4D85D5),
+        Z(0xAEDAED37, 0xD6BB5786), Z(0x11805883, 0xC8976BB8), Z(0x9915980C, 0x9B1F44F4),
+        Z(0xC14B5439, 0x3F27019E), Z(0x98B004AE, 0xDA5728CB), Z(0x787BC911, 0x8B144E2F),
+        Z(0xE05A0CF2, 0x1F49E48F), Z(0x99ABF824, 0x68149BBC), Z(0x4CCE74DF, 0x07BEC544),
+        Z(0xA773176C, 0x15917A16), Z(0x6D2B4C2C, 0x0F85E0A4), Z(0xBCB39708, 0xF54AAE2C),
+        Z(0x709C4F86, 0x78418220), Z(0x86F0B52A, 0x592D9BE8), Z(0x184604DC, 0xE73429CF),
+        Z(0xB32D5836, 0x2381E2EB), Z(0x42D3A3EE, 0x54F28427)
+    },
+    {
+        Z(0xD21386EA, 0xA4B044E6), Z(0xACB5E8B2, 0x858CC631), Z(0xF95DE515, 0xA39E0B04),
+        Z(0x918C08FF, 0x043A88B2), Z(0xE37ECA4F, 0xC68D5275), Z(0x1305E097, 0x4F1F2B84),
+        Z(0x927C7F34, 0x4EC3A778), Z(0xB2970CAD, 0x010708CA), Z(0x3F2CF836, 0xBEB240B3),
+        Z(0x09B0A618, 0xFB31B7E7), Z(0xEE8898E0, 0x5219446D), Z(0x9896AC18, 0xE1D42AA4),
+        Z(0x4B776035, 0x6D607598), Z(0xB169D524, 0xE5518920), Z(0x94314369, 0x812D335F),
+        Z(0x81ED26EF, 0xD7BA7D2D), Z(0xE9763AFE, 0xAA67D8BE), Z(0xDA0E9D64, 0xAC73EBFB),
+        Z(0x31E93E0F, 0xF6673310), Z(0x0634FE13, 0x0B911F80), Z(0x66F2626B, 0xAB9E725A),
+        Z(0xE82CF365, 0x2F6D124E), Z(0x177B0980, 0x70C6870E), Z(0xD2C3AD46, 0x72D7523D),
+        Z(0xED7C2B79, 0x333D26EA), Z(0x83A5183F, 0x03B7A8CB), Z(0x893E857F, 0x6509307B),
+        Z(0x1F8FA9DA, 0xD3C1DB62), Z(0xFB32ABC5, 0x3C777453), Z(0xA0DF8EDF, 0xF67C0352),
+        Z(0x02A4D1AF, 0x6E6CE22E), Z(0xEEC59CA7, 0x64807E19), Z(0xA1CA0311, 0x8D119ABD),
+        Z(0x6C03A35A, 0x350B08BD), Z(0x275E4463, 0x1EF52693), Z(0x7BBA6BE4, 0x112BF7F2),
+        Z(0xDF09FF36, 0xAECC41BB), Z(0x68D9E3F8, 0x27C31052), Z(0x1D1086FE, 0x21DA8BAC),
+        Z(0x1B487C76, 0xF91D57AF), Z(0xC33CB3A0, 0x5B2F89D8), Z(0x95E9FF38, 0x80B9C705),
+        Z(0xC285EEA9, 0x7DC7E026), Z(0x9157A385, 0x7791F9A1), Z(0x3D82ACED, 0x3D9B93FC),
+        Z(0xF70DAFC8, 0xD41210FF), Z(0x018FB954, 0x230BC1D4), Z(0xD3FCF02D, 0x5175A6F3),
+        Z(0x8EE9DA41, 0xE6E18B5F), Z(0xE53DA5AD, 0xBDD9B45C), Z(0x1605D3C8, 0x2E76A5B0),
+        Z(0x3CE3AFEA, 0x59754289), Z(0xEC0828EC, 0xD660BBAD), Z(0xB86C0FAE, 0xBE5D4D2C),
+        Z(0xED2775D5, 0xB2546D57), Z(0x3A38D188, 0x3683866B)
+    },
+    {
+        Z(0x02243952, 0xDAA39A25), Z(0xCBBDCDEB, 0xCA2A40E3), Z(0x0AEF133A, 0x7B4E0139),
+        Z(0xD60A67D1, 0x38FD6808), Z(0xF476EFF8, 0xE15DE8B1), Z(0x31BE9669, 0xC9CB3D9C),
+        Z(0xCC5BE88E, 0x9E20103E), Z(0xC176369D, 0xE5CBEB4F), Z(0x93A0A73B, 0x6BD3DEF3),
+        Z(0x7E5E4B4A, 0x52D97174), Z(0x3FD4222B, 0x633DAB3A), Z(0x641B48AF, 0xA975C3F5),
+        Z(0x7D34E8B4, 0x1D7DE90F), Z(0x0BFCBD5C, 0xEE8D2F49), Z(0x48926DF1, 0xAB5CF9B9),
+        Z(0x48332639, 0x4869F928), Z(0x0947B0F5, 0xDF553162), Z(0xE000277B, 0x689CF719),
+        Z(0x379BB3BD, 0xA3C60BCF), Z(0x95E8C983, 0x1792DDCE), Z(0xC139499B, 0x5FD194C4),
+        Z(0xB9D794D7, 0x08520356), Z(0x803F67AA, 0xEA92F20B), Z(0x3744D531, 0xBAE59033),
+        Z(0xEFA9605E, 0xEAF87024), Z(0xAD40188A, 0xA3247C70), Z(0xF70601E1, 0x2C4496E0),
+        Z(0x5D3F31FE, 0xFF1D8525), Z(0x2A4FDF7C, 0xE7EEFB64), Z(0x28B99869, 0x7B2BB5C9),
+        Z(0xC214D516, 0x14EFF2D0), Z(0xD3A80A4D, 0xD32426ED), Z(0x81BB1581, 0x2F37AC4B),
+        Z(0x693A3063, 0x322E3EF5), Z(0x307B290E, 0x2A996BA8), Z(0x47E9075C, 0x79FD43BE),
+        Z(0x2C23C290, 0x41A3D2F5), Z(0x6CEB7E64, 0x4CA42931), Z(0x2F0892AE, 0x777C9729),
+        Z(0xBE2E893F, 0x095F0DD9), Z(0x8459C749, 0xA11788D9), Z(0xC7AAFA48, 0x8ECA630A),
+        Z(0x460C5844, 0x0C743798), Z(0x26D0CA06, 0xCFDE3349), Z(0xD206FD37, 0xF2CD412E),
+        Z(0xAC7A5D74, 0xB64601DA), Z(0x29FC70D5, 0x55F7FDE5), Z(0xA9CBA6E4, 0x3BDA6686),
+        Z(0xD9D55938, 0xE8E14A55), Z(0x943B5285, 0x281749D5), Z(0x90BE46C6, 0xF706B8C8),
+        Z(0x4A67192E, 0x2B182714), Z(0xB84A12B3, 0xF93E6372), Z(0x2BD4D652, 0x3FE7AB2B),
+        Z(0xEF0E5369, 0x9CB05546), Z(0xD2C17645, 0x6D084B5B)
+    },
+    {
+        Z(0xA32CC47B, 0x88DACAA1), Z(0x8CCD52A2, 0x14634D98), Z(0xEEC19DF9, 0x2D79AC15),
+        Z(0x54C5E28F, 0xE9A2917D), Z(0x1A11FE08, 0xE7B3446A), Z(0x1E72AF2F, 0x06BD1EEB),
+        Z(0x23FE2561, 0x69DC7993), Z(0x3B6CCCD8, 0xB4202E6B), Z(0xBF013F4F, 0xDC767C37),
+        Z(0x6260577C, 0x71EAF319), Z(0x1CAADB44, 0x5F375BCC), Z(0x2299568F, 0x6CAC5C49),
+        Z(0x6C104EC5, 0xDEBED2B1), Z(0x7A889EA4, 0xDB7B346C), Z(0x658F01B1, 0x8470F014),
+        Z(0xD7494B09, 0x22DF45E1), Z(0x5461BFC3, 0x05D01519), Z(0x6A96B0C3, 0xF11B2884),
+        Z(0x85B34C92, 0x4B6AC2ED), Z(0x65E421F9, 0x074251F4), Z(0x1F5CBF57, 0xF344262C),
+        Z(0xC5FEAF04, 0xA30F6C17), Z(0xFD3E026D, 0x9CFA839F), Z(0xFC046917, 0x37BA816D),
+        Z(0x46087688, 0x4A7AE5CA), Z(0xA0771F83, 0x5D3F939B), Z(0x60D43C45, 0x5F32B924),
+        Z(0xF6E03EDD, 0x119B5C88), Z(0x2D663959, 0x1F5F39C7), Z(0xEC815897, 0x845030FB),
+        Z(0x4FCD7188, 0x3AE8CEB5), Z(0x01D2023C, 0x8F240F25), Z(0x6241A014, 0xBCB9BC38),
+        Z(0x64B02082, 0x0F09B1B4), Z(0x724802AA, 0xB9F1A69F), Z(0x073BACFE, 0x8DF8017E),
+        Z(0xE60A6970, 0xAE839DAC), Z(0xCB5FEAF8, 0x52989CCB), Z(0x9A805EA7, 0xF3670CC4),
+        Z(0xB59B3F38, 0xC4AAE660), Z(0x88B8BE34, 0x62374616), Z(0x7797B507, 0x4017E68C),
+        Z(0xCC1AC24D, 0x2FDA997A), Z(0x7E99E98D, 0x2E1C0CF2), Z(0x83A2EE65, 0xF30D7D0F),
+        Z(0x4449BFB3, 0xB1618BE8), Z(0xF37CC6A3, 0x866578A1), Z(0xE924DAFE, 0xAE3C5B60),
+        Z(0x3C714640, 0xB6DC5B6B), Z(0x588F46B3, 0xD0883721), Z(0xE301606F, 0x589076E4),
+        Z(0x48D222D9, 0x1D48C61A), Z(0x2CB61AB4, 0x4CF88B19), Z(0xB7264332, 0x23E2BC97),
+        Z(0xA3AEE987, 0x15584C0D), Z(0xEADF8828, 0x2AC18047)
+    },
+    {
+        Z(0xFA690759, 0xDADA26E2), Z(0x4FD7D07E, 0xF363D578), Z(0xE6F58053, 0x1E9F7150),
+        Z(0xA7905899, 0x2DE367EB), Z(0x43D1117C, 0x3CB53DA7), Z(0x4E27D7D9, 0x3523C645),
+        Z(0x5EA2FE37, 0xDFF82482), Z(0x1FC9DC5E, 0x8EA2442A), Z(0xF186327E, 0x2E0EE634),
+        Z(0x30EA3968, 0xBB34102D), Z(0x1C8726C7, 0x0B56A77B), Z(0x500F5081, 0x6A5F186D),
+        Z(0xA8D5BED2, 0x55BF00CE), Z(0xC362AEF1, 0x9EA154CC), Z(0xE43A8C42, 0xE763FEB6),
+        Z(0x0616907C, 0x7FE055C6), Z(0xB450D650, 0xF353D894), Z(0xC7740BDD, 0x1E56EEF3),
+        Z(0x57B835FA, 0x81FEFEA6), Z(0x6024F18F, 0x12F8F48B), Z(0x94796577, 0x58E1BE0D),
+        Z(0x0C9DC89F, 0x76659B00), Z(0x1A6BE6F0, 0x22BF1FD2), Z(0x3AD1E7C5, 0x4F7E0CD4),
+        Z(0x3CC592AD, 0xAC098B44), Z(0xD87E0C05, 0xA5764D56), Z(0xE9707785, 0x1E453077),
+        Z(0x3727FD33, 0x7519C2CE), Z(0x300140ED, 0xA73221B0), Z(0xE398806B, 0x1E1EBC3D),
+        Z(0x43728C20, 0xBE17CC2D), Z(0x7EB996AC, 0x77900C93), Z(0xBA20C2E7, 0x3A7FE849),
+        Z(0xF12EC153, 0x1796B654), Z(0x01F57C86, 0x7A36E702), Z(0x059315B9, 0x0221018A),
+        Z(0xABAEEFB4, 0xF1CD173A), Z(0xE6EED38D, 0xB878F4CC), Z(0x1646BDE7, 0x477905AD),
+        Z(0x9DFCEA4E, 0x328DA36F), Z(0xBD447F48, 0x4E9F79F6), Z(0x9CC7FDC8, 0xC11298EE),
+        Z(0x149DD63C, 0x94379775), Z(0x2B508C42, 0xB780FE0E), Z(0x148C0461, 0xA333F6B8),
+        Z(0x3F787DF3, 0x48344C9E), Z(0xE6A74F66, 0x1167139E), Z(0xCAB986CC, 0xC21ADB06),
+        Z(0x019A0D2B, 0xEDC255E3), Z(0x69FA947C, 0xA05AF370), Z(0x2B2F3926, 0xA6BEF863),
+        Z(0xFA5DCAE4, 0x6368CFF9), Z(0x6C7AFBA1, 0xFEFF9B51), Z(0x23C05BCA, 0x48D7FDCD),
+        Z(0x849F297E, 0xBDAFEEFA), Z(0xA7CA9C98, 0xF509E31C)
+    },
+    {
+        Z(0xE94E4DFD, 0x68BE29D3), Z(0x6FE8707E, 0x90857214), Z(0x199C80C7, 0x95401A8F),
+        Z(0x5CAA5E7F, 0x3DAE7FF6), Z(0x3E4DFE7B, 0x7C179CD5), Z(0x5A676951, 0x1460DDA5),
+        Z(0x152CA3BD, 0x7AA26D6A), Z(0x26AB73D3, 0x5F6D35EE), Z(0xAB3A5E54, 0x4AC36122),
+        Z(0x90C70ABC, 0xC2C2C3D5), Z(0x35031DB1, 0x0CC9A2ED), Z(0x651CD0D0, 0xF0AC0D04),
+        Z(0xCD0E7D5C, 0x1F4C9110), Z(0xD2896CBF, 0xC68B1958), Z(0xE729958A, 0xDB3D9D9C),
+        Z(0x16F02A8A, 0x6D4944D5), Z(0x39CF9D14, 0x6252CA61), Z(0x541A14BF, 0x37767AF0),
+        Z(0xA54506E3, 0x81E2F2F4), Z(0xF200CF89, 0x57FC5A59), Z(0x9C13CE38, 0x0D571F12),
+        Z(0x230E7A97, 0x4E35E799), Z(0x216C1890, 0x1D6FE09C), Z(0xD7607F59, 0xC811FEE7),
+        Z(0x9A32F07A, 0x46F811A2), Z(0x15749707, 0x34807569), Z(0x0747FEB5, 0x2235B779),
+        Z(0xD68C14AF, 0x3453B2B2), Z(0x34CDC352, 0x189346BF), Z(0x7FFBF603, 0x40C15669),
+        Z(0xD062A037, 0x62B771A2), Z(0x363C0D44, 0xF8F75552), Z(0xC1F0332C, 0xD8007C95),
+        Z(0x10CC9D0A, 0x91ABE0CD), Z(0x2FB5F1E8, 0x5F23A3DD), Z(0xD201FDC5, 0xA603D8EA),
+        Z(0xB9AFF239, 0x19C36631), Z(0x3D77F4E2, 0x4C114812), Z(0xCC06E0F7, 0x48DCB698),
+        Z(0x5889ED42, 0x9818A35B), Z(0x4B0FAABF, 0x12E18C7C), Z(0xE515B215, 0x5101B6E1),
+        Z(0x278842F8, 0xF7555FA1), Z(0xECAC7B9D, 0x76C8C51F), Z(0xBE3768C5, 0x217F0B75),
+        Z(0x4F7811DF, 0x78C5930C), Z(0x9FD4A7A6, 0x756FF991), Z(0xA2713EC3, 0x790F2BBC),
+        Z(0x5275D1CC, 0x778B28E5), Z(0x79BA670D, 0xB150AE3D), Z(0x943B0623, 0x2E33DF92),
+        Z(0x5B81F88B, 0x20D30D10), Z(0x25011F09, 0x55ABFE45), Z(0x1ABAAFBF, 0xE975BD75),
+        Z(0x519D0B5B, 0x83DD7F16), Z(0xB3189011, 0xF925DB0D)
+    },
+    {
+        Z(0xBD2AD89E, 0x6F527FDD), Z(0xDBF91946, 0x12B1F14C), Z(0x44A2BF68, 0xC0AC4C76),
+        Z(0x90EAE103, 0x459C647A), Z(0x72A28CF7, 0xC6B4EC9D), Z(0xCAEF1B31, 0x05C9FF54),
+        Z(0xBE73146A, 0xD0D63770), Z(0xEADFDA0B, 0xD0B88264), Z(0x46CEAACC, 0x4C1CBC7C),
+        Z(0x88F79C53, 0x8B31CBE3), Z(0x9417B390, 0x75423811), Z(0x25EA7BA9, 0x31209A4F),
+        Z(0xFE8660DC, 0x93766396), Z(0xC754755E, 0xFF68167C), Z(0x0F5DD423, 0xF978E302),
+        Z(0xF3E09876, 0x175A6231), Z(0xBCC59F23, 0x01691D5E), Z(0x2AE59A1B, 0x21620562),
+        Z(0xFD48677C, 0xD36C9B8A), Z(0x74C4A95D, 0x475871B3), Z(0xEF9A491B, 0x4D548B89),
+        Z(0x0E17D228, 0x09A78A1A), Z(0x70819831, 0x07DB5163), Z(0x366B0DC5, 0x0C5CE93A),
+        Z(0x5F6DAE5D, 0xC2F2F07E), Z(0x27F49658, 0xE3C41162), Z(0xB9B130D7, 0x0D098BC8),
+        Z(0xF360E81D, 0x3367A3CA), Z(0xD1CA7584, 0x9BB1A7BD), Z(0x5C8DC557, 0x7D0C5536),
+        Z(0xA30491C2, 0xC8533B63), Z(0x934B7B83, 0x94BF9A68), Z(0x3F27809C, 0xC1B8E63C),
+        Z(0x39B349BE, 0x217A8AA9), Z(0x508E97D3, 0xC8D687E1), Z(0x7EBEF4A6, 0x46E68A39),
+        Z(0x49294723, 0xAEEC003F), Z(0xB81D9AE5, 0xCF8A19D7), Z(0x2BA98EC8, 0x9FB57F44),
+        Z(0x6ADDA1ED, 0xF306E06E), Z(0x51C2DC34, 0x287CFE28), Z(0x3AD4910E, 0x372E283C),
+        Z(0xAEB751D3, 0x8998145F), Z(0x0F06E2FF, 0x6A91516C), Z(0x730E70B2, 0x912A9E18),
+        Z(0xA4FEF0D5, 0xA4386123), Z(0xC0DA02B7, 0x2E78EEE6), Z(0x6BAC696C, 0xD376ADCD),
+        Z(0x1EE8814A, 0x56603528), Z(0x7E9179AE, 0xEB902A05), Z(0xC1C1E0CA, 0x7292B6DE),
+        Z(0xD10B8C96, 0x78A633C3), Z(0x03AC8684, 0xC5FB0FC7), Z(0x8F2E80B2, 0x5064CD1A),
+        Z(0x96953C7A, 0xDEFDC197), Z(0x5F33C704, 0x2AE98A1C)
+    },
+    {
+        Z(0x4565A92A, 0xD38F441D), Z(0x7A8E48BE, 0x1B4223B7), Z(0xD5BA3764, 0x96375168),
+        Z(0x0E37F055, 0x562E0306), Z(0x60CA90B4, 0x22270D2D), Z(0xD555DE4A, 0x9F488493),
+        Z(0x7D87D497, 0xF451C0D1), Z(0x4E32423B, 0x00AD5C86), Z(0x51325E34, 0x51704021),
+        Z(0xA4F68611, 0x5F7E7290), Z(0xD6C7FB63, 0x2AC8A5BC), Z(0x40BB843F, 0x07230948),
+        Z(0x7ABB866F, 0x607BA683), Z(0xA12CF77B, 0x823CC2AC), Z(0x99D6C3CC, 0x493D9909),
+        Z(0x498A919A, 0xAF385042), Z(0x7F6B6EA4, 0x21C93E7A), Z(0x26715A1F, 0xAB5C6F0E),
+        Z(0xFD97938E, 0x65B7DD91), Z(0x3A88B974, 0xF2411560), Z(0x2B87F4A2, 0xB87C7F1C),
+        Z(0x38574265, 0x95110592), Z(0xC1BB83C1, 0x3641174D), Z(0x00EE1EF1, 0xEEADD846),
+        Z(0x163C2921, 0xAF8F6072), Z(0x24A9BA2F, 0x679D113D), Z(0xA02514A2, 0x8B0B54BB),
+        Z(0x751831B7, 0xA12E25F7), Z(0xA7BB3901, 0xD7EA9A39), Z(0xC50E7691, 0xBFBDA701),
+        Z(0x3A085903, 0x27F2CFE1), Z(0xC6BCC834, 0x0A3119B5), Z(0xD32F4B40, 0xCA5F1415),
+        Z(0xBE83CF3E, 0x21EA4E6C), Z(0xB1B5F532, 0x0211FBBA), Z(0xEF403228, 0xE9C2F012),
+        Z(0x87C60FFB, 0x828927F9), Z(0xE1A767E0, 0x386A83C2), Z(0x7D13D25C, 0x47DDD6EE),
+        Z(0x2A656F4C, 0x9462BD2F), Z(0x57C77B41, 0x87EC1B19), Z(0xD6641504, 0xA0370D64),
+        Z(0xE1A37474, 0x019FFD98), Z(0x7F3F8ADD, 0x1391EBDF), Z(0xE702A973, 0x3FC735C3),
+        Z(0x402440D3, 0xF8789566), Z(0x2889CFB1, 0x3F0708A9), Z(0xF6DAF506, 0x4A0DA9D3),
+        Z(0x46CB740A, 0xF8B5C489), Z(0xC0F03D5A, 0x1393ED65), Z(0x426BCF19, 0xA2287429),
+        Z(0xB7260DA0, 0x962FD5B1), Z(0x9DB0FAE8, 0x1FE334A5), Z(0x2DB371E3, 0xD7EEAE45),
+        Z(0x23598D46, 0x1CA9D67E), Z(0x2A41249B, 0x0ACD086F)
+    }
+};
+
+static const uint64_t rachel_zobrist_top[56] = {
+    Z(0x5F335830, 0x40E4E06A), Z(0xCE721A7C, 0x0BDB642C), Z(0x31A303B8, 0xA3018FE8),
+    Z(0x2AC1D8D7, 0x7A5972F2), Z(0xD49AE1F2, 0xF4F0B093), Z(0xEA0BA8B7, 0xB9BC0CBE),
+    Z(0xF67171C4, 0xF7FA3AF1), Z(0x9D786285, 0xACC97EEC), Z(0xD8288F95, 0xB76574AA),
+    Z(0x5C9722F0, 0xA433310C), Z(0x7FB1FA7C, 0x626A98D6), Z(0x78D0CE60, 0xEA5F4D07),
+    Z(0x1823E66B, 0xA6E9A687), Z(0xCA9E522E, 0x2472C9CB), Z(0x525388A4, 0x588DABA4),
+    Z(0x4878DB2E, 0x10B87895), Z(0xEEE5EF2F, 0xE9F86B1F), Z(0xDEC594DE, 0xF91A9648),
+    Z(0x0CE8BEAC, 0x4E596E94), Z(0xFBA63EE2, 0x93F9D044), Z(0xF5B652C1, 0x97C3E12E),
+    Z(0x9DA1A54E, 0xD0B1B26F), Z(0x986A77EA, 0xCC6293DC), Z(0x7393E849, 0x377221FA),
+    Z(0xAE32E14D, 0xBDC501A6), Z(0x64FD3E4D, 0xE391CBE0), Z(0x272C13C5, 0x133B3AF8),
+    Z(0x1C71FFB7, 0x4C2531A4), Z(0x6E7053E4, 0x2E23F8A1), Z(0x57DC433B, 0xFD831255),
+    Z(0x06F735F4, 0x6614DEF3), Z(0x3B243764, 0xA58E8D81), Z(0x208D8C14, 0x371654C8),
+    Z(0xEB20BB0C, 0xDD857B1E), Z(0x60A56665, 0x5EC0CDFF), Z(0x57BB8E53, 0x8FF6F9C9),
+    Z(0x68B1C228, 0xFAF740B2), Z(0x64F434FE, 0xA4FC545C), Z(0xAAA5260E, 0xDB3CA826),
+    Z(0xCA55721F, 0xFFD0B275), Z(0xFE5DB019, 0x0200E023), Z(0x15122952, 0x5758E93D),
+    Z(0x0F1C475F, 0xA4D8F7D3), Z(0xBB2D2E74, 0x27138594), Z(0x570BBCF5, 0x00F771B2),
+    Z(0xD1E1D7DC, 0x564BA330), Z(0xD305231C, 0xA2039ED3), Z(0x922A1B87, 0x8D2BB701),
+    Z(0x6C49C73F, 0x2687D900), Z(0xD0ABD0A0, 0xB9C3E7B5), Z(0xB2FEEB03, 0xD0C2822C),
+    Z(0x5E263C02, 0x05242D16), Z(0x9E8FA5C3, 0x8F22F19C), Z(0x015CEC66, 0x87100D76),
+    Z(0x0C8FCA1E, 0x54C1DE5F), Z(0x34861440, 0xA8A8491B)
+};
+
+static const uint64_t rachel_zobrist_player[8] = {
+    Z(0x8323354B, 0xECC77BF0), Z(0xF6530CB7, 0x73F180D1), Z(0xDD3A5397, 0x0DF6BEE0),
+    Z(0xF13B642F, 0x425EC5F0), Z(0xE7B7014E, 0xF3A8E99F), Z(0xC4141CF4, 0xF258244F),
+    Z(0xB03251FA, 0x2BF1B0F4), Z(0x09CF1C71, 0x36109927)
+};
+
+static const uint64_t rachel_zobrist_nominated[8] = {
+    Z(0xC9C14D6B, 0xDAE009F8), Z(0x3E388C86, 0xDC5F6F13), Z(0x161DABA5, 0x93C0D80E),
+    Z(0x18D72C75, 0x365BEFAF), Z(0xE4DF1DA1, 0xFA709179), Z(0xF65D7700, 0xC07F6810),
+    Z(0x4ABCA42B, 0x51B84EAE), Z(0xC5B6DA9C, 0x7B1842F0)
+};
+
+static const uint64_t rachel_zobrist_pending_type[16] = {
+    Z(0x194579C4, 0xED338876), Z(0xA74373BB, 0x576C1524), Z(0x156FE696, 0x30C4754D),
+    Z(0xBB1327BE, 0xE1A67F35), Z(0x360DAFDC, 0x34E7FA76), Z(0x11049431, 0x2BB14CAE),
+    Z(0x404C62C8, 0x97CF009E), Z(0xFA62E757, 0xBC17DA27), Z(0xEE227611, 0x9857B1F6),
+    Z(0xD52E0BDE, 0x4C3E5B7D), Z(0xE5267EB9, 0x153D8028), Z(0xBCB97FA4, 0x2B3D5403),
+    Z(0x1307F56D, 0x5A83B4BC), Z(0xD2582834, 0x610B33C7), Z(0xA652317F, 0x99B9E9E4),
+    Z(0xF4B636DB, 0x81E6FC6D)
+};
+
+static const uint64_t rachel_zobrist_pending_count[64] = {
+    Z(0x474CB747, 0xD4B7164F), Z(0x09264988, 0x5C4DD4C3), Z(0x8130B994, 0xE95D1166),
+    Z(0x575BB649, 0x755F1924), Z(0xE32AF99E, 0xA348442C), Z(0xA5311FE7, 0xC4986598),
+    Z(0x994684CC, 0xB6761BC6), Z(0x7FB2682F, 0x7EA9A68D), Z(0x10EAF956, 0xF11CE2DA),
+    Z(0x8367CC10, 0xFC829CFA), Z(0x6C802C6E, 0x559DCFF1), Z(0xE94B46CD, 0xEC3539CA),
+    Z(0x32267575, 0xAFAAAFE4), Z(0xECD69809, 0xAE3359BE), Z(0x44F1B32F, 0xC8FE0497),
+    Z(0xA1D68D47, 0x92C810A8), Z(0xBF7BB911, 0xD13FE785), Z(0xC1D96F5A, 0xC52D5896),
+    Z(0x69E79DE1, 0x1232490E), Z(0x9BE4D83E, 0x18412492), Z(0x0F53C898, 0x6D42276E),
+    Z(0x767B5243, 0x971ED1E8), Z(0x21C38F04, 0xA5B8E485), Z(0x56AA7CFD, 0xCCE3E79D),
+    Z(0x540026C5, 0xA5A58243), Z(0x6CF105A0, 0x901F087D), Z(0x1223A4BC, 0xA00AC3F9),
+    Z(0x539D9356, 0xC126288F), Z(0xA3DB3DD8, 0x8E062DE0), Z(0xB7C46440, 0x39604633),
+    Z(0x50665794, 0x7BEA8CB3), Z(0x0F752480, 0x1FBF44DC), Z(0x9077BC63, 0xB4A2399F),
+    Z(0xAAF5B6DB, 0x36585D84), Z(0xE1666ED2, 0xE7D3BB3A), Z(0xCBE92E0B, 0xA715F0D8),
+    Z(0xA830E6C2, 0x8527CA09), Z(0xDD39C56A, 0x115C2C94), Z(0x32A21CF4, 0xDF7D185A),
+    Z(0xC3156EA2, 0x6AA64182), Z(0x6C12B05C, 0xA72D4D23), Z(0xDEB534D2, 0xEB324729),
+    Z(0x48EECDD3, 0x2528BABB), Z(0xCFE1C155, 0x5E2C6899), Z(0x2671069D, 0x459D1918),
+    Z(0x8B1BD776, 0xC240B84D), Z(0x71BDC3FF, 0x5945CF30), Z(0x3A835F1E, 0x3A9B77CE),
+    Z(0xE738572B, 0x61DDB081), Z(0x99C551D0, 0xCC2D7C62), Z(0x8CCFE7C6, 0x2AC88030),
+    Z(0xB5FE1A81, 0xDF2CAE75), Z(0x08ECA65B, 0xD7F449C8), Z(0xB0877139, 0x18F51E29),
+    Z(0xA24B485F, 0xDA341C57), Z(0x2B197D33, 0x9F8801B2), Z(0x7480530F, 0x0C2CE74F),
+    Z(0xB0771A9C, 0x83346E51), Z(0x945EFD70, 0xB59156B3), Z(0xC15AA58E, 0x4C720EEE),
+    Z(0xAD1A2A66, 0xFC711146), Z(0xCB3EEF97, 0x778312E6), Z(0x6CF27A68, 0x0C554591),
+    Z(0x3C818856, 0xA40898E2)
+};
+
+static const uint64_t rachel_zobrist_direction = Z(0x3F5B8C47, 0x7E0A04F4);
+
+#undef Z
+
+/* Card index for hashing: bitboard position, jokers share 52 */
+static uint8_t rachel_card_index(Card card) {
+    uint8_t index;
+    
+    if (IS_JOKER(card.encoded)) {
+        return STANDARD_DECK;
+    }
+    index = (uint8_t)(GET_SUIT(card.encoded) * 13 + GET_RANK(card.encoded) - RANK_2);
+    return index < ULTIMATE_DECK ? index : ULTIMATE_DECK - 1;
+}
+
+/* Keys for the cards added to or removed from a hand */
+static uint64_t rachel_hash_hand_delta(uint8_t player_id, uint64_t diff) {
+    uint64_t hash = 0;
+    
+    while (diff) {
+        hash ^= rachel_zobrist_hand[player_id][RACHEL_MASK_LOWEST(diff)];
+        diff &= diff - 1;
+    }
+    return hash;
+}
 
-static uint32_t rachel_rand(void) {
-    rachel_rand_seed = rachel_rand_seed * 1103515245 + 12345;
-    return (rachel_rand_seed / 65536) % 32768;
+/* Keys for nomination, pending effect and direction */
+static uint64_t rachel_hash_flow(const Game* game) {
+    uint64_t hash = 0;
+    
+    if (game->nominated_suit != 0xFF) {
+        hash ^= rachel_zobrist_nominated[game->nominated_suit & 7];
+    }
+    if (game->pending_effect.count > 0) {
+        hash ^= rachel_zobrist_pending_type[game->pending_effect.type & 15];
+        hash ^= rachel_zobrist_pending_count[game->pending_effect.count & 63];
+    }
+    if (game->direction != DIR_CLOCKWISE) {
+        hash ^= rachel_zobrist_direction;
+    }
+    return hash;
+}
+
+/* Key for the top of the discard pile */
+static uint64_t rachel_hash_top(const Game* game) {
+    if (game->discard_count == 0) {
+        return 0;
+    }
+    return rachel_zobrist_top[rachel_card_index(RACHEL_TOP_CARD(game))];
 }
 
-static void rachel_srand(uint32_t seed) {
-    rachel_rand_seed = seed;
+uint64_t rachel_hash_game(const Game* game) {
+    uint64_t hash;
+    uint8_t i;
+    
+    hash = rachel_hash_flow(game) ^ rachel_hash_top(game) ^
+           rachel_zobrist_player[game->current_player_index & 7];
+    for (i = 0; i < game->player_count && i < MAX_PLAYERS; i++) {
+        hash ^= rachel_hash_hand_delta(i, game->players[i].hand_mask);
+    }
+    return hash;
 }
 
 /* Initialize a new game */
@@ -34,7 +557,7 @@ void rachel_init_game(Game* game, uint8_t player_count) {
     int i;
     
     /* Clear everything */
-    for (i = 0; i < sizeof(Game); i++) {
+    for (i = 0; i < (int)sizeof(Game); i++) {
         ((uint8_t*)game)[i] = 0;
     }
     
@@ -54,6 +577,16 @@ void rachel_init_game(Game* game, uint8_t player_count) {
     game->pending_effect.type = 0;
     game->pending_effect.count = 0;
     game->pending_effect.source_player = 0xFF;
+    
+    /* Same deal every time unless the caller seeds */
+    rachel_rng_seed(&game->rng, RACHEL_RNG_DEFAULT, 0);
+    
+    game->hash = rachel_hash_game(game);
+}
+
+/* Seed the game's RNG */
+void rachel_seed_game(Game* game, uint64_t seed, uint64_t stream) {
+    rachel_rng_seed(&game->rng, seed, stream);
 }
 
 /* Add a player */
@@ -68,6 +601,7 @@ bool_t rachel_add_player(Game* game, const char* name, bool_t is_ai) {
     player->id = game->player_count;
     rachel_strcpy(player->name, name);
     player->hand_count = 0;
+    player->hand_mask = 0;
     player->is_out = FALSE;
     player->is_ai = is_ai;
     player->finish_position = 0;
@@ -100,50 +634,72 @@ void rachel_create_deck(Card* deck, bool_t include_jokers) {
 
 /* Shuffle deck */
 void rachel_shuffle(Card* cards, uint8_t count, uint32_t seed) {
-    int i, j;
-    Card temp;
+    RachelRng rng;
     
-    rachel_srand(seed);
+    rachel_rng_seed(&rng, seed, 0);
+    rachel_shuffle_rng(cards, count, &rng);
+}
+
+/*
+ * The deck is shuffled lazily: a draw picks a random card from what is
+ * left and moves the last card into its slot. Drawn one after another
+ * that is exactly Fisher-Yates, but only the cards actually drawn cost
+ * anything, and the RNG is consumed in a fixed order from the seed.
+ */
+static Card rachel_deck_take(Game* game) {
+    Card* deck = RACHEL_DECK(game);
+    uint8_t n = game->deck_count;
+    uint8_t j = 0;
+    Card card;
     
-    /* Fisher-Yates shuffle */
-    for (i = count - 1; i > 0; i--) {
-        j = rachel_rand() % (i + 1);
-        temp = cards[i];
-        cards[i] = cards[j];
-        cards[j] = temp;
+    if (n > 1) {
+        j = (uint8_t)rachel_rng_below(&game->rng, n);
     }
+    card = deck[j];
+    deck[j] = deck[n - 1];
+    game->deck_count = n - 1;
+    return card;
+}
+
+/* Empty deck: the discard pile under the top card becomes the deck as
+ * it lies - drawing shuffles it. The piles swap roles; no card moves
+ * except the top card. */
+static void rachel_reshuffle(Game* game) {
+    Card top_card = RACHEL_TOP_CARD(game);
+    
+    game->deck_count = game->discard_count - 1;
+    game->deck_pile ^= 1;
+    RACHEL_DISCARD(game)[0] = top_card;
+    game->discard_count = 1;
 }
 
 /* Start the game */
 void rachel_start_game(Game* game) {
-    int i, j, card_index = 0;
+    int i, j;
     
-    /* Create and shuffle deck */
-    rachel_create_deck(game->deck, game->ultimate_mode);
+    /* Fresh deck in order - the deal draws from it at random */
+    game->deck_pile = 0;
+    rachel_create_deck(RACHEL_DECK(game), game->ultimate_mode);
     game->deck_count = game->ultimate_mode ? ULTIMATE_DECK : STANDARD_DECK;
-    rachel_shuffle(game->deck, game->deck_count, rachel_rand_seed);
     
     /* Deal cards to players */
     for (i = 0; i < game->starting_hand_size; i++) {
         for (j = 0; j < game->player_count; j++) {
-            game->players[j].hand[i] = game->deck[card_index++];
+            game->players[j].hand[i] = rachel_deck_take(game);
+            game->players[j].hand_mask =
+                rachel_mask_add(game->players[j].hand_mask, game->players[j].hand[i]);
             game->players[j].hand_count++;
         }
     }
     
     /* Place one card in discard pile */
-    game->discard_pile[0] = game->deck[card_index++];
+    RACHEL_DISCARD(game)[0] = rachel_deck_take(game);
     game->discard_count = 1;
     
-    /* Move remaining cards to deck */
-    for (i = 0; card_index < game->deck_count; i++, card_index++) {
-        game->deck[i] = game->deck[card_index];
-    }
-    game->deck_count = i;
-    
     /* Start playing */
     game->state = STATE_PLAYING;
     game->current_player_index = 0;
+    game->hash = rachel_hash_game(game);
 }
 
 /* Check if cards match */
@@ -162,8 +718,9 @@ bool_t rachel_cards_match(Card c1, Card c2) {
     return (suit1 == suit2) || (rank1 == rank2);
 }
 
-/* Check if player can play a card */
-bool_t rachel_can_play_card(const Game* game, Card card) {
+/* The rule as written, branch by branch. Play goes through the tables;
+ * this is kept so the self test can hold them to it. */
+static bool_t rachel_can_play_card_reference(const Game* game, Card card) {
     Card top_card;
     uint8_t required_suit;
     
@@ -171,7 +728,7 @@ bool_t rachel_can_play_card(const Game* game, Card card) {
         return FALSE;
     }
     
-    top_card = game->discard_pile[game->discard_count - 1];
+    top_card = RACHEL_TOP_CARD(game);
     
     /* Handle pending effects - can only play certain cards */
     if (game->pending_effect.count > 0) {
@@ -208,25 +765,41 @@ bool_t rachel_can_play_card(const Game* game, Card card) {
            (GET_RANK(card.encoded) == GET_RANK(top_card.encoded));
 }
 
-/* Check if player must play */
-bool_t rachel_must_play(const Game* game, uint8_t player_id) {
-    const Player* player;
-    int i;
-    
-    if (player_id >= game->player_count) {
-        return FALSE;
+/* Check if player can play a card: one table load and an AND */
+bool_t rachel_can_play_card(const Game* game, Card card) {
+    return (rachel_playable_mask(game) & rachel_card_bits[card.encoded]) != 0;
+}
+
+/* Every card that could go on a given top card */
+uint64_t rachel_playable_mask_for(Card top_card, uint8_t nominated_suit,
+                                  const PendingEffect* effect) {
+    unsigned index;
+
+    index = rachel_effect_rows[effect->type] & (0u - (effect->count != 0));
+    index |= rachel_top_rows[top_card.encoded] | ((nominated_suit + 1u) & 7);
+    return rachel_playable_table[index];
+}
+
+/* Every card that could go on the pile now */
+uint64_t rachel_playable_mask(const Game* game) {
+    if (game->discard_count == 0) {
+        return 0;
     }
-    
-    player = &game->players[player_id];
-    
-    /* Check each card in hand */
-    for (i = 0; i < player->hand_count; i++) {
-        if (rachel_can_play_card(game, player->hand[i])) {
-            return TRUE;
-        }
+    return rachel_playable_mask_for(RACHEL_TOP_CARD(game),
+                                    game->nominated_suit, &game->pending_effect);
+}
+
+/* Playable cards held by a player */
+uint64_t rachel_valid_plays_mask(const Game* game, uint8_t player_id) {
+    if (player_id >= game->player_count) {
+        return 0;
     }
-    
-    return FALSE;
+    return game->players[player_id].hand_mask & rachel_playable_mask(game);
+}
+
+/* Check if player must play */
+bool_t rachel_must_play(const Game* game, uint8_t player_id) {
+    return rachel_valid_plays_mask(game, player_id) != 0;
 }
 
 /* Play cards */
@@ -235,7 +808,8 @@ bool_t rachel_play_cards(Game* game, uint8_t player_id,
                         uint8_t nominated_suit) {
     Player* player;
     uint8_t first_rank, i, j;
-    bool_t found;
+    uint64_t wanted = 0;
+    uint64_t old_hand, old_keys;
     
     if (player_id >= game->player_count || count == 0) {
         return FALSE;
@@ -257,24 +831,25 @@ bool_t rachel_play_cards(Game* game, uint8_t player_id,
         }
     }
     
-    /* Verify player has all these cards */
+    /* Verify player has all these cards, each one only once */
     for (i = 0; i < count; i++) {
-        found = FALSE;
-        for (j = 0; j < player->hand_count; j++) {
-            if (player->hand[j].encoded == cards[i].encoded) {
-                found = TRUE;
-                break;
-            }
-        }
-        if (!found) {
+        if (!IS_JOKER(cards[i].encoded) && (wanted & rachel_card_bit(cards[i]))) {
             return FALSE;
         }
+        wanted = rachel_mask_add(wanted, cards[i]);
+    }
+    if (wanted & ~player->hand_mask) {
+        return FALSE;
     }
     
+    old_hand = player->hand_mask;
+    old_keys = rachel_hash_flow(game) ^ rachel_hash_top(game);
+    
     /* Remove cards from hand and add to discard */
     for (i = 0; i < count; i++) {
         /* Add to discard pile */
-        game->discard_pile[game->discard_count++] = cards[i];
+        RACHEL_DISCARD(game)[game->discard_count++] = cards[i];
+        player->hand_mask = rachel_mask_remove(player->hand_mask, cards[i]);
         
         /* Remove from hand */
         for (j = 0; j < player->hand_count; j++) {
@@ -337,6 +912,9 @@ bool_t rachel_play_cards(Game* game, uint8_t player_id,
         player->finish_position = ++game->winner_count;
     }
     
+    game->hash ^= old_keys ^ rachel_hash_flow(game) ^ rachel_hash_top(game) ^
+                  rachel_hash_hand_delta(player_id, old_hand ^ player->hand_mask);
+    RACHEL_CHECK_HASH(game);
     return TRUE;
 }
 
@@ -344,7 +922,7 @@ bool_t rachel_play_cards(Game* game, uint8_t player_id,
 bool_t rachel_draw_cards(Game* game, uint8_t player_id, uint8_t count) {
     Player* player;
     uint8_t cards_to_draw;
-    int i;
+    uint64_t old_hand;
     
     if (player_id >= game->player_count) {
         return FALSE;
@@ -352,48 +930,40 @@ bool_t rachel_draw_cards(Game* game, uint8_t player_id, uint8_t count) {
     
     player = &game->players[player_id];
     cards_to_draw = count;
+    old_hand = player->hand_mask;
     
-    /* Draw from deck */
-    while (cards_to_draw > 0 && game->deck_count > 0) {
-        player->hand[player->hand_count++] = game->deck[--game->deck_count];
-        cards_to_draw--;
-    }
-    
-    /* If deck empty, shuffle discard pile (keeping top card) */
-    if (cards_to_draw > 0 && game->discard_count > 1) {
-        Card top_card = game->discard_pile[game->discard_count - 1];
-        
-        /* Move discard to deck (except top card) */
-        for (i = 0; i < game->discard_count - 1; i++) {
-            game->deck[i] = game->discard_pile[i];
-        }
-        game->deck_count = game->discard_count - 1;
-        
-        /* Shuffle */
-        rachel_shuffle(game->deck, game->deck_count, rachel_rand());
-        
-        /* Keep only top card in discard */
-        game->discard_pile[0] = top_card;
-        game->discard_count = 1;
-        
-        /* Continue drawing */
-        while (cards_to_draw > 0 && game->deck_count > 0) {
-            player->hand[player->hand_count++] = game->deck[--game->deck_count];
-            cards_to_draw--;
+    /* Draw at random; an empty deck takes the discard pile (keeping the
+     * top card) once, then drawing goes on */
+    while (cards_to_draw > 0) {
+        if (game->deck_count == 0) {
+            if (game->discard_count <= 1) {
+                break;
+            }
+            rachel_reshuffle(game);
         }
+        player->hand[player->hand_count] = rachel_deck_take(game);
+        player->hand_mask = rachel_mask_add(player->hand_mask,
+                                            player->hand[player->hand_count]);
+        player->hand_count++;
+        cards_to_draw--;
     }
     
+    game->hash ^= rachel_hash_hand_delta(player_id, old_hand ^ player->hand_mask);
+    RACHEL_CHECK_HASH(game);
     return TRUE;
 }
 
 /* Process pending effects */
 void rachel_process_effects(Game* game) {
     uint8_t current_player = game->current_player_index;
+    uint64_t old_flow;
     
     if (game->pending_effect.count == 0) {
         return;
     }
     
+    old_flow = rachel_hash_flow(game);
+    
     /* Apply effect based on type */
     if (game->pending_effect.type == RANK_2) {
         /* Draw 2s */
@@ -416,10 +986,14 @@ void rachel_process_effects(Game* game) {
     game->pending_effect.type = 0;
     game->pending_effect.count = 0;
     game->pending_effect.source_player = 0xFF;
+    
+    game->hash ^= old_flow ^ rachel_hash_flow(game);
+    RACHEL_CHECK_HASH(game);
 }
 
 /* Advance to next player */
 void rachel_next_turn(Game* game) {
+    uint8_t old_player = game->current_player_index;
     int attempts = 0;
     
     do {
@@ -436,6 +1010,9 @@ void rachel_next_turn(Game* game) {
     } while (game->players[game->current_player_index].is_out && attempts < game->player_count);
     
     game->turn_count++;
+    game->hash ^= rachel_zobrist_player[old_player & 7] ^
+                  rachel_zobrist_player[game->current_player_index & 7];
+    RACHEL_CHECK_HASH(game);
 }
 
 /* Check if game is over */
@@ -452,27 +1029,173 @@ bool_t rachel_is_game_over(const Game* game) {
     return active_players <= 1;
 }
 
-/* Get valid plays */
-uint8_t rachel_get_valid_plays(const Game* game, Card* valid_cards) {
-    const Player* player;
-    uint8_t count = 0;
-    int i;
+/* Was hand slot j one of the first n cards already taken? */
+static bool_t rachel_slot_taken(const uint8_t* removed, uint8_t n, uint8_t j) {
+    uint8_t i;
     
-    if (game->current_player_index >= game->player_count) {
-        return 0;
+    for (i = 0; i < n; i++) {
+        if (removed[i] == j) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Make a move - a whole turn - keeping only what cannot be recomputed */
+bool_t rachel_make_move(Game* game, const Move* move, MoveUndo* undo) {
+    uint8_t player_id = game->current_player_index;
+    Player* player = &game->players[player_id];
+    uint8_t removed[RACHEL_MAX_PLAY];
+    uint8_t i, j, slot, effect_type;
+    
+    if (move->type == MOVE_PLAY && (move->count == 0 || move->count > RACHEL_MAX_PLAY)) {
+        return FALSE;
+    }
+    if (move->type == MOVE_PASS && rachel_valid_plays_mask(game, player_id)) {
+        return FALSE;
+    }
+    
+    undo->move = *move;
+    undo->player = player_id;
+    undo->hand_mask = player->hand_mask;
+    undo->hand_count = player->hand_count;
+    undo->is_out = player->is_out;
+    undo->finish_position = player->finish_position;
+    undo->deck_count = game->deck_count;
+    undo->discard_count = game->discard_count;
+    undo->current_player_index = game->current_player_index;
+    undo->direction = game->direction;
+    undo->nominated_suit = game->nominated_suit;
+    undo->pending_effect = game->pending_effect;
+    undo->rng_state = game->rng.state;
+    undo->hash = game->hash;
+    undo->turn_count = game->turn_count;
+    undo->winner_count = game->winner_count;
+    
+    if (move->type == MOVE_PLAY) {
+        /* Where each card sits once the earlier ones are gone, the same
+         * first-match search rachel_play_cards does */
+        for (i = 0; i < move->count; i++) {
+            slot = 0;
+            for (j = 0; j < player->hand_count; j++) {
+                if (rachel_slot_taken(removed, i, j)) {
+                    continue;
+                }
+                if (player->hand[j].encoded == move->cards[i].encoded) {
+                    break;
+                }
+                slot++;
+            }
+            removed[i] = j;
+            undo->slots[i] = slot;
+        }
+        if (!rachel_play_cards(game, player_id, move->cards, move->count,
+                               move->nominated_suit)) {
+            return FALSE;
+        }
+        rachel_next_turn(game);
+        undo->reshuffled = FALSE;
+        return TRUE;
+    }
+    
+    if (game->pending_effect.count > 0) {
+        effect_type = game->pending_effect.type;
+        rachel_process_effects(game);
+        if (effect_type == RANK_7) {
+            undo->reshuffled = FALSE;
+            return TRUE;   /* Skips already advanced the turn */
+        }
+    } else {
+        rachel_draw_cards(game, player_id, 1);
     }
     
-    player = &game->players[game->current_player_index];
+    /* A reshuffle always empties the old deck first */
+    undo->reshuffled = player->hand_count > undo->hand_count + undo->deck_count;
+    rachel_next_turn(game);
+    return TRUE;
+}
+
+/* Take a move back */
+void rachel_unmake_move(Game* game, const MoveUndo* undo) {
+    Player* player = &game->players[undo->player];
+    uint8_t slots[MAX_HAND_SIZE], sizes[MAX_HAND_SIZE];
+    RachelRng rng;
+    Card* deck;
+    uint8_t i, j, n, drawn, reshuffle_at;
     
-    for (i = 0; i < player->hand_count; i++) {
-        if (rachel_can_play_card(game, player->hand[i])) {
-            if (valid_cards != 0) {
-                valid_cards[count] = player->hand[i];
+    if (undo->move.type == MOVE_PLAY) {
+        /* Put the cards back into their slots, last removed first */
+        for (i = undo->move.count; i-- > 0; ) {
+            for (j = player->hand_count; j > undo->slots[i]; j--) {
+                player->hand[j] = player->hand[j - 1];
+            }
+            player->hand[undo->slots[i]] = undo->move.cards[i];
+            player->hand_count++;
+        }
+    } else {
+        /* Replay the draws' random slots from the saved RNG state, then
+         * put each drawn card back into its slot, last draw first. The
+         * reshuffle, if there was one, is undone by swapping the piles
+         * back and restoring the top card over the old pile. */
+        drawn = player->hand_count - undo->hand_count;
+        rng.state = undo->rng_state;
+        rng.inc = game->rng.inc;
+        n = undo->deck_count;
+        reshuffle_at = drawn;
+        for (i = 0; i < drawn; i++) {
+            if (n == 0) {
+                reshuffle_at = i;
+                n = undo->discard_count - 1;
+            }
+            sizes[i] = n;
+            slots[i] = n > 1 ? (uint8_t)rachel_rng_below(&rng, n) : 0;
+            n--;
+        }
+        for (i = drawn; i-- > 0; ) {
+            deck = RACHEL_DECK(game);
+            deck[sizes[i] - 1] = deck[slots[i]];
+            deck[slots[i]] = player->hand[undo->hand_count + i];
+            if (i == reshuffle_at) {
+                game->deck_pile ^= 1;
+                RACHEL_DISCARD(game)[undo->discard_count - 1] = RACHEL_DECK(game)[0];
             }
-            count++;
         }
     }
     
+    player->hand_count = undo->hand_count;
+    player->hand_mask = undo->hand_mask;
+    player->is_out = undo->is_out;
+    player->finish_position = undo->finish_position;
+    game->deck_count = undo->deck_count;
+    game->discard_count = undo->discard_count;
+    game->current_player_index = undo->current_player_index;
+    game->direction = undo->direction;
+    game->nominated_suit = undo->nominated_suit;
+    game->pending_effect = undo->pending_effect;
+    game->rng.state = undo->rng_state;
+    game->hash = undo->hash;
+    game->turn_count = undo->turn_count;
+    game->winner_count = undo->winner_count;
+    RACHEL_CHECK_HASH(game);
+}
+
+/* Get valid plays */
+uint8_t rachel_get_valid_plays(const Game* game, Card* valid_cards) {
+    uint64_t plays;
+    uint8_t count = 0;
+    
+    plays = rachel_valid_plays_mask(game, game->current_player_index);
+    
+    if (valid_cards == 0) {
+        return RACHEL_MASK_COUNT(plays);
+    }
+    
+    /* Lowest bit first: suit order, then rank, then jokers */
+    while (plays) {
+        valid_cards[count++] = rachel_card_from_index(RACHEL_MASK_LOWEST(plays));
+        plays &= plays - 1;
+    }
+    
     return count;
 }
 
@@ -512,15 +1235,103 @@ bool_t rachel_is_special(Card card) {
             rank == RANK_ACE || rank == RANK_JOKER);
 }
 
+/* Network encoding - the card byte itself, with anything that is not a
+ * card (or a joker with suit bits) folded to NO_CARD / plain RANK_JOKER */
+uint8_t rachel_encode_card(Card card) {
+    uint8_t rank = GET_RANK(card.encoded);
+    
+    if (rank == RANK_JOKER) {
+        return RANK_JOKER;
+    }
+    if (rank < RANK_2 || rank > RANK_ACE) {
+        return NO_CARD;
+    }
+    return card.encoded;
+}
+
+Card rachel_decode_card(uint8_t encoded) {
+    Card card;
+    
+    card.encoded = encoded;
+    card.encoded = rachel_encode_card(card);
+    return card;
+}
+
 /* Version string */
 const char* rachel_version(void) {
-    return "1.0.0";
+    return RACHEL_VERSION;
+}
+
+/* Everything the rules read, for checking that unmake is exact */
+static bool_t rachel_same_position(const Game* a, const Game* b) {
+    int i, j;
+    
+    if (a->player_count != b->player_count ||
+        a->current_player_index != b->current_player_index ||
+        a->deck_count != b->deck_count || a->discard_count != b->discard_count ||
+        a->direction != b->direction || a->nominated_suit != b->nominated_suit ||
+        a->pending_effect.type != b->pending_effect.type ||
+        a->pending_effect.count != b->pending_effect.count ||
+        a->pending_effect.source_player != b->pending_effect.source_player ||
+        a->rng.state != b->rng.state || a->hash != b->hash ||
+        a->turn_count != b->turn_count || a->winner_count != b->winner_count) {
+        return FALSE;
+    }
+    for (i = 0; i < a->deck_count; i++) {
+        if (RACHEL_DECK(a)[i].encoded != RACHEL_DECK(b)[i].encoded) return FALSE;
+    }
+    for (i = 0; i < a->discard_count; i++) {
+        if (RACHEL_DISCARD(a)[i].encoded != RACHEL_DISCARD(b)[i].encoded) return FALSE;
+    }
+    for (i = 0; i < a->player_count; i++) {
+        if (a->players[i].hand_count != b->players[i].hand_count ||
+            a->players[i].hand_mask != b->players[i].hand_mask ||
+            a->players[i].is_out != b->players[i].is_out ||
+            a->players[i].finish_position != b->players[i].finish_position) {
+            return FALSE;
+        }
+        for (j = 0; j < a->players[i].hand_count; j++) {
+            if (a->players[i].hand[j].encoded != b->players[i].hand[j].encoded) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
 }
 
-/* Self test */
+void rachel_test_seat(Game* game, uint8_t players, bool_t ultimate) {
+    rachel_init_game(game, players);
+    while (game->player_count < players) {
+        rachel_add_player(game, "TEST", TRUE);
+    }
+    game->ultimate_mode = ultimate;
+}
+
+void rachel_test_deal(Game* game, uint8_t players, bool_t ultimate,
+                      uint64_t seed, uint64_t stream) {
+    rachel_test_seat(game, players, ultimate);
+    rachel_seed_game(game, seed, stream);
+    rachel_start_game(game);
+}
+
+void rachel_test_move(const Game* game, Move* move) {
+    uint64_t mask = rachel_valid_plays_mask(game, game->current_player_index);
+    
+    move->type = mask ? MOVE_PLAY : MOVE_PASS;
+    move->count = 0;
+    move->nominated_suit = (uint8_t)(game->turn_count & 3);
+    if (mask) {
+        move->cards[move->count++] = rachel_card_from_index(RACHEL_MASK_LOWEST(mask));
+    }
+}
+
+/* Quick smoke check, run by every front end at startup: keep it cheap */
 bool_t rachel_self_test(void) {
     Game game;
     Card test_card;
+    RachelRng rng_a, rng_b;
+    uint64_t mask;
+    int i, card;
     
     /* Test card encoding */
     test_card.encoded = MAKE_CARD(SUIT_HEARTS, RANK_ACE);
@@ -538,7 +1349,162 @@ bool_t rachel_self_test(void) {
     rachel_init_game(&game, 4);
     if (game.state != STATE_WAITING) return FALSE;
     
-    /* More tests would go here */
+    /* Test RNG streams: reproducible, independent, jumpable */
+    rachel_rng_seed(&rng_a, 42, 7);
+    rachel_rng_seed(&rng_b, 42, 7);
+    for (i = 0; i < 100; i++) {
+        if (rachel_rng_next(&rng_a) != rachel_rng_next(&rng_b)) return FALSE;
+    }
+    rachel_rng_advance(&rng_b, 1000);
+    for (i = 0; i < 1000; i++) {
+        rachel_rng_next(&rng_a);
+    }
+    if (rng_a.state != rng_b.state) return FALSE;
+    rachel_rng_seed(&rng_b, 42, 8);
+    if (rachel_rng_next(&rng_a) == rachel_rng_next(&rng_b) &&
+        rachel_rng_next(&rng_a) == rachel_rng_next(&rng_b)) return FALSE;
+    
+    /* Test seeded deals are reproducible */
+    for (i = 0; i < 2; i++) {
+        rachel_test_deal(&game, 2, FALSE, 2024, 1);
+        if (i == 0) {
+            test_card = RACHEL_DISCARD(&game)[0];
+            rng_a = game.rng;
+        }
+    }
+    if (RACHEL_DISCARD(&game)[0].encoded != test_card.encoded) return FALSE;
+    if (game.rng.state != rng_a.state) return FALSE;
+    
+    /* Test bitboards: helpers round-trip, jokers count */
+    for (i = 0; i < ULTIMATE_DECK; i++) {
+        test_card = rachel_card_from_index(i);
+        if (i < STANDARD_DECK && rachel_card_bit(test_card) != (uint64_t)1 << i) {
+            return FALSE;
+        }
+    }
+    test_card.encoded = RANK_JOKER;
+    mask = rachel_mask_add(rachel_mask_add(0, test_card), test_card);
+    if (RACHEL_MASK_COUNT(mask) != 2 || rachel_mask_count(mask) != 2) return FALSE;
+    if (rachel_mask_remove(mask, test_card) != RACHEL_JOKER_BIT) return FALSE;
+    if (RACHEL_MASK_LOWEST(rachel_rank_masks[RANK_ACE]) != 12) return FALSE;
+    
+    /* Test the card bit table against the layout, every byte */
+    for (i = 0; i < 256; i++) {
+        card = GET_RANK(i);
+        mask = card == RANK_JOKER ? RACHEL_JOKER_BIT :
+               (card >= RANK_2 && card <= RANK_ACE ?
+                (uint64_t)1 << (GET_SUIT(i) * 13 + card - RANK_2) : 0);
+        if (rachel_card_bits[i] != mask) return FALSE;
+    }
+    
+    return TRUE;
+}
+
+/* The exhaustive checks: every playability case, the Zobrist keys, and
+ * whole seeded games for the incremental hash and make/unmake. Seconds
+ * on a slow machine and about 20K of stack, so host tools only. */
+bool_t rachel_engine_self_test(void) {
+    Game game, before, start;
+    MoveUndo undo[256];
+    Card test_card;
+    RachelRng rng_a;
+    Move move;
+    uint64_t mask;
+    int i, top, card, effect, player, ply, reshuffles = 0;
+    
+    /* Test the playability tables against the rule as written: every top
+     * card, nomination, pending effect type and count, and card */
+    rachel_init_game(&game, 2);
+    game.discard_count = 1;
+    for (top = 0; top < STANDARD_DECK + 1; top++) {
+        RACHEL_DISCARD(&game)[0] = rachel_card_from_index(top);
+        for (effect = 0; effect < 16 * 3 * 5; effect++) {
+            game.pending_effect.type = (uint8_t)(effect / 15);
+            game.pending_effect.count = (uint8_t)(effect / 5 % 3);
+            game.nominated_suit = effect % 5 == 4 ? 0xFF : effect % 5;
+            mask = rachel_playable_mask(&game);
+            for (card = 0; card < STANDARD_DECK + 1; card++) {
+                test_card = rachel_card_from_index(card);
+                if (rachel_can_play_card_reference(&game, test_card) !=
+                    rachel_can_play_card(&game, test_card) ||
+                    !rachel_can_play_card(&game, test_card) !=
+                    !(mask & rachel_card_bit(test_card))) {
+                    return FALSE;
+                }
+            }
+        }
+    }
+    
+    /* Test Zobrist keys match their generator */
+    rachel_rng_seed(&rng_a, RACHEL_ZOBRIST_SEED, 0);
+    for (i = 0; i < 601; i++) {
+        mask = (uint64_t)rachel_rng_next(&rng_a) << 32;
+        mask |= rachel_rng_next(&rng_a);
+        if (i < 448) {
+            if (mask != rachel_zobrist_hand[i / 56][i % 56]) return FALSE;
+        } else if (i < 504) {
+            if (mask != rachel_zobrist_top[i - 448]) return FALSE;
+        } else if (i < 512) {
+            if (mask != rachel_zobrist_player[i - 504]) return FALSE;
+        } else if (i < 520) {
+            if (mask != rachel_zobrist_nominated[i - 512]) return FALSE;
+        } else if (i < 536) {
+            if (mask != rachel_zobrist_pending_type[i - 520]) return FALSE;
+        } else if (i < 600) {
+            if (mask != rachel_zobrist_pending_count[i - 536]) return FALSE;
+        } else if (mask != rachel_zobrist_direction) {
+            return FALSE;
+        }
+    }
+    
+    /* Test the incremental hash through a few seeded games */
+    for (i = 0; i < 6; i++) {
+        rachel_test_deal(&game, (uint8_t)(2 + i), FALSE, 6, i);
+        while (!rachel_is_game_over(&game) && game.turn_count < 1000) {
+            if (game.hash != rachel_hash_game(&game)) return FALSE;
+            rachel_test_move(&game, &move);
+            if (!rachel_make_move(&game, &move, &undo[0])) return FALSE;
+        }
+        if (game.hash != rachel_hash_game(&game)) return FALSE;
+    }
+    
+    /* Test make/unmake: every move undoes exactly, reshuffles included,
+     * and a whole line of play unwinds back to the deal */
+    for (i = 0; i < 8; i++) {
+        rachel_test_deal(&game, (uint8_t)(2 + i % 7), i & 1, 8, i);
+        start = game;
+        for (ply = 0; ply < 256 && !rachel_is_game_over(&game); ply++) {
+            player = game.current_player_index;
+            mask = rachel_valid_plays_mask(&game, (uint8_t)player);
+            move.type = mask ? MOVE_PLAY : MOVE_PASS;
+            move.count = 0;
+            move.nominated_suit = (uint8_t)(ply & 3);
+            if (mask) {
+                /* Alternate single cards and whole stacks */
+                move.cards[move.count++] = rachel_card_from_index(RACHEL_MASK_LOWEST(mask));
+                mask = game.players[player].hand_mask &
+                       rachel_rank_masks[GET_RANK(move.cards[0].encoded)];
+                mask = rachel_mask_remove(mask, move.cards[0]);
+                while ((ply & 1) && mask && move.count < RACHEL_MAX_PLAY) {
+                    move.cards[move.count++] =
+                        rachel_card_from_index(RACHEL_MASK_LOWEST(mask));
+                    mask = rachel_mask_remove(mask, move.cards[move.count - 1]);
+                }
+            }
+            before = game;
+            if (!rachel_make_move(&game, &move, &undo[ply])) return FALSE;
+            rachel_unmake_move(&game, &undo[ply]);
+            if (!rachel_same_position(&game, &before)) return FALSE;
+            rachel_make_move(&game, &move, &undo[ply]);
+            reshuffles += undo[ply].reshuffled;
+            if (move.type == MOVE_PLAY && game.hash == before.hash) return FALSE;
+        }
+        while (ply-- > 0) {
+            rachel_unmake_move(&game, &undo[ply]);
+        }
+        if (!rachel_same_position(&game, &start)) return FALSE;
+    }
+    if (reshuffles == 0) return FALSE;
     
     return TRUE;
 }
@@ -2,7 +2,8 @@
  * RACHEL CANONICAL RULES HEADER
  * 
  * This is the sacred definition. All implementations must follow these rules.
- * This code must compile on any C compiler since C89.
+ * This code must compile on any C89 compiler with a 64-bit integer type
+ * (long long or __int64): the bitboards, hashes and RNG all need one.
  * No external dependencies. No assumptions. Just cards and logic.
  * 
  * "The rules are immutable. The cards are eternal."
@@ -18,15 +19,40 @@ extern "C" {
 /* Standard integer types for maximum compatibility */
 #ifndef RACHEL_TYPES_DEFINED
 #define RACHEL_TYPES_DEFINED
+#if (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L) || \
+    (defined(_MSC_VER) && _MSC_VER >= 1600)
+#include <stdint.h>
+#else
 typedef unsigned char  uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int   uint32_t;
 typedef signed char    int8_t;
+#if defined(_MSC_VER) || (defined(__BORLANDC__) && __BORLANDC__ >= 0x500)
+typedef unsigned __int64   uint64_t;
+#elif defined(__TURBOC__)
+#error "Turbo C and Borland C++ before 5 have no 64-bit type - use DJGPP"
+#elif defined(__GNUC__)
+__extension__ typedef unsigned long long uint64_t;   /* Quiet under -std=c89 */
+#else
+typedef unsigned long long uint64_t;
+#endif
+#endif
 typedef int            bool_t;
 #define TRUE  1
 #define FALSE 0
 #endif
 
+/* Engine version. Bumped whenever a seed stops replaying the same game. */
+#define RACHEL_RULES_VERSION_MAJOR 1
+#define RACHEL_RULES_VERSION_MINOR 1
+#define RACHEL_RULES_VERSION_PATCH 0
+
+#define RACHEL_STRING_(x)  #x
+#define RACHEL_STRING(x)   RACHEL_STRING_(x)
+#define RACHEL_VERSION     RACHEL_STRING(RACHEL_RULES_VERSION_MAJOR) "." \
+                           RACHEL_STRING(RACHEL_RULES_VERSION_MINOR) "." \
+                           RACHEL_STRING(RACHEL_RULES_VERSION_PATCH)
+
 /* Constants */
 #define MAX_PLAYERS        8
 #define MAX_HAND_SIZE     52    /* Theoretical maximum */
@@ -74,6 +100,24 @@ typedef int            bool_t;
 #define IS_BLACK_JACK(card)   (IS_JACK(card) && (GET_SUIT(card) >= SUIT_CLUBS))
 #define IS_RED_JACK(card)     (IS_JACK(card) && (GET_SUIT(card) <= SUIT_DIAMONDS))
 
+/* Card sets as 64-bit bitboards.
+ * Standard cards use bit (suit * 13 + rank - 2), so bits 0-51.
+ * Jokers are identical, so bits 52-55 count them: n jokers = n low bits. */
+#define RACHEL_JOKER_BIT      ((uint64_t)1 << 52)
+#define RACHEL_MASK_JOKERS    ((uint64_t)0xF << 52)
+#define RACHEL_MASK_STANDARD  (((uint64_t)1 << 52) - 1)
+#define RACHEL_SUIT_MASK(s)   ((uint64_t)0x1FFF << (13 * (s)))
+#define RACHEL_RANK_MASK(r)   ((((uint64_t)1 << 39) | ((uint64_t)1 << 26) | \
+                                ((uint64_t)1 << 13) | 1) << ((r) - RANK_2))
+
+#if defined(__GNUC__)
+#define RACHEL_MASK_COUNT(m)  ((uint8_t)__builtin_popcountll(m))
+#define RACHEL_MASK_LOWEST(m) ((uint8_t)__builtin_ctzll(m))
+#else
+#define RACHEL_MASK_COUNT(m)  rachel_mask_count(m)
+#define RACHEL_MASK_LOWEST(m) rachel_mask_lowest(m)
+#endif
+
 /* Game states */
 typedef enum {
     STATE_WAITING,     /* Waiting for players */
@@ -97,12 +141,19 @@ typedef struct {
     uint8_t  id;
     char     name[32];
     Card     hand[MAX_HAND_SIZE];
+    uint64_t hand_mask;    /* Bitboard of hand[], always kept in sync */
     uint8_t  hand_count;
     bool_t   is_out;
     bool_t   is_ai;
     uint8_t  finish_position;
 } Player;
 
+/* Random number stream (PCG32) - one per game, no shared state */
+typedef struct {
+    uint64_t state;
+    uint64_t inc;          /* Stream selector, always odd */
+} RachelRng;
+
 /* Pending effect structure */
 typedef struct {
     uint8_t  type;         /* RANK_2, RANK_7, RANK_JACK */
@@ -117,10 +168,13 @@ typedef struct {
     uint8_t  player_count;
     uint8_t  current_player_index;
     
-    /* Cards */
-    Card     deck[MAX_DECK_SIZE];
+    /* Cards - the deck and the discard pile are the two piles, and a
+     * reshuffle swaps which is which. Use RACHEL_DECK and RACHEL_DISCARD.
+     * The deck is not kept in shuffled order: each draw takes a random
+     * card from it (one Fisher-Yates step at a time). */
+    Card     piles[2][MAX_DECK_SIZE];
+    uint8_t  deck_pile;           /* Which of piles[] is the deck */
     uint8_t  deck_count;
-    Card     discard_pile[MAX_DECK_SIZE];
     uint8_t  discard_count;
     
     /* Game flow */
@@ -131,6 +185,12 @@ typedef struct {
     /* Pending effects */
     PendingEffect pending_effect;
     
+    /* Randomness - deals and reshuffles draw only from this */
+    RachelRng rng;
+    
+    /* Zobrist key of the position, updated by every rule function */
+    uint64_t hash;
+    
     /* Statistics */
     uint32_t turn_count;
     uint8_t  winner_count;        /* How many have gone out */
@@ -140,15 +200,62 @@ typedef struct {
     uint8_t  starting_hand_size;  /* Varies by player count */
 } Game;
 
+#define RACHEL_DECK(game)     ((game)->piles[(game)->deck_pile])
+#define RACHEL_DISCARD(game)  ((game)->piles[(game)->deck_pile ^ 1])
+#define RACHEL_TOP_CARD(game) (RACHEL_DISCARD(game)[(game)->discard_count - 1])
+
+/* One whole turn, for search: play cards or take the forced pass */
+#define RACHEL_MAX_PLAY   4     /* Four of a rank at most */
+
+typedef enum {
+    MOVE_PLAY,         /* Play cards[0..count), then next turn */
+    MOVE_PASS          /* No valid play: take the pending effect, or
+                        * draw one, then next turn (skips move on) */
+} MoveType;
+
+typedef struct {
+    MoveType type;
+    Card     cards[RACHEL_MAX_PLAY];
+    uint8_t  count;
+    uint8_t  nominated_suit;
+} Move;
+
+/* Just enough to put a Game back after rachel_make_move */
+typedef struct {
+    Move          move;
+    uint8_t       player;
+    uint8_t       slots[RACHEL_MAX_PLAY];  /* Hand slot of each played card */
+    uint64_t      hand_mask;
+    uint8_t       hand_count;
+    bool_t        is_out;
+    uint8_t       finish_position;
+    uint8_t       deck_count;
+    uint8_t       discard_count;
+    bool_t        reshuffled;
+    uint8_t       current_player_index;
+    Direction     direction;
+    uint8_t       nominated_suit;
+    PendingEffect pending_effect;
+    uint64_t      rng_state;
+    uint64_t      hash;
+    uint32_t      turn_count;
+    uint8_t       winner_count;
+} MoveUndo;
+
 /* Core rule functions - These are the LAW */
 
-/* Initialize a new game */
+/* Initialize a new game (seeded with a fixed default stream) */
 void rachel_init_game(Game* game, uint8_t player_count);
 
+/* Seed the game's private RNG - call after init, before start.
+ * Each stream is an independent sequence for the same seed, so worker
+ * threads (or individual games) can take one stream each. */
+void rachel_seed_game(Game* game, uint64_t seed, uint64_t stream);
+
 /* Add a player to the game */
 bool_t rachel_add_player(Game* game, const char* name, bool_t is_ai);
 
-/* Start the game (shuffle and deal) */
+/* Start the game (deal at random from a fresh deck) */
 void rachel_start_game(Game* game);
 
 /* Check if a card can be played */
@@ -174,14 +281,49 @@ void rachel_next_turn(Game* game);
 /* Check if game is over */
 bool_t rachel_is_game_over(const Game* game);
 
+/* Make a move for the current player, recording how to take it back.
+ * Returns FALSE and changes nothing if the move is illegal - including
+ * a pass while a valid play exists. */
+bool_t rachel_make_move(Game* game, const Move* move, MoveUndo* undo);
+
+/* Take back the last move made. Moves must be unmade in reverse order.
+ * Restores everything the rules read; array slots past the live
+ * counts may differ. */
+void rachel_unmake_move(Game* game, const MoveUndo* undo);
+
 /* Get valid plays for current player */
 uint8_t rachel_get_valid_plays(const Game* game, Card* valid_cards);
 
+/* Bitboard of every card that could be played right now */
+uint64_t rachel_playable_mask(const Game* game);
+
+/* Same, for a top card, nomination and pending effect held elsewhere */
+uint64_t rachel_playable_mask_for(Card top_card, uint8_t nominated_suit,
+                                  const PendingEffect* effect);
+
+/* The table behind both: effect class (0 none, 1 twos, 2 sevens,
+ * 3 jacks), top card and nomination (0-3 or 0xFF) to a playable mask */
+#define RACHEL_PLAYABLE_ENTRIES  (4 * 64 * 8)
+#define RACHEL_PLAYABLE_INDEX(effect_class, top, nominated)          \
+    (((unsigned)(effect_class) << 9) |                                \
+     ((((unsigned)(top) >> 2 & 0x30) | ((unsigned)(top) & 0x0F)) << 3) | \
+     (((unsigned)(nominated) + 1) & 7))
+extern const uint64_t rachel_playable_table[RACHEL_PLAYABLE_ENTRIES];
+
+/* Bitboard of the cards in a player's hand that can be played now */
+uint64_t rachel_valid_plays_mask(const Game* game, uint8_t player_id);
+
 /* Utility functions */
 
 /* Shuffle deck using seed for reproducibility */
 void rachel_shuffle(Card* cards, uint8_t count, uint32_t seed);
 
+/* Random number streams */
+void rachel_rng_seed(RachelRng* rng, uint64_t seed, uint64_t stream);
+uint32_t rachel_rng_next(RachelRng* rng);
+uint32_t rachel_rng_below(RachelRng* rng, uint32_t bound);  /* [0, bound) */
+void rachel_rng_advance(RachelRng* rng, uint64_t delta);    /* Jump ahead */
+
 /* Create standard 52-card deck */
 void rachel_create_deck(Card* deck, bool_t include_jokers);
 
@@ -197,6 +339,22 @@ uint8_t rachel_get_attack_value(Card card);
 /* Calculate hand size based on player count */
 uint8_t rachel_calculate_hand_size(uint8_t player_count);
 
+/* Bitboard helpers */
+extern const uint64_t rachel_suit_masks[4];
+extern const uint64_t rachel_rank_masks[16];   /* Indexed by rank */
+extern const uint64_t rachel_card_bits[256];    /* Indexed by encoded card */
+uint64_t rachel_card_bit(Card card);            /* 0 for non-cards */
+Card rachel_card_from_index(uint8_t index);     /* Inverse of the bit */
+uint64_t rachel_mask_add(uint64_t mask, Card card);
+uint64_t rachel_mask_remove(uint64_t mask, Card card);
+uint8_t rachel_mask_count(uint64_t mask);
+uint8_t rachel_mask_lowest(uint64_t mask);      /* Mask must be non-zero */
+
+/* Zobrist hash from scratch - covers hands, top card, nomination,
+ * pending effect, direction and current player. game->hash must always
+ * equal this; RACHEL_DEBUG builds assert it after every rule function. */
+uint64_t rachel_hash_game(const Game* game);
+
 /* Encode/decode cards for network protocol */
 uint8_t rachel_encode_card(Card card);
 Card rachel_decode_card(uint8_t encoded);
@@ -209,17 +367,24 @@ void rachel_print_game_state(const Game* game);
 const char* rachel_card_to_string(Card card);
 #endif
 
-/* Version information */
-#define RACHEL_RULES_VERSION_MAJOR 1
-#define RACHEL_RULES_VERSION_MINOR 0
-#define RACHEL_RULES_VERSION_PATCH 0
-
-/* Get version string */
+/* Get version string, RACHEL_VERSION */
 const char* rachel_version(void);
 
 /* Validate implementation against test suite */
 bool_t rachel_self_test(void);
 
+/* Exhaustive engine checks for host tools: slow, not for startup */
+bool_t rachel_engine_self_test(void);
+
+/* Shared by the module self tests. rachel_test_seat fills a table with
+ * AI players, jokers in if ultimate; rachel_test_deal also seeds and
+ * starts it. rachel_test_move is the move they play: the lowest valid
+ * card nominating turn_count & 3, or the forced pass. */
+void rachel_test_seat(Game* game, uint8_t players, bool_t ultimate);
+void rachel_test_deal(Game* game, uint8_t players, bool_t ultimate,
+                      uint64_t seed, uint64_t stream);
+void rachel_test_move(const Game* game, Move* move);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,572 @@
+/*
+ * RACHEL ENDGAME SOLVER
+ *
+ * Move generation, the alpha-beta search, the lock-free table and the
+ * threads around them. Every thread deepens the same root with its own
+ * Game; helpers try the moves in a different order so they fill the
+ * table with what the main thread will need next.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "solver.h"
+#include "ai.h"
+
+#define SOLVER_FLUSH       1024          /* Nodes between budget checks */
+#define SOLVER_NO_MOVE     0x1FF
+
+/* Table data word: lower and upper bound (value + 1), the turns they
+ * were searched to and the best move's index */
+#define SOLVER_PACK(lo, hi, turns, move) \
+    ((uint64_t)((lo) + 1) | (uint64_t)((hi) + 1) << 2 | \
+     (uint64_t)(turns) << 4 | (uint64_t)(move) << 12 | (uint64_t)1 << 21)
+#define SOLVER_LO(d)       ((int)((d) & 3) - 1)
+#define SOLVER_HI(d)       ((int)((d) >> 2 & 3) - 1)
+#define SOLVER_TURNS(d)    ((int)((d) >> 4 & 0xFF))
+#define SOLVER_MOVE(d)     ((uint16_t)((d) >> 12 & 0x1FF))
+
+typedef struct {
+    _Atomic uint64_t* entries;
+    uint64_t          mask;
+    uint64_t          max_nodes;
+    uint8_t           seat;
+    atomic_ullong     nodes;
+    atomic_int        stop;
+    atomic_int        out_of_nodes;
+} SolverShared;
+
+/* One search thread */
+typedef struct {
+    SolverShared* shared;
+    Game          game;
+    Move*         moves;         /* SOLVER_MAX_MOVES per turn of depth */
+    MoveUndo      undo[SOLVER_MAX_TURNS + 1];
+    uint8_t       id;
+    uint8_t       max_turns;
+    uint8_t       ply;
+    bool_t        aborted;
+    uint64_t      nodes;         /* Not yet added to the shared count */
+    uint64_t      hits;
+    uint64_t      total_nodes;
+    int           value;
+    uint8_t       turns;
+    uint16_t      root_best;     /* Index into moves[0..) */
+    uint16_t      root_count;
+    pthread_t     thread;
+    bool_t        started;
+} SolverThread;
+
+static double solver_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void rachel_solver_default_config(SolverConfig* config) {
+    config->max_nodes = 1000000;
+    config->max_turns = 64;
+    config->table_bits = 20;
+    config->threads = 1;
+}
+
+bool_t rachel_solver_table_init(SolverTable* table, uint8_t bits) {
+    uint64_t count;
+
+    bits = bits < 4 ? 4 : bits > 30 ? 30 : bits;
+    count = (uint64_t)1 << bits;
+    table->entries = (uint64_t*)calloc((size_t)count, 2 * sizeof(uint64_t));
+    table->mask = table->entries ? count - 1 : 0;
+    return table->entries != 0;
+}
+
+void rachel_solver_table_clear(SolverTable* table) {
+    if (table->entries) {
+        memset(table->entries, 0, (size_t)(table->mask + 1) * 2 * sizeof(uint64_t));
+    }
+}
+
+void rachel_solver_table_free(SolverTable* table) {
+    free(table->entries);
+    table->entries = 0;
+    table->mask = 0;
+}
+
+/* ----- Moves ----- */
+
+static uint16_t solver_add(Move* moves, uint16_t count, const Card* cards,
+                           uint8_t card_count, bool_t nominates) {
+    uint8_t suit, suits = nominates ? 4 : 1;
+
+    for (suit = 0; suit < suits && count < SOLVER_MAX_MOVES; suit++) {
+        moves[count].type = MOVE_PLAY;
+        memcpy(moves[count].cards, cards, card_count * sizeof(Card));
+        moves[count].count = card_count;
+        moves[count].nominated_suit = suit;
+        count++;
+    }
+    return count;
+}
+
+/*
+ * The rules look at the first card of a stack for its effect and the
+ * last for the new top card; the cards between change nothing but the
+ * order of the pile. So a move is a playable first card, a set of the
+ * same rank to go with it, which of those ends on top and, for aces
+ * and jokers, the suit. Jokers are identical, so only how many.
+ * Bigger stacks come first: going out sooner is usually the point.
+ */
+uint16_t rachel_solver_moves(const Game* game, Move* moves) {
+    const Player* player = &game->players[game->current_player_index];
+    uint64_t valid = rachel_valid_plays_mask(game, game->current_player_index);
+    uint64_t firsts, same, sub, rest, jokers;
+    uint16_t count = 0;
+    uint8_t top, n, size;
+    Card cards[RACHEL_MAX_PLAY];
+    bool_t nominates;
+
+    if (valid == 0) {
+        moves[0].type = MOVE_PASS;
+        moves[0].count = 0;
+        moves[0].nominated_suit = 0;
+        return 1;
+    }
+
+    for (size = RACHEL_MAX_PLAY; size > 0; size--) {
+        for (firsts = valid & (RACHEL_MASK_STANDARD | RACHEL_JOKER_BIT); firsts;
+             firsts &= firsts - 1) {
+            cards[0] = rachel_card_from_index(RACHEL_MASK_LOWEST(firsts));
+            nominates = IS_ACE(cards[0].encoded) || IS_JOKER(cards[0].encoded);
+            same = rachel_mask_remove(player->hand_mask &
+                       (IS_JOKER(cards[0].encoded) ? RACHEL_MASK_JOKERS :
+                        rachel_rank_masks[GET_RANK(cards[0].encoded)]), cards[0]);
+
+            /* Every subset of the rest of the rank with size - 1 cards */
+            sub = 0;
+            do {
+                jokers = sub >> STANDARD_DECK;
+                if (RACHEL_MASK_COUNT(sub) != size - 1 || (jokers & (jokers + 1)) != 0) {
+                    /* Wrong size, or not the lowest jokers of the count */
+                } else if (sub == 0 || jokers) {
+                    for (n = 1; n < size; n++) {
+                        cards[n] = cards[0];
+                    }
+                    count = solver_add(moves, count, cards, size, nominates);
+                } else {
+                    /* Each card of the set on top in turn */
+                    for (top = 0; top < STANDARD_DECK; top++) {
+                        if (!(sub >> top & 1)) {
+                            continue;
+                        }
+                        n = 1;
+                        for (rest = sub & ~((uint64_t)1 << top); rest; rest &= rest - 1) {
+                            cards[n++] = rachel_card_from_index(RACHEL_MASK_LOWEST(rest));
+                        }
+                        cards[n] = rachel_card_from_index(top);
+                        count = solver_add(moves, count, cards, size, nominates);
+                    }
+                }
+                sub = (sub - same) & same;
+            } while (sub != 0);
+        }
+    }
+    return count;
+}
+
+/* ----- Table ----- */
+
+/* The hash leaves out the piles and the RNG; a double-dummy future
+ * depends on both, so fold them in */
+static uint64_t solver_key(const Game* game) {
+    uint64_t key = game->hash ^ (game->rng.state * 0x9E3779B97F4A7C15ULL);
+    const Card* pile;
+    uint8_t i;
+
+    pile = RACHEL_DECK(game);
+    for (i = 0; i < game->deck_count; i++) {
+        key = (key ^ pile[i].encoded) * 0x100000001B3ULL;
+    }
+    key ^= (uint64_t)game->deck_count << 56;
+    pile = RACHEL_DISCARD(game);
+    for (i = 0; i < game->discard_count; i++) {
+        key = (key ^ pile[i].encoded) * 0x100000001B3ULL;
+    }
+    return key ^ (uint64_t)game->discard_count << 48;
+}
+
+static bool_t solver_probe(SolverShared* shared, uint64_t key, uint64_t* data) {
+    _Atomic uint64_t* entry = &shared->entries[2 * (key & shared->mask)];
+    uint64_t check = atomic_load_explicit(&entry[0], memory_order_relaxed);
+
+    *data = atomic_load_explicit(&entry[1], memory_order_relaxed);
+    return *data != 0 && (check ^ *data) == key;
+}
+
+static void solver_store(SolverShared* shared, uint64_t key, uint64_t data) {
+    _Atomic uint64_t* entry = &shared->entries[2 * (key & shared->mask)];
+
+    atomic_store_explicit(&entry[0], key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&entry[1], data, memory_order_relaxed);
+}
+
+/* ----- Search ----- */
+
+static void solver_flush(SolverThread* thread) {
+    SolverShared* shared = thread->shared;
+    uint64_t total;
+
+    total = atomic_fetch_add(&shared->nodes, thread->nodes) + thread->nodes;
+    thread->total_nodes += thread->nodes;
+    thread->nodes = 0;
+    if (shared->max_nodes > 0 && total >= shared->max_nodes) {
+        atomic_store(&shared->out_of_nodes, 1);
+        atomic_store(&shared->stop, 1);
+    }
+}
+
+/* Value for the seat: 1 win, -1 loss, 0 not decided within turns */
+static int solver_search(SolverThread* thread, int turns, int alpha, int beta) {
+    SolverShared* shared = thread->shared;
+    Game* game = &thread->game;
+    Move* moves = thread->moves + (size_t)thread->ply * SOLVER_MAX_MOVES;
+    uint64_t key = 0, data;
+    uint16_t count, i, pick, best_move = SOLVER_NO_MOVE, hint = SOLVER_NO_MOVE;
+    int value, best, alpha_in = alpha, beta_in = beta, lo, hi;
+    bool_t maximize = game->current_player_index == shared->seat;
+    Move swap;
+
+    if (++thread->nodes >= SOLVER_FLUSH) {
+        solver_flush(thread);
+    }
+    if (atomic_load_explicit(&shared->stop, memory_order_relaxed)) {
+        thread->aborted = TRUE;
+        return 0;
+    }
+    if (turns == 0) {
+        return 0;
+    }
+
+    if (turns > 1) {
+        key = solver_key(game);
+        if (solver_probe(shared, key, &data)) {
+            thread->hits++;
+            lo = SOLVER_LO(data);
+            hi = SOLVER_HI(data);
+            if (lo == 1 || hi == -1) {
+                return lo == 1 ? 1 : -1;     /* Proven, at any depth */
+            }
+            if (SOLVER_TURNS(data) >= turns) {
+                if (lo >= beta) {
+                    return lo;
+                }
+                if (hi <= alpha) {
+                    return hi;
+                }
+                alpha = lo > alpha ? lo : alpha;
+                beta = hi < beta ? hi : beta;
+            }
+            hint = SOLVER_MOVE(data);
+        }
+    }
+
+    count = rachel_solver_moves(game, moves);
+    if (hint < count && hint > 0) {
+        swap = moves[0];
+        moves[0] = moves[hint];
+        moves[hint] = swap;
+    }
+
+    best = maximize ? -2 : 2;
+    for (i = 0; i < count; i++) {
+        /* Helpers start elsewhere in the list, after the table's move */
+        pick = i;
+        if (thread->id > 0 && i > 0 && count > 2) {
+            pick = (uint16_t)(1 + (i - 1 + thread->id + thread->ply) % (count - 1));
+        }
+
+        rachel_make_move(game, &moves[pick], &thread->undo[thread->ply]);
+        if (game->winner_count > 0) {
+            value = game->players[shared->seat].finish_position == 1 ? 1 : -1;
+        } else {
+            thread->ply++;
+            value = solver_search(thread, turns - 1, alpha, beta);
+            thread->ply--;
+        }
+        rachel_unmake_move(game, &thread->undo[thread->ply]);
+        if (thread->aborted) {
+            return 0;
+        }
+
+        if (maximize ? value > best : value < best) {
+            best = value;
+            best_move = pick;
+        }
+        if (maximize) {
+            alpha = best > alpha ? best : alpha;
+        } else {
+            beta = best < beta ? best : beta;
+        }
+        if (alpha >= beta) {
+            break;
+        }
+    }
+
+    /* Indexes are kept as generated, before the hint swap */
+    if (hint < count && hint > 0) {
+        best_move = best_move == 0 ? hint : best_move == hint ? 0 : best_move;
+    }
+    if (thread->ply == 0) {
+        thread->root_best = best_move;
+        thread->root_count = count;
+    }
+    if (turns > 1) {
+        lo = best >= beta_in ? best : best <= alpha_in ? -1 : best;
+        hi = best <= alpha_in ? best : best >= beta_in ? 1 : best;
+        solver_store(shared, key, SOLVER_PACK(lo, hi, turns, best_move));
+    }
+    return best;
+}
+
+/* Deepen one turn at a time until proven, out of turns or stopped */
+static void* solver_run(void* arg) {
+    SolverThread* thread = (SolverThread*)arg;
+    int value, turns;
+
+    thread->value = 0;
+    thread->turns = 0;
+    thread->root_best = SOLVER_NO_MOVE;
+    for (turns = 1; turns <= thread->max_turns; turns++) {
+        value = solver_search(thread, turns, -1, 1);
+        if (thread->aborted) {
+            break;
+        }
+        thread->value = value;
+        thread->turns = (uint8_t)turns;
+        if (value != 0) {
+            break;
+        }
+    }
+    solver_flush(thread);
+    return 0;
+}
+
+bool_t rachel_solve(const Game* game, uint8_t seat, const SolverConfig* config,
+                    SolverTable* table, SolverResult* result) {
+    SolverShared shared;
+    SolverThread* threads;
+    SolverTable local;
+    Move root_moves[SOLVER_MAX_MOVES];
+    double start = solver_now_ms(), seconds;
+    uint8_t count, t;
+    bool_t ok = TRUE;
+
+    memset(result, 0, sizeof(*result));
+    if (game->winner_count > 0) {
+        result->value = game->players[seat].finish_position == 1 ? SOLVE_WIN : SOLVE_LOSS;
+        return TRUE;
+    }
+
+    local.entries = 0;
+    if (table == 0) {
+        if (!rachel_solver_table_init(&local, config->table_bits)) {
+            return FALSE;
+        }
+        table = &local;
+    }
+
+    count = config->threads == 0 ? 1 :
+            config->threads > SOLVER_MAX_THREADS ? SOLVER_MAX_THREADS : config->threads;
+    threads = (SolverThread*)calloc(count, sizeof(SolverThread));
+    if (threads == 0) {
+        rachel_solver_table_free(&local);
+        return FALSE;
+    }
+
+    shared.entries = (_Atomic uint64_t*)table->entries;
+    shared.mask = table->mask;
+    shared.max_nodes = config->max_nodes;
+    shared.seat = seat;
+    atomic_init(&shared.nodes, 0);
+    atomic_init(&shared.stop, 0);
+    atomic_init(&shared.out_of_nodes, 0);
+
+    for (t = 0; t < count; t++) {
+        threads[t].shared = &shared;
+        threads[t].game = *game;
+        threads[t].id = t;
+        threads[t].max_turns = config->max_turns == 0 ? 1 :
+            config->max_turns > SOLVER_MAX_TURNS ? SOLVER_MAX_TURNS : config->max_turns;
+        threads[t].moves = (Move*)malloc((size_t)(threads[t].max_turns + 1) *
+                                         SOLVER_MAX_MOVES * sizeof(Move));
+        if (threads[t].moves == 0) {
+            ok = FALSE;
+        }
+    }
+
+    /* Thread 0 searches on the caller's thread; when it is done, so are
+     * the helpers */
+    for (t = 1; t < count && ok; t++) {
+        threads[t].started =
+            pthread_create(&threads[t].thread, 0, solver_run, &threads[t]) == 0;
+    }
+    if (ok) {
+        solver_run(&threads[0]);
+    }
+    atomic_store(&shared.stop, 1);
+    for (t = 1; t < count; t++) {
+        if (threads[t].started) {
+            pthread_join(threads[t].thread, 0);
+        }
+        result->table_hits += threads[t].hits;
+    }
+
+    if (ok) {
+        result->value = (SolveValue)threads[0].value;
+        result->turns = threads[0].turns;
+        result->table_hits += threads[0].hits;
+        result->out_of_nodes = atomic_load(&shared.out_of_nodes) != 0;
+        if (threads[0].root_best != SOLVER_NO_MOVE &&
+            game->current_player_index == seat &&
+            rachel_solver_moves(game, root_moves) == threads[0].root_count) {
+            result->best = root_moves[threads[0].root_best];
+            result->has_best = TRUE;
+        }
+    }
+    result->nodes = atomic_load(&shared.nodes);
+    result->elapsed_ms = solver_now_ms() - start;
+    seconds = result->elapsed_ms / 1000.0;
+    result->nodes_per_sec = seconds > 0 ? result->nodes / seconds : 0.0;
+
+    for (t = 0; t < count; t++) {
+        free(threads[t].moves);
+    }
+    free(threads);
+    rachel_solver_table_free(&local);
+    return ok;
+}
+
+SolveValue rachel_solve_leaf(const Game* game, uint8_t seat, uint64_t max_nodes,
+                             SolverTable* table) {
+    SolverConfig config;
+    SolverResult result;
+
+    rachel_solver_default_config(&config);
+    config.max_nodes = max_nodes;
+    config.threads = 1;
+    if (!rachel_solve(game, seat, &config, table, &result)) {
+        return SOLVE_UNKNOWN;
+    }
+    return result.value;
+}
+
+/* ----- Self test ----- */
+
+/* Plain minimax to a fixed number of turns: no table, no pruning */
+static int solver_brute(Game* game, uint8_t seat, int turns) {
+    Move moves[SOLVER_MAX_MOVES];
+    MoveUndo undo;
+    uint16_t count, i;
+    int value, best;
+    bool_t maximize = game->current_player_index == seat;
+
+    if (turns == 0) {
+        return 0;
+    }
+    count = rachel_solver_moves(game, moves);
+    best = maximize ? -1 : 1;
+    for (i = 0; i < count; i++) {
+        if (!rachel_make_move(game, &moves[i], &undo)) {
+            return 2;    /* An illegal move: fails the test */
+        }
+        value = game->winner_count > 0 ?
+                (game->players[seat].finish_position == 1 ? 1 : -1) :
+                solver_brute(game, seat, turns - 1);
+        rachel_unmake_move(game, &undo);
+        if (value == 2) {
+            return 2;
+        }
+        best = maximize ? (value > best ? value : best) : (value < best ? value : best);
+    }
+    return best;
+}
+
+bool_t rachel_solver_self_test(void) {
+    const int turns = 8;
+    SolverConfig config;
+    SolverResult result, again;
+    SolverTable table;
+    MoveUndo undo;
+    RachelRng rng;
+    Game game;
+    uint8_t seat, i, fewest, total;
+    int seed, brute, decided = 0, positions = 0;
+    bool_t ok = TRUE;
+
+    if (!rachel_solver_table_init(&table, 16)) {
+        return FALSE;
+    }
+    rachel_solver_default_config(&config);
+    config.max_nodes = 0;
+    config.max_turns = turns;
+    rachel_rng_seed(&rng, 0x17, 0);
+
+    for (seed = 0; seed < 60 && ok; seed++) {
+        rachel_test_deal(&game, (uint8_t)(2 + seed % 2), (seed >> 1) & 1, 17, seed);
+
+        /* Play on until someone is close to going out */
+        for (;;) {
+            if (rachel_is_game_over(&game) || game.winner_count > 0 ||
+                game.turn_count > 500) {
+                break;
+            }
+            fewest = MAX_HAND_SIZE;
+            total = 0;
+            for (i = 0; i < game.player_count; i++) {
+                fewest = game.players[i].hand_count < fewest ?
+                         game.players[i].hand_count : fewest;
+                total += game.players[i].hand_count;
+            }
+            if (fewest <= 2 && total <= 10) {
+                break;
+            }
+            rachel_ai_take_turn(&game, &rachel_ai_policies[seed % 3], &rng);
+        }
+        if (game.winner_count > 0 || game.turn_count > 500) {
+            continue;
+        }
+
+        /* Same answer as brute force, with and without helper threads */
+        seat = (uint8_t)(seed % game.player_count);
+        brute = solver_brute(&game, seat, turns);
+        rachel_solver_table_clear(&table);
+        config.threads = 1 + seed % 2;
+        ok = brute != 2 && rachel_solve(&game, seat, &config, &table, &result) &&
+             result.value * brute != -1 && (brute == 0 || result.value == brute) &&
+             result.nodes > 0;
+        positions++;
+        decided += brute != 0;
+
+        /* A winning move keeps the win */
+        if (ok && result.value == SOLVE_WIN && game.current_player_index == seat) {
+            ok = result.has_best && rachel_make_move(&game, &result.best, &undo) &&
+                 (game.winner_count > 0 ?
+                  game.players[seat].finish_position == 1 :
+                  rachel_solve(&game, seat, &config, &table, &again) &&
+                  again.value == SOLVE_WIN);
+        }
+    }
+
+    rachel_solver_table_free(&table);
+    return ok && positions > 10 && decided > 0;
+}
+
+/*
+ * End of solver.
+ *
+ * Perfect play, for everyone who can see every card.
+ */
@@ -0,0 +1,97 @@
+/*
+ * RACHEL ENDGAME SOLVER
+ *
+ * Exact search with every card face up: all hands, and the deck as the
+ * game's own RNG stream will deal it (double dummy, as bridge players
+ * say). It answers one question for one seat: can they force being
+ * first out, whatever everyone else does? With more than two players
+ * the others are assumed to play together against that seat.
+ *
+ * Alpha-beta over rachel_make_move / rachel_unmake_move, every legal
+ * play considered: each playable first card, each set of same-rank
+ * cards stacked on it, each card that could end on top, each suit an
+ * ace or joker could nominate. Forced passes - draws, penalties, skips
+ * - are single moves. Iterative deepening on turns: a win or loss found
+ * at any depth is proven, and "unknown" only means not within the
+ * turns searched.
+ *
+ * Positions are remembered in a fixed-size transposition table shared
+ * by all search threads without locks: each entry is stored as two
+ * words, key ^ data and data, so a torn write reads back as a miss.
+ *
+ * "Show me your cards and I will tell you how it ends."
+ */
+
+#ifndef RACHEL_SOLVER_H
+#define RACHEL_SOLVER_H
+
+#include "rules.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SOLVER_MAX_THREADS   64
+#define SOLVER_MAX_TURNS     250
+#define SOLVER_MAX_MOVES     480    /* Four aces and a full suit: about 380 */
+
+typedef enum {
+    SOLVE_LOSS = -1,      /* Someone else can be made to go out first */
+    SOLVE_UNKNOWN = 0,    /* Neither, within the turns or nodes allowed */
+    SOLVE_WIN = 1         /* The seat goes out first, however others play */
+} SolveValue;
+
+typedef struct {
+    uint64_t max_nodes;        /* Node budget over all threads, 0 = none */
+    uint8_t  max_turns;        /* Deepest iteration, up to SOLVER_MAX_TURNS */
+    uint8_t  table_bits;       /* 2^bits table entries, 16 bytes each */
+    uint8_t  threads;          /* Threads sharing the table, 1 = no threads */
+} SolverConfig;
+
+typedef struct {
+    SolveValue value;
+    Move       best;           /* For the seat, if it is their turn */
+    bool_t     has_best;
+    uint8_t    turns;          /* Depth of the last finished iteration */
+    bool_t     out_of_nodes;
+    uint64_t   nodes;          /* Positions visited, all threads */
+    uint64_t   table_hits;
+    double     elapsed_ms;
+    double     nodes_per_sec;
+} SolverResult;
+
+/* A table of 2^bits entries, reusable across solves of one game */
+typedef struct {
+    uint64_t* entries;         /* Two words per entry */
+    uint64_t  mask;
+} SolverTable;
+
+/* 1M nodes, 64 turns, 2^20 entries (16 MB), one thread */
+void rachel_solver_default_config(SolverConfig* config);
+
+bool_t rachel_solver_table_init(SolverTable* table, uint8_t bits);
+void rachel_solver_table_clear(SolverTable* table);
+void rachel_solver_table_free(SolverTable* table);
+
+/* Solve for seat. table may be NULL for a private one sized by the
+ * config. game is not changed. */
+bool_t rachel_solve(const Game* game, uint8_t seat, const SolverConfig* config,
+                    SolverTable* table, SolverResult* result);
+
+/* Leaf evaluation inside another search: one thread, a small budget,
+ * the caller's table. Returns the value for seat. */
+SolveValue rachel_solve_leaf(const Game* game, uint8_t seat, uint64_t max_nodes,
+                             SolverTable* table);
+
+/* Every legal whole-turn move for the player to move, in the solver's
+ * order. moves needs room for SOLVER_MAX_MOVES. */
+uint16_t rachel_solver_moves(const Game* game, Move* moves);
+
+/* Small endgames against a brute-force search with no table */
+bool_t rachel_solver_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RACHEL_SOLVER_H */
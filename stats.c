@@ -0,0 +1,466 @@
+/*
+ * RACHEL GAME STATISTICS
+ *
+ * A game is followed from its records alone, counting cards rather
+ * than naming them: hands, deck and discard pile start from the deal
+ * and move with each play, draw and penalty exactly as rachel_draw_cards
+ * moves them, so a reshuffle shows up as the deck running dry with
+ * cards under the top of the pile. END carries the real pile sizes, and
+ * a game whose count disagrees is tallied as mismatched.
+ */
+
+#include <string.h>
+#include <stdatomic.h>
+#include "stats.h"
+#include "eventlog.h"
+#include "ai.h"
+
+/* One game as it is read */
+typedef struct {
+    StatsTable* table;
+    uint8_t     players;
+    uint8_t     hand[MAX_PLAYERS];
+    uint8_t     deck, discard;
+    uint8_t     first_out;          /* Seat, or MAX_PLAYERS */
+    uint64_t    turns;
+} StatsGame;
+
+/* Values below two steps get a bucket each; above, STATS_LENGTH_STEPS
+ * buckets split each power of two */
+static unsigned stats_length_bucket(uint64_t turns) {
+    unsigned octave;
+
+    if (turns < 2 * STATS_LENGTH_STEPS) {
+        return (unsigned)turns;
+    }
+    if (turns > 0xFFFF) {
+        turns = 0xFFFF;
+    }
+#if defined(__GNUC__)
+    octave = 63 - (unsigned)__builtin_clzll(turns);
+#else
+    for (octave = 5; (turns >> (octave + 1)) != 0; octave++) {
+    }
+#endif
+    return (octave - 3) * STATS_LENGTH_STEPS +
+           (unsigned)((turns >> (octave - 4)) & (STATS_LENGTH_STEPS - 1));
+}
+
+/* Largest value that lands in a bucket */
+static uint64_t stats_length_upper(unsigned bucket) {
+    unsigned octave;
+
+    if (bucket < 2 * STATS_LENGTH_STEPS) {
+        return bucket;
+    }
+    octave = bucket / STATS_LENGTH_STEPS + 3;
+    return (((uint64_t)(STATS_LENGTH_STEPS + bucket % STATS_LENGTH_STEPS) + 1)
+            << (octave - 4)) - 1;
+}
+
+/* Lock-free folds into a total other threads may be merging into */
+static void stats_add(uint64_t* total, uint64_t part) {
+    if (part == 0) {
+        return;
+    }
+    atomic_fetch_add_explicit((_Atomic uint64_t*)total, part, memory_order_relaxed);
+}
+
+static void stats_add_all(uint64_t* total, const uint64_t* part, unsigned count) {
+    unsigned i;
+
+    for (i = 0; i < count; i++) {
+        stats_add(&total[i], part[i]);
+    }
+}
+
+static void stats_max(uint64_t* total, uint64_t part) {
+    _Atomic uint64_t* shared = (_Atomic uint64_t*)total;
+    uint64_t seen = atomic_load_explicit(shared, memory_order_relaxed);
+
+    while (part > seen &&
+           !atomic_compare_exchange_weak_explicit(shared, &seen, part,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+void rachel_stats_init(GameStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+/* Take up to count cards the way rachel_draw_cards does */
+static void stats_draw(StatsGame* game, uint8_t player, uint8_t count) {
+    while (count > 0) {
+        if (game->deck == 0) {
+            if (game->discard <= 1) {
+                break;
+            }
+            game->deck = (uint8_t)(game->discard - 1);
+            game->discard = 1;
+            game->table->reshuffles++;
+        }
+        game->deck--;
+        game->hand[player]++;
+        game->table->drawn++;
+        count--;
+    }
+}
+
+static void stats_start(StatsGame* game, GameStats* stats, const EventRecord* record) {
+    uint8_t hand_size = rachel_calculate_hand_size(record->player);
+    uint8_t i;
+
+    game->table = &stats->players[record->player];
+    game->players = record->player;
+    for (i = 0; i < game->players; i++) {
+        game->hand[i] = hand_size;
+    }
+    game->deck = (uint8_t)((record->arg ? ULTIMATE_DECK : STANDARD_DECK) -
+                           game->players * hand_size - 1);
+    game->discard = 1;
+    game->first_out = MAX_PLAYERS;
+    game->turns = 0;
+}
+
+static void stats_play(StatsGame* game, const EventRecord* record) {
+    StatsTable* table = game->table;
+    uint8_t i;
+
+    table->plays++;
+    for (i = 0; i < record->count; i++) {
+        table->played[GET_RANK(record->cards[i]) & RANK_JOKER]++;
+        if (IS_BLACK_JACK(record->cards[i])) {
+            table->black_jacks++;
+        }
+    }
+    game->discard = (uint8_t)(game->discard + record->count);
+    game->hand[record->player] = (uint8_t)(game->hand[record->player] - record->count);
+    if (game->hand[record->player] == 0 && game->first_out == MAX_PLAYERS) {
+        game->first_out = record->player;
+    }
+}
+
+static void stats_effect(StatsGame* game, const EventRecord* record) {
+    StatsTable* table = game->table;
+    uint8_t size = record->count < STATS_MAX_PENALTY ? record->count :
+                   STATS_MAX_PENALTY;
+
+    if (record->arg == RANK_7) {
+        table->skips += record->count;
+        game->turns += record->count;   /* Each skip is a rachel_next_turn */
+        return;
+    }
+    if (record->arg == RANK_2) {
+        table->twos[size]++;
+    } else if (record->arg == RANK_JACK) {
+        table->jacks[size]++;
+    }
+    stats_draw(game, record->player, record->count);
+}
+
+static void stats_end(StatsGame* game, const EventRecord* record) {
+    StatsTable* table = game->table;
+
+    table->games++;
+    table->turns += game->turns;
+    table->length[stats_length_bucket(game->turns)]++;
+    if (game->turns > table->longest) {
+        table->longest = game->turns;
+    }
+    if (game->first_out < MAX_PLAYERS) {
+        table->wins[game->first_out]++;
+    } else {
+        table->capped++;
+    }
+    if (record->cards[0] != game->deck || record->cards[1] != game->discard) {
+        table->mismatched++;
+    }
+}
+
+void rachel_stats_add_records(GameStats* stats, const uint8_t* records,
+                              uint32_t count) {
+    EventRecord record;
+    StatsGame game;
+    bool_t in_game = FALSE;
+    uint32_t i;
+
+    memset(&game, 0, sizeof(game));     /* Set by GAME; -O1 cannot tell */
+    for (i = 0; i < count; i++) {
+        rachel_log_decode(records + (size_t)i * EVENT_RECORD_SIZE, &record);
+        if (record.type == EVENT_GAME) {
+            in_game = record.player >= 2 && record.player <= MAX_PLAYERS;
+            if (in_game) {
+                stats_start(&game, stats, &record);
+            }
+            continue;
+        }
+        if (!in_game || record.player >= game.players) {
+            continue;
+        }
+        switch (record.type) {
+        case EVENT_PLAY:
+            if (record.count <= RACHEL_MAX_PLAY &&
+                record.count <= game.hand[record.player]) {
+                stats_play(&game, &record);
+            }
+            break;
+        case EVENT_DRAW:
+            stats_draw(&game, record.player, record.count);
+            break;
+        case EVENT_EFFECT:
+            stats_effect(&game, &record);
+            break;
+        case EVENT_TURN:
+            game.turns++;
+            break;
+        case EVENT_END:
+            stats_end(&game, &record);
+            in_game = FALSE;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void rachel_stats_tap(void* stats, const uint8_t* records, uint32_t count) {
+    rachel_stats_add_records((GameStats*)stats, records, count);
+}
+
+void rachel_stats_merge(GameStats* total, const GameStats* part) {
+    StatsTable* to;
+    const StatsTable* from;
+    int p;
+
+    for (p = 2; p <= MAX_PLAYERS; p++) {
+        to = &total->players[p];
+        from = &part->players[p];
+        if (from->games == 0 && from->plays == 0) {
+            continue;
+        }
+        stats_add(&to->games, from->games);
+        stats_add(&to->capped, from->capped);
+        stats_add(&to->turns, from->turns);
+        stats_max(&to->longest, from->longest);
+        stats_add_all(to->wins, from->wins, MAX_PLAYERS);
+        stats_add_all(to->length, from->length, STATS_LENGTH_BUCKETS);
+        stats_add(&to->plays, from->plays);
+        stats_add_all(to->played, from->played, RANK_JOKER + 1);
+        stats_add(&to->black_jacks, from->black_jacks);
+        stats_add(&to->drawn, from->drawn);
+        stats_add(&to->reshuffles, from->reshuffles);
+        stats_add_all(to->twos, from->twos, STATS_MAX_PENALTY + 1);
+        stats_add_all(to->jacks, from->jacks, STATS_MAX_PENALTY + 1);
+        stats_add(&to->skips, from->skips);
+        stats_add(&to->mismatched, from->mismatched);
+    }
+}
+
+uint64_t rachel_stats_length_quantile(const StatsTable* table, double fraction) {
+    uint64_t target = (uint64_t)(fraction * table->games);
+    uint64_t seen = 0, upper;
+    unsigned i;
+
+    for (i = 0; i < STATS_LENGTH_BUCKETS; i++) {
+        seen += table->length[i];
+        if (seen > target) {
+            upper = stats_length_upper(i);
+            return upper < table->longest ? upper : table->longest;
+        }
+    }
+    return table->longest;
+}
+
+static void stats_row(FILE* file, int players, const char* figure,
+                      const char* key, double value) {
+    fprintf(file, "%d,%s,%s,%.15g\n", players, figure, key, value);
+}
+
+/* Penalty histogram rows, sizes that happened only */
+static void stats_penalty_rows(FILE* file, int players, const char* figure,
+                               const uint64_t* sizes) {
+    char key[8];
+    int size;
+
+    for (size = 1; size <= STATS_MAX_PENALTY; size++) {
+        if (sizes[size] != 0) {
+            snprintf(key, sizeof(key), "%d", size);
+            stats_row(file, players, figure, key, (double)sizes[size]);
+        }
+    }
+}
+
+bool_t rachel_stats_write_csv(const GameStats* stats, FILE* file) {
+    static const char* const quantiles[] = { "p50", "p90", "p99" };
+    static const double fractions[] = { 0.50, 0.90, 0.99 };
+    static const uint8_t specials[] = {
+        RANK_2, RANK_7, RANK_JACK, RANK_QUEEN, RANK_ACE, RANK_JOKER
+    };
+    static const char* const special_names[] = {
+        "2", "7", "jack", "queen", "ace", "joker"
+    };
+    const StatsTable* table;
+    double games;
+    char key[16];
+    int p, i;
+
+    fprintf(file, "players,figure,key,value\n");
+    for (p = 2; p <= MAX_PLAYERS; p++) {
+        table = &stats->players[p];
+        if (table->games == 0) {
+            continue;
+        }
+        games = (double)table->games;
+        stats_row(file, p, "games", "", games);
+        stats_row(file, p, "hand_size", "", rachel_calculate_hand_size((uint8_t)p));
+        stats_row(file, p, "capped", "", (double)table->capped);
+        stats_row(file, p, "mismatched", "", (double)table->mismatched);
+        for (i = 0; i < p; i++) {
+            snprintf(key, sizeof(key), "seat%d", i);
+            stats_row(file, p, "wins", key, (double)table->wins[i]);
+            stats_row(file, p, "win_rate", key, table->wins[i] / games);
+        }
+        stats_row(file, p, "turns", "mean", table->turns / games);
+        for (i = 0; i < 3; i++) {
+            stats_row(file, p, "turns", quantiles[i],
+                      (double)rachel_stats_length_quantile(table, fractions[i]));
+        }
+        stats_row(file, p, "turns", "max", (double)table->longest);
+        stats_row(file, p, "plays", "", (double)table->plays);
+        for (i = 0; i < (int)sizeof(specials); i++) {
+            stats_row(file, p, "played", special_names[i],
+                      (double)table->played[specials[i]]);
+            stats_row(file, p, "played_per_game", special_names[i],
+                      table->played[specials[i]] / games);
+        }
+        stats_row(file, p, "played", "black_jack", (double)table->black_jacks);
+        stats_row(file, p, "drawn", "", (double)table->drawn);
+        stats_row(file, p, "skips", "", (double)table->skips);
+        stats_row(file, p, "reshuffles", "", (double)table->reshuffles);
+        stats_row(file, p, "reshuffles_per_game", "", table->reshuffles / games);
+        stats_penalty_rows(file, p, "penalty_two", table->twos);
+        stats_penalty_rows(file, p, "penalty_jack", table->jacks);
+    }
+    return fflush(file) == 0 && !ferror(file);
+}
+
+/* Self test tap: the whole run and one half of it */
+static void stats_test_tap(void* pair, const uint8_t* records, uint32_t count) {
+    rachel_stats_add_records(((GameStats**)pair)[0], records, count);
+    rachel_stats_add_records(((GameStats**)pair)[1], records, count);
+}
+
+bool_t rachel_stats_self_test(void) {
+    static GameStats whole, halves[2], merged;
+    GameStats* pair[2];
+    uint64_t lengths[64], wins[MAX_PLAYERS];
+    uint64_t exact, got;
+    unsigned long played = 0, drawn = 0, held = 0, dealt = 0;
+    StatsTable* table;
+    EventLog log;
+    Game game;
+    RachelRng rng;
+    FILE* file;
+    uint32_t seed, i, j;
+    uint8_t players, seat;
+    bool_t ok = TRUE;
+
+    /* Sketch buckets are contiguous and their edges round-trip */
+    for (exact = 0; exact < 70000 && ok; exact++) {
+        i = stats_length_bucket(exact);
+        ok = i < STATS_LENGTH_BUCKETS &&
+             (exact > 0xFFFF || stats_length_upper(i) >= exact) &&
+             (i == 0 || exact > 0xFFFF || stats_length_upper(i - 1) < exact);
+    }
+
+    rachel_stats_init(&whole);
+    rachel_stats_init(&halves[0]);
+    rachel_stats_init(&halves[1]);
+    rachel_stats_init(&merged);
+    rachel_log_init(&log, NULL);
+    pair[0] = &whole;
+    rachel_log_set_tap(&log, stats_test_tap, pair);
+
+    /* Games of every size, some with jokers, against the Games themselves */
+    for (seed = 0; ok && seed < 64; seed++) {
+        players = (uint8_t)(2 + seed % 7);
+        rachel_test_seat(&game, players, (seed % 3) == 0);
+        rachel_rng_seed(&rng, 23, seed);
+        rachel_log_start_game(&log, &game, 11, seed);
+        while (!rachel_is_game_over(&game) && game.turn_count < 2000) {
+            rachel_ai_take_turn_log(&game, &rachel_ai_policies[seed % 2], &rng, &log);
+        }
+        table = &whole.players[players];
+        memcpy(wins, table->wins, sizeof(wins));
+        pair[1] = &halves[seed % 2];
+        ok = rachel_log_end_game(&log, &game) && log.count == 0;
+
+        if (players == 4) {
+            lengths[seed / 7] = game.turn_count;
+        }
+        dealt += (unsigned long)players * game.starting_hand_size;
+        for (seat = 0; seat < players; seat++) {
+            held += game.players[seat].hand_count;
+            if (table->wins[seat] - wins[seat] !=
+                (game.players[seat].finish_position == 1)) {
+                ok = FALSE;     /* The winner, and only the winner */
+            }
+        }
+        ok = ok && table->mismatched == 0;
+    }
+    rachel_log_free(&log);
+    if (!ok) {
+        return FALSE;
+    }
+
+    /* Cards only move between hands and piles */
+    exact = 0;
+    for (players = 2; players <= MAX_PLAYERS; players++) {
+        table = &whole.players[players];
+        for (i = RANK_2; i <= RANK_JOKER; i++) {
+            played += (unsigned long)table->played[i];
+        }
+        drawn += (unsigned long)table->drawn;
+        exact += table->games;
+    }
+    if (exact != 64 || dealt + drawn != held + played) {
+        return FALSE;
+    }
+
+    /* Merged halves are the whole */
+    rachel_stats_merge(&merged, &halves[0]);
+    rachel_stats_merge(&merged, &halves[1]);
+    if (memcmp(&merged, &whole, sizeof(whole)) != 0) {
+        return FALSE;
+    }
+
+    /* Quantiles within a bucket of the exact order statistic */
+    table = &whole.players[4];
+    for (i = 1; i < table->games; i++) {
+        for (j = i; j > 0 && lengths[j - 1] > lengths[j]; j--) {
+            got = lengths[j];
+            lengths[j] = lengths[j - 1];
+            lengths[j - 1] = got;
+        }
+    }
+    exact = lengths[table->games / 2];
+    got = rachel_stats_length_quantile(table, 0.5);
+    if (got < exact || got > exact + exact / STATS_LENGTH_STEPS + 1) {
+        return FALSE;
+    }
+
+    file = tmpfile();
+    if (file == NULL) {
+        return TRUE;    /* Nowhere to write; the counting is what matters */
+    }
+    ok = rachel_stats_write_csv(&whole, file) && ftell(file) > 0;
+    fclose(file);
+    return ok;
+}
+
+/*
+ * End of stats.
+ *
+ * Every figure here is a count, and every count adds up.
+ */
@@ -0,0 +1,94 @@
+/*
+ * RACHEL GAME STATISTICS
+ *
+ * What happens over many games, broken down by player count, for
+ * tuning the rules - chiefly the starting hand size for each table
+ * size. Fed from the event log: each finished game's records, through
+ * an EventLog tap, so the simulator and the server feed it alike.
+ *
+ *   wins          first out, by seat
+ *   length        turns per game, as a quantile sketch
+ *   played        cards played, by rank; black jacks apart
+ *   twos, jacks   penalties taken, by size of the stack
+ *   skips         turns lost to sevens
+ *   reshuffles    times the discard pile became the deck
+ *
+ * Memory is fixed whatever the number of games: every figure is a
+ * counter or a histogram of counters. Game length goes into log-linear
+ * buckets, STATS_LENGTH_STEPS per power of two, so any quantile is
+ * within about 6% and two sketches merge by adding buckets.
+ *
+ * Each thread keeps its own GameStats and folds it into a shared one
+ * with rachel_stats_merge, which needs no lock: every counter is added
+ * atomically, so any number of threads may merge into one total at
+ * once.
+ *
+ * "Deal a million hands and the deck tells you its secrets."
+ */
+
+#ifndef RACHEL_STATS_H
+#define RACHEL_STATS_H
+
+#include <stdio.h>
+#include "rules.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STATS_LENGTH_STEPS    16
+#define STATS_LENGTH_BUCKETS  ((16 - 3) * STATS_LENGTH_STEPS)  /* To 65535 */
+#define STATS_MAX_PENALTY     31     /* Bigger penalties share the top bucket */
+
+/* Every game of one player count */
+typedef struct {
+    uint64_t games;
+    uint64_t capped;                 /* Ended with nobody out */
+    uint64_t turns;                  /* Over all games */
+    uint64_t longest;
+    uint64_t wins[MAX_PLAYERS];      /* First out, by seat */
+    uint64_t length[STATS_LENGTH_BUCKETS];
+    uint64_t plays;                  /* Turns that played cards */
+    uint64_t played[RANK_JOKER + 1]; /* Cards played, by rank */
+    uint64_t black_jacks;
+    uint64_t drawn;                  /* Cards drawn, penalties included */
+    uint64_t reshuffles;
+    uint64_t twos[STATS_MAX_PENALTY + 1];   /* Penalties taken, by size */
+    uint64_t jacks[STATS_MAX_PENALTY + 1];
+    uint64_t skips;                  /* Turns lost to sevens */
+    uint64_t mismatched;             /* Piles disagreed with END */
+} StatsTable;
+
+typedef struct {
+    StatsTable players[MAX_PLAYERS + 1];   /* By player count */
+} GameStats;
+
+void rachel_stats_init(GameStats* stats);
+
+/* Add whole games of encoded event records, GAME to END. Records
+ * outside a game are skipped. */
+void rachel_stats_add_records(GameStats* stats, const uint8_t* records,
+                              uint32_t count);
+
+/* The same, as an EventTap: the context is the GameStats */
+void rachel_stats_tap(void* stats, const uint8_t* records, uint32_t count);
+
+/* Fold part into total; safe against other threads merging into total */
+void rachel_stats_merge(GameStats* total, const GameStats* part);
+
+/* Upper edge of the bucket holding the given fraction of games,
+ * never above the longest */
+uint64_t rachel_stats_length_quantile(const StatsTable* table, double fraction);
+
+/* One row per figure: players,figure,key,value. Player counts with no
+ * games are left out. Returns FALSE on a write error. */
+bool_t rachel_stats_write_csv(const GameStats* stats, FILE* file);
+
+/* Logged games against the Games that played them, then merges */
+bool_t rachel_stats_self_test(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RACHEL_STATS_H */